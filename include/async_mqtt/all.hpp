@@ -9,10 +9,14 @@
 
 #include <async_mqtt/asio_bind/client.hpp>
 #include <async_mqtt/asio_bind/client_fwd.hpp>
+#include <async_mqtt/asio_bind/client_pool.hpp>
 #include <async_mqtt/asio_bind/endpoint.hpp>
 #include <async_mqtt/asio_bind/endpoint_fwd.hpp>
 #include <async_mqtt/asio_bind/filter.hpp>
 #include <async_mqtt/asio_bind/predefined_layer/mqtt.hpp>
+#include <async_mqtt/asio_bind/publish_message.hpp>
+#include <async_mqtt/asio_bind/reconnecting_client.hpp>
+#include <async_mqtt/asio_bind/resolve_cache.hpp>
 #include <async_mqtt/asio_bind/stream_customize.hpp>
 #include <async_mqtt/protocol/buffer_to_packet_variant.hpp>
 #include <async_mqtt/protocol/connection.hpp>
@@ -7,7 +7,9 @@
 #if !defined(ASYNC_MQTT_ASIO_BIND_CLIENT_HPP)
 #define ASYNC_MQTT_ASIO_BIND_CLIENT_HPP
 
+#include <functional>
 #include <optional>
+#include <vector>
 #include <boost/asio/async_result.hpp>
 #include <boost/asio/any_io_executor.hpp>
 
@@ -17,6 +19,7 @@
 #include <async_mqtt/protocol/error.hpp>
 #include <async_mqtt/protocol/role.hpp>
 #include <async_mqtt/protocol/packet/packet_id_type.hpp>
+#include <async_mqtt/protocol/packet/packet_variant_fwd.hpp>
 #include <async_mqtt/asio_bind/endpoint_fwd.hpp>
 
 namespace async_mqtt {
@@ -41,6 +44,12 @@ public:
     /// @brief executor_type of the given NextLayer
     using executor_type = typename next_layer_type::executor_type;
 
+    /// @brief type of the handler that is set by set_recv_handler()
+    ///
+    /// The parameters are the same as async_recv() Signature.
+    /// Return true to continue reading, false to pause reading until resume_recv() is called.
+    using recv_handler_type = std::function<bool(error_code const&, std::optional<packet_variant>)>;
+
     /// @brief connect packet type
     ///
     /// if Version is v3.1.1 the type is @ref v3_1_1::connect_packet.
@@ -587,6 +596,51 @@ public:
         CompletionToken&& token = as::default_completion_token_t<executor_type>{}
     );
 
+    /**
+     * @brief receive all PUBLISH, DISCONNECT and AUTH packets that are already received, or wait for at least one packet
+     *        The CompletionToken is invoked once for all of them, instead of once per packet as async_recv().
+     *        users CANNOT call recv() or recv_batch() before the previous call's CompletionToken is invoked
+     * @param packets the received packets are stored. It is cleared at the beginning of the operation,
+     *                and its capacity is kept, so the same container can be reused for each call.
+     *                It must be valid until the CompletionToken is invoked.
+     * @param max_count the maximum number of packets to receive. 0 means no limit.
+     * @param token see Signature
+     * @return deduced by token
+     *
+     * ### Completion Token
+     * @li <a href="https://www.boost.org/doc/html/boost_asio/overview/composition/token_adapters.html">Default Completion Token</a> is supported
+     *
+     * #### Signature
+     * void(@ref error_code)
+     *
+     * ##### error_code
+     * @li If an error occurs at an underlying layer while receiving a packet,
+     *     underlying error is set. e.g. system, asio, beast, ...
+     *     The error is reported after the packets that are received before the error,
+     *     so `packets` is empty in this case.
+     * @li If there are no errors during receiving the packets,
+     *     <a href="https://www.boost.org/libs/system/doc/html/system.html#ref_errc">errc::success</a> is set.
+     *     `packets` contains at least one packet. The packet types are the same as async_recv().
+     *
+     * ### Per-Operation Cancellation
+     *
+     *  This asynchronous operation supports cancellation for the following
+     *  [boost::asio::cancellation_type](https://www.boost.org/doc/html/boost_asio/reference/cancellation_type.html) values:
+     *  @li cancellation_type::terminal
+     *  @li cancellation_type::partial
+     *
+     * if they are also supported by the NextLayer type's async_read_some and async_write_some operation.
+     */
+    template <
+        typename CompletionToken = as::default_completion_token_t<executor_type>
+    >
+    auto
+    async_recv_batch(
+        std::vector<packet_variant>& packets,
+        std::size_t max_count,
+        CompletionToken&& token = as::default_completion_token_t<executor_type>{}
+    );
+
     /**
      * @brief executor getter
      * @return return endpoint's  executor.
@@ -683,6 +737,18 @@ public:
      */
     void set_bulk_write(bool val);
 
+    /**
+     * @brief Set the write coalesce threshold.
+     * Packets whose size is less than or equal to `val` are copied into a contiguous
+     * buffer of the stream before writing, instead of being written as a const buffer
+     * sequence that refers to each packet field. In bulk write mode, consecutive small
+     * packets are packed into the same buffer. Larger packets are written without copy.
+     * \n This function should be called before async_start() call.
+     * @note By default the threshold is 0 (disabled)
+     * @param val threshold in bytes. 0 disables coalescing.
+     */
+    void set_write_coalesce_threshold(std::size_t val);
+
     /**
      * @brief Set read buffer size.
      * If bulk read is enabled, the `val` parameter specifies the size of the internal
@@ -693,6 +759,35 @@ public:
      */
     void set_read_buffer_size(std::size_t val);
 
+    /**
+     * @brief Set the receive handler (push mode).
+     * If the handler is set, PUBLISH, DISCONNECT, and AUTH packets are passed to the handler
+     * as soon as they are received, instead of being queued for async_recv().
+     * The handler is invoked on the client's executor, and it is also invoked once with the error
+     * when the underlying layer is closed. async_recv() and async_recv_batch() MUST NOT be called
+     * in push mode.
+     * If the handler returns false, the client stops reading from the underlying layer
+     * until resume_recv() is called, so the number of buffered packets is bounded.
+     * While reading is paused, the responses of other operations, such as PUBACK and PINGRESP,
+     * are not received either.
+     * The handler is invoked for each packet, there is no batch variant. Returning false after
+     * N packets gives the same bound as a batch of N. If you want to get the packets as a batch,
+     * use async_recv_batch() in pull mode.
+     * async_start() starts reading unpaused, even if the previous connection was closed
+     * while reading was paused.
+     * \n This function should be called before async_start() call.
+     * @note By default the handler is not set (pull mode)
+     * @param handler the receive handler. Empty handler means pull mode.
+     */
+    void set_recv_handler(recv_handler_type handler);
+
+    /**
+     * @brief Resume reading that is paused by the receive handler.
+     * It can also be called in the receive handler.
+     * If reading is not paused, nothing happens.
+     */
+    void resume_recv();
+
     // TBD doc later
     template <
         typename... Args
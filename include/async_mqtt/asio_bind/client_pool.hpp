@@ -0,0 +1,379 @@
+// Copyright Takatoshi Kondo 2024
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#if !defined(ASYNC_MQTT_ASIO_BIND_CLIENT_POOL_HPP)
+#define ASYNC_MQTT_ASIO_BIND_CLIENT_POOL_HPP
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include <boost/asio/append.hpp>
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/associated_executor.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/system_executor.hpp>
+
+#include <async_mqtt/asio_bind/client.hpp>
+#include <async_mqtt/asio_bind/publish_message.hpp>
+#include <async_mqtt/asio_bind/reconnecting_client.hpp>
+#include <async_mqtt/protocol/error.hpp>
+#include <async_mqtt/util/hash_ring.hpp>
+#include <async_mqtt/util/move.hpp>
+
+namespace async_mqtt {
+
+namespace as = boost::asio;
+
+/**
+ * @brief Pool of clients that routes PUBLISH packets by the topic
+ *
+ * Each member is an independent client that has its own connection and executor,
+ * so members can run on different io_contexts.
+ * A PUBLISH packet is sent by the member that is chosen by the consistent hash of the topic,
+ * so the packets that have the same topic are sent in order by the same member.
+ * If a member is unavailable, its topics are moved to the other members until it is
+ * available again, and the other topics are not moved.
+ *
+ * The member type is @ref client or @ref reconnecting_client.
+ * @li @ref reconnecting_client members reconnect independently. The pool sets their
+ *     connection handler, so a member is available only while it is connected.
+ *     Use set_connection_handler() of the pool to be notified.
+ * @li @ref client members are available by default. Call set_available() when
+ *     the member's connection is closed and connected again.
+ *
+ * Each member sends the packets in the order of the calls, even if a PUBLISH waits for a
+ * packet_id. The later PUBLISH packets, including QoS0 ones, wait behind it.
+ *
+ * When the topics of a member are moved, the order is kept only among the packets that are
+ * sent by the same member. A PUBLISH that is in flight on the original member, or that
+ * is resent by it after reconnecting, can arrive after the later PUBLISH packets of the
+ * same topic that are sent by the other member.
+ *
+ * Connecting, subscribing, and receiving are done by each member that is returned by at().
+ * For consumers, route() can be used to spread subscriptions over the members, or each
+ * member can subscribe the same shared subscription (`$share/<ShareName>/<TopicFilter>`).
+ *
+ * #### Thread Safety
+ *    @li Distinct objects: Safe
+ *    @li Shared objects: Safe for async_publish(), async_publish_batch(), route(), and
+ *        set_available() after all members are added. Unsafe for emplace().
+ *
+ * @tparam Version       MQTT protocol version.
+ * @tparam NextLayer     Just next layer for client. mqtt, mqtts, ws, and wss are predefined.
+ * @tparam Member        type of the member. client or reconnecting_client.
+ */
+template <
+    protocol_version Version,
+    typename NextLayer,
+    typename Member = client<Version, NextLayer>
+>
+class client_pool {
+public:
+    /// @brief type of the underlying client
+    using client_type = client<Version, NextLayer>;
+
+    /// @brief type of the member
+    using member_type = Member;
+
+    static_assert(
+        std::is_same_v<member_type, client_type> ||
+        std::is_same_v<member_type, reconnecting_client<Version, NextLayer>>,
+        "Member must be client or reconnecting_client"
+    );
+
+    /// @brief type of the handler that is called when a member is connected (true) or disconnected (false)
+    using connection_handler_type = std::function<void(std::size_t index, bool connected)>;
+
+    /// @brief executor_type of the member client
+    using executor_type = typename client_type::executor_type;
+
+    /// @brief response type of async_publish()
+    using pubres_type = typename client_type::pubres_type;
+
+    /// @brief message to publish
+    using message = publish_message;
+
+    /**
+     * @brief constructor
+     * @param vnodes number of points on the consistent hash ring for each member
+     */
+    explicit client_pool(std::size_t vnodes = 160)
+        :ring_{vnodes}
+    {
+    }
+
+    client_pool(client_pool const&) = delete;
+    client_pool& operator=(client_pool const&) = delete;
+
+    /**
+     * @brief Add a member
+     *        A @ref reconnecting_client member is unavailable until it is connected.
+     * @param args arguments of the member constructor. e.g. executor
+     * @return the added member. The reference is valid while the pool is alive.
+     */
+    template <typename... Args>
+    member_type& emplace(Args&&... args) {
+        auto index = members_.size();
+        auto& m = members_.emplace_back(std::forward<Args>(args)...);
+        ring_.insert(index);
+        if constexpr (reconnects) {
+            m.available->store(false);
+            // The member can outlive the pool, so the shared states are captured.
+            m.cl.set_connection_handler(
+                [index, available = m.available, handler = connection_handler_]
+                (bool connected) {
+                    available->store(connected);
+                    if (*handler) (*handler)(index, connected);
+                }
+            );
+        }
+        return m.cl;
+    }
+
+    /**
+     * @brief Set the connection handler
+     *        It is called on the member's executor after the member's availability is updated.
+     *        It is used only for @ref reconnecting_client members.
+     *        \n This function should be called before the members are started.
+     * @param handler the handler that is called with the member index, and true when connected
+     *                or false when disconnected
+     */
+    void set_connection_handler(connection_handler_type handler) {
+        *connection_handler_ = force_move(handler);
+    }
+
+    /**
+     * @brief Get the number of members
+     * @return the number of members
+     */
+    std::size_t size() const {
+        return members_.size();
+    }
+
+    /**
+     * @brief Get the member
+     * @param index member index
+     * @return the member
+     */
+    member_type& at(std::size_t index) {
+        return members_.at(index).cl;
+    }
+
+    /**
+     * @brief Set the member availability
+     *        Call it with false when the member's connection is closed, and with true
+     *        when the member is connected again.
+     *        For @ref reconnecting_client members, it is called by the pool.
+     * @note  By default, a @ref client member is available.
+     * @param index member index
+     * @param val   if true, the member is used for routing, otherwise it is skipped.
+     */
+    void set_available(std::size_t index, bool val) {
+        members_.at(index).available->store(val);
+    }
+
+    /**
+     * @brief Get the member index for the key
+     * @param key TopicName or any key to spread over the members
+     * @return member index. If no member is available, std::nullopt.
+     */
+    std::optional<std::size_t> route(std::string_view key) const {
+        return ring_.find(
+            key,
+            [this](std::size_t index) {
+                return members_[index].available->load();
+            }
+        );
+    }
+
+    /**
+     * @brief publish the message by the member that is chosen by the topic
+     * @param msg   the message to publish
+     * @param token see Signature
+     * @return deduced by token
+     *
+     * ### Completion Token
+     * @li <a href="https://www.boost.org/doc/html/boost_asio/overview/composition/token_adapters.html">Default Completion Token</a> is supported
+     *
+     * #### Signature
+     * void(@ref error_code, @ref pubres_type)
+     *
+     * ##### error_code
+     * @li If no member is available, or the pool has no member, boost::asio::error::not_connected is set.
+     * @li Otherwise, the same as client::async_publish().
+     */
+    template <
+        typename CompletionToken = as::default_completion_token_t<executor_type>
+    >
+    auto
+    async_publish(
+        message msg,
+        CompletionToken&& token = as::default_completion_token_t<executor_type>{}
+    ) {
+        return
+            as::async_initiate<
+                CompletionToken,
+                void(error_code, pubres_type)
+            >(
+                [this](auto handler, message msg) {
+                    auto index = route(msg.topic);
+                    if (!index) {
+                        auto exe = as::get_associated_executor(handler, fallback_executor());
+                        as::post(
+                            exe,
+                            as::append(
+                                force_move(handler),
+                                make_error_code(as::error::not_connected),
+                                pubres_type{}
+                            )
+                        );
+                        return;
+                    }
+                    if constexpr (reconnects) {
+                        members_[*index].cl.async_publish(force_move(msg), force_move(handler));
+                    }
+                    else {
+                        auto& m = members_[*index];
+                        as::dispatch(
+                            m.cl.get_executor(),
+                            [seq = m.seq, msg = force_move(msg), handler = force_move(handler)] () mutable {
+                                seq->publish(force_move(msg), force_move(handler));
+                            }
+                        );
+                    }
+                },
+                token,
+                force_move(msg)
+            );
+    }
+
+    /**
+     * @brief publish the messages, and complete when all of them are completed
+     *        Each message is routed in the same way as async_publish().
+     * @param msgs  the messages to publish
+     * @param token see Signature
+     * @return deduced by token
+     *
+     * ### Completion Token
+     * @li <a href="https://www.boost.org/doc/html/boost_asio/overview/composition/token_adapters.html">Default Completion Token</a> is supported
+     *
+     * #### Signature
+     * void(@ref error_code)
+     *
+     * ##### error_code
+     * The first error of the messages. If all messages are published successfully,
+     * <a href="https://www.boost.org/libs/system/doc/html/system.html#ref_errc">errc::success</a> is set.
+     */
+    template <
+        typename CompletionToken = as::default_completion_token_t<executor_type>
+    >
+    auto
+    async_publish_batch(
+        std::vector<message> msgs,
+        CompletionToken&& token = as::default_completion_token_t<executor_type>{}
+    ) {
+        return
+            as::async_initiate<
+                CompletionToken,
+                void(error_code)
+            >(
+                [this](auto handler, std::vector<message> msgs) {
+                    using handler_type = decltype(handler);
+                    auto exe = as::get_associated_executor(handler, fallback_executor());
+                    if (msgs.empty()) {
+                        as::post(exe, as::append(force_move(handler), error_code{}));
+                        return;
+                    }
+                    auto state = std::make_shared<batch_state<handler_type, decltype(exe)>>(
+                        force_move(handler),
+                        exe,
+                        msgs.size()
+                    );
+                    for (auto& msg : msgs) {
+                        async_publish(
+                            force_move(msg),
+                            [state](error_code const& ec, pubres_type const& /* res */) {
+                                state->complete(ec);
+                            }
+                        );
+                    }
+                },
+                token,
+                force_move(msgs)
+            );
+    }
+
+private:
+    static constexpr bool reconnects = !std::is_same_v<member_type, client_type>;
+
+    struct no_sequencer {};
+    using sequencer_type = detail::publish_sequencer<Version, NextLayer>;
+
+    struct member {
+        template <typename... Args>
+        explicit member(Args&&... args)
+            :cl{std::forward<Args>(args)...}
+        {
+            if constexpr (!reconnects) seq = std::make_shared<sequencer_type>(cl);
+        }
+        member_type cl;
+        std::shared_ptr<std::atomic<bool>> available = std::make_shared<std::atomic<bool>>(true);
+        // reconnecting_client keeps the order by itself
+        std::conditional_t<reconnects, no_sequencer, std::shared_ptr<sequencer_type>> seq;
+    };
+
+    template <typename Handler, typename Executor>
+    struct batch_state {
+        batch_state(Handler handler, Executor exe, std::size_t rest)
+            :handler{force_move(handler)},
+             wg{exe},
+             rest{rest}
+        {
+        }
+
+        // called from the members' executors
+        void complete(error_code const& ec) {
+            std::lock_guard<std::mutex> g{mtx};
+            if (!this->ec) this->ec = ec;
+            if (--rest != 0) return;
+            auto exe = wg.get_executor();
+            as::post(exe, as::append(force_move(handler), this->ec));
+            wg.reset();
+        }
+
+        std::mutex mtx;
+        Handler handler;
+        as::executor_work_guard<Executor> wg;
+        std::size_t rest;
+        error_code ec;
+    };
+
+    // used when the handler has no associated executor
+    as::any_io_executor fallback_executor() {
+        if (members_.empty()) return as::system_executor{};
+        return members_.front().cl.get_executor();
+    }
+
+    // std::deque keeps the references of the members on emplace_back()
+    std::deque<member> members_;
+    hash_ring ring_;
+    std::shared_ptr<connection_handler_type> connection_handler_ =
+        std::make_shared<connection_handler_type>();
+};
+
+} // namespace async_mqtt
+
+#endif // ASYNC_MQTT_ASIO_BIND_CLIENT_POOL_HPP
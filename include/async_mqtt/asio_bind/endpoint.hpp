@@ -8,6 +8,7 @@
 #define ASYNC_MQTT_ASIO_BIND_ENDPOINT_HPP
 
 #include <set>
+#include <vector>
 #include <boost/asio/any_io_executor.hpp>
 
 #include <async_mqtt/asio_bind/detail/endpoint_impl_fwd.hpp>
@@ -247,6 +248,18 @@ public:
      */
     void set_bulk_write(bool val);
 
+    /**
+     * @brief Set the write coalesce threshold.
+     * Packets whose size is less than or equal to `val` are copied into a contiguous
+     * buffer of the stream before writing, instead of being written as a const buffer
+     * sequence that refers to each packet field. In bulk write mode, consecutive small
+     * packets are packed into the same buffer. Larger packets are written without copy.
+     * \n This function should be called before async_send() call.
+     * @note By default the threshold is 0 (disabled)
+     * @param val threshold in bytes. 0 disables coalescing.
+     */
+    void set_write_coalesce_threshold(std::size_t val);
+
     /**
      * @brief Set the read buffer size.
      * If bulk read is enabled, the `val` parameter specifies the size of the internal streambuf.
@@ -549,6 +562,51 @@ public:
         CompletionToken&& token = as::default_completion_token_t<executor_type>{}
     );
 
+    /**
+     * @brief receive all packets that are already buffered, or wait for at least one packet
+     *        The underlying layer is read only when no complete packet is buffered.
+     *        The packets are received in the same way as async_recv() without filter, but
+     *        the CompletionToken is invoked once for all of them.
+     * @param packets the received packets are stored. It is cleared at the beginning of the operation,
+     *                and its capacity is kept, so the same container can be reused for each call.
+     *                It must be valid until the CompletionToken is invoked.
+     * @param max_count the maximum number of packets to receive. 0 means no limit.
+     * @param token see Signature
+     * @return deduced by token
+     *
+     * ### Completion Token
+     * @li <a href="https://www.boost.org/doc/html/boost_asio/overview/composition/token_adapters.html">Default Completion Token</a> is supported
+     *
+     * #### Signature
+     * void(@ref error_code)
+     *
+     * ##### error_code
+     * @li If an error occurs at an underlying layer while receiving a packet,
+     *     underlying error is set. e.g. system, asio, beast, ...
+     *     `packets` contains the packets received before the error.
+     * @li If there are no errors during receiving the packets,
+     *     <a href="https://www.boost.org/libs/system/doc/html/system.html#ref_errc">errc::success</a> is set.
+     *     `packets` contains at least one packet.
+     *
+     * ### Per-Operation Cancellation
+     *
+     *  This asynchronous operation supports cancellation for the following
+     *  [boost::asio::cancellation_type](https://www.boost.org/doc/html/boost_asio/reference/cancellation_type.html) values:
+     *  @li cancellation_type::terminal
+     *  @li cancellation_type::partial
+     *
+     * if they are also supported by the NextLayer type's async_read_some and async_write_some operation.
+     */
+    template <
+        typename CompletionToken = as::default_completion_token_t<executor_type>
+    >
+    auto
+    async_recv_batch(
+        std::vector<packet_variant_type>& packets,
+        std::size_t max_count,
+        CompletionToken&& token = as::default_completion_token_t<executor_type>{}
+    );
+
     /**
      * @brief close the underlying connection
      * @param token see Signature
@@ -693,6 +751,14 @@ public:
      */
     std::set<typename basic_packet_id_type<PacketIdBytes>::type> get_qos2_publish_handled_pids() const;
 
+    /**
+     * @brief Get processed but not released QoS2 packet ids as a bitset
+     *        This function should be called after disconnection
+     *        It doesn't allocate a node for each packet id.
+     * @return bitset of packet_ids
+     */
+    basic_packet_id_bitset<PacketIdBytes> get_qos2_publish_handled_pid_bitset() const;
+
     /**
      * @brief Restore processed but not released QoS2 packet ids
      *        This function should be called before receive the first publish
@@ -700,6 +766,13 @@ public:
      */
     void restore_qos2_publish_handled_pids(std::set<typename basic_packet_id_type<PacketIdBytes>::type> pids);
 
+    /**
+     * @brief Restore processed but not released QoS2 packet ids
+     *        This function should be called before receive the first publish
+     * @param pids packet ids got by get_qos2_publish_handled_pid_bitset()
+     */
+    void restore_qos2_publish_handled_pid_bitset(basic_packet_id_bitset<PacketIdBytes> pids);
+
     /**
      * @brief restore packets
      *        the restored packets would automatically send when CONNACK packet is received
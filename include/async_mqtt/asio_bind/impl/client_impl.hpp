@@ -8,6 +8,7 @@
 #define ASYNC_MQTT_ASIO_BIND_IMPL_CLIENT_IMPL_HPP
 
 #include <deque>
+#include <functional>
 #include <optional>
 
 #include <boost/multi_index_container.hpp>
@@ -41,6 +42,7 @@ public:
     using next_layer_type = NextLayer;
     using lowest_layer_type = detail::lowest_layer_type<next_layer_type>;
     using executor_type = typename next_layer_type::executor_type;
+    using recv_handler_type = std::function<bool(error_code const&, std::optional<packet_variant>)>;
 
     template <typename... Args>
     explicit
@@ -75,7 +77,9 @@ public:
     void set_pingresp_recv_timeout(std::chrono::milliseconds duration);
     void set_close_delay_after_disconnect_sent(std::chrono::milliseconds duration);
     void set_bulk_write(bool val);
+    void set_write_coalesce_threshold(std::size_t val);
     void set_read_buffer_size(std::size_t val);
+    void set_recv_handler(recv_handler_type handler);
 
     std::optional<packet_id_type> acquire_unique_packet_id();
     bool register_packet_id(packet_id_type packet_id);
@@ -283,6 +287,17 @@ private:
         > handler
     );
 
+    static
+    void
+    async_recv_batch(
+        this_type_sp impl,
+        std::vector<packet_variant>& packets,
+        std::size_t max_count,
+        as::any_completion_handler<
+            void(error_code)
+        > handler
+    );
+
     static
     void
     async_close(
@@ -294,6 +309,7 @@ private:
 
 
     static void recv_loop(this_type_sp impl);
+    static void resume_recv(this_type_sp impl);
 
     // async operations
     struct start_op;
@@ -303,6 +319,7 @@ private:
     struct disconnect_op;
     struct auth_op;
     struct recv_op;
+    struct recv_batch_op;
 
     // internal types
     struct pid_tim_pv_res_col {
@@ -370,11 +387,17 @@ private:
         std::optional<packet_variant> pv;
     };
 
+    // deliver to the recv handler if set, otherwise push to recv_queue_
+    // return false if the recv handler requests to pause reading
+    bool deliver(recv_type r);
+
     endpoint_type ep_;
     pid_tim_pv_res_col pid_tim_pv_res_col_;
     std::deque<recv_type> recv_queue_;
     bool recv_queue_inserted_ = false;
     as::steady_timer tim_notify_publish_recv_;
+    recv_handler_type recv_handler_;
+    bool recv_paused_ = false;
 };
 
 } // namespace async_mqtt::detail
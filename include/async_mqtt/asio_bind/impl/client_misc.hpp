@@ -127,6 +127,13 @@ client_impl<Version, NextLayer>::set_bulk_write(bool val) {
     ep_.set_bulk_write(val);
 }
 
+template <protocol_version Version, typename NextLayer>
+inline
+void
+client_impl<Version, NextLayer>::set_write_coalesce_threshold(std::size_t val) {
+    ep_.set_write_coalesce_threshold(val);
+}
+
 template <protocol_version Version, typename NextLayer>
 inline
 void
@@ -134,6 +141,13 @@ client_impl<Version, NextLayer>::set_read_buffer_size(std::size_t val) {
     ep_.set_read_buffer_size(val);
 }
 
+template <protocol_version Version, typename NextLayer>
+inline
+void
+client_impl<Version, NextLayer>::set_recv_handler(recv_handler_type handler) {
+    recv_handler_ = force_move(handler);
+}
+
 } // namespace detail
 
 // member functions
@@ -254,6 +268,14 @@ client<Version, NextLayer>::set_bulk_write(bool val) {
     impl_->set_bulk_write(val);
 }
 
+template <protocol_version Version, typename NextLayer>
+inline
+void
+client<Version, NextLayer>::set_write_coalesce_threshold(std::size_t val) {
+    BOOST_ASSERT(impl_);
+    impl_->set_write_coalesce_threshold(val);
+}
+
 template <protocol_version Version, typename NextLayer>
 inline
 void
@@ -262,6 +284,14 @@ client<Version, NextLayer>::set_read_buffer_size(std::size_t val) {
     impl_->set_read_buffer_size(val);
 }
 
+template <protocol_version Version, typename NextLayer>
+inline
+void
+client<Version, NextLayer>::set_recv_handler(recv_handler_type handler) {
+    BOOST_ASSERT(impl_);
+    impl_->set_recv_handler(force_move(handler));
+}
+
 } // namespace async_mqtt
 
 #if !defined(ASYNC_MQTT_SEPARATE_COMPILATION)
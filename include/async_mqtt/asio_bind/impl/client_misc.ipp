@@ -10,6 +10,7 @@
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index/key.hpp>
+#include <boost/asio/post.hpp>
 
 #include <async_mqtt/asio_bind/client.hpp>
 #include <async_mqtt/asio_bind/impl/client_impl.hpp>
@@ -31,13 +32,12 @@ client_impl<Version, NextLayer>::recv_loop(this_type_sp impl) {
         [impl = force_move(impl)]
         (error_code const& ec, std::optional<packet_variant> pv_opt) mutable {
             if (ec) {
-                impl->recv_queue_.emplace_back(ec);
-                impl->recv_queue_inserted_  = true;
-                impl->tim_notify_publish_recv_.cancel();
+                impl->deliver(recv_type{ec});
                 impl->pid_tim_pv_res_col_.clear();
                 return;
             }
             BOOST_ASSERT(pv_opt);
+            bool cont = true;
             pv_opt->visit(
                 overload {
                     [&](typename client_type::connack_packet& p) {
@@ -65,9 +65,7 @@ client_impl<Version, NextLayer>::recv_loop(this_type_sp impl) {
                         }
                     },
                     [&](typename client_type::publish_packet& p) {
-                        impl->recv_queue_.emplace_back(force_move(p));
-                        impl->recv_queue_inserted_  = true;
-                        impl->tim_notify_publish_recv_.cancel();
+                        cont = impl->deliver(recv_type{force_move(p)});
                     },
                     [&](typename client_type::puback_packet& p) {
                         auto& idx = impl->pid_tim_pv_res_col_.get_pid_idx();
@@ -104,24 +102,56 @@ client_impl<Version, NextLayer>::recv_loop(this_type_sp impl) {
                         }
                     },
                     [&](typename client_type::disconnect_packet& p) {
-                        impl->recv_queue_.emplace_back(force_move(p));
-                        impl->recv_queue_inserted_  = true;
-                        impl->tim_notify_publish_recv_.cancel();
+                        cont = impl->deliver(recv_type{force_move(p)});
                     },
                     [&](v5::auth_packet& p) {
-                        impl->recv_queue_.emplace_back(force_move(p));
-                        impl->recv_queue_inserted_  = true;
-                        impl->tim_notify_publish_recv_.cancel();
+                        cont = impl->deliver(recv_type{force_move(p)});
                     },
                     [&](auto const&) {
                     }
                 }
             );
+            if (cont) {
+                recv_loop(force_move(impl));
+            }
+            else {
+                impl->recv_paused_ = true;
+            }
+        }
+    );
+}
+
+template <protocol_version Version, typename NextLayer>
+ASYNC_MQTT_HEADER_ONLY_INLINE
+void
+client_impl<Version, NextLayer>::resume_recv(this_type_sp impl) {
+    BOOST_ASSERT(impl);
+    auto exe = impl->get_executor();
+    // post is used to resume after the recv handler that requests to pause returns,
+    // even if resume_recv() is called in the handler
+    as::post(
+        exe,
+        [impl = force_move(impl)] () mutable {
+            if (!impl->recv_paused_) return;
+            impl->recv_paused_ = false;
             recv_loop(force_move(impl));
         }
     );
 }
 
+template <protocol_version Version, typename NextLayer>
+ASYNC_MQTT_HEADER_ONLY_INLINE
+bool
+client_impl<Version, NextLayer>::deliver(recv_type r) {
+    if (recv_handler_) {
+        return recv_handler_(r.ec, force_move(r.pv));
+    }
+    recv_queue_.push_back(force_move(r));
+    recv_queue_inserted_  = true;
+    tim_notify_publish_recv_.cancel();
+    return true;
+}
+
 } // namespace detail
 
 // member functions
@@ -134,6 +164,14 @@ client<Version, NextLayer>::recv_loop() {
     impl_type::recv_loop(impl_);
 }
 
+template <protocol_version Version, typename NextLayer>
+ASYNC_MQTT_HEADER_ONLY_INLINE
+void
+client<Version, NextLayer>::resume_recv() {
+    BOOST_ASSERT(impl_);
+    impl_type::resume_recv(impl_);
+}
+
 } // namespace async_mqtt
 
 #include <async_mqtt/asio_bind/impl/client_instantiate.hpp>
@@ -45,6 +45,43 @@ client<Version, NextLayer>::async_recv(
         );
 }
 
+template <protocol_version Version, typename NextLayer>
+template <typename CompletionToken>
+auto
+client<Version, NextLayer>::async_recv_batch(
+    std::vector<packet_variant>& packets,
+    std::size_t max_count,
+    CompletionToken&& token
+) {
+    ASYNC_MQTT_LOG("mqtt_api", info)
+        << ASYNC_MQTT_ADD_VALUE(address, this)
+        << "recv_batch max_count:" << max_count;
+    BOOST_ASSERT(impl_);
+    return
+        as::async_initiate<
+            CompletionToken,
+            void(error_code)
+        >(
+            [](
+                auto handler,
+                std::shared_ptr<impl_type> impl,
+                std::vector<packet_variant>* packets,
+                std::size_t max_count
+            ) {
+                impl_type::async_recv_batch(
+                    force_move(impl),
+                    *packets,
+                    max_count,
+                    force_move(handler)
+                );
+            },
+            token,
+            impl_,
+            &packets,
+            max_count
+        );
+}
+
 } // namespace async_mqtt
 
 #if !defined(ASYNC_MQTT_SEPARATE_COMPILATION)
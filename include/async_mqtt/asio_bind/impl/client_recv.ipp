@@ -39,9 +39,6 @@ recv_op {
             state = complete;
             if (a_cl.recv_queue_.empty()) {
                 a_cl.recv_queue_inserted_ = false;
-                auto tim = std::make_shared<as::steady_timer>(
-                    a_cl.ep_.get_executor()
-                );
                 a_cl.tim_notify_publish_recv_.expires_at(
                     std::chrono::steady_clock::time_point::max()
                 );
@@ -84,6 +81,114 @@ recv_op {
     }
 };
 
+template <protocol_version Version, typename NextLayer>
+struct client_impl<Version, NextLayer>::
+recv_batch_op {
+    this_type_sp cl;
+    std::vector<packet_variant>& packets;
+    std::size_t max_count;
+    enum { dispatch, recv, complete } state = dispatch;
+    template <typename Self>
+    void operator()(
+        Self& self
+    ) {
+        auto& a_cl{*cl};
+        if (state == dispatch) {
+            state = recv;
+            packets.clear();
+            as::dispatch(
+                a_cl.ep_.get_executor(),
+                force_move(self)
+            );
+        }
+        else {
+            BOOST_ASSERT(state == recv);
+            state = complete;
+            if (a_cl.recv_queue_.empty()) {
+                a_cl.recv_queue_inserted_ = false;
+                a_cl.tim_notify_publish_recv_.expires_at(
+                    std::chrono::steady_clock::time_point::max()
+                );
+                a_cl.tim_notify_publish_recv_.async_wait(
+                    force_move(self)
+                );
+            }
+            else {
+                take(self);
+            }
+        }
+    }
+
+    template <typename Self>
+    void operator()(
+        Self& self,
+        error_code /* ec */
+    ) {
+        BOOST_ASSERT(state == complete);
+        auto& a_cl{*cl};
+        if (a_cl.recv_queue_inserted_) {
+            take(self);
+        }
+        else {
+            self.complete(
+                make_error_code(as::error::operation_aborted)
+            );
+        }
+    }
+
+    template <typename Self>
+    void take(Self& self) {
+        auto& queue{cl->recv_queue_};
+        BOOST_ASSERT(!queue.empty());
+        error_code ec;
+        while (!queue.empty() &&
+               (max_count == 0 || packets.size() < max_count)) {
+            auto& front{queue.front()};
+            if (front.ec) {
+                // the error is reported by the next call if packets have been taken
+                if (packets.empty()) {
+                    ec = front.ec;
+                    queue.pop_front();
+                }
+                break;
+            }
+            BOOST_ASSERT(front.pv);
+            packets.push_back(force_move(*front.pv));
+            queue.pop_front();
+        }
+        self.complete(ec);
+    }
+};
+
+template <protocol_version Version, typename NextLayer>
+ASYNC_MQTT_HEADER_ONLY_INLINE
+void
+client_impl<Version, NextLayer>::async_recv_batch(
+    this_type_sp impl,
+    std::vector<packet_variant>& packets,
+    std::size_t max_count,
+    as::any_completion_handler<
+        void(error_code)
+    > handler
+) {
+    BOOST_ASSERT(impl);
+    auto exe = impl->get_executor();
+    as::async_compose<
+        as::any_completion_handler<
+            void(error_code)
+        >,
+        void(error_code)
+    >(
+        recv_batch_op{
+            force_move(impl),
+            packets,
+            max_count
+        },
+        handler,
+        exe
+    );
+}
+
 template <protocol_version Version, typename NextLayer>
 ASYNC_MQTT_HEADER_ONLY_INLINE
 void
@@ -54,6 +54,9 @@ start_op {
         auto tim = std::make_shared<as::steady_timer>(a_cl.ep_.get_executor());
         tim->expires_at(std::chrono::steady_clock::time_point::max());
         a_cl.pid_tim_pv_res_col_.get_tim_idx().emplace(tim);
+        // The loop of the previous connection could be paused when it was closed.
+        // The new loop starts unpaused, so resume_recv() doesn't start another one.
+        a_cl.recv_paused_ = false;
         recv_loop(cl);
         tim->async_wait(
             as::append(
@@ -78,6 +78,7 @@ public:
     void set_pingresp_recv_timeout(std::chrono::milliseconds duration);
     void set_close_delay_after_disconnect_sent(std::chrono::milliseconds duration);
     void set_bulk_write(bool val);
+    void set_write_coalesce_threshold(std::size_t val);
     void set_read_buffer_size(std::size_t val);
 
     // async funcs
@@ -125,6 +126,16 @@ public:
         > handler
     );
 
+    static void
+    async_recv_batch(
+        this_type_sp impl,
+        std::vector<packet_variant_type>& packets,
+        std::size_t max_count,
+        as::any_completion_handler<
+            void(error_code)
+        > handler
+    );
+
     static void
     async_get_stored_packets(
         this_type_sp impl,
@@ -157,7 +168,9 @@ public:
     bool register_packet_id(typename basic_packet_id_type<PacketIdBytes>::type packet_id);
     void release_packet_id(typename basic_packet_id_type<PacketIdBytes>::type packet_id);
     std::set<typename basic_packet_id_type<PacketIdBytes>::type> get_qos2_publish_handled_pids() const;
+    basic_packet_id_bitset<PacketIdBytes> get_qos2_publish_handled_pid_bitset() const;
     void restore_qos2_publish_handled_pids(std::set<typename basic_packet_id_type<PacketIdBytes>::type> pids);
+    void restore_qos2_publish_handled_pid_bitset(basic_packet_id_bitset<PacketIdBytes> pids);
     void restore_packets(
         std::vector<basic_store_packet_variant<PacketIdBytes>> pvs
     );
@@ -209,6 +222,7 @@ private: // compose operation impl
     struct release_packet_id_op;
     template <typename Packet> struct send_op;
     struct recv_op;
+    struct recv_batch_op;
     struct close_op;
     struct restore_packets_op;
     struct get_stored_packets_op;
@@ -287,6 +301,9 @@ private:
     static void cancel_pingreq_recv_timer(
         this_type_sp ep
     );
+    static void wait_pingreq_recv_timer(
+        this_type_sp ep
+    );
 
     static void reset_pingresp_recv_timer(
         this_type_sp ep,
@@ -319,6 +336,8 @@ private:
 
     as::steady_timer tim_pingreq_send_;
     as::steady_timer tim_pingreq_recv_;
+    std::chrono::steady_clock::time_point pingreq_recv_deadline_;
+    bool pingreq_recv_armed_ = false;
     as::steady_timer tim_pingresp_recv_;
     as::steady_timer tim_close_by_disconnect_;
     std::chrono::milliseconds duration_close_by_disconnect_{std::chrono::milliseconds::zero()};
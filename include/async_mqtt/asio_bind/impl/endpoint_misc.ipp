@@ -86,6 +86,13 @@ basic_endpoint_impl<Role, PacketIdBytes, NextLayer>::set_bulk_write(bool val) {
     stream_.set_bulk_write(val);
 }
 
+template <role Role, std::size_t PacketIdBytes, typename NextLayer>
+ASYNC_MQTT_HEADER_ONLY_INLINE
+void
+basic_endpoint_impl<Role, PacketIdBytes, NextLayer>::set_write_coalesce_threshold(std::size_t val) {
+    stream_.set_write_coalesce_threshold(val);
+}
+
 template <role Role, std::size_t PacketIdBytes, typename NextLayer>
 ASYNC_MQTT_HEADER_ONLY_INLINE
 void
@@ -100,6 +107,13 @@ basic_endpoint_impl<Role, PacketIdBytes, NextLayer>::get_qos2_publish_handled_pi
     return con_.get_qos2_publish_handled_pids();
 }
 
+template <role Role, std::size_t PacketIdBytes, typename NextLayer>
+ASYNC_MQTT_HEADER_ONLY_INLINE
+basic_packet_id_bitset<PacketIdBytes>
+basic_endpoint_impl<Role, PacketIdBytes, NextLayer>::get_qos2_publish_handled_pid_bitset() const {
+    return con_.get_qos2_publish_handled_pid_bitset();
+}
+
 
 template <role Role, std::size_t PacketIdBytes, typename NextLayer>
 ASYNC_MQTT_HEADER_ONLY_INLINE
@@ -110,6 +124,15 @@ basic_endpoint_impl<Role, PacketIdBytes, NextLayer>::restore_qos2_publish_handle
     con_.restore_qos2_publish_handled_pids(force_move(pids));
 }
 
+template <role Role, std::size_t PacketIdBytes, typename NextLayer>
+ASYNC_MQTT_HEADER_ONLY_INLINE
+void
+basic_endpoint_impl<Role, PacketIdBytes, NextLayer>::restore_qos2_publish_handled_pid_bitset(
+    basic_packet_id_bitset<PacketIdBytes> pids
+) {
+    con_.restore_qos2_publish_handled_pid_bitset(force_move(pids));
+}
+
 
 template <role Role, std::size_t PacketIdBytes, typename NextLayer>
 ASYNC_MQTT_HEADER_ONLY_INLINE
@@ -281,72 +304,98 @@ basic_endpoint_impl<Role, PacketIdBytes, NextLayer>::reset_pingreq_recv_timer(
     this_type_sp ep,
     std::optional<std::chrono::milliseconds> ms
 ) {
-    cancel_pingreq_recv_timer(ep);
     if constexpr (Role == role::server || Role == role::any) {
         if (ms) {
-            ep->tim_pingreq_recv_.expires_after(
-                *ms
-            );
+            // The reset is requested on every received packet.
+            // Only the deadline is updated here. The running timer
+            // re-arms itself to the latest deadline when it fires.
+            ep->pingreq_recv_deadline_ = std::chrono::steady_clock::now() + *ms;
+            if (!ep->pingreq_recv_armed_) {
+                ep->pingreq_recv_armed_ = true;
+                wait_pingreq_recv_timer(ep);
+            }
+        }
+        else {
+            cancel_pingreq_recv_timer(ep);
+        }
+    }
+    else {
+        (void)ep;
+        (void)ms;
+    }
+}
 
-            ep->tim_pingreq_recv_.async_wait(
-                [wp = std::weak_ptr{ep}](error_code const& ec) {
-                    if (!ec) {
-                        if (auto ep = wp.lock()) {
-                            auto events = ep->con_.notify_timer_fired(timer_kind::pingreq_recv);
-                            for (auto it = events.begin(); it != events.end();) {
-                                auto& event = *it++;
-                                std::visit(
-                                    overload {
-                                        [&](async_mqtt::event::timer&& ev) {
-                                            if (ev.get_kind() == timer_kind::pingreq_recv) {
-                                                switch (ev.get_op()) {
-                                                case timer_op::reset:
-                                                    reset_pingreq_recv_timer(ep, ev.get_ms());
-                                                    break;
-                                                case timer_op::cancel:
-                                                    ep->tim_pingreq_recv_.cancel();
-                                                    break;
-                                                }
-                                            }
-                                            else {
-                                                BOOST_ASSERT(false);
-                                            }
-                                        },
-                                        [&](async_mqtt::event::basic_send<PacketIdBytes>&& ev) {
-                                            auto pv{force_move(ev.get())};
-                                            BOOST_ASSERT(pv.template get_if<v5::disconnect_packet>());
-                                            BOOST_ASSERT(it != events.end());
-                                            auto& ev_close = *it++;
-                                            (void)ev_close;
-                                            BOOST_ASSERT(it == events.end());
-                                            BOOST_ASSERT(std::get_if<async_mqtt::event::close>(&ev_close));
-                                            ep->stream_.async_write_packet(
-                                                force_move(pv),
-                                                [ep]
-                                                (
-                                                    error_code const& /*ec*/,
-                                                    std::size_t /*bytes_transferred*/
-                                                ) {
-                                                    async_close(ep, as::detached);
-                                                }
-                                            );
-                                        },
-                                        [&](async_mqtt::event::close const&) {
+template <role Role, std::size_t PacketIdBytes, typename NextLayer>
+ASYNC_MQTT_HEADER_ONLY_INLINE
+void
+basic_endpoint_impl<Role, PacketIdBytes, NextLayer>::wait_pingreq_recv_timer(
+    this_type_sp ep
+) {
+    ep->tim_pingreq_recv_.expires_at(ep->pingreq_recv_deadline_);
+    ep->tim_pingreq_recv_.async_wait(
+        [wp = std::weak_ptr{ep}](error_code const& ec) {
+            if (!ec) {
+                if (auto ep = wp.lock()) {
+                    if (!ep->pingreq_recv_armed_) return;
+                    if (std::chrono::steady_clock::now() < ep->pingreq_recv_deadline_) {
+                        // packets have been received after the timer was set
+                        wait_pingreq_recv_timer(ep);
+                        return;
+                    }
+                    ep->pingreq_recv_armed_ = false;
+                    auto events = ep->con_.notify_timer_fired(timer_kind::pingreq_recv);
+                    for (auto it = events.begin(); it != events.end();) {
+                        auto& event = *it++;
+                        std::visit(
+                            overload {
+                                [&](async_mqtt::event::timer&& ev) {
+                                    if (ev.get_kind() == timer_kind::pingreq_recv) {
+                                        switch (ev.get_op()) {
+                                        case timer_op::reset:
+                                            reset_pingreq_recv_timer(ep, ev.get_ms());
+                                            break;
+                                        case timer_op::cancel:
+                                            cancel_pingreq_recv_timer(ep);
+                                            break;
+                                        }
+                                    }
+                                    else {
+                                        BOOST_ASSERT(false);
+                                    }
+                                },
+                                [&](async_mqtt::event::basic_send<PacketIdBytes>&& ev) {
+                                    auto pv{force_move(ev.get())};
+                                    BOOST_ASSERT(pv.template get_if<v5::disconnect_packet>());
+                                    BOOST_ASSERT(it != events.end());
+                                    auto& ev_close = *it++;
+                                    (void)ev_close;
+                                    BOOST_ASSERT(it == events.end());
+                                    BOOST_ASSERT(std::get_if<async_mqtt::event::close>(&ev_close));
+                                    ep->stream_.async_write_packet(
+                                        force_move(pv),
+                                        [ep]
+                                        (
+                                            error_code const& /*ec*/,
+                                            std::size_t /*bytes_transferred*/
+                                        ) {
                                             async_close(ep, as::detached);
-                                        },
-                                        [&](auto const&) {
-                                            BOOST_ASSERT(false);
                                         }
-                                    },
-                                    force_move(event)
-                                );
-                            }
-                        }
+                                    );
+                                },
+                                [&](async_mqtt::event::close const&) {
+                                    async_close(ep, as::detached);
+                                },
+                                [&](auto const&) {
+                                    BOOST_ASSERT(false);
+                                }
+                            },
+                            force_move(event)
+                        );
                     }
                 }
-            );
+            }
         }
-    }
+    );
 }
 
 template <role Role, std::size_t PacketIdBytes, typename NextLayer>
@@ -355,6 +404,7 @@ void
 basic_endpoint_impl<Role, PacketIdBytes, NextLayer>::cancel_pingreq_recv_timer(
     this_type_sp ep
 ) {
+    ep->pingreq_recv_armed_ = false;
     ep->tim_pingreq_recv_.cancel();
 }
 
@@ -610,6 +660,14 @@ basic_endpoint<Role, PacketIdBytes, NextLayer>::set_bulk_write(bool val) {
     impl_->set_bulk_write(val);
 }
 
+template <role Role, std::size_t PacketIdBytes, typename NextLayer>
+ASYNC_MQTT_HEADER_ONLY_INLINE
+void
+basic_endpoint<Role, PacketIdBytes, NextLayer>::set_write_coalesce_threshold(std::size_t val) {
+    BOOST_ASSERT(impl_);
+    impl_->set_write_coalesce_threshold(val);
+}
+
 template <role Role, std::size_t PacketIdBytes, typename NextLayer>
 ASYNC_MQTT_HEADER_ONLY_INLINE
 void
@@ -629,6 +687,17 @@ basic_endpoint<Role, PacketIdBytes, NextLayer>::get_qos2_publish_handled_pids()
     return impl_->get_qos2_publish_handled_pids();
 }
 
+template <role Role, std::size_t PacketIdBytes, typename NextLayer>
+ASYNC_MQTT_HEADER_ONLY_INLINE
+basic_packet_id_bitset<PacketIdBytes>
+basic_endpoint<Role, PacketIdBytes, NextLayer>::get_qos2_publish_handled_pid_bitset() const {
+    ASYNC_MQTT_LOG("mqtt_api", info)
+        << ASYNC_MQTT_ADD_VALUE(address, this)
+        << "get_qos2_publish_handled_pid_bitset";
+    BOOST_ASSERT(impl_);
+    return impl_->get_qos2_publish_handled_pid_bitset();
+}
+
 
 template <role Role, std::size_t PacketIdBytes, typename NextLayer>
 ASYNC_MQTT_HEADER_ONLY_INLINE
@@ -643,6 +712,19 @@ basic_endpoint<Role, PacketIdBytes, NextLayer>::restore_qos2_publish_handled_pid
     impl_->restore_qos2_publish_handled_pids(force_move(pids));
 }
 
+template <role Role, std::size_t PacketIdBytes, typename NextLayer>
+ASYNC_MQTT_HEADER_ONLY_INLINE
+void
+basic_endpoint<Role, PacketIdBytes, NextLayer>::restore_qos2_publish_handled_pid_bitset(
+    basic_packet_id_bitset<PacketIdBytes> pids
+) {
+    ASYNC_MQTT_LOG("mqtt_api", info)
+        << ASYNC_MQTT_ADD_VALUE(address, this)
+        << "restore_qos2_publish_handled_pid_bitset";
+    BOOST_ASSERT(impl_);
+    impl_->restore_qos2_publish_handled_pid_bitset(force_move(pids));
+}
+
 
 
 template <role Role, std::size_t PacketIdBytes, typename NextLayer>
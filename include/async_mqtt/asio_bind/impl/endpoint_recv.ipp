@@ -318,6 +318,89 @@ recv_op {
     }
 };
 
+template <role Role, std::size_t PacketIdBytes, typename NextLayer>
+struct basic_endpoint_impl<Role, PacketIdBytes, NextLayer>::
+recv_batch_op {
+    this_type_sp ep;
+    std::vector<packet_variant_type>& packets;
+    std::size_t max_count;
+    enum { dispatch, recv, complete } state = dispatch;
+
+    template <typename Self>
+    void operator()(
+        Self& self
+    ) {
+        auto& a_ep{*ep};
+        switch (state) {
+        case dispatch: {
+            state = recv;
+            packets.clear();
+            as::dispatch(
+                a_ep.get_executor(),
+                force_move(self)
+            );
+        } break;
+        case recv: {
+            state = complete;
+            auto ep_copy{ep};
+            async_recv(
+                force_move(ep_copy),
+                std::nullopt,
+                std::set<control_packet_type>{},
+                force_move(self)
+            );
+        } break;
+        default:
+            BOOST_ASSERT(false);
+            break;
+        }
+    }
+
+    template <typename Self>
+    void operator()(
+        Self& self,
+        error_code ec,
+        std::optional<packet_variant_type> packet
+    ) {
+        BOOST_ASSERT(state == complete);
+        if (packet) packets.push_back(force_move(*packet));
+        if (ec) {
+            self.complete(ec);
+            return;
+        }
+        if ((max_count == 0 || packets.size() < max_count) &&
+            has_buffered_packet()) {
+            // the next packet is received without reading the underlying layer
+            state = recv;
+            (*this)(self);
+            return;
+        }
+        self.complete(ec);
+    }
+
+    // true if read_buf_ has at least one complete packet.
+    // read_buf_ always starts at a packet boundary after a packet is received.
+    bool has_buffered_packet() const {
+        auto cb = ep->read_buf_.data();
+        auto p = static_cast<char const*>(cb.data());
+        auto size = cb.size();
+        std::size_t remaining_length = 0;
+        std::size_t multiplier = 1;
+        // fixed header, and at most 4 bytes of remaining length
+        for (std::size_t i = 1; i != 5; ++i) {
+            if (i >= size) return false;
+            auto encoded_byte = static_cast<std::uint8_t>(p[i]);
+            remaining_length += (encoded_byte & 0b0111'1111) * multiplier;
+            if ((encoded_byte & 0b1000'0000) == 0) {
+                return size - (i + 1) >= remaining_length;
+            }
+            multiplier *= 128;
+        }
+        // malformed remaining length, async_recv reports the error
+        return true;
+    }
+};
+
 template <role Role, std::size_t PacketIdBytes, typename NextLayer>
 ASYNC_MQTT_HEADER_ONLY_INLINE
 void
@@ -347,6 +430,35 @@ async_recv(
     );
 }
 
+template <role Role, std::size_t PacketIdBytes, typename NextLayer>
+ASYNC_MQTT_HEADER_ONLY_INLINE
+void
+basic_endpoint_impl<Role, PacketIdBytes, NextLayer>::
+async_recv_batch(
+    this_type_sp impl,
+    std::vector<packet_variant_type>& packets,
+    std::size_t max_count,
+    as::any_completion_handler<
+        void(error_code)
+    > handler
+) {
+    auto exe = impl->get_executor();
+    as::async_compose<
+        as::any_completion_handler<
+            void(error_code)
+        >,
+        void(error_code)
+    >(
+        recv_batch_op{
+            force_move(impl),
+            packets,
+            max_count
+        },
+        handler,
+        exe
+    );
+}
+
 } // namespace async_mqtt::detail
 
 #include <async_mqtt/asio_bind/impl/endpoint_instantiate.hpp>
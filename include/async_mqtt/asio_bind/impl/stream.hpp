@@ -120,6 +120,10 @@ public:
         impl_->set_bulk_write(val);
     }
 
+    void set_write_coalesce_threshold(std::size_t val) {
+        impl_->set_write_coalesce_threshold(val);
+    }
+
     template <typename Executor1>
     struct rebind_executor {
         using other = stream<
@@ -52,7 +52,8 @@ struct stream_impl<NextLayer>::stream_close_op {
                 << ASYNC_MQTT_ADD_VALUE(address, strm.get())
                 << "async operation finish. state: complete";
             BOOST_ASSERT(state == complete);
-            a_strm.storing_cbs_.clear();
+            a_strm.storing_pieces_.clear();
+            a_strm.storing_chunk_.clear();
             a_strm.sending_cbs_.clear();
             self.complete(ec);
         }
@@ -91,6 +91,10 @@ public:
         bulk_write_ = val;
     }
 
+    void set_write_coalesce_threshold(std::size_t val) {
+        write_coalesce_threshold_ = val;
+    }
+
     template <typename Executor1>
     struct rebind_executor {
         using other = stream_impl<
@@ -146,8 +150,34 @@ private:
     ioc_queue read_queue_;
     ioc_queue write_queue_;
     struct stream_read_op;
-    std::vector<as::const_buffer> storing_cbs_;
+
+    // A piece of the bulk write. It refers to either the packet memory
+    // (zero-copy) or the range [chunk_begin, chunk_end) of storing_chunk_.
+    // The range is kept as offsets because storing_chunk_ can be reallocated.
+    struct write_piece {
+        as::const_buffer cb;
+        std::size_t chunk_begin = 0;
+        std::size_t chunk_end = 0;
+    };
+
+    template <typename Packet>
+    static void append_to_chunk(std::vector<char>& chunk, Packet const& packet) {
+        auto cbs = packet.const_buffer_sequence();
+        for (auto const& cb : cbs) {
+            auto begin = static_cast<char const*>(cb.data());
+            chunk.insert(chunk.end(), begin, begin + cb.size());
+        }
+    }
+
+    bool coalesce(std::size_t size) const {
+        return size <= write_coalesce_threshold_;
+    }
+
+    std::vector<write_piece> storing_pieces_;
+    std::vector<char> storing_chunk_;
     std::vector<as::const_buffer> sending_cbs_;
+    std::vector<char> sending_chunk_;
+    std::size_t write_coalesce_threshold_ = 0;
     bool bulk_write_ = false;
 };
 
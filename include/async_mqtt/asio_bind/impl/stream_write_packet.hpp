@@ -46,8 +46,26 @@ struct stream_impl<NextLayer>::stream_write_packet_op {
             }
             else {
                 state = bulk_write;
-                auto cbs = a_packet.const_buffer_sequence();
-                std::copy(cbs.begin(), cbs.end(), std::back_inserter(a_strm.storing_cbs_));
+                if (a_strm.coalesce(size)) {
+                    auto& pieces{a_strm.storing_pieces_};
+                    auto& chunk{a_strm.storing_chunk_};
+                    auto begin = chunk.size();
+                    append_to_chunk(chunk, a_packet);
+                    // consecutive small packets share one buffer
+                    if (!pieces.empty() && pieces.back().chunk_end == begin &&
+                        pieces.back().chunk_end != pieces.back().chunk_begin) {
+                        pieces.back().chunk_end = chunk.size();
+                    }
+                    else {
+                        pieces.push_back(write_piece{as::const_buffer{}, begin, chunk.size()});
+                    }
+                }
+                else {
+                    auto cbs = a_packet.const_buffer_sequence();
+                    for (auto const& cb : cbs) {
+                        a_strm.storing_pieces_.push_back(write_piece{cb});
+                    }
+                }
             }
             a_strm.write_queue_.post(
                 force_move(self)
@@ -59,7 +77,27 @@ struct stream_impl<NextLayer>::stream_write_packet_op {
             if (a_strm.lowest_layer().is_open()) {
                 state = complete;
                 auto& a_packet{*packet};
-                if constexpr (
+                if (a_strm.coalesce(size)) {
+                    a_strm.sending_chunk_.clear();
+                    append_to_chunk(a_strm.sending_chunk_, a_packet);
+                    a_strm.sending_cbs_.push_back(as::buffer(a_strm.sending_chunk_));
+                    if constexpr (
+                        has_async_write<next_layer_type>::value) {
+                        layer_customize<next_layer_type>::async_write(
+                            a_strm.nl_,
+                            a_strm.sending_cbs_,
+                            force_move(self)
+                        );
+                    }
+                    else {
+                        async_write(
+                            a_strm.nl_,
+                            a_strm.sending_cbs_,
+                            force_move(self)
+                        );
+                    }
+                }
+                else if constexpr (
                     has_async_write<next_layer_type>::value) {
                     layer_customize<next_layer_type>::async_write(
                         a_strm.nl_,
@@ -91,7 +129,7 @@ struct stream_impl<NextLayer>::stream_write_packet_op {
             a_strm.write_queue_.start_work();
             if (a_strm.lowest_layer().is_open()) {
                 state = complete;
-                if (a_strm.storing_cbs_.empty()) {
+                if (a_strm.storing_pieces_.empty()) {
                     auto& a_size{size};
                     as::dispatch(
                         a_strm.get_executor(),
@@ -103,7 +141,24 @@ struct stream_impl<NextLayer>::stream_write_packet_op {
                     );
                 }
                 else {
-                    a_strm.sending_cbs_ = force_move(a_strm.storing_cbs_);
+                    // storing_chunk_ is swapped to keep both capacities
+                    std::swap(a_strm.sending_chunk_, a_strm.storing_chunk_);
+                    a_strm.storing_chunk_.clear();
+                    a_strm.sending_cbs_.reserve(a_strm.storing_pieces_.size());
+                    for (auto const& piece : a_strm.storing_pieces_) {
+                        if (piece.chunk_begin == piece.chunk_end) {
+                            a_strm.sending_cbs_.push_back(piece.cb);
+                        }
+                        else {
+                            a_strm.sending_cbs_.push_back(
+                                as::buffer(
+                                    a_strm.sending_chunk_.data() + piece.chunk_begin,
+                                    piece.chunk_end - piece.chunk_begin
+                                )
+                            );
+                        }
+                    }
+                    a_strm.storing_pieces_.clear();
                     if constexpr (
                         has_async_write<next_layer_type>::value) {
                         layer_customize<next_layer_type>::async_write(
@@ -148,6 +203,7 @@ struct stream_impl<NextLayer>::stream_write_packet_op {
         auto& a_strm{*strm};
         if (ec) {
             a_strm.write_queue_.stop_work();
+            a_strm.sending_cbs_.clear();
             as::post(
                 a_strm.get_executor(),
                 [strm = force_move(strm)] {
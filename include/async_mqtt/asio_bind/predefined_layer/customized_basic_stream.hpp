@@ -7,8 +7,18 @@
 #if !defined(ASYNC_MQTT_ASIO_BIND_PREDEFINED_LAYER_CUSTOMIZED_BASIC_STREAM_HPP)
 #define ASYNC_MQTT_ASIO_BIND_PREDEFINED_LAYER_CUSTOMIZED_BASIC_STREAM_HPP
 
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
 #include <boost/asio.hpp>
 
+#include <async_mqtt/asio_bind/resolve_cache.hpp>
 #include <async_mqtt/asio_bind/stream_customize.hpp>
 #include <async_mqtt/util/log.hpp>
 
@@ -62,14 +72,14 @@ struct layer_customize<as::basic_stream_socket<Protocol, Executor>> {
         as::basic_stream_socket<Protocol, Executor>& stream;
         std::string host;
         std::string port;
-        enum { dispatch, resolve, connect, complete } state = dispatch;
+        enum { dispatch, start, complete } state = dispatch;
 
         template <typename Self>
         void operator()(
             Self& self
         ) {
             if (state == dispatch) {
-                state = resolve;
+                state = start;
                 auto& a_stream{stream};
                 as::dispatch(
                     a_stream.get_executor(),
@@ -77,61 +87,363 @@ struct layer_customize<as::basic_stream_socket<Protocol, Executor>> {
                 );
             }
             else {
-                BOOST_ASSERT(state == resolve);
-                state = connect;
-                auto res = std::make_shared<as::ip::tcp::resolver>(stream.get_executor());
-                auto a_host{host};
-                auto a_port{port};
-                res->async_resolve(
-                    a_host,
-                    a_port,
-                    as::consign(
-                        force_move(self),
-                        res
-                    )
+                BOOST_ASSERT(state == start);
+                state = complete;
+                // this op is moved with self, so take the members out first
+                auto& a_stream{stream};
+                auto a_host{force_move(host)};
+                auto a_port{force_move(port)};
+                using race_type = connect_race<std::decay_t<Self>>;
+                auto race = std::make_shared<race_type>(
+                    a_stream,
+                    force_move(a_host),
+                    force_move(a_port),
+                    force_move(self)
                 );
+                // The race is registered before resolving, so async_close() can cancel
+                // the resolution, too.
+                register_race(a_stream, race);
+                // per-operation cancellation cancels the resolution and all attempts
+                auto slot = race->self->get_cancellation_state().slot();
+                if (slot.is_connected()) {
+                    slot.assign(
+                        [wp = std::weak_ptr<race_type>(race)]
+                        (as::cancellation_type) {
+                            if (auto sp = wp.lock()) sp->cancel();
+                        }
+                    );
+                }
+                race_type::start(force_move(race));
             }
         }
+    };
+
+    // The handshakes in progress are registered by the stream address,
+    // so async_close() can cancel them.
+    struct race_base {
+        virtual ~race_base() = default;
+        virtual void cancel() = 0;
+    };
+
+    static std::mutex& races_mtx() {
+        static std::mutex mtx;
+        return mtx;
+    }
+
+    static std::map<void const*, std::weak_ptr<race_base>>& races() {
+        static std::map<void const*, std::weak_ptr<race_base>> m;
+        return m;
+    }
+
+    static void register_race(
+        as::basic_stream_socket<Protocol, Executor> const& stream,
+        std::shared_ptr<race_base> const& race
+    ) {
+        std::lock_guard<std::mutex> g{races_mtx()};
+        races().insert_or_assign(&stream, race);
+    }
+
+    static void unregister_race(
+        as::basic_stream_socket<Protocol, Executor> const& stream,
+        race_base const* race
+    ) {
+        std::lock_guard<std::mutex> g{races_mtx()};
+        auto it = races().find(&stream);
+        if (it == races().end()) return;
+        auto sp = it->second.lock();
+        if (!sp || sp.get() == race) races().erase(it);
+    }
+
+    static std::shared_ptr<race_base> take_race(
+        as::basic_stream_socket<Protocol, Executor> const& stream
+    ) {
+        std::lock_guard<std::mutex> g{races_mtx()};
+        auto it = races().find(&stream);
+        if (it == races().end()) return nullptr;
+        auto sp = it->second.lock();
+        races().erase(it);
+        return sp;
+    }
+
+    // Resolution and Happy Eyeballs (RFC 8305) connection attempts.
+    // The host is looked up in resolve_cache, resolved by this race, or resolved by the other
+    // race that this race joins. Then an attempt is started for each connection_attempt_delay,
+    // or as soon as the previous attempt fails, and the first established connection is moved
+    // to the stream.
+    template <typename Self>
+    struct connect_race : race_base, std::enable_shared_from_this<connect_race<Self>> {
+        using socket_type = as::basic_stream_socket<Protocol, Executor>;
+
+        enum class phase { resolving, waiting, connecting };
+
+        connect_race(
+            socket_type& stream,
+            std::string host,
+            std::string port,
+            Self self
+        ):stream{stream},
+          host{force_move(host)},
+          port{force_move(port)},
+          tim{stream.get_executor()},
+          self{force_move(self)}
+        {}
+
+        // Called by async_close() and per-operation cancellation.
+        // The flag is set synchronously, so no socket is moved to the stream after that.
+        void cancel() override {
+            if (cancelled.exchange(true)) return;
+            as::dispatch(
+                tim.get_executor(),
+                [sp = this->shared_from_this()] {
+                    sp->tim.cancel();
+                    if (sp->res) sp->res->cancel();
+                    for (auto& s : sp->socks) {
+                        error_code ignored;
+                        s->close(ignored);
+                    }
+                }
+            );
+        }
 
-        struct default_connect_condition {
-            template <typename Endpoint>
-            bool operator()(error_code const&, Endpoint const&) {
-                return true;
+        static void start(std::shared_ptr<connect_race> sp) {
+            if (sp->cancelled) {
+                finish(sp, make_error_code(as::error::operation_aborted));
+                return;
+            }
+            auto& cache = resolve_cache::global();
+            if (auto eps = cache.lookup(sp->host, sp->port)) {
+                ASYNC_MQTT_LOG("mqtt_impl", trace)
+                    << "resolve cache hit:" << sp->host << ":" << sp->port;
+                start_connect(force_move(sp), force_move(*eps));
+                return;
             }
-        };
+            // The waiter doesn't keep the race alive. The wait timer does, so the race
+            // is released when its io_context is destroyed.
+            bool joined = cache.join(
+                sp->host,
+                sp->port,
+                [wp = std::weak_ptr<connect_race>(sp), exe = sp->stream.get_executor()]
+                (error_code const& ec, resolve_cache::endpoints_type const& eps) {
+                    if (wp.expired()) return;
+                    as::post(
+                        exe,
+                        [wp, ec, eps = resolve_cache::endpoints_type{eps}] () mutable {
+                            if (auto sp = wp.lock()) on_joined(force_move(sp), ec, force_move(eps));
+                        }
+                    );
+                }
+            );
+            if (!joined) {
+                sp->guard.emplace(cache, sp->host, sp->port);
+                resolve(force_move(sp));
+                return;
+            }
+            ASYNC_MQTT_LOG("mqtt_impl", trace)
+                << "resolve in progress. wait for it:" << sp->host << ":" << sp->port;
+            sp->ph = phase::waiting;
+            sp->tim.expires_after(cache.join_timeout());
+            sp->tim.async_wait(
+                [sp](error_code const& ec) {
+                    // resumed by on_joined()
+                    if (sp->ph != phase::waiting) return;
+                    if (sp->cancelled) {
+                        finish(sp, make_error_code(as::error::operation_aborted));
+                        return;
+                    }
+                    // the wait is restarted
+                    if (ec) return;
+                    ASYNC_MQTT_LOG("mqtt_impl", info)
+                        << "resolve in progress takes too long. resolve by itself:"
+                        << sp->host << ":" << sp->port;
+                    resolve(sp);
+                }
+            );
+        }
 
-        template <typename Self>
-        void operator()(
-            Self& self,
-            error_code ec,
-            as::ip::tcp::resolver::results_type eps
+        static void resolve(std::shared_ptr<connect_race> sp) {
+            sp->ph = phase::resolving;
+            sp->res.emplace(sp->stream.get_executor());
+            sp->res->async_resolve(
+                sp->host,
+                sp->port,
+                [sp](error_code const& ec, as::ip::tcp::resolver::results_type results) {
+                    resolve_cache::endpoints_type eps;
+                    eps.reserve(results.size());
+                    for (auto const& entry : results) {
+                        eps.push_back(entry.endpoint());
+                    }
+                    if (sp->guard) {
+                        // the waiters that joined this resolution are resumed
+                        sp->guard->complete(ec, eps);
+                        sp->guard.reset();
+                    }
+                    else if (!ec) {
+                        resolve_cache::global().store(sp->host, sp->port, eps);
+                    }
+                    if (sp->cancelled) {
+                        finish(sp, make_error_code(as::error::operation_aborted));
+                        return;
+                    }
+                    if (ec) {
+                        finish(sp, ec);
+                        return;
+                    }
+                    start_connect(sp, force_move(eps));
+                }
+            );
+        }
+
+        // resolved by the other race that this race joined
+        static void on_joined(
+            std::shared_ptr<connect_race> sp,
+            error_code const& ec,
+            resolve_cache::endpoints_type eps
         ) {
-            BOOST_ASSERT(state == connect);
-            state = complete;
+            if (sp->ph != phase::waiting) return;
+            sp->ph = phase::resolving;
+            sp->tim.cancel();
+            if (sp->cancelled) {
+                finish(sp, make_error_code(as::error::operation_aborted));
+                return;
+            }
+            if (ec == as::error::operation_aborted) {
+                // the other race is aborted, so join or resolve again
+                start(force_move(sp));
+                return;
+            }
             if (ec) {
-                self.complete(ec);
+                finish(sp, ec);
+                return;
+            }
+            start_connect(force_move(sp), force_move(eps));
+        }
+
+        static void start_connect(std::shared_ptr<connect_race> sp, resolve_cache::endpoints_type eps) {
+            sp->ph = phase::connecting;
+            sp->eps = interleave(force_move(eps));
+            start_attempt(force_move(sp));
+        }
+
+        // RFC 8305 Section 4: sort the endpoints alternating the address families,
+        // starting from IPv6. The order in each family is kept.
+        static resolve_cache::endpoints_type interleave(resolve_cache::endpoints_type eps) {
+            resolve_cache::endpoints_type v6;
+            resolve_cache::endpoints_type v4;
+            for (auto& ep : eps) {
+                (ep.address().is_v6() ? v6 : v4).push_back(ep);
+            }
+            eps.clear();
+            auto it6 = v6.begin();
+            auto it4 = v4.begin();
+            while (it6 != v6.end() || it4 != v4.end()) {
+                if (it6 != v6.end()) eps.push_back(*it6++);
+                if (it4 != v4.end()) eps.push_back(*it4++);
+            }
+            return eps;
+        }
+
+        static void start_attempt(std::shared_ptr<connect_race> sp) {
+            if (sp->cancelled) {
+                if (sp->running == 0) finish(sp, make_error_code(as::error::operation_aborted));
+                return;
+            }
+            if (sp->next == sp->eps.size()) {
+                if (sp->running == 0) finish(sp, make_error_code(as::error::host_not_found));
                 return;
             }
-            auto& a_stream{stream};
-            as::async_connect(
-                a_stream,
-                eps,
-                default_connect_condition(),
-                force_move(self)
+            auto const& ep = sp->eps[sp->next++];
+            ASYNC_MQTT_LOG("mqtt_impl", trace)
+                << "TCP connect attempt:" << ep;
+            auto sock = std::make_shared<socket_type>(sp->stream.get_executor());
+            sp->socks.push_back(sock);
+            ++sp->running;
+            sock->async_connect(
+                ep,
+                [sp, sock](error_code const& ec) {
+                    on_attempt(sp, sock, ec);
+                }
             );
+            if (sp->next != sp->eps.size()) {
+                sp->tim.expires_after(connection_attempt_delay);
+                sp->tim.async_wait(
+                    [sp](error_code const& ec) {
+                        if (ec || !sp->self) return;
+                        start_attempt(sp);
+                    }
+                );
+            }
         }
 
-        template <typename Self>
-        void operator()(
-            Self& self,
-            error_code ec,
-            as::ip::tcp::endpoint /*unused*/
+        static void on_attempt(
+            std::shared_ptr<connect_race> sp,
+            std::shared_ptr<socket_type> const& sock,
+            error_code const& ec
         ) {
-            BOOST_ASSERT(state == complete);
-            self.complete(ec);
+            --sp->running;
+            if (!sp->self) return;
+            if (sp->cancelled) {
+                error_code ignored;
+                sock->close(ignored);
+                if (sp->running == 0) finish(sp, make_error_code(as::error::operation_aborted));
+                return;
+            }
+            if (!ec) {
+                sp->tim.cancel();
+                for (auto& s : sp->socks) {
+                    if (s != sock) {
+                        error_code ignored;
+                        s->close(ignored);
+                    }
+                }
+                sp->stream = force_move(*sock);
+                finish(sp, error_code{});
+                return;
+            }
+            sp->last_ec = ec;
+            if (sp->next != sp->eps.size()) {
+                // don't wait for the delay if the attempt fails
+                sp->tim.cancel();
+                start_attempt(sp);
+            }
+            else if (sp->running == 0) {
+                // The cache entry is kept until it expires, so the retries to the broker
+                // that is down don't resolve the host again.
+                finish(sp, sp->last_ec);
+            }
         }
+
+        static void finish(std::shared_ptr<connect_race> const& sp, error_code const& ec) {
+            if (!sp->self) return;
+            unregister_race(sp->stream, sp.get());
+            auto a_self{force_move(*sp->self)};
+            sp->self.reset();
+            sp->socks.clear();
+            a_self.get_cancellation_state().slot().clear();
+            a_self.complete(ec);
+        }
+
+        socket_type& stream;
+        std::string host;
+        std::string port;
+        phase ph = phase::resolving;
+        // set while this race resolves the host that the other races can join
+        std::optional<resolve_cache::pending_guard> guard;
+        std::optional<as::ip::tcp::resolver> res;
+        resolve_cache::endpoints_type eps;
+        std::size_t next = 0;
+        std::size_t running = 0;
+        std::vector<std::shared_ptr<socket_type>> socks;
+        as::steady_timer tim;
+        std::optional<Self> self;
+        error_code last_ec;
+        std::atomic<bool> cancelled{false};
     };
 
+    /**
+     * @brief Connection Attempt Delay of Happy Eyeballs. The recommended value of RFC 8305.
+     */
+    static constexpr std::chrono::milliseconds connection_attempt_delay{250};
+
     template <
         typename CompletionToken
     >
@@ -146,6 +458,11 @@ struct layer_customize<as::basic_stream_socket<Protocol, Executor>> {
         > (
             [&stream](auto& self) {
                 error_code ec;
+                if (auto race = take_race(stream)) {
+                    ASYNC_MQTT_LOG("mqtt_impl", info)
+                        << "TCP connect cancelled";
+                    race->cancel();
+                }
                 if (stream.is_open()) {
                     ASYNC_MQTT_LOG("mqtt_impl", info)
                         << "TCP close";
@@ -0,0 +1,142 @@
+// Copyright Takatoshi Kondo 2024
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#if !defined(ASYNC_MQTT_ASIO_BIND_PUBLISH_MESSAGE_HPP)
+#define ASYNC_MQTT_ASIO_BIND_PUBLISH_MESSAGE_HPP
+
+#include <deque>
+#include <memory>
+
+#include <boost/asio/any_completion_handler.hpp>
+#include <boost/asio/append.hpp>
+#include <boost/asio/dispatch.hpp>
+
+#include <async_mqtt/asio_bind/client.hpp>
+#include <async_mqtt/protocol/error.hpp>
+#include <async_mqtt/protocol/protocol_version.hpp>
+#include <async_mqtt/protocol/packet/packet_id_type.hpp>
+#include <async_mqtt/protocol/packet/property_variant.hpp>
+#include <async_mqtt/protocol/packet/pubopts.hpp>
+#include <async_mqtt/util/buffer.hpp>
+#include <async_mqtt/util/move.hpp>
+
+namespace async_mqtt {
+
+/**
+ * @brief message to publish by client_pool and reconnecting_client
+ *        packet_id is acquired by the client that sends the message.
+ */
+struct publish_message {
+    buffer topic;      ///< TopicName
+    buffer payload;    ///< Payload
+    pub::opts opts;    ///< Publish Options
+    properties props;  ///< Publish Properties. Ignored if the protocol version is v3.1.1
+};
+
+namespace detail {
+
+namespace as = boost::asio;
+
+template <protocol_version Version, typename NextLayer>
+typename client<Version, NextLayer>::publish_packet
+make_publish_packet(packet_id_type pid, publish_message msg) {
+    using publish_packet = typename client<Version, NextLayer>::publish_packet;
+    if constexpr (Version == protocol_version::v5) {
+        return publish_packet{
+            pid,
+            force_move(msg.topic),
+            force_move(msg.payload),
+            msg.opts,
+            force_move(msg.props)
+        };
+    }
+    else {
+        return publish_packet{
+            pid,
+            force_move(msg.topic),
+            force_move(msg.payload),
+            msg.opts
+        };
+    }
+}
+
+// Publish the messages by the client in the order of the calls.
+// While a packet_id is awaited, the later messages, including QoS0 ones, wait behind it.
+// All member functions are called on the client's executor.
+template <protocol_version Version, typename NextLayer>
+class publish_sequencer : public std::enable_shared_from_this<publish_sequencer<Version, NextLayer>> {
+public:
+    using client_type = client<Version, NextLayer>;
+    using pubres_type = typename client_type::pubres_type;
+    using handler_type = as::any_completion_handler<void(error_code, pubres_type)>;
+
+    explicit publish_sequencer(client_type& cl)
+        :cl_{cl}
+    {
+    }
+
+    void publish(publish_message msg, handler_type handler) {
+        waiting_.push_back(entry{force_move(msg), force_move(handler)});
+        if (!acquiring_) send();
+    }
+
+private:
+    struct entry {
+        publish_message msg;
+        handler_type handler;
+    };
+
+    void send() {
+        while (!waiting_.empty()) {
+            packet_id_type pid = 0;
+            if (waiting_.front().msg.opts.get_qos() != qos::at_most_once) {
+                auto pid_opt = cl_.acquire_unique_packet_id();
+                if (!pid_opt) {
+                    wait();
+                    return;
+                }
+                pid = *pid_opt;
+            }
+            auto e = force_move(waiting_.front());
+            waiting_.pop_front();
+            cl_.async_publish(make_publish_packet<Version, NextLayer>(pid, force_move(e.msg)), force_move(e.handler));
+        }
+    }
+
+    void wait() {
+        acquiring_ = true;
+        cl_.async_acquire_unique_packet_id_wait_until(
+            [sp = this->shared_from_this()]
+            (error_code const& ec, packet_id_type pid) {
+                sp->acquiring_ = false;
+                if (ec) {
+                    auto es = force_move(sp->waiting_);
+                    sp->waiting_.clear();
+                    for (auto& e : es) {
+                        as::dispatch(
+                            as::append(force_move(e.handler), ec, pubres_type{})
+                        );
+                    }
+                    return;
+                }
+                auto e = force_move(sp->waiting_.front());
+                sp->waiting_.pop_front();
+                sp->cl_.async_publish(make_publish_packet<Version, NextLayer>(pid, force_move(e.msg)), force_move(e.handler));
+                sp->send();
+            }
+        );
+    }
+
+    client_type& cl_;
+    std::deque<entry> waiting_;
+    bool acquiring_ = false;
+};
+
+} // namespace detail
+
+} // namespace async_mqtt
+
+#endif // ASYNC_MQTT_ASIO_BIND_PUBLISH_MESSAGE_HPP
@@ -0,0 +1,540 @@
+// Copyright Takatoshi Kondo 2024
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#if !defined(ASYNC_MQTT_ASIO_BIND_RECONNECTING_CLIENT_HPP)
+#define ASYNC_MQTT_ASIO_BIND_RECONNECTING_CLIENT_HPP
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <boost/asio/any_completion_handler.hpp>
+#include <boost/asio/append.hpp>
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include <async_mqtt/asio_bind/client.hpp>
+#include <async_mqtt/asio_bind/publish_message.hpp>
+#include <async_mqtt/protocol/error.hpp>
+#include <async_mqtt/protocol/packet/store_packet_variant.hpp>
+#include <async_mqtt/protocol/packet/topic_subopts.hpp>
+#include <async_mqtt/util/backoff.hpp>
+#include <async_mqtt/util/drop_queue.hpp>
+#include <async_mqtt/util/log.hpp>
+#include <async_mqtt/util/move.hpp>
+#include <async_mqtt/util/overload.hpp>
+
+namespace async_mqtt {
+
+namespace as = boost::asio;
+
+/**
+ * @brief client that reconnects automatically
+ *
+ * After start() is called, the client connects to the broker, and when the connection is lost
+ * or fails, it reconnects after a delay of exponential backoff with full jitter.
+ * On each connection:
+ *  @li If the CONNACK has session_present true, the endpoint resends the stored PUBLISH (QoS1, QoS2)
+ *      and PUBREL packets.
+ *  @li Otherwise, the subscriptions that are set by set_subscriptions() are subscribed again,
+ *      and then the stored PUBLISH packets of the previous connection are published again
+ *      with their packet ids. A packet that can't be resent is logged as an error.
+ *  @li The publishes that are queued while disconnected are sent in order.
+ *
+ * The CONNECT packet given to start() is used for all connections. Set CleanStart false
+ * (and Session Expiry Interval for v5) to resume the session.
+ * The packets are received by the handler that is set by set_recv_handler() (push mode).
+ *
+ * #### Thread Safety
+ *    @li Distinct objects: Safe
+ *    @li Shared objects: Unsafe
+ *
+ * @tparam Version       MQTT protocol version.
+ * @tparam NextLayer     Just next layer for client. mqtt, mqtts, ws, and wss are predefined.
+ */
+template <protocol_version Version, typename NextLayer>
+class reconnecting_client {
+public:
+    /// @brief type of the underlying client
+    using client_type = client<Version, NextLayer>;
+
+    /// @brief executor_type of the underlying client
+    using executor_type = typename client_type::executor_type;
+
+    /// @brief connect packet type of the underlying client
+    using connect_packet = typename client_type::connect_packet;
+
+    /// @brief response type of async_publish()
+    using pubres_type = typename client_type::pubres_type;
+
+    /// @brief type of the receive handler. See client::set_recv_handler()
+    using recv_handler_type = typename client_type::recv_handler_type;
+
+    /// @brief type of the handler that is called when the connection is established (true) or lost (false)
+    using connection_handler_type = std::function<void(bool)>;
+
+    /// @brief message to publish
+    using message = publish_message;
+
+    /// @brief behavior when a publish is requested while the queue is full
+    using drop_policy = async_mqtt::drop_policy;
+
+    /**
+     * @brief reconnect configuration
+     */
+    struct config {
+        /// the first ceiling of the reconnect delay
+        std::chrono::milliseconds initial_backoff{100};
+        /// the maximum ceiling of the reconnect delay
+        std::chrono::milliseconds max_backoff{30000};
+        /// the maximum number of publishes that are queued while disconnected. 0 means no queueing.
+        std::size_t max_queued = 1024;
+        /// behavior when the queue is full
+        drop_policy policy = drop_policy::drop_oldest;
+    };
+
+    /**
+     * @brief constructor
+     * @param cfg  reconnect configuration
+     * @param args arguments of the client constructor. e.g. executor
+     */
+    template <typename... Args>
+    explicit
+    reconnecting_client(config cfg, Args&&... args)
+        :impl_{std::make_shared<impl>(force_move(cfg), std::forward<Args>(args)...)}
+    {
+        impl_->init();
+    }
+
+    /**
+     * @brief Get the underlying client
+     *        It can be used to configure the client before start(), and to subscribe and
+     *        unsubscribe while connected.
+     * @return the underlying client
+     */
+    client_type& get_client() {
+        return impl_->cl;
+    }
+
+    /**
+     * @brief executor getter
+     * @return the underlying client's executor
+     */
+    as::any_io_executor get_executor() {
+        return impl_->cl.get_executor();
+    }
+
+    /**
+     * @brief Set the receive handler
+     *        The handler is not called with the error of lost connections.
+     *        \n This function should be called before start() call.
+     * @param handler the receive handler. See client::set_recv_handler()
+     */
+    void set_recv_handler(recv_handler_type handler) {
+        impl_->recv_handler = force_move(handler);
+    }
+
+    /**
+     * @brief Resume reading that is paused by the receive handler.
+     */
+    void resume_recv() {
+        impl_->cl.resume_recv();
+    }
+
+    /**
+     * @brief Set the connection handler
+     *        client_pool sets it for its reconnecting_client members.
+     *        \n This function should be called before start() call.
+     * @param handler the handler that is called with true when connected, and with false when disconnected
+     */
+    void set_connection_handler(connection_handler_type handler) {
+        impl_->connection_handler = force_move(handler);
+    }
+
+    /**
+     * @brief Set the subscriptions
+     *        They are subscribed when the CONNACK has session_present false.
+     *        \n This function should be called before start() call.
+     * @param entries subscription entries
+     */
+    void set_subscriptions(std::vector<topic_subopts> entries) {
+        impl_->subscriptions = force_move(entries);
+    }
+
+    /**
+     * @brief Start connecting
+     * @param host   hostname of the broker
+     * @param port   port of the broker
+     * @param packet CONNECT packet that is used for all connections
+     */
+    void start(std::string host, std::string port, connect_packet packet) {
+        as::dispatch(
+            impl_->cl.get_executor(),
+            [impl = impl_, host = force_move(host), port = force_move(port), packet = force_move(packet)]
+            () mutable {
+                impl->host = force_move(host);
+                impl->port = force_move(port);
+                impl->packet.emplace(force_move(packet));
+                impl->connect();
+            }
+        );
+    }
+
+    /**
+     * @brief publish the message, or queue it while disconnected
+     * @param msg   the message to publish
+     * @param token see Signature
+     * @return deduced by token
+     *
+     * ### Completion Token
+     * @li <a href="https://www.boost.org/doc/html/boost_asio/overview/composition/token_adapters.html">Default Completion Token</a> is supported
+     *
+     * #### Signature
+     * void(@ref error_code, @ref pubres_type)
+     *
+     * ##### error_code
+     * @li If disconnected and config::max_queued is 0, boost::asio::error::not_connected is set.
+     * @li If the message is dropped by drop_policy, boost::asio::error::no_buffer_space is set.
+     * @li If stopped before the message is sent, boost::asio::error::operation_aborted is set.
+     * @li Otherwise, the same as client::async_publish().
+     *     If the connection is lost before the response is received, the error is reported,
+     *     but QoS1 and QoS2 messages are sent again on the next connection.
+     */
+    template <
+        typename CompletionToken = as::default_completion_token_t<executor_type>
+    >
+    auto
+    async_publish(
+        message msg,
+        CompletionToken&& token = as::default_completion_token_t<executor_type>{}
+    ) {
+        return
+            as::async_initiate<
+                CompletionToken,
+                void(error_code, pubres_type)
+            >(
+                [](auto handler, std::shared_ptr<impl> impl, message msg) {
+                    auto exe = impl->cl.get_executor();
+                    as::dispatch(
+                        exe,
+                        [impl = force_move(impl), msg = force_move(msg), handler = force_move(handler)]
+                        () mutable {
+                            impl->publish(force_move(msg), force_move(handler));
+                        }
+                    );
+                },
+                token,
+                impl_,
+                force_move(msg)
+            );
+    }
+
+    /**
+     * @brief stop reconnecting, and disconnect
+     * @param token see Signature
+     * @return deduced by token
+     *
+     * ### Completion Token
+     * @li <a href="https://www.boost.org/doc/html/boost_asio/overview/composition/token_adapters.html">Default Completion Token</a> is supported
+     *
+     * #### Signature
+     * void()
+     */
+    template <
+        typename CompletionToken = as::default_completion_token_t<executor_type>
+    >
+    auto
+    async_stop(
+        CompletionToken&& token = as::default_completion_token_t<executor_type>{}
+    ) {
+        return
+            as::async_initiate<
+                CompletionToken,
+                void()
+            >(
+                [](auto handler, std::shared_ptr<impl> impl) {
+                    auto exe = impl->cl.get_executor();
+                    as::dispatch(
+                        exe,
+                        [impl = force_move(impl), handler = force_move(handler)]
+                        () mutable {
+                            impl->stop(force_move(handler));
+                        }
+                    );
+                },
+                token,
+                impl_
+            );
+    }
+
+private:
+    using publish_handler_type = as::any_completion_handler<void(error_code, pubres_type)>;
+
+    struct queued_publish {
+        message msg;
+        publish_handler_type handler;
+    };
+
+    // all members are accessed on the client's executor
+    struct impl : std::enable_shared_from_this<impl> {
+        enum class state { idle, connecting, connected, waiting, stopped };
+
+        template <typename... Args>
+        explicit impl(config cfg, Args&&... args)
+            :cfg{force_move(cfg)},
+             cl{std::forward<Args>(args)...},
+             tim{cl.get_executor()},
+             backoff{this->cfg.initial_backoff, this->cfg.max_backoff},
+             queue{this->cfg.max_queued, this->cfg.policy}
+        {
+        }
+
+        void init() {
+            // weak_ptr avoids the cycle impl -> cl -> handler -> impl
+            cl.set_recv_handler(
+                [wp = this->weak_from_this()]
+                (error_code const& ec, std::optional<packet_variant> pv_opt) {
+                    auto sp = wp.lock();
+                    if (!sp) return false;
+                    if (ec) {
+                        sp->on_disconnected(ec);
+                        return false;
+                    }
+                    if (sp->recv_handler) {
+                        return sp->recv_handler(ec, force_move(pv_opt));
+                    }
+                    return true;
+                }
+            );
+        }
+
+        void connect() {
+            if (st == state::stopped) return;
+            st = state::connecting;
+            cl.async_underlying_handshake(
+                host,
+                port,
+                [sp = this->shared_from_this()](error_code const& ec) {
+                    if (sp->st == state::stopped) return;
+                    if (ec) {
+                        ASYNC_MQTT_LOG("mqtt_impl", info)
+                            << "reconnecting_client handshake failed:" << ec.message();
+                        sp->retry();
+                        return;
+                    }
+                    sp->cl.async_start(
+                        *sp->packet,
+                        [sp](error_code const& ec, auto connack_opt) {
+                            if (sp->st == state::stopped) return;
+                            if (ec || !connack_opt) {
+                                ASYNC_MQTT_LOG("mqtt_impl", info)
+                                    << "reconnecting_client start failed:" << ec.message();
+                                sp->retry();
+                                return;
+                            }
+                            sp->on_connected(connack_opt->session_present());
+                        }
+                    );
+                }
+            );
+        }
+
+        void on_connected(bool session_present) {
+            st = state::connected;
+            backoff.reset();
+            if (!session_present) {
+                // The packet ids of the stored packets are registered before the SUBSCRIBE
+                // acquires one. Subscribe before publishing, so that the republished messages
+                // are delivered to the own subscriptions, too.
+                auto pubs = reserve_stored();
+                resubscribe();
+                republish(force_move(pubs));
+            }
+            stored.clear();
+            for (auto& e : queue.take()) {
+                seq->publish(force_move(e.msg), force_move(e.handler));
+            }
+            if (connection_handler) connection_handler(true);
+        }
+
+        void on_disconnected(error_code const& ec) {
+            // errors while connecting are reported by async_start()
+            if (st != state::connected) return;
+            ASYNC_MQTT_LOG("mqtt_impl", info)
+                << "reconnecting_client disconnected:" << ec.message();
+            st = state::waiting;
+            if (connection_handler) connection_handler(false);
+            cl.get_endpoint().async_get_stored_packets(
+                [sp = this->shared_from_this()]
+                (error_code const& /* ec */, std::vector<store_packet_variant> pvs) {
+                    sp->stored = force_move(pvs);
+                    sp->retry();
+                }
+            );
+        }
+
+        void retry() {
+            if (st == state::stopped) return;
+            st = state::waiting;
+            cl.async_close(
+                [sp = this->shared_from_this()] {
+                    if (sp->st == state::stopped) return;
+                    sp->tim.expires_after(sp->backoff.next());
+                    sp->tim.async_wait(
+                        [sp](error_code const& ec) {
+                            if (ec) return;
+                            sp->connect();
+                        }
+                    );
+                }
+            );
+        }
+
+        // The broker doesn't have the session, and the endpoint has cleared its store and
+        // its packet ids. Register the packet ids of the stored PUBLISH packets of the previous
+        // connection again. If a packet id is already in use, a new one is acquired (v5 only).
+        // PUBREL packets are dropped because the broker has already received the PUBLISH.
+        std::vector<typename client_type::publish_packet> reserve_stored() {
+            std::vector<typename client_type::publish_packet> pubs;
+            for (auto const& pv : stored) {
+                pv.visit(
+                    overload {
+                        [&](typename client_type::publish_packet const& p) {
+                            auto copied = p;
+                            copied.set_dup(false);
+                            if (cl.register_packet_id(p.packet_id())) {
+                                pubs.push_back(force_move(copied));
+                                return;
+                            }
+                            if constexpr (Version == protocol_version::v5) {
+                                if (auto pid_opt = cl.acquire_unique_packet_id()) {
+                                    copied.set_packet_id(*pid_opt);
+                                    pubs.push_back(force_move(copied));
+                                    return;
+                                }
+                            }
+                            ASYNC_MQTT_LOG("mqtt_impl", error)
+                                << "reconnecting_client stored PUBLISH cannot be resent. packet_id:"
+                                << p.packet_id() << " topic:" << p.topic();
+                        },
+                        [](auto const&) {
+                        }
+                    }
+                );
+            }
+            return pubs;
+        }
+
+        void republish(std::vector<typename client_type::publish_packet> pubs) {
+            for (auto& p : pubs) {
+                cl.async_publish(
+                    force_move(p),
+                    [](error_code const& ec, pubres_type const&) {
+                        if (ec) {
+                            ASYNC_MQTT_LOG("mqtt_impl", warning)
+                                << "reconnecting_client republish failed:" << ec.message();
+                        }
+                    }
+                );
+            }
+        }
+
+        void resubscribe() {
+            if (subscriptions.empty()) return;
+            auto pid_opt = cl.acquire_unique_packet_id();
+            if (!pid_opt) return;
+            cl.async_subscribe(
+                typename client_type::subscribe_packet{*pid_opt, subscriptions},
+                [](error_code const& ec, auto const&) {
+                    if (ec) {
+                        ASYNC_MQTT_LOG("mqtt_impl", warning)
+                            << "reconnecting_client resubscribe failed:" << ec.message();
+                    }
+                }
+            );
+        }
+
+        void publish(message msg, publish_handler_type handler) {
+            switch (st) {
+            case state::connected:
+                seq->publish(force_move(msg), force_move(handler));
+                return;
+            case state::stopped:
+                complete(force_move(handler), as::error::operation_aborted);
+                return;
+            default:
+                break;
+            }
+            if (cfg.max_queued == 0) {
+                complete(force_move(handler), as::error::not_connected);
+                return;
+            }
+            if (auto dropped = queue.push(queued_publish{force_move(msg), force_move(handler)})) {
+                complete(force_move(dropped->handler), as::error::no_buffer_space);
+            }
+        }
+
+        template <typename Handler>
+        void stop(Handler handler) {
+            bool was_connected = st == state::connected;
+            st = state::stopped;
+            tim.cancel();
+            for (auto& e : queue.take()) {
+                complete(force_move(e.handler), as::error::operation_aborted);
+            }
+            auto close =
+                [sp = this->shared_from_this(), handler = force_move(handler)] () mutable {
+                    sp->cl.async_close(force_move(handler));
+                };
+            if (was_connected) {
+                if (connection_handler) connection_handler(false);
+                cl.async_disconnect(
+                    typename client_type::disconnect_packet{},
+                    [close = force_move(close)](error_code const&) mutable {
+                        close();
+                    }
+                );
+            }
+            else {
+                close();
+            }
+        }
+
+        static void complete(publish_handler_type handler, as::error::basic_errors e) {
+            as::dispatch(
+                as::append(force_move(handler), make_error_code(e), pubres_type{})
+            );
+        }
+
+        config cfg;
+        client_type cl;
+        // publishes in the order of the calls, even while a packet_id is awaited
+        std::shared_ptr<detail::publish_sequencer<Version, NextLayer>> seq =
+            std::make_shared<detail::publish_sequencer<Version, NextLayer>>(cl);
+        as::steady_timer tim;
+        exponential_backoff backoff;
+        state st = state::idle;
+        std::string host;
+        std::string port;
+        std::optional<connect_packet> packet;
+        std::vector<topic_subopts> subscriptions;
+        recv_handler_type recv_handler;
+        connection_handler_type connection_handler;
+        drop_queue<queued_publish> queue;
+        std::vector<store_packet_variant> stored;
+    };
+
+    std::shared_ptr<impl> impl_;
+};
+
+} // namespace async_mqtt
+
+#endif // ASYNC_MQTT_ASIO_BIND_RECONNECTING_CLIENT_HPP
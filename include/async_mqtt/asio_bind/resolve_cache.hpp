@@ -0,0 +1,325 @@
+// Copyright Takatoshi Kondo 2024
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#if !defined(ASYNC_MQTT_ASIO_BIND_RESOLVE_CACHE_HPP)
+#define ASYNC_MQTT_ASIO_BIND_RESOLVE_CACHE_HPP
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <boost/asio/error.hpp>
+#include <boost/asio/ip/tcp.hpp>
+
+#include <async_mqtt/protocol/error.hpp>
+#include <async_mqtt/util/move.hpp>
+
+namespace async_mqtt {
+
+namespace as = boost::asio;
+
+/**
+ * @brief Cache of resolved TCP endpoints
+ *
+ * The predefined TCP layer looks up the cache before resolving the host, so the clients that
+ * connect to the same host:port don't resolve it again until the entry expires.
+ * The entry is kept until it expires even if all endpoints fail to connect, so the clients
+ * that reconnect to the broker that is down don't resolve the host on each retry.
+ * Failed resolutions are not cached.
+ *
+ * The resolutions of the same host:port that are requested while one is in progress are
+ * coalesced by join() and complete(), so many clients that start at the same time
+ * resolve the host only once.
+ * The caller that resolves holds a pending_guard, so the waiters are resumed even if the
+ * caller is destroyed before the resolution finishes. e.g. its io_context is stopped.
+ *
+ * #### Thread Safety
+ *    @li Distinct objects: Safe
+ *    @li Shared objects: Safe
+ */
+class resolve_cache {
+public:
+    using endpoints_type = std::vector<as::ip::tcp::endpoint>;
+    using clock_type = std::chrono::steady_clock;
+    using waiter_type = std::function<void(error_code const&, endpoints_type const&)>;
+
+    /**
+     * @brief Guard of the resolution that is started by join()
+     *        complete() finishes the resolution. If the guard is destroyed before that,
+     *        the waiters are resumed with boost::asio::error::operation_aborted.
+     */
+    class pending_guard {
+    public:
+        /**
+         * @brief constructor
+         * @param cache cache that join() returned false
+         * @param host  host
+         * @param port  port
+         */
+        pending_guard(resolve_cache& cache, std::string host, std::string port)
+            :cache_{&cache},
+             host_{force_move(host)},
+             port_{force_move(port)}
+        {
+        }
+
+        pending_guard(pending_guard&& other) noexcept
+            :cache_{std::exchange(other.cache_, nullptr)},
+             host_{force_move(other.host_)},
+             port_{force_move(other.port_)}
+        {
+        }
+
+        pending_guard(pending_guard const&) = delete;
+        pending_guard& operator=(pending_guard const&) = delete;
+        pending_guard& operator=(pending_guard&&) = delete;
+
+        ~pending_guard() {
+            if (cache_) {
+                cache_->complete(host_, port_, make_error_code(as::error::operation_aborted), {});
+            }
+        }
+
+        /**
+         * @brief Finish the resolution. See resolve_cache::complete()
+         * @param ec  result of the resolution
+         * @param eps resolved endpoints
+         */
+        void complete(error_code const& ec, endpoints_type const& eps) {
+            if (auto c = std::exchange(cache_, nullptr)) {
+                c->complete(host_, port_, ec, eps);
+            }
+        }
+
+    private:
+        resolve_cache* cache_;
+        std::string host_;
+        std::string port_;
+    };
+
+    /**
+     * @brief constructor
+     * @param ttl         time to live of the entries. zero disables the cache.
+     * @param max_entries maximum number of entries
+     */
+    explicit resolve_cache(
+        clock_type::duration ttl = std::chrono::seconds{30},
+        std::size_t max_entries = 1024
+    ):ttl_{ttl},
+      max_entries_{max_entries}
+    {
+    }
+
+    /**
+     * @brief Get the process-wide cache that is used by the predefined TCP layer
+     * @return the cache
+     */
+    static resolve_cache& global() {
+        static resolve_cache cache;
+        return cache;
+    }
+
+    /**
+     * @brief Set time to live of the entries
+     *        The existing entries keep their expiry.
+     * @param ttl time to live. zero disables the cache.
+     */
+    void set_ttl(clock_type::duration ttl) {
+        std::lock_guard<std::mutex> g{mtx_};
+        ttl_ = ttl;
+    }
+
+    /**
+     * @brief Set the maximum time to wait for the resolution that is joined by join()
+     *        When it elapses, the waiter resolves the host by itself.
+     * @param timeout maximum time to wait
+     */
+    void set_join_timeout(clock_type::duration timeout) {
+        std::lock_guard<std::mutex> g{mtx_};
+        join_timeout_ = timeout;
+    }
+
+    /**
+     * @brief Get the maximum time to wait for the resolution that is joined by join()
+     * @return maximum time to wait
+     */
+    clock_type::duration join_timeout() const {
+        std::lock_guard<std::mutex> g{mtx_};
+        return join_timeout_;
+    }
+
+    /**
+     * @brief Look up the endpoints
+     * @param host host
+     * @param port port
+     * @param now  current time
+     * @return the endpoints if the entry exists and it is not expired, otherwise std::nullopt
+     */
+    std::optional<endpoints_type> lookup(
+        std::string_view host,
+        std::string_view port,
+        clock_type::time_point now = clock_type::now()
+    ) {
+        std::lock_guard<std::mutex> g{mtx_};
+        auto it = entries_.find(key(host, port));
+        if (it == entries_.end()) return std::nullopt;
+        if (it->second.expiry <= now) {
+            entries_.erase(it);
+            return std::nullopt;
+        }
+        return it->second.eps;
+    }
+
+    /**
+     * @brief Store the endpoints
+     * @param host host
+     * @param port port
+     * @param eps  resolved endpoints. If empty, nothing is stored.
+     * @param now  current time
+     */
+    void store(
+        std::string_view host,
+        std::string_view port,
+        endpoints_type eps,
+        clock_type::time_point now = clock_type::now()
+    ) {
+        std::lock_guard<std::mutex> g{mtx_};
+        store_locked(key(host, port), force_move(eps), now);
+    }
+
+    /**
+     * @brief Join the resolution in progress, or start a new one
+     *        If no resolution of host:port is in progress, the caller becomes the resolver,
+     *        and it must call complete() when the resolution is finished. Create a
+     *        pending_guard to make sure of it.
+     * @param host   host
+     * @param port   port
+     * @param waiter called by complete() if the resolution is in progress. It is called
+     *               on the thread that calls complete(), so it should post the work to
+     *               its own executor. If the resolver is aborted, it is called with
+     *               boost::asio::error::operation_aborted.
+     * @return true if the waiter is registered, false if the caller needs to resolve
+     */
+    bool join(
+        std::string_view host,
+        std::string_view port,
+        waiter_type waiter
+    ) {
+        std::lock_guard<std::mutex> g{mtx_};
+        auto [it, inserted] = pending_.try_emplace(key(host, port));
+        if (inserted) return false;
+        it->second.push_back(force_move(waiter));
+        return true;
+    }
+
+    /**
+     * @brief Finish the resolution that is started by join()
+     *        If succeeded, the endpoints are stored. The waiters are called with the result.
+     * @param host host
+     * @param port port
+     * @param ec   result of the resolution
+     * @param eps  resolved endpoints
+     * @param now  current time
+     */
+    void complete(
+        std::string_view host,
+        std::string_view port,
+        error_code const& ec,
+        endpoints_type const& eps,
+        clock_type::time_point now = clock_type::now()
+    ) {
+        std::vector<waiter_type> waiters;
+        {
+            std::lock_guard<std::mutex> g{mtx_};
+            auto k = key(host, port);
+            if (auto it = pending_.find(k); it != pending_.end()) {
+                waiters = force_move(it->second);
+                pending_.erase(it);
+            }
+            if (!ec) store_locked(force_move(k), eps, now);
+        }
+        for (auto& w : waiters) w(ec, eps);
+    }
+
+    /**
+     * @brief Erase the entry
+     * @param host host
+     * @param port port
+     */
+    void erase(std::string_view host, std::string_view port) {
+        std::lock_guard<std::mutex> g{mtx_};
+        entries_.erase(key(host, port));
+    }
+
+    /**
+     * @brief Erase all entries
+     *        The resolutions in progress are not affected.
+     */
+    void clear() {
+        std::lock_guard<std::mutex> g{mtx_};
+        entries_.clear();
+    }
+
+    /**
+     * @brief Get the number of entries including expired ones
+     * @return the number of entries
+     */
+    std::size_t size() const {
+        std::lock_guard<std::mutex> g{mtx_};
+        return entries_.size();
+    }
+
+private:
+    using key_type = std::pair<std::string, std::string>;
+
+    struct entry {
+        endpoints_type eps;
+        clock_type::time_point expiry;
+    };
+
+    static key_type key(std::string_view host, std::string_view port) {
+        return {std::string{host}, std::string{port}};
+    }
+
+    void store_locked(key_type k, endpoints_type eps, clock_type::time_point now) {
+        if (ttl_ <= clock_type::duration::zero() || eps.empty() || max_entries_ == 0) return;
+        if (auto it = entries_.find(k); it != entries_.end()) {
+            it->second = entry{force_move(eps), now + ttl_};
+            return;
+        }
+        if (entries_.size() >= max_entries_) {
+            for (auto it = entries_.begin(); it != entries_.end();) {
+                if (it->second.expiry <= now) {
+                    it = entries_.erase(it);
+                }
+                else {
+                    ++it;
+                }
+            }
+            if (entries_.size() >= max_entries_) {
+                entries_.erase(entries_.begin());
+            }
+        }
+        entries_.emplace(force_move(k), entry{force_move(eps), now + ttl_});
+    }
+
+    mutable std::mutex mtx_;
+    clock_type::duration ttl_;
+    clock_type::duration join_timeout_ = std::chrono::seconds{10};
+    std::size_t max_entries_;
+    std::map<key_type, entry> entries_;
+    std::map<key_type, std::vector<waiter_type>> pending_;
+};
+
+} // namespace async_mqtt
+
+#endif // ASYNC_MQTT_ASIO_BIND_RESOLVE_CACHE_HPP
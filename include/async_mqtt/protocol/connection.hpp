@@ -285,6 +285,16 @@ public:
      */
     std::set<typename basic_packet_id_type<PacketIdBytes>::type> get_qos2_publish_handled_pids() const;
 
+    /**
+     * @brief Get processed but not released QoS2 packet_ids as a bitset.
+     *
+     * This function should be called after disconnection.
+     * Unlike get_qos2_publish_handled_pids(), it doesn't allocate a node for each packet_id.
+     *
+     * @return A bitset of packet_ids that have been processed but not released.
+     */
+    basic_packet_id_bitset<PacketIdBytes> get_qos2_publish_handled_pid_bitset() const;
+
     /**
      * @brief Restore processed but not released QoS2 packet_ids.
      *
@@ -294,6 +304,15 @@ public:
      */
     void restore_qos2_publish_handled_pids(std::set<typename basic_packet_id_type<PacketIdBytes>::type> pids);
 
+    /**
+     * @brief Restore processed but not released QoS2 packet_ids.
+     *
+     * This function should be called before starting a connection.
+     *
+     * @param pids The packet_ids to restore. It is typically got by get_qos2_publish_handled_pid_bitset().
+     */
+    void restore_qos2_publish_handled_pid_bitset(basic_packet_id_bitset<PacketIdBytes> pids);
+
     /**
      * @brief Restore packets.
      *
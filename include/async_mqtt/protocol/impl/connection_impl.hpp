@@ -11,6 +11,7 @@
 #include <deque>
 
 #include <async_mqtt/protocol/error.hpp>
+#include <async_mqtt/util/buffer.hpp>
 #include <async_mqtt/util/topic_alias_send.hpp>
 #include <async_mqtt/util/topic_alias_recv.hpp>
 #include <async_mqtt/protocol/protocol_version.hpp>
@@ -77,8 +78,12 @@ public:
 
     std::set<typename basic_packet_id_type<PacketIdBytes>::type> get_qos2_publish_handled_pids() const;
 
+    basic_packet_id_bitset<PacketIdBytes> get_qos2_publish_handled_pid_bitset() const;
+
     void restore_qos2_publish_handled_pids(std::set<typename basic_packet_id_type<PacketIdBytes>::type> pids);
 
+    void restore_qos2_publish_handled_pid_bitset(basic_packet_id_bitset<PacketIdBytes> pids);
+
     void restore_packets(
         std::vector<basic_store_packet_variant<PacketIdBytes>> pvs
     );
@@ -175,8 +180,8 @@ private:
     std::optional<std::chrono::milliseconds> pingreq_recv_timeout_ms_;
     std::optional<std::chrono::milliseconds> pingresp_recv_timeout_ms_;
 
-    std::set<basic_pid_type> qos2_publish_handled_;
-    std::set<basic_pid_type> qos2_publish_processing_;
+    basic_packet_id_bitset<PacketIdBytes> qos2_publish_handled_;
+    basic_packet_id_bitset<PacketIdBytes> qos2_publish_processing_;
 
     bool pingreq_send_set_{false};
     bool pingreq_recv_set_{false};
@@ -204,7 +209,8 @@ private:
         std::size_t remaining_length_ = 0;
         std::size_t multiplier_ = 1;
         static_vector<char, 5> header_remaining_length_buf_;
-        std::shared_ptr<char []> raw_buf_;
+        buffer::life_type raw_buf_;
+        char* raw_buf_begin_ = nullptr;
         std::size_t raw_buf_size_ = 0;
         char* raw_buf_ptr_ = nullptr;
         std::optional<error_packet> read_packet_;
@@ -9,11 +9,11 @@
 
 #include <deque>
 #include <istream>
+#include <tuple>
 
 #include <async_mqtt/protocol/connection.hpp>
 #include <async_mqtt/protocol/impl/connection_impl.hpp>
 #include <async_mqtt/util/static_vector.hpp>
-#include <async_mqtt/util/shared_ptr_array.hpp>
 #include <async_mqtt/util/inline.hpp>
 
 #if !defined(ASYNC_MQTT_SEPARATE_COMPILATION)
@@ -54,8 +54,8 @@ recv(std::istream& is) {
                 multiplier_ *= 128;
                 if ((encoded_byte & 0b1000'0000) == 0) {
                     raw_buf_size_ = header_remaining_length_buf_.size() + remaining_length_;
-                    raw_buf_ = make_shared_ptr_char_array(raw_buf_size_);
-                    raw_buf_ptr_ = raw_buf_.get();
+                    std::tie(raw_buf_, raw_buf_begin_) = buffer::life_type::allocate(raw_buf_size_);
+                    raw_buf_ptr_ = raw_buf_begin_;
                     std::copy_n(
                         header_remaining_length_buf_.data(),
                         header_remaining_length_buf_.size(),
@@ -63,10 +63,9 @@ recv(std::istream& is) {
                     );
                     raw_buf_ptr_ += header_remaining_length_buf_.size();
                     if (remaining_length_ == 0) {
-                        auto ptr = raw_buf_.get();
                         BOOST_ASSERT(!read_packet_);
                         read_packet_.emplace(
-                            buffer{ptr, raw_buf_size_, force_move(raw_buf_)}
+                            buffer{raw_buf_begin_, raw_buf_size_, force_move(raw_buf_)}
                         );
                         initialize();
                         return;
@@ -93,10 +92,9 @@ recv(std::istream& is) {
             auto copied_size = static_cast<std::size_t>(copied);
             size -= copied_size;
             if (copied_size == remaining_length_) {
-                auto ptr = raw_buf_.get();
                 BOOST_ASSERT(!read_packet_);
                 read_packet_.emplace(
-                    buffer{ptr, raw_buf_size_, force_move(raw_buf_)}
+                    buffer{raw_buf_begin_, raw_buf_size_, force_move(raw_buf_)}
                 );
                 initialize();
                 return;
@@ -145,6 +143,7 @@ initialize() {
     remaining_length_ = 0;
     multiplier_ = 1;
     raw_buf_.reset();
+    raw_buf_begin_ = nullptr;
     raw_buf_size_ = 0;
     raw_buf_ptr_ = nullptr;
 }
@@ -423,6 +422,17 @@ ASYNC_MQTT_HEADER_ONLY_INLINE
 std::set<typename basic_packet_id_type<PacketIdBytes>::type>
 basic_connection_impl<Role, PacketIdBytes>::
 get_qos2_publish_handled_pids() const {
+    return std::set<typename basic_packet_id_type<PacketIdBytes>::type>(
+        qos2_publish_handled_.begin(),
+        qos2_publish_handled_.end()
+    );
+}
+
+template <role Role, std::size_t PacketIdBytes>
+ASYNC_MQTT_HEADER_ONLY_INLINE
+basic_packet_id_bitset<PacketIdBytes>
+basic_connection_impl<Role, PacketIdBytes>::
+get_qos2_publish_handled_pid_bitset() const {
     return qos2_publish_handled_;
 }
 
@@ -432,6 +442,16 @@ void
 basic_connection_impl<Role, PacketIdBytes>::
 restore_qos2_publish_handled_pids(
     std::set<typename basic_packet_id_type<PacketIdBytes>::type> pids
+) {
+    qos2_publish_handled_ = basic_packet_id_bitset<PacketIdBytes>(pids.begin(), pids.end());
+}
+
+template <role Role, std::size_t PacketIdBytes>
+ASYNC_MQTT_HEADER_ONLY_INLINE
+void
+basic_connection_impl<Role, PacketIdBytes>::
+restore_qos2_publish_handled_pid_bitset(
+    basic_packet_id_bitset<PacketIdBytes> pids
 ) {
     qos2_publish_handled_ = force_move(pids);
 }
@@ -509,7 +529,7 @@ ASYNC_MQTT_HEADER_ONLY_INLINE
 bool
 basic_connection_impl<Role, PacketIdBytes>::
 is_publish_processing(typename basic_packet_id_type<PacketIdBytes>::type pid) const {
-    return qos2_publish_processing_.find(pid) != qos2_publish_processing_.end();
+    return qos2_publish_processing_.contains(pid);
 }
 
 template <role Role, std::size_t PacketIdBytes>
@@ -896,10 +916,7 @@ process_recv_packet() {
                     case qos::exactly_once: {
                         auto packet_id = p.packet_id();
                         bool already_handled = false;
-                        if (qos2_publish_handled_.find(packet_id) == qos2_publish_handled_.end()) {
-                            qos2_publish_handled_.emplace(packet_id);
-                        }
-                        else {
+                        if (!qos2_publish_handled_.insert(packet_id)) {
                             already_handled = true;
                         }
                         if (status_ == connection_status::connected &&
@@ -961,10 +978,7 @@ process_recv_packet() {
                         }
                         publish_recv_.insert(packet_id);
 
-                        if (qos2_publish_handled_.find(packet_id) == qos2_publish_handled_.end()) {
-                            qos2_publish_handled_.emplace(packet_id);
-                        }
-                        else {
+                        if (!qos2_publish_handled_.insert(packet_id)) {
                             already_handled = true;
                         }
                         if (status_ == connection_status::connected &&
@@ -1706,6 +1720,15 @@ get_qos2_publish_handled_pids() const {
     return impl_->get_qos2_publish_handled_pids();
 }
 
+template <role Role, std::size_t PacketIdBytes>
+ASYNC_MQTT_HEADER_ONLY_INLINE
+basic_packet_id_bitset<PacketIdBytes>
+basic_connection<Role, PacketIdBytes>::
+get_qos2_publish_handled_pid_bitset() const {
+    BOOST_ASSERT(impl_);
+    return impl_->get_qos2_publish_handled_pid_bitset();
+}
+
 template <role Role, std::size_t PacketIdBytes>
 ASYNC_MQTT_HEADER_ONLY_INLINE
 void
@@ -1717,6 +1740,17 @@ restore_qos2_publish_handled_pids(
     impl_->restore_qos2_publish_handled_pids(force_move(pids));
 }
 
+template <role Role, std::size_t PacketIdBytes>
+ASYNC_MQTT_HEADER_ONLY_INLINE
+void
+basic_connection<Role, PacketIdBytes>::
+restore_qos2_publish_handled_pid_bitset(
+    basic_packet_id_bitset<PacketIdBytes> pids
+) {
+    BOOST_ASSERT(impl_);
+    impl_->restore_qos2_publish_handled_pid_bitset(force_move(pids));
+}
+
 template <role Role, std::size_t PacketIdBytes>
 ASYNC_MQTT_HEADER_ONLY_INLINE
 void
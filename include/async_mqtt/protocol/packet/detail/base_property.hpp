@@ -19,6 +19,7 @@
 #include <async_mqtt/protocol/packet/property_id.hpp>
 
 #include <async_mqtt/util/buffer.hpp>
+#include <async_mqtt/util/const_buffer_vector.hpp>
 #include <async_mqtt/util/endian_convert.hpp>
 #include <async_mqtt/util/move.hpp>
 #include <async_mqtt/util/static_vector.hpp>
@@ -63,8 +64,8 @@ struct n_bytes_property : private boost::totally_ordered<n_bytes_property<N>> {
      * @brief Add const buffer sequence into the given buffer.
      * @return A vector of const_buffer
      */
-    std::vector<as::const_buffer> const_buffer_sequence() const {
-        std::vector<as::const_buffer> v;
+    const_buffer_vector const_buffer_sequence() const {
+        const_buffer_vector v;
         v.reserve(num_of_const_buffer_sequence());
         v.emplace_back(as::buffer(&id_, 1));
         v.emplace_back(as::buffer(buf_.data(), buf_.size()));
@@ -150,8 +151,8 @@ struct binary_property : private boost::totally_ordered<binary_property> {
      * @brief Add const buffer sequence into the given buffer.
      * @return A vector of const_buffer
      */
-    std::vector<as::const_buffer> const_buffer_sequence() const {
-        std::vector<as::const_buffer> v;
+    const_buffer_vector const_buffer_sequence() const {
+        const_buffer_vector v;
         v.reserve(num_of_const_buffer_sequence());
         v.emplace_back(as::buffer(&id_, 1));
         v.emplace_back(as::buffer(length_.data(), length_.size()));
@@ -278,8 +279,8 @@ struct variable_property : private boost::totally_ordered<variable_property> {
      * @brief Add const buffer sequence into the given buffer.
      * @return A vector of const_buffer
      */
-    std::vector<as::const_buffer> const_buffer_sequence() const {
-        std::vector<as::const_buffer> v;
+    const_buffer_vector const_buffer_sequence() const {
+        const_buffer_vector v;
         v.reserve(num_of_const_buffer_sequence());
         v.emplace_back(as::buffer(&id_, 1));
         v.emplace_back(as::buffer(value_.data(), value_.size()));
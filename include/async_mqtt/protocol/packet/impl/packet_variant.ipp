@@ -39,7 +39,7 @@ std::size_t basic_packet_variant<PacketIdBytes>::size() const {
 
 template <std::size_t PacketIdBytes>
 ASYNC_MQTT_HEADER_ONLY_INLINE
-std::vector<as::const_buffer> basic_packet_variant<PacketIdBytes>::const_buffer_sequence() const {
+const_buffer_vector basic_packet_variant<PacketIdBytes>::const_buffer_sequence() const {
     return visit(
         overload {
             [] (auto const& p) {
@@ -425,8 +425,8 @@ user_property::user_property(std::string key, std::string val)
 {}
 
 inline
-std::vector<as::const_buffer> user_property::const_buffer_sequence() const {
-    std::vector<as::const_buffer> v;
+const_buffer_vector user_property::const_buffer_sequence() const {
+    const_buffer_vector v;
     v.reserve(num_of_const_buffer_sequence());
     v.emplace_back(as::buffer(&id_, 1));
     v.emplace_back(as::buffer(key_.len.data(), key_.len.size()));
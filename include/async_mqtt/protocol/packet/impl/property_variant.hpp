@@ -82,7 +82,7 @@ decltype(auto) property_variant::get_if() const {
 }
 
 properties make_properties(buffer buf, property_location loc, error_code& ec);
-std::vector<as::const_buffer> const_buffer_sequence(properties const& props);
+const_buffer_vector const_buffer_sequence(properties const& props);
 std::size_t size(properties const& props);
 std::size_t num_of_const_buffer_sequence(properties const& props);
 
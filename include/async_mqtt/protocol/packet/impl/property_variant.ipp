@@ -38,7 +38,7 @@ std::size_t property_variant::num_of_const_buffer_sequence() const {
 }
 
 ASYNC_MQTT_HEADER_ONLY_INLINE
-std::vector<as::const_buffer> property_variant::const_buffer_sequence() const {
+const_buffer_vector property_variant::const_buffer_sequence() const {
     return visit(
         [] (auto const& p) {
             return p.const_buffer_sequence();
@@ -528,8 +528,8 @@ properties make_properties(buffer buf, property_location loc, error_code& ec) {
 }
 
 ASYNC_MQTT_HEADER_ONLY_INLINE
-std::vector<as::const_buffer> const_buffer_sequence(properties const& props) {
-    std::vector<as::const_buffer> v;
+const_buffer_vector const_buffer_sequence(properties const& props) {
+    const_buffer_vector v;
     for (auto const& p : props) {
         auto cbs = p.const_buffer_sequence();
         std::move(cbs.begin(), cbs.end(), std::back_inserter(v));
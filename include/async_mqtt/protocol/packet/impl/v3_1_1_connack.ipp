@@ -39,8 +39,8 @@ connack_packet::connack_packet(
 }
 
 ASYNC_MQTT_HEADER_ONLY_INLINE
-std::vector<as::const_buffer> connack_packet::const_buffer_sequence() const {
-    std::vector<as::const_buffer> ret;
+const_buffer_vector connack_packet::const_buffer_sequence() const {
+    const_buffer_vector ret;
 
     ret.emplace_back(as::buffer(all_.data(), all_.size()));
     return ret;
@@ -140,8 +140,8 @@ connect_packet::connect_packet(
 }
 
 ASYNC_MQTT_HEADER_ONLY_INLINE
-std::vector<as::const_buffer> connect_packet::const_buffer_sequence() const {
-    std::vector<as::const_buffer> ret;
+const_buffer_vector connect_packet::const_buffer_sequence() const {
+    const_buffer_vector ret;
     ret.reserve(num_of_const_buffer_sequence());
 
     ret.emplace_back(as::buffer(&fixed_header_, 1));
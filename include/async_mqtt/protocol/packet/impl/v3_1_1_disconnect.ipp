@@ -35,8 +35,8 @@ disconnect_packet::disconnect_packet()
 }
 
 ASYNC_MQTT_HEADER_ONLY_INLINE
-std::vector<as::const_buffer> disconnect_packet::const_buffer_sequence() const {
-    std::vector<as::const_buffer> ret;
+const_buffer_vector disconnect_packet::const_buffer_sequence() const {
+    const_buffer_vector ret;
 
     ret.emplace_back(as::buffer(all_.data(), all_.size()));
     return ret;
@@ -34,8 +34,8 @@ pingreq_packet::pingreq_packet()
 }
 
 ASYNC_MQTT_HEADER_ONLY_INLINE
-std::vector<as::const_buffer> pingreq_packet::const_buffer_sequence() const {
-    std::vector<as::const_buffer> ret;
+const_buffer_vector pingreq_packet::const_buffer_sequence() const {
+    const_buffer_vector ret;
 
     ret.emplace_back(as::buffer(all_.data(), all_.size()));
     return ret;
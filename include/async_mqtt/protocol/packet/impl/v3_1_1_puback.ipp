@@ -46,8 +46,8 @@ basic_puback_packet<PacketIdBytes>::basic_puback_packet(
 
 template <std::size_t PacketIdBytes>
 ASYNC_MQTT_HEADER_ONLY_INLINE
-std::vector<as::const_buffer> basic_puback_packet<PacketIdBytes>::const_buffer_sequence() const {
-    std::vector<as::const_buffer> ret;
+const_buffer_vector basic_puback_packet<PacketIdBytes>::const_buffer_sequence() const {
+    const_buffer_vector ret;
 
     ret.emplace_back(as::buffer(all_.data(), all_.size()));
     return ret;
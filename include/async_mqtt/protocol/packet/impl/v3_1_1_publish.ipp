@@ -127,8 +127,8 @@ basic_publish_packet<PacketIdBytes>::basic_publish_packet(
 
 template <std::size_t PacketIdBytes>
 ASYNC_MQTT_HEADER_ONLY_INLINE
-std::vector<as::const_buffer> basic_publish_packet<PacketIdBytes>::const_buffer_sequence() const {
-    std::vector<as::const_buffer> ret;
+const_buffer_vector basic_publish_packet<PacketIdBytes>::const_buffer_sequence() const {
+    const_buffer_vector ret;
     ret.reserve(num_of_const_buffer_sequence());
     ret.emplace_back(as::buffer(&fixed_header_, 1));
     ret.emplace_back(as::buffer(remaining_length_buf_.data(), remaining_length_buf_.size()));
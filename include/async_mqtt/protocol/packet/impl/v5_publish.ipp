@@ -99,8 +99,8 @@ basic_publish_packet<PacketIdBytes>::basic_publish_packet(
         property_length_buf_.push_back(e);
     }
 
-    for (auto const& prop : props_) {
-        auto id = prop.id();
+    for (std::size_t i = 0; i != props_.size(); ++i) {
+        auto id = props_[i].id();
         if (!validate_property(property_location::publish, id)) {
             throw system_error(
                 make_error_code(
@@ -108,6 +108,9 @@ basic_publish_packet<PacketIdBytes>::basic_publish_packet(
                 )
             );
         }
+        if (id == property::id::message_expiry_interval) {
+            message_expiry_interval_index_ = i;
+        }
     }
 
     remaining_length_ += property_length_buf_.size() + property_length_;
@@ -142,8 +145,8 @@ basic_publish_packet<PacketIdBytes>::basic_publish_packet(
 
 template <std::size_t PacketIdBytes>
 ASYNC_MQTT_HEADER_ONLY_INLINE
-std::vector<as::const_buffer> basic_publish_packet<PacketIdBytes>::const_buffer_sequence() const {
-    std::vector<as::const_buffer> ret;
+const_buffer_vector basic_publish_packet<PacketIdBytes>::const_buffer_sequence() const {
+    const_buffer_vector ret;
     ret.reserve(num_of_const_buffer_sequence());
     ret.emplace_back(as::buffer(&fixed_header_, 1));
     ret.emplace_back(as::buffer(remaining_length_buf_.data(), remaining_length_buf_.size()));
@@ -192,6 +195,23 @@ typename basic_packet_id_type<PacketIdBytes>::type basic_publish_packet<PacketId
     return endian_load<typename basic_packet_id_type<PacketIdBytes>::type>(packet_id_.data());
 }
 
+template <std::size_t PacketIdBytes>
+ASYNC_MQTT_HEADER_ONLY_INLINE
+void basic_publish_packet<PacketIdBytes>::set_packet_id(
+    typename basic_packet_id_type<PacketIdBytes>::type packet_id
+) {
+    auto qos_value = pub::get_qos(fixed_header_);
+    if (packet_id == 0 ||
+        (qos_value != qos::at_least_once && qos_value != qos::exactly_once)) {
+        throw system_error(
+            make_error_code(
+                disconnect_reason_code::protocol_error
+            )
+        );
+    }
+    endian_store(packet_id, packet_id_.data());
+}
+
 template <std::size_t PacketIdBytes>
 ASYNC_MQTT_HEADER_ONLY_INLINE
 std::string basic_publish_packet<PacketIdBytes>::topic() const {
@@ -323,18 +343,30 @@ void basic_publish_packet<PacketIdBytes>::remove_topic_alias_add_topic(std::stri
 template <std::size_t PacketIdBytes>
 ASYNC_MQTT_HEADER_ONLY_INLINE
 void basic_publish_packet<PacketIdBytes>::update_message_expiry_interval(std::uint32_t val) {
-    bool updated = false;
-    for (auto& prop : props_) {
-        prop.visit(
-            overload {
-                [&](property::message_expiry_interval& p) {
-                    p = property::message_expiry_interval(val);
-                    updated = true;
-                },
-                [&](auto&){}
+    auto update =
+        [&](std::size_t i) {
+            bool updated = false;
+            props_[i].visit(
+                overload {
+                    [&](property::message_expiry_interval& p) {
+                        p = property::message_expiry_interval(val);
+                        updated = true;
+                    },
+                    [&](auto&){}
                 }
-        );
-        if (updated) return;
+            );
+            return updated;
+        };
+    // The hint can be stale if a property has been removed.
+    if (message_expiry_interval_index_ < props_.size() &&
+        update(message_expiry_interval_index_)) {
+        return;
+    }
+    for (std::size_t i = 0; i != props_.size(); ++i) {
+        if (update(i)) {
+            message_expiry_interval_index_ = i;
+            return;
+        }
     }
 }
 
@@ -10,6 +10,8 @@
 #include <cstdint>
 #include <cstddef>
 
+#include <async_mqtt/util/value_bitset.hpp>
+
 namespace async_mqtt {
 
 /**
@@ -39,6 +41,21 @@ struct basic_packet_id_type<4> {
  */
 using packet_id_type = typename basic_packet_id_type<2>::type;
 
+/**
+ * @brief set of packet idenfitifers stored as a paged bitmap
+ *
+ * It is used to hold the packet identifiers of the handled QoS2 PUBLISH without
+ * allocating a node for each packet identifier.
+ */
+template <std::size_t PacketIdBytes>
+using basic_packet_id_bitset = value_bitset<typename basic_packet_id_type<PacketIdBytes>::type>;
+
+/**
+ * @brief set of packet idenfitifers stored as a paged bitmap
+ *
+ */
+using packet_id_bitset = basic_packet_id_bitset<2>;
+
 } // namespace async_mqtt
 
 #endif // ASYNC_MQTT_PROTOCOL_PACKET_PACKET_ID_TYPE_HPP
@@ -45,6 +45,7 @@
 #include <async_mqtt/protocol/packet/v5_disconnect.hpp>
 #include <async_mqtt/protocol/packet/v5_auth.hpp>
 #include <async_mqtt/util/overload.hpp>
+#include <async_mqtt/util/const_buffer_vector.hpp>
 
 namespace async_mqtt {
 namespace as = boost::asio;
@@ -139,7 +140,7 @@ public:
      *        it is for boost asio APIs
      * @return const buffer sequence
      */
-    std::vector<as::const_buffer> const_buffer_sequence() const;
+    const_buffer_vector const_buffer_sequence() const;
 
 private:
 
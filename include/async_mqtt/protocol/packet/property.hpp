@@ -20,6 +20,7 @@
 #include <boost/container/static_vector.hpp>
 #include <boost/operators.hpp>
 
+#include <async_mqtt/util/const_buffer_vector.hpp>
 #include <async_mqtt/util/json_like_out.hpp>
 
 #include <async_mqtt/protocol/packet/qos.hpp>
@@ -979,7 +980,7 @@ public:
      * @brief Add const buffer sequence into the given buffer.
      * @return A vector of const_buffer
      */
-    std::vector<as::const_buffer> const_buffer_sequence() const;
+    const_buffer_vector const_buffer_sequence() const;
 
     /**
      * @brief Get property::id
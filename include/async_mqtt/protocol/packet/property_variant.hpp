@@ -10,6 +10,7 @@
 #include <variant>
 
 #include <async_mqtt/util/overload.hpp>
+#include <async_mqtt/util/const_buffer_vector.hpp>
 #include <async_mqtt/protocol/packet/property.hpp>
 
 namespace async_mqtt {
@@ -133,7 +134,7 @@ public:
      *        it is for boost asio APIs
      * @return const buffer sequence
      */
-    std::vector<as::const_buffer> const_buffer_sequence() const;
+    const_buffer_vector const_buffer_sequence() const;
 
     /**
      * @brief Get packet size.
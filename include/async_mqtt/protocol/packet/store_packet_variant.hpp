@@ -10,6 +10,7 @@
 #include <variant>
 
 #include <async_mqtt/util/overload.hpp>
+#include <async_mqtt/util/const_buffer_vector.hpp>
 #include <async_mqtt/protocol/packet/store_packet_variant_fwd.hpp>
 #include <async_mqtt/protocol/packet/packet_variant.hpp>
 #include <async_mqtt/protocol/packet/packet_id_type.hpp>
@@ -147,7 +148,7 @@ public:
      *        it is for boost asio APIs
      * @return const buffer sequence
      */
-    std::vector<as::const_buffer> const_buffer_sequence() const {
+    const_buffer_vector const_buffer_sequence() const {
         return visit(
             overload {
                 [] (auto const& p) {
@@ -155,7 +156,7 @@ public:
                 },
                 [] (error_code const&) {
                     BOOST_ASSERT(false);
-                    return std::vector<as::const_buffer>{};
+                    return const_buffer_vector{};
                 }
             }
         );
@@ -9,6 +9,7 @@
 
 #include <async_mqtt/protocol/buffer_to_packet_variant.hpp>
 #include <async_mqtt/util/buffer.hpp>
+#include <async_mqtt/util/const_buffer_vector.hpp>
 
 #include <async_mqtt/util/static_vector.hpp>
 
@@ -116,7 +117,7 @@ public:
      *        it is for boost asio APIs
      * @return const buffer sequence
      */
-    std::vector<as::const_buffer> const_buffer_sequence() const;
+    const_buffer_vector const_buffer_sequence() const;
 
     /**
      * @brief Get packet size.
@@ -17,6 +17,7 @@
 #include <async_mqtt/protocol/packet/control_packet_type.hpp>
 
 #include <async_mqtt/util/buffer.hpp>
+#include <async_mqtt/util/const_buffer_vector.hpp>
 #include <async_mqtt/util/move.hpp>
 #include <async_mqtt/util/static_vector.hpp>
 #include <async_mqtt/util/endian_convert.hpp>
@@ -63,7 +64,7 @@ public:
      *        it is for boost asio APIs
      * @return const buffer sequence
      */
-    std::vector<as::const_buffer> const_buffer_sequence() const;
+    const_buffer_vector const_buffer_sequence() const;
 
     /**
      * @brief Get packet size.
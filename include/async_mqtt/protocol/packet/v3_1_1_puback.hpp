@@ -13,6 +13,7 @@
 #include <async_mqtt/protocol/packet/packet_id_type.hpp>
 
 #include <async_mqtt/util/buffer.hpp>
+#include <async_mqtt/util/const_buffer_vector.hpp>
 #include <async_mqtt/util/static_vector.hpp>
 
 namespace async_mqtt::v3_1_1 {
@@ -59,7 +60,7 @@ public:
      *        it is for boost asio APIs
      * @return const buffer sequence
      */
-    std::vector<as::const_buffer> const_buffer_sequence() const;
+    const_buffer_vector const_buffer_sequence() const;
 
     /**
      * @brief Get packet size.
@@ -17,6 +17,7 @@
 #include <async_mqtt/protocol/packet/detail/is_payload.hpp>
 
 #include <async_mqtt/util/buffer.hpp>
+#include <async_mqtt/util/const_buffer_vector.hpp>
 #include <async_mqtt/util/variable_bytes.hpp>
 #include <async_mqtt/util/static_vector.hpp>
 
@@ -130,7 +131,7 @@ public:
      *        it is for boost asio APIs
      * @return const buffer sequence
      */
-    std::vector<as::const_buffer> const_buffer_sequence() const;
+    const_buffer_vector const_buffer_sequence() const;
 
     /**
      * @brief Get packet size.
@@ -196,6 +197,15 @@ public:
         pub::set_dup(fixed_header_, dup);
     }
 
+    /**
+     * @brief Set packet_id
+     *        This is for sending a packet that is built before the packet_id is acquired.
+     *        Only the packet_id field is overwritten. The packet size doesn't change.
+     *        If QoS is 0, or the packet_id is 0, then system_error is thrown.
+     * @param packet_id MQTT PacketIdentifier
+     */
+    void set_packet_id(typename basic_packet_id_type<PacketIdBytes>::type packet_id);
+
     /**
      * @brief Get properties
      * @return properties
@@ -238,6 +248,8 @@ public:
 
     /**
      * @brief Update MessageExpiryInterval property
+     *        The constructor remembers the position of the property, so the update
+     *        doesn't search the properties.
      * @param val message_expiry_interval
      */
     void update_message_expiry_interval(std::uint32_t val);
@@ -264,6 +276,8 @@ private:
     friend struct ::ut_packet::v5_publish_pid4;
     friend struct ::ut_packet::v5_publish_topic_alias;
     friend struct ::ut_packet::v5_publish_error;
+    friend struct ::ut_packet::v5_publish_many_properties;
+    friend struct ::ut_packet::v5_publish_update_message_expiry_interval;
 #endif // defined(ASYNC_MQTT_UNIT_TEST_FOR_PACKET)
 
     // private constructor for internal use
@@ -290,6 +304,8 @@ private:
     std::vector<buffer> payloads_;
     std::size_t remaining_length_;
     static_vector<char, 4> remaining_length_buf_;
+    // hint of the position of MessageExpiryInterval in props_
+    std::size_t message_expiry_interval_index_ = 0;
 };
 
 /**
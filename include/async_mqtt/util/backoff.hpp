@@ -0,0 +1,80 @@
+// Copyright Takatoshi Kondo 2024
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#if !defined(ASYNC_MQTT_UTIL_BACKOFF_HPP)
+#define ASYNC_MQTT_UTIL_BACKOFF_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <random>
+
+namespace async_mqtt {
+
+/**
+ * @brief Exponential backoff with full jitter
+ *
+ * The ceiling starts from `initial` and is doubled for each next() call until it reaches `max`.
+ * next() returns a random duration in [0, ceiling], so clients that start retrying at
+ * the same time are spread over the ceiling instead of retrying in lockstep.
+ */
+class exponential_backoff {
+public:
+    /**
+     * @brief constructor
+     * @param initial the first ceiling
+     * @param max     the maximum ceiling
+     * @param seed    seed of the random engine
+     */
+    exponential_backoff(
+        std::chrono::milliseconds initial,
+        std::chrono::milliseconds max,
+        std::uint64_t seed = std::random_device{}()
+    )
+        :initial_{std::max(initial, std::chrono::milliseconds{1})},
+         max_{std::max(max, initial_)},
+         ceiling_{initial_},
+         engine_{seed}
+    {
+    }
+
+    /**
+     * @brief Get the next delay, and double the ceiling
+     * @return delay
+     */
+    std::chrono::milliseconds next() {
+        std::uniform_int_distribution<std::chrono::milliseconds::rep> dist{0, ceiling_.count()};
+        auto ret = std::chrono::milliseconds{dist(engine_)};
+        ceiling_ = ceiling_ >= max_ / 2 ? max_ : ceiling_ * 2;
+        return ret;
+    }
+
+    /**
+     * @brief Reset the ceiling to the initial value
+     *        Call it when the retried operation succeeded.
+     */
+    void reset() {
+        ceiling_ = initial_;
+    }
+
+    /**
+     * @brief Get the current ceiling
+     * @return the ceiling of the next delay
+     */
+    std::chrono::milliseconds ceiling() const {
+        return ceiling_;
+    }
+
+private:
+    std::chrono::milliseconds initial_;
+    std::chrono::milliseconds max_;
+    std::chrono::milliseconds ceiling_;
+    std::mt19937_64 engine_;
+};
+
+} // namespace async_mqtt
+
+#endif // ASYNC_MQTT_UTIL_BACKOFF_HPP
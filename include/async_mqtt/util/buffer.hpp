@@ -16,6 +16,7 @@
 
 #include <async_mqtt/util/move.hpp>
 #include <async_mqtt/util/detail/is_iterator.hpp>
+#include <async_mqtt/util/detail/buffer_life.hpp>
 
 namespace async_mqtt {
 
@@ -31,11 +32,13 @@ namespace as = boost::asio;
  * #### Thread Safety
  *    @li Distinct objects: Safe
  *    @li Shared objects: Unsafe
+ *    @li If ASYNC_MQTT_BUFFER_NON_ATOMIC_LIFE is defined, distinct objects that share the same lifetime
+ *        (copies and substr results) are also unsafe to use from different threads.
  *
  */
 class buffer {
 public:
-    using life_type = std::shared_ptr<void>;
+    using life_type = detail::buffer_life;
     using traits_type = std::string_view::traits_type;
     using value_type = std::string_view::value_type;
     using pointer = std::string_view::pointer;
@@ -128,11 +131,13 @@ public:
     /**
      * @brief string constructor
      * @param s string
+     * The string is moved into the life holder. The control block and the string object
+     * are allocated at once.
      */
-    explicit buffer(std::string s) {
-        auto str = std::make_shared<std::string>(force_move(s));
-        view_ = *str;
-        life_ = force_move(str);
+    explicit buffer(std::string s)
+        : life_{force_move(s)}
+    {
+        view_ = life_.string();
     }
 
     /**
@@ -158,6 +163,29 @@ public:
           life_{force_move(life)}
     {}
 
+    /**
+     * @brief std::string_view and life_type constructor
+     * @param sv std::string_view
+     * @param life sv target's lifetime keeping object
+     * It is typically created by life_type::allocate() or taken from other buffer.
+     */
+    explicit buffer(std::string_view sv, life_type life) noexcept
+        : view_{force_move(sv)},
+          life_{force_move(life)}
+    {}
+
+    /**
+     * @brief pointer, size,  and life_type constructor
+     * @param s     pointer to the beginning of the view
+     * @param count size of the view
+     * @param life sv target's lifetime keeping object
+     * It is typically created by life_type::allocate() or taken from other buffer.
+     */
+    explicit buffer(char const* s, std::size_t count, life_type life) noexcept
+        : view_{s, count},
+          life_{force_move(life)}
+    {}
+
     /**
      * @brief range and lifetime constructor
      * @param first  iterator to the beginning of the view
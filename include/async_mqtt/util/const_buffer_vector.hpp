@@ -0,0 +1,36 @@
+// Copyright Takatoshi Kondo 2024
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#if !defined(ASYNC_MQTT_UTIL_CONST_BUFFER_VECTOR_HPP)
+#define ASYNC_MQTT_UTIL_CONST_BUFFER_VECTOR_HPP
+
+#include <boost/asio/buffer.hpp>
+#include <boost/container/small_vector.hpp>
+
+namespace async_mqtt {
+
+namespace as = boost::asio;
+
+/**
+ * @brief Inline capacity of const_buffer_vector.
+ * It covers the const buffer sequence of packets that have a few properties and payloads.
+ */
+static constexpr std::size_t const_buffer_vector_inline_capacity = 16;
+
+/**
+ * @brief Const buffer sequence type returned by const_buffer_sequence() of packets.
+ * It satisfies ConstBufferSequence requirements of Boost.Asio.
+ * The elements are stored inline up to const_buffer_vector_inline_capacity,
+ * and heap allocation happens only if more elements are required.
+ */
+using const_buffer_vector = boost::container::small_vector<
+    as::const_buffer,
+    const_buffer_vector_inline_capacity
+>;
+
+} // namespace async_mqtt
+
+#endif // ASYNC_MQTT_UTIL_CONST_BUFFER_VECTOR_HPP
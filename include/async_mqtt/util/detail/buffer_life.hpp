@@ -0,0 +1,156 @@
+// Copyright Takatoshi Kondo 2024
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#if !defined(ASYNC_MQTT_UTIL_DETAIL_BUFFER_LIFE_HPP)
+#define ASYNC_MQTT_UTIL_DETAIL_BUFFER_LIFE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <string>
+#include <utility>
+
+#include <async_mqtt/util/move.hpp>
+
+namespace async_mqtt::detail {
+
+/**
+ * @brief intrusive reference counted lifetime holder for async_mqtt::buffer.
+ *
+ * The counter is atomic by default. If ASYNC_MQTT_BUFFER_NON_ATOMIC_LIFE is defined,
+ * a plain counter is used. It removes the atomic increment/decrement on each buffer copy,
+ * but then buffers (and packets that contain them) MUST NOT be shared between threads.
+ * It is only for applications that run all async_mqtt objects on a single thread.
+ */
+class buffer_life {
+public:
+#if defined(ASYNC_MQTT_BUFFER_NON_ATOMIC_LIFE)
+    using count_type = std::size_t;
+#else  // defined(ASYNC_MQTT_BUFFER_NON_ATOMIC_LIFE)
+    using count_type = std::atomic<std::size_t>;
+#endif // defined(ASYNC_MQTT_BUFFER_NON_ATOMIC_LIFE)
+
+    constexpr buffer_life() noexcept = default;
+
+    /**
+     * @brief wrap an existing shared_ptr.
+     *        If sp is empty, then no life is held.
+     * @param sp life holder
+     */
+    explicit buffer_life(std::shared_ptr<void> sp) {
+        if (sp) p_ = new holder<std::shared_ptr<void>>{force_move(sp)};
+    }
+
+    /**
+     * @brief hold the string. The control block and the string object are allocated at once.
+     * @param s string to hold
+     */
+    explicit buffer_life(std::string s)
+        :p_{new holder<std::string>{force_move(s)}}
+    {}
+
+    buffer_life(buffer_life const& other) noexcept
+        :p_{other.p_}
+    {
+        if (p_) ++p_->count;
+    }
+
+    buffer_life(buffer_life&& other) noexcept
+        :p_{std::exchange(other.p_, nullptr)}
+    {}
+
+    buffer_life& operator=(buffer_life const& other) noexcept {
+        buffer_life{other}.swap(*this);
+        return *this;
+    }
+
+    buffer_life& operator=(buffer_life&& other) noexcept {
+        buffer_life{force_move(other)}.swap(*this);
+        return *this;
+    }
+
+    ~buffer_life() {
+        release();
+    }
+
+    /**
+     * @brief allocate the control block and the char array in a single allocation.
+     * @param size size of the char array
+     * @return pair of the life and the pointer to the beginning of the char array
+     */
+    static std::pair<buffer_life, char*> allocate(std::size_t size) {
+        void* mem = ::operator new(sizeof(block) + size);
+        auto* b = new (mem) block{&destroy_storage};
+        return {buffer_life{b}, reinterpret_cast<char*>(b + 1)};
+    }
+
+    /**
+     * @brief get the held string.
+     *        The life must be created by buffer_life(std::string).
+     * @return held string
+     */
+    std::string const& string() const noexcept {
+        return static_cast<holder<std::string> const*>(p_)->value;
+    }
+
+    void swap(buffer_life& other) noexcept {
+        std::swap(p_, other.p_);
+    }
+
+    void reset() noexcept {
+        release();
+        p_ = nullptr;
+    }
+
+    explicit operator bool() const noexcept {
+        return p_ != nullptr;
+    }
+
+private:
+    struct block {
+        explicit block(void (*d)(block*) noexcept) noexcept
+            :destroy{d}
+        {}
+        count_type count{1};
+        void (*destroy)(block*) noexcept;
+    };
+
+    template <typename T>
+    struct holder : block {
+        explicit holder(T v)
+            :block{&destroy_holder<T>},
+             value{force_move(v)}
+        {}
+        T value;
+    };
+
+    explicit buffer_life(block* p) noexcept
+        :p_{p}
+    {}
+
+    template <typename T>
+    static void destroy_holder(block* b) noexcept {
+        delete static_cast<holder<T>*>(b);
+    }
+
+    static void destroy_storage(block* b) noexcept {
+        b->~block();
+        ::operator delete(b);
+    }
+
+    void release() noexcept {
+        if (p_ && --p_->count == 0) {
+            p_->destroy(p_);
+        }
+    }
+
+    block* p_ = nullptr;
+};
+
+} // namespace async_mqtt::detail
+
+#endif // ASYNC_MQTT_UTIL_DETAIL_BUFFER_LIFE_HPP
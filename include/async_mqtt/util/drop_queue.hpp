@@ -0,0 +1,102 @@
+// Copyright Takatoshi Kondo 2024
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#if !defined(ASYNC_MQTT_UTIL_DROP_QUEUE_HPP)
+#define ASYNC_MQTT_UTIL_DROP_QUEUE_HPP
+
+#include <cstddef>
+#include <deque>
+#include <optional>
+
+#include <async_mqtt/util/move.hpp>
+
+namespace async_mqtt {
+
+/**
+ * @brief behavior when an element is pushed to the full drop_queue
+ */
+enum class drop_policy {
+    drop_oldest, ///< the oldest element is dropped
+    drop_newest  ///< the pushed element is dropped
+};
+
+/**
+ * @brief FIFO queue that has the maximum size
+ *
+ * When an element is pushed to the full queue, the oldest element or the pushed element
+ * is dropped by drop_policy, and it is returned to the caller.
+ */
+template <typename T>
+class drop_queue {
+public:
+    /**
+     * @brief constructor
+     * @param max_size the maximum number of elements. 0 means nothing is queued.
+     * @param policy   behavior when the queue is full
+     */
+    drop_queue(std::size_t max_size, drop_policy policy)
+        :max_size_{max_size},
+         policy_{policy}
+    {
+    }
+
+    /**
+     * @brief Push the element
+     * @param v element
+     * @return the dropped element. If nothing is dropped, std::nullopt.
+     *         If max_size is 0, v itself is returned.
+     */
+    std::optional<T> push(T v) {
+        if (max_size_ == 0) return std::optional<T>{force_move(v)};
+        if (queue_.size() < max_size_) {
+            queue_.push_back(force_move(v));
+            return std::nullopt;
+        }
+        if (policy_ == drop_policy::drop_newest) {
+            return std::optional<T>{force_move(v)};
+        }
+        std::optional<T> ret{force_move(queue_.front())};
+        queue_.pop_front();
+        queue_.push_back(force_move(v));
+        return ret;
+    }
+
+    /**
+     * @brief Take all elements in the pushed order
+     *        The queue becomes empty.
+     * @return elements
+     */
+    std::deque<T> take() {
+        auto ret = force_move(queue_);
+        queue_.clear();
+        return ret;
+    }
+
+    /**
+     * @brief Get the number of elements
+     * @return the number of elements
+     */
+    std::size_t size() const {
+        return queue_.size();
+    }
+
+    /**
+     * @brief Check the queue is empty
+     * @return true if empty
+     */
+    bool empty() const {
+        return queue_.empty();
+    }
+
+private:
+    std::size_t max_size_;
+    drop_policy policy_;
+    std::deque<T> queue_;
+};
+
+} // namespace async_mqtt
+
+#endif // ASYNC_MQTT_UTIL_DROP_QUEUE_HPP
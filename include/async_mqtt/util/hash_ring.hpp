@@ -0,0 +1,168 @@
+// Copyright Takatoshi Kondo 2024
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#if !defined(ASYNC_MQTT_UTIL_HASH_RING_HPP)
+#define ASYNC_MQTT_UTIL_HASH_RING_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace async_mqtt {
+
+/**
+ * @brief Consistent hash ring of node indexes.
+ *
+ * Each node is placed on the ring at `vnodes` points. A key is mapped to the node of the
+ * first point at or after the hash of the key. When a node is inserted or erased, only
+ * the keys that are mapped to the node move, and the other keys keep their nodes.
+ * The hash is stable across processes and platforms.
+ */
+class hash_ring {
+public:
+    /**
+     * @brief constructor
+     * @param vnodes number of points on the ring for each node. It must be greater than 0.
+     */
+    explicit hash_ring(std::size_t vnodes = 160)
+        :vnodes_{vnodes == 0 ? 1 : vnodes}
+    {
+    }
+
+    /**
+     * @brief Insert the node
+     * @param node node index
+     * @return true if inserted, false if the node has already been inserted
+     */
+    bool insert(std::size_t node) {
+        if (contains(node)) return false;
+        points_.reserve(points_.size() + vnodes_);
+        for (std::size_t i = 0; i != vnodes_; ++i) {
+            points_.emplace_back(point_of(node, i), node);
+        }
+        std::sort(points_.begin(), points_.end());
+        ++nodes_;
+        return true;
+    }
+
+    /**
+     * @brief Erase the node
+     * @param node node index
+     * @return true if erased, false if the node doesn't exist
+     */
+    bool erase(std::size_t node) {
+        auto it = std::remove_if(
+            points_.begin(), points_.end(),
+            [&](auto const& p) { return p.second == node; }
+        );
+        if (it == points_.end()) return false;
+        points_.erase(it, points_.end());
+        --nodes_;
+        return true;
+    }
+
+    /**
+     * @brief Check the node exists
+     * @param node node index
+     * @return true if the node exists
+     */
+    bool contains(std::size_t node) const {
+        return std::any_of(
+            points_.begin(), points_.end(),
+            [&](auto const& p) { return p.second == node; }
+        );
+    }
+
+    /**
+     * @brief Find the node of the key
+     * @param key key
+     * @return node index. If the ring is empty, std::nullopt.
+     */
+    std::optional<std::size_t> find(std::string_view key) const {
+        return find(key, [](std::size_t) { return true; });
+    }
+
+    /**
+     * @brief Find the node of the key, skipping the nodes that don't satisfy pred
+     *        The key is mapped to the next node on the ring, so the keys of a skipped
+     *        node are spread over the other nodes.
+     * @param key  key
+     * @param pred predicate that is called with the node index, returns true if the node can be used
+     * @return node index. If no node satisfies pred, std::nullopt.
+     */
+    template <typename Pred>
+    std::optional<std::size_t> find(std::string_view key, Pred pred) const {
+        if (points_.empty()) return std::nullopt;
+        auto h = hash(key);
+        auto it = std::lower_bound(
+            points_.begin(), points_.end(), h,
+            [](auto const& p, std::uint64_t v) { return p.first < v; }
+        );
+        for (std::size_t i = 0; i != points_.size(); ++i, ++it) {
+            if (it == points_.end()) it = points_.begin();
+            if (pred(it->second)) return it->second;
+        }
+        return std::nullopt;
+    }
+
+    /**
+     * @brief Get the number of nodes
+     * @return the number of nodes
+     */
+    std::size_t size() const {
+        return nodes_;
+    }
+
+    /**
+     * @brief Check the ring is empty
+     * @return true if empty
+     */
+    bool empty() const {
+        return nodes_ == 0;
+    }
+
+    /**
+     * @brief Hash the key (FNV-1a 64bit with a final mix)
+     * @param key key
+     * @return hash value
+     */
+    static std::uint64_t hash(std::string_view key) {
+        std::uint64_t h = 0xcbf29ce484222325ULL;
+        for (auto c : key) {
+            h ^= static_cast<std::uint8_t>(c);
+            h *= 0x100000001b3ULL;
+        }
+        return mix(h);
+    }
+
+private:
+    // splitmix64 finalizer
+    static std::uint64_t mix(std::uint64_t v) {
+        v ^= v >> 30;
+        v *= 0xbf58476d1ce4e5b9ULL;
+        v ^= v >> 27;
+        v *= 0x94d049bb133111ebULL;
+        v ^= v >> 31;
+        return v;
+    }
+
+    static std::uint64_t point_of(std::size_t node, std::size_t replica) {
+        return mix(mix(static_cast<std::uint64_t>(node)) ^ static_cast<std::uint64_t>(replica));
+    }
+
+    std::size_t vnodes_;
+    std::size_t nodes_ = 0;
+    // sorted by the point
+    std::vector<std::pair<std::uint64_t, std::size_t>> points_;
+};
+
+} // namespace async_mqtt
+
+#endif // ASYNC_MQTT_UTIL_HASH_RING_HPP
@@ -0,0 +1,287 @@
+// Copyright Takatoshi Kondo 2024
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#if !defined(ASYNC_MQTT_UTIL_VALUE_BITSET_HPP)
+#define ASYNC_MQTT_UTIL_VALUE_BITSET_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include <boost/assert.hpp>
+
+#include <async_mqtt/util/detail/is_iterator.hpp>
+
+namespace async_mqtt {
+
+/**
+ * @brief Set of unsigned integer values stored as a paged bitmap.
+ *
+ * The value space is split into pages of page_bits values, and only the pages that
+ * contain at least one value are kept, in the order of the page index.
+ * A page is removed when its last value is erased, but the storage of the page list
+ * is kept, so inserting and erasing values in a steady state doesn't allocate.
+ * It is suitable for packet identifiers that are allocated in a narrow, moving range.
+ * The values are iterated in ascending order.
+ *
+ * @tparam T unsigned integer type of the values
+ */
+template <typename T>
+class value_bitset {
+    static_assert(std::is_unsigned_v<T>, "T must be an unsigned integer type");
+
+    using word_type = std::uint64_t;
+    static constexpr std::size_t word_bits = 64;
+
+public:
+    using value_type = T;
+
+    /**
+     * @brief number of values in a page
+     */
+    static constexpr std::size_t page_bits = 1024;
+
+private:
+    using page_index_type = std::size_t;
+
+    struct page {
+        explicit page(page_index_type index) : index{index} {}
+        page_index_type index;
+        std::size_t count = 0;
+        std::array<word_type, page_bits / word_bits> words{};
+    };
+
+public:
+    /**
+     * @brief forward iterator of the values in ascending order
+     */
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = T const*;
+        using reference = T;
+
+        const_iterator() = default;
+
+        T operator*() const {
+            BOOST_ASSERT(pages_ && page_pos_ < pages_->size());
+            return static_cast<T>((*pages_)[page_pos_].index * page_bits + bit_pos_);
+        }
+
+        const_iterator& operator++() {
+            ++bit_pos_;
+            settle();
+            return *this;
+        }
+
+        const_iterator operator++(int) {
+            auto ret = *this;
+            ++*this;
+            return ret;
+        }
+
+        friend bool operator==(const_iterator const& lhs, const_iterator const& rhs) {
+            return lhs.page_pos_ == rhs.page_pos_ && lhs.bit_pos_ == rhs.bit_pos_;
+        }
+
+        friend bool operator!=(const_iterator const& lhs, const_iterator const& rhs) {
+            return !(lhs == rhs);
+        }
+
+    private:
+        friend class value_bitset;
+
+        const_iterator(std::vector<page> const& pages, std::size_t page_pos)
+            :pages_{&pages}, page_pos_{page_pos}
+        {
+            settle();
+        }
+
+        // move to the first value at or after the current position
+        void settle() {
+            while (page_pos_ < pages_->size()) {
+                auto const& words = (*pages_)[page_pos_].words;
+                while (bit_pos_ < page_bits) {
+                    auto w = words[bit_pos_ / word_bits] >> (bit_pos_ % word_bits);
+                    if (w == 0) {
+                        bit_pos_ = (bit_pos_ / word_bits + 1) * word_bits;
+                        continue;
+                    }
+                    while ((w & 1) == 0) {
+                        w >>= 1;
+                        ++bit_pos_;
+                    }
+                    return;
+                }
+                ++page_pos_;
+                bit_pos_ = 0;
+            }
+            bit_pos_ = 0;
+        }
+
+        std::vector<page> const* pages_ = nullptr;
+        std::size_t page_pos_ = 0;
+        std::size_t bit_pos_ = 0;
+    };
+
+    using iterator = const_iterator;
+
+    value_bitset() = default;
+
+    /**
+     * @brief Create value_bitset from the range of values
+     * @param first the first iterator of the values
+     * @param last  the last iterator of the values
+     */
+    template <
+        typename It,
+        typename std::enable_if_t<
+            detail::is_input_iterator<It>::value
+        >* = nullptr
+    >
+    value_bitset(It first, It last) {
+        for (; first != last; ++first) insert(*first);
+    }
+
+    /**
+     * @brief Insert the value
+     * @param v value
+     * @return true if inserted, false if the value has already been inserted
+     */
+    bool insert(T v) {
+        auto idx = page_of(v);
+        auto it = lower_bound(idx);
+        if (it == pages_.end() || it->index != idx) {
+            it = pages_.emplace(it, idx);
+        }
+        auto& w = it->words[word_of(v)];
+        auto mask = mask_of(v);
+        if (w & mask) return false;
+        w |= mask;
+        ++it->count;
+        ++size_;
+        return true;
+    }
+
+    /**
+     * @brief Erase the value
+     * @param v value
+     * @return true if erased, false if the value doesn't exist
+     */
+    bool erase(T v) {
+        auto idx = page_of(v);
+        auto it = lower_bound(idx);
+        if (it == pages_.end() || it->index != idx) return false;
+        auto& w = it->words[word_of(v)];
+        auto mask = mask_of(v);
+        if (!(w & mask)) return false;
+        w &= ~mask;
+        --size_;
+        if (--it->count == 0) pages_.erase(it);
+        return true;
+    }
+
+    /**
+     * @brief Check the value exists
+     * @param v value
+     * @return true if the value exists
+     */
+    bool contains(T v) const {
+        auto idx = page_of(v);
+        auto it = lower_bound(idx);
+        if (it == pages_.end() || it->index != idx) return false;
+        return (it->words[word_of(v)] & mask_of(v)) != 0;
+    }
+
+    /**
+     * @brief Erase all values
+     *        The storage of the pages is kept.
+     */
+    void clear() {
+        pages_.clear();
+        size_ = 0;
+    }
+
+    /**
+     * @brief Get the number of values
+     * @return the number of values
+     */
+    std::size_t size() const {
+        return size_;
+    }
+
+    /**
+     * @brief Check the set is empty
+     * @return true if empty
+     */
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    const_iterator begin() const {
+        return const_iterator{pages_, 0};
+    }
+
+    const_iterator end() const {
+        return const_iterator{pages_, pages_.size()};
+    }
+
+    friend bool operator==(value_bitset const& lhs, value_bitset const& rhs) {
+        return lhs.size_ == rhs.size_ &&
+            std::equal(
+                lhs.pages_.begin(), lhs.pages_.end(),
+                rhs.pages_.begin(), rhs.pages_.end(),
+                [](page const& l, page const& r) {
+                    return l.index == r.index && l.words == r.words;
+                }
+            );
+    }
+
+    friend bool operator!=(value_bitset const& lhs, value_bitset const& rhs) {
+        return !(lhs == rhs);
+    }
+
+private:
+    static page_index_type page_of(T v) {
+        return static_cast<page_index_type>(v / page_bits);
+    }
+
+    static std::size_t word_of(T v) {
+        return static_cast<std::size_t>((v % page_bits) / word_bits);
+    }
+
+    static word_type mask_of(T v) {
+        return word_type(1) << (v % word_bits);
+    }
+
+    typename std::vector<page>::iterator lower_bound(page_index_type idx) {
+        return std::lower_bound(
+            pages_.begin(), pages_.end(), idx,
+            [](page const& p, page_index_type i) { return p.index < i; }
+        );
+    }
+
+    typename std::vector<page>::const_iterator lower_bound(page_index_type idx) const {
+        return std::lower_bound(
+            pages_.begin(), pages_.end(), idx,
+            [](page const& p, page_index_type i) { return p.index < i; }
+        );
+    }
+
+    std::vector<page> pages_;
+    std::size_t size_ = 0;
+};
+
+} // namespace async_mqtt
+
+#endif // ASYNC_MQTT_UTIL_VALUE_BITSET_HPP
@@ -63,9 +63,12 @@ inline void kill_broker(pid_type pid) {
 }
 
 struct broker_runner {
+    // port_offset is added to the ports that are waited for.
+    // It is used to run several brokers that have different ports.
     broker_runner(
         std::string const& config = "st_broker.conf",
-        std::string const& auth = "st_auth.json"
+        std::string const& auth = "st_auth.json",
+        std::uint16_t port_offset = 0
     ) {
         if (!launch_broker_required()) return;
         auto level_opt =
@@ -143,7 +146,7 @@ struct broker_runner {
         {
             as::io_context ioc;
             as::ip::address address = boost::asio::ip::make_address("127.0.0.1");
-            as::ip::tcp::endpoint endpoint{address, 1883};
+            as::ip::tcp::endpoint endpoint{address, std::uint16_t(1883 + port_offset)};
             as::ip::tcp::socket s{ioc};
             std::function<void(boost::system::error_code const&)> f =
                 [&](boost::system::error_code const& ec) {
@@ -166,7 +169,7 @@ struct broker_runner {
         {
             as::io_context ioc;
             as::ip::address address = boost::asio::ip::make_address("127.0.0.1");
-            as::ip::tcp::endpoint endpoint{address, 8883};
+            as::ip::tcp::endpoint endpoint{address, std::uint16_t(8883 + port_offset)};
             as::ip::tcp::socket s{ioc};
             std::function<void(boost::system::error_code const&)> f =
                 [&](boost::system::error_code const& ec) {
@@ -190,7 +193,7 @@ struct broker_runner {
         {
             as::io_context ioc;
             as::ip::address address = boost::asio::ip::make_address("127.0.0.1");
-            as::ip::tcp::endpoint endpoint{address, 10080};
+            as::ip::tcp::endpoint endpoint{address, std::uint16_t(10080 + port_offset)};
             as::ip::tcp::socket s{ioc};
             std::function<void(boost::system::error_code const&)> f =
                 [&](boost::system::error_code const& ec) {
@@ -215,7 +218,7 @@ struct broker_runner {
             as::io_context ioc;
             as::ip::address address = boost::asio::ip::make_address("127.0.0.1");
             as::ip::tcp::socket s{ioc};
-            as::ip::tcp::endpoint endpoint{address, 10443};
+            as::ip::tcp::endpoint endpoint{address, std::uint16_t(10443 + port_offset)};
             std::function<void(boost::system::error_code const&)> f =
                 [&](boost::system::error_code const& ec) {
                     if (ec) {
@@ -0,0 +1,242 @@
+// Copyright Takatoshi Kondo 2024
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "../common/test_main.hpp"
+#include "../common/global_fixture.hpp"
+#include "broker_runner.hpp"
+
+#include <async_mqtt/all.hpp>
+
+BOOST_AUTO_TEST_SUITE(st_cluster)
+
+namespace am = async_mqtt;
+namespace as = boost::asio;
+
+using namespace am;
+
+namespace {
+
+using client_t = am::client<am::protocol_version::v5, am::protocol::mqtt>;
+
+as::awaitable<void> connect(client_t& cl, std::string port, std::string cid) {
+    auto [ec_und] = co_await cl.async_underlying_handshake(
+        "127.0.0.1",
+        port,
+        as::as_tuple(as::use_awaitable)
+    );
+    BOOST_TEST(!ec_und);
+    auto [ec_con, connack_opt] = co_await cl.async_start(
+        true,   // clean_start
+        std::uint16_t(0),      // keep_alive
+        cid,
+        std::nullopt, // will
+        "u1",
+        "passforu1",
+        as::as_tuple(as::use_awaitable)
+    );
+    BOOST_TEST(!ec_con);
+}
+
+} // anonymous namespace
+
+// node1 (tcp:1883, cluster:11883) and node2 (tcp:1884, cluster:11884) are linked.
+// The subscriber is on node2 and the publisher is on node1.
+BOOST_AUTO_TEST_CASE(v5_forward_by_interest) {
+    broker_runner br1{"st_cluster1.conf", "st_auth.json", 0};
+    broker_runner br2{"st_cluster2.conf", "st_auth.json", 1};
+    as::io_context ioc;
+    auto exe = ioc.get_executor();
+    auto pub = client_t{exe};
+    auto sub = client_t{exe};
+    as::co_spawn(
+        exe,
+        [&] () -> as::awaitable<void> {
+            co_await connect(sub, "1884", "sub");
+            co_await connect(pub, "1883", "pub");
+
+            std::vector<am::topic_subopts> sub_entry{
+                {"cluster/a", am::qos::exactly_once}
+            };
+            auto [ec_sub, suback_opt] = co_await sub.async_subscribe(
+                *sub.acquire_unique_packet_id(),
+                am::force_move(sub_entry), // sub_entry variable is required to avoid g++ bug
+                as::as_tuple(as::use_awaitable)
+            );
+            BOOST_TEST(!ec_sub);
+
+            // Wait until the link is established and node2's interest reaches node1.
+            // Until then, node1 has no matching subscribers for the topic.
+            as::steady_timer tim{exe};
+            bool forwarded = false;
+            for (int i = 0; i != 100 && !forwarded; ++i) {
+                auto [ec_pub, pubres] = co_await pub.async_publish(
+                    *pub.acquire_unique_packet_id(),
+                    "cluster/a",
+                    "probe",
+                    am::qos::at_least_once,
+                    as::as_tuple(as::use_awaitable)
+                );
+                BOOST_TEST(!ec_pub);
+                BOOST_REQUIRE(pubres.puback_opt);
+                if (pubres.puback_opt->code() == am::puback_reason_code::success) {
+                    forwarded = true;
+                }
+                else {
+                    BOOST_TEST(pubres.puback_opt->code() == am::puback_reason_code::no_matching_subscribers);
+                    tim.expires_after(std::chrono::milliseconds(100));
+                    co_await tim.async_wait(as::use_awaitable);
+                }
+            }
+            BOOST_TEST(forwarded);
+            {
+                auto [ec_recv, pv] = co_await sub.async_recv(as::as_tuple(as::use_awaitable));
+                BOOST_TEST(!ec_recv);
+                auto const* p = pv->get_if<am::v5::publish_packet>();
+                BOOST_REQUIRE(p);
+                BOOST_TEST(p->topic() == "cluster/a");
+                BOOST_TEST(p->payload() == "probe");
+                BOOST_TEST(p->opts().get_qos() == am::qos::at_least_once);
+            }
+
+            // QoS2 is kept across the link
+            {
+                auto [ec_pub, pubres] = co_await pub.async_publish(
+                    *pub.acquire_unique_packet_id(),
+                    "cluster/a",
+                    "payload2",
+                    am::qos::exactly_once,
+                    as::as_tuple(as::use_awaitable)
+                );
+                BOOST_TEST(!ec_pub);
+                BOOST_REQUIRE(pubres.pubrec_opt);
+                BOOST_TEST(pubres.pubrec_opt->code() == am::pubrec_reason_code::success);
+                auto [ec_recv, pv] = co_await sub.async_recv(as::as_tuple(as::use_awaitable));
+                BOOST_TEST(!ec_recv);
+                auto const* p = pv->get_if<am::v5::publish_packet>();
+                BOOST_REQUIRE(p);
+                BOOST_TEST(p->payload() == "payload2");
+                BOOST_TEST(p->opts().get_qos() == am::qos::exactly_once);
+            }
+
+            // node2 is not interested in cluster/b, so it is not forwarded
+            {
+                auto [ec_pub, pubres] = co_await pub.async_publish(
+                    *pub.acquire_unique_packet_id(),
+                    "cluster/b",
+                    "payload3",
+                    am::qos::at_least_once,
+                    as::as_tuple(as::use_awaitable)
+                );
+                BOOST_TEST(!ec_pub);
+                BOOST_REQUIRE(pubres.puback_opt);
+                BOOST_TEST(pubres.puback_opt->code() == am::puback_reason_code::no_matching_subscribers);
+            }
+
+            co_await pub.async_disconnect(as::as_tuple(as::use_awaitable));
+            co_await sub.async_disconnect(as::as_tuple(as::use_awaitable));
+            co_return;
+        },
+        as::detached
+    );
+    ioc.run();
+}
+
+// A link must prove that it knows the secret. The secret as a password is not accepted,
+// and a wrong proof is rejected.
+BOOST_AUTO_TEST_CASE(v5_link_requires_proof) {
+    broker_runner br1{"st_cluster1.conf", "st_auth.json", 0};
+    as::io_context ioc;
+    auto exe = ioc.get_executor();
+    using ep_t = am::endpoint<am::role::client, am::protocol::mqtt>;
+    as::co_spawn(
+        exe,
+        [&] () -> as::awaitable<void> {
+            // the secret as the password
+            {
+                auto ep = ep_t{am::protocol_version::v5, exe};
+                auto [ec_und] = co_await ep.async_underlying_handshake(
+                    "127.0.0.1",
+                    "11883",
+                    as::as_tuple(as::use_awaitable)
+                );
+                BOOST_TEST(!ec_und);
+                auto [ec_send] = co_await ep.async_send(
+                    am::v5::connect_packet{
+                        true,   // clean_start
+                        0,      // keep_alive
+                        "$cluster/rogue",
+                        std::nullopt, // user_name
+                        "st_cluster_secret"
+                    },
+                    as::as_tuple(as::use_awaitable)
+                );
+                BOOST_TEST(!ec_send);
+                auto [ec_recv, pv] = co_await ep.async_recv(as::as_tuple(as::use_awaitable));
+                BOOST_TEST(!ec_recv);
+                auto const* p = pv->get_if<am::v5::connack_packet>();
+                BOOST_REQUIRE(p);
+                BOOST_TEST(p->code() == am::connect_reason_code::bad_authentication_method);
+                co_await ep.async_close(as::use_awaitable);
+            }
+            // a wrong proof
+            {
+                auto ep = ep_t{am::protocol_version::v5, exe};
+                auto [ec_und] = co_await ep.async_underlying_handshake(
+                    "127.0.0.1",
+                    "11883",
+                    as::as_tuple(as::use_awaitable)
+                );
+                BOOST_TEST(!ec_und);
+                auto [ec_con] = co_await ep.async_send(
+                    am::v5::connect_packet{
+                        true,   // clean_start
+                        0,      // keep_alive
+                        "$cluster/rogue",
+                        std::nullopt, // user_name
+                        std::nullopt, // password
+                        am::properties{
+                            am::property::authentication_method{"async_mqtt-cluster-hmac-sha256"},
+                            am::property::authentication_data{std::string(32, 'n')}
+                        }
+                    },
+                    as::as_tuple(as::use_awaitable)
+                );
+                BOOST_TEST(!ec_con);
+                {
+                    auto [ec_recv, pv] = co_await ep.async_recv(as::as_tuple(as::use_awaitable));
+                    BOOST_TEST(!ec_recv);
+                    auto const* p = pv->get_if<am::v5::auth_packet>();
+                    BOOST_REQUIRE(p);
+                    BOOST_TEST(p->code() == am::auth_reason_code::continue_authentication);
+                }
+                auto [ec_auth] = co_await ep.async_send(
+                    am::v5::auth_packet{
+                        am::auth_reason_code::continue_authentication,
+                        am::properties{
+                            am::property::authentication_method{"async_mqtt-cluster-hmac-sha256"},
+                            am::property::authentication_data{std::string(32, 'p')}
+                        }
+                    },
+                    as::as_tuple(as::use_awaitable)
+                );
+                BOOST_TEST(!ec_auth);
+                {
+                    auto [ec_recv, pv] = co_await ep.async_recv(as::as_tuple(as::use_awaitable));
+                    BOOST_TEST(!ec_recv);
+                    auto const* p = pv->get_if<am::v5::connack_packet>();
+                    BOOST_REQUIRE(p);
+                    BOOST_TEST(p->code() == am::connect_reason_code::not_authorized);
+                }
+                co_await ep.async_close(as::use_awaitable);
+            }
+            co_return;
+        },
+        as::detached
+    );
+    ioc.run();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
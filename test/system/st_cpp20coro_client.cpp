@@ -9,6 +9,12 @@
 #include "broker_runner.hpp"
 #include "coro_base.hpp"
 
+#include <set>
+
+#if !defined(_WIN32)
+#include <signal.h>
+#endif // !defined(_WIN32)
+
 #include <async_mqtt/all.hpp>
 
 BOOST_AUTO_TEST_SUITE(st_cpp20coro_client)
@@ -370,4 +376,674 @@ BOOST_AUTO_TEST_CASE(v5) {
     ioc.run();
 }
 
+BOOST_AUTO_TEST_CASE(v5_recv_batch) {
+    broker_runner br;
+    as::io_context ioc;
+    auto exe = ioc.get_executor();
+    auto amcl = am::client<am::protocol_version::v5, am::protocol::mqtt>{exe};
+    as::co_spawn(
+        exe,
+        [&] () -> as::awaitable<void> {
+            co_await as::dispatch(
+                as::bind_executor(
+                    amcl.get_executor(),
+                    as::use_awaitable
+                )
+            );
+
+            auto [ec_und] = co_await amcl.async_underlying_handshake(
+                "127.0.0.1",
+                "1883",
+                as::as_tuple(as::use_awaitable)
+            );
+            BOOST_TEST(!ec_und);
+
+            auto [ec_con, connack_opt] = co_await amcl.async_start(
+                am::v5::connect_packet{
+                    true,   // clean_session
+                    0,      // keep_alive
+                    "cid1",
+                    std::nullopt, // will
+                    "u1",
+                    "passforu1"
+                },
+                as::as_tuple(as::use_awaitable)
+            );
+            BOOST_TEST(!ec_con);
+            BOOST_CHECK(connack_opt);
+
+            std::vector<am::topic_subopts> sub_entry{
+                {"topic1", am::qos::at_most_once},
+            };
+            auto pid_sub_opt = amcl.acquire_unique_packet_id();
+            BOOST_CHECK(pid_sub_opt);
+            auto [ec_sub, suback_opt] = co_await amcl.async_subscribe(
+                am::v5::subscribe_packet{
+                    *pid_sub_opt,
+                    am::force_move(sub_entry) // sub_entry variable is required to avoid g++ bug
+                },
+                as::as_tuple(as::use_awaitable)
+            );
+            BOOST_TEST(!ec_sub);
+            BOOST_CHECK(suback_opt);
+
+            std::vector<std::string> payloads{"payload1", "payload2", "payload3"};
+            for (auto const& payload : payloads) {
+                auto [ec_pub, pubres] = co_await amcl.async_publish(
+                    am::v5::publish_packet{
+                        "topic1",
+                        payload,
+                        am::qos::at_most_once
+                    },
+                    as::as_tuple(as::use_awaitable)
+                );
+                BOOST_TEST(!ec_pub);
+            }
+
+            // the same container is reused
+            std::vector<am::packet_variant> packets;
+            std::vector<std::string> received;
+            while (received.size() < payloads.size()) {
+                auto [ec_recv] = co_await amcl.async_recv_batch(
+                    packets,
+                    2, // max_count
+                    as::as_tuple(as::use_awaitable)
+                );
+                BOOST_TEST(!ec_recv);
+                BOOST_TEST(!packets.empty());
+                BOOST_TEST(packets.size() <= 2u);
+                for (auto const& pv : packets) {
+                    auto const* p = pv.get_if<am::v5::publish_packet>();
+                    BOOST_REQUIRE(p);
+                    BOOST_TEST(p->topic() == "topic1");
+                    received.push_back(p->payload());
+                }
+            }
+            BOOST_TEST(received == payloads);
+
+            auto [ec_disconnect] = co_await amcl.async_disconnect(
+                am::v5::disconnect_packet{},
+                as::as_tuple(as::use_awaitable)
+            );
+            BOOST_TEST(!ec_disconnect);
+
+            // the error is reported after all packets are received
+            auto [ec_recv] = co_await amcl.async_recv_batch(
+                packets,
+                0, // no limit
+                as::as_tuple(as::use_awaitable)
+            );
+            BOOST_TEST(ec_recv);
+            BOOST_TEST(packets.empty());
+
+            co_await amcl.async_close(
+                as::as_tuple(as::use_awaitable)
+            );
+            co_return;
+        },
+        as::detached
+    );
+    ioc.run();
+}
+
+BOOST_AUTO_TEST_CASE(v5_recv_handler) {
+    broker_runner br;
+    as::io_context ioc;
+    auto exe = ioc.get_executor();
+    auto amcl = am::client<am::protocol_version::v5, am::protocol::mqtt>{exe};
+    as::steady_timer tim{exe};
+    std::vector<std::string> payloads{"payload1", "payload2", "payload3"};
+    std::vector<std::string> received;
+    bool error_received = false;
+    amcl.set_recv_handler(
+        [&](am::error_code const& ec, std::optional<am::packet_variant> pv_opt) {
+            if (ec) {
+                error_received = true;
+                return false;
+            }
+            BOOST_REQUIRE(pv_opt);
+            auto const* p = pv_opt->get_if<am::v5::publish_packet>();
+            BOOST_REQUIRE(p);
+            received.push_back(p->payload());
+            if (received.size() == 1) {
+                // pause reading, and resume it later
+                amcl.resume_recv();
+                return false;
+            }
+            if (received.size() == payloads.size()) {
+                tim.cancel();
+            }
+            return true;
+        }
+    );
+    as::co_spawn(
+        exe,
+        [&] () -> as::awaitable<void> {
+            co_await as::dispatch(
+                as::bind_executor(
+                    amcl.get_executor(),
+                    as::use_awaitable
+                )
+            );
+
+            auto [ec_und] = co_await amcl.async_underlying_handshake(
+                "127.0.0.1",
+                "1883",
+                as::as_tuple(as::use_awaitable)
+            );
+            BOOST_TEST(!ec_und);
+
+            auto [ec_con, connack_opt] = co_await amcl.async_start(
+                am::v5::connect_packet{
+                    true,   // clean_session
+                    0,      // keep_alive
+                    "cid1",
+                    std::nullopt, // will
+                    "u1",
+                    "passforu1"
+                },
+                as::as_tuple(as::use_awaitable)
+            );
+            BOOST_TEST(!ec_con);
+            BOOST_CHECK(connack_opt);
+
+            std::vector<am::topic_subopts> sub_entry{
+                {"topic1", am::qos::at_most_once},
+            };
+            auto pid_sub_opt = amcl.acquire_unique_packet_id();
+            BOOST_CHECK(pid_sub_opt);
+            auto [ec_sub, suback_opt] = co_await amcl.async_subscribe(
+                am::v5::subscribe_packet{
+                    *pid_sub_opt,
+                    am::force_move(sub_entry) // sub_entry variable is required to avoid g++ bug
+                },
+                as::as_tuple(as::use_awaitable)
+            );
+            BOOST_TEST(!ec_sub);
+            BOOST_CHECK(suback_opt);
+
+            tim.expires_at(std::chrono::steady_clock::time_point::max());
+            for (auto const& payload : payloads) {
+                auto [ec_pub, pubres] = co_await amcl.async_publish(
+                    am::v5::publish_packet{
+                        "topic1",
+                        payload,
+                        am::qos::at_most_once
+                    },
+                    as::as_tuple(as::use_awaitable)
+                );
+                BOOST_TEST(!ec_pub);
+            }
+
+            // wait until all publishes are passed to the handler
+            co_await tim.async_wait(as::as_tuple(as::use_awaitable));
+            BOOST_TEST(received == payloads);
+
+            auto [ec_disconnect] = co_await amcl.async_disconnect(
+                am::v5::disconnect_packet{},
+                as::as_tuple(as::use_awaitable)
+            );
+            BOOST_TEST(!ec_disconnect);
+
+            co_await amcl.async_close(
+                as::as_tuple(as::use_awaitable)
+            );
+            co_return;
+        },
+        as::detached
+    );
+    ioc.run();
+    BOOST_TEST(error_received);
+}
+
+BOOST_AUTO_TEST_CASE(v5_client_pool) {
+    broker_runner br;
+    as::io_context ioc;
+    auto exe = ioc.get_executor();
+    am::client_pool<am::protocol_version::v5, am::protocol::mqtt> pool;
+    pool.emplace(exe);
+    pool.emplace(exe);
+    as::co_spawn(
+        exe,
+        [&] () -> as::awaitable<void> {
+            for (std::size_t i = 0; i != pool.size(); ++i) {
+                auto& amcl = pool.at(i);
+                auto [ec_und] = co_await amcl.async_underlying_handshake(
+                    "127.0.0.1",
+                    "1883",
+                    as::as_tuple(as::use_awaitable)
+                );
+                BOOST_TEST(!ec_und);
+
+                auto [ec_con, connack_opt] = co_await amcl.async_start(
+                    am::v5::connect_packet{
+                        true,   // clean_session
+                        0,      // keep_alive
+                        "cid" + std::to_string(i),
+                        std::nullopt, // will
+                        "u1",
+                        "passforu1"
+                    },
+                    as::as_tuple(as::use_awaitable)
+                );
+                BOOST_TEST(!ec_con);
+                BOOST_CHECK(connack_opt);
+            }
+
+            // member 0 receives all messages
+            auto& sub = pool.at(0);
+            std::vector<am::topic_subopts> sub_entry{
+                {"pool/#", am::qos::at_least_once},
+            };
+            auto pid_sub_opt = sub.acquire_unique_packet_id();
+            BOOST_CHECK(pid_sub_opt);
+            auto [ec_sub, suback_opt] = co_await sub.async_subscribe(
+                am::v5::subscribe_packet{
+                    *pid_sub_opt,
+                    am::force_move(sub_entry) // sub_entry variable is required to avoid g++ bug
+                },
+                as::as_tuple(as::use_awaitable)
+            );
+            BOOST_TEST(!ec_sub);
+            BOOST_CHECK(suback_opt);
+
+            std::vector<decltype(pool)::message> msgs;
+            std::set<std::string> topics;
+            for (std::size_t i = 0; i != 4; ++i) {
+                auto topic = "pool/topic" + std::to_string(i);
+                topics.insert(topic);
+                msgs.push_back({am::buffer{topic}, am::buffer{"payload"}, am::qos::at_least_once, {}});
+            }
+            auto [ec_batch] = co_await pool.async_publish_batch(
+                am::force_move(msgs),
+                as::as_tuple(as::use_awaitable)
+            );
+            BOOST_TEST(!ec_batch);
+
+            std::set<std::string> received;
+            while (received.size() < topics.size()) {
+                auto [ec_recv, pv] = co_await sub.async_recv(as::as_tuple(as::use_awaitable));
+                BOOST_TEST(!ec_recv);
+                auto const* p = pv->get_if<am::v5::publish_packet>();
+                BOOST_REQUIRE(p);
+                received.insert(std::string{p->topic()});
+            }
+            BOOST_TEST(received == topics);
+
+            // the order is kept while a PUBLISH waits for a packet_id
+            {
+                auto& m = pool.at(*pool.route("pool/order"));
+                std::vector<am::packet_id_type> pids;
+                while (auto pid_opt = m.acquire_unique_packet_id()) pids.push_back(*pid_opt);
+                std::vector<am::error_code> ecs;
+                pool.async_publish(
+                    {am::buffer{"pool/order"}, am::buffer{"first"}, am::qos::at_least_once, {}},
+                    [&](am::error_code const& ec, auto const&) { ecs.push_back(ec); }
+                );
+                pool.async_publish(
+                    {am::buffer{"pool/order"}, am::buffer{"second"}, am::qos::at_most_once, {}},
+                    [&](am::error_code const& ec, auto const&) { ecs.push_back(ec); }
+                );
+                for (auto pid : pids) {
+                    co_await m.async_release_packet_id(pid, as::use_awaitable);
+                }
+                std::vector<std::string> payloads;
+                while (payloads.size() < 2) {
+                    auto [ec_recv, pv] = co_await sub.async_recv(as::as_tuple(as::use_awaitable));
+                    BOOST_TEST(!ec_recv);
+                    auto const* p = pv->get_if<am::v5::publish_packet>();
+                    BOOST_REQUIRE(p);
+                    payloads.push_back(p->payload());
+                }
+                BOOST_TEST(payloads == (std::vector<std::string>{"first", "second"}));
+                for (auto const& ec : ecs) BOOST_TEST(!ec);
+            }
+
+            // no member is available
+            pool.set_available(0, false);
+            pool.set_available(1, false);
+            BOOST_TEST(!pool.route("pool/topic0"));
+            auto [ec_pub, pubres] = co_await pool.async_publish(
+                {am::buffer{"pool/topic0"}, am::buffer{"payload"}, am::qos::at_most_once, {}},
+                as::as_tuple(as::use_awaitable)
+            );
+            BOOST_TEST(ec_pub == as::error::not_connected);
+
+            // no member
+            am::client_pool<am::protocol_version::v5, am::protocol::mqtt> empty_pool;
+            auto [ec_empty, pubres_empty] = co_await empty_pool.async_publish(
+                {am::buffer{"pool/topic0"}, am::buffer{"payload"}, am::qos::at_most_once, {}},
+                as::as_tuple(as::use_awaitable)
+            );
+            BOOST_TEST(ec_empty == as::error::not_connected);
+
+            for (std::size_t i = 0; i != pool.size(); ++i) {
+                co_await pool.at(i).async_close(
+                    as::as_tuple(as::use_awaitable)
+                );
+            }
+            co_return;
+        },
+        as::detached
+    );
+    ioc.run();
+}
+
+BOOST_AUTO_TEST_CASE(v5_reconnecting_client_pool) {
+    broker_runner br;
+    as::io_context ioc;
+    auto exe = ioc.get_executor();
+    using rc_type = am::reconnecting_client<am::protocol_version::v5, am::protocol::mqtt>;
+    am::client_pool<am::protocol_version::v5, am::protocol::mqtt, rc_type> pool;
+    pool.emplace(rc_type::config{}, exe);
+    pool.emplace(rc_type::config{}, exe);
+    // members are unavailable until connected
+    BOOST_TEST(!pool.route("rpool/topic0"));
+
+    as::steady_timer tim_connected{exe, std::chrono::steady_clock::time_point::max()};
+    std::size_t connected = 0;
+    pool.set_connection_handler(
+        [&](std::size_t /* index */, bool val) {
+            if (val && ++connected == pool.size()) tim_connected.cancel();
+        }
+    );
+
+    auto sub = am::client<am::protocol_version::v5, am::protocol::mqtt>{exe};
+    as::co_spawn(
+        exe,
+        [&] () -> as::awaitable<void> {
+            auto [ec_und] = co_await sub.async_underlying_handshake(
+                "127.0.0.1",
+                "1883",
+                as::as_tuple(as::use_awaitable)
+            );
+            BOOST_TEST(!ec_und);
+            auto [ec_con, connack_opt] = co_await sub.async_start(
+                am::v5::connect_packet{
+                    true,   // clean_start
+                    0,      // keep_alive
+                    "sub",
+                    std::nullopt, // will
+                    "u1",
+                    "passforu1"
+                },
+                as::as_tuple(as::use_awaitable)
+            );
+            BOOST_TEST(!ec_con);
+            std::vector<am::topic_subopts> sub_entry{
+                {"rpool/#", am::qos::at_least_once},
+            };
+            auto [ec_sub, suback_opt] = co_await sub.async_subscribe(
+                am::v5::subscribe_packet{
+                    *sub.acquire_unique_packet_id(),
+                    am::force_move(sub_entry) // sub_entry variable is required to avoid g++ bug
+                },
+                as::as_tuple(as::use_awaitable)
+            );
+            BOOST_TEST(!ec_sub);
+
+            for (std::size_t i = 0; i != pool.size(); ++i) {
+                pool.at(i).start(
+                    "127.0.0.1",
+                    "1883",
+                    am::v5::connect_packet{
+                        true,   // clean_start
+                        0,      // keep_alive
+                        "cid" + std::to_string(i),
+                        std::nullopt, // will
+                        "u1",
+                        "passforu1"
+                    }
+                );
+            }
+            co_await tim_connected.async_wait(as::as_tuple(as::use_awaitable));
+
+            auto recv_topic =
+                [&] () -> as::awaitable<std::string> {
+                    auto [ec_recv, pv] = co_await sub.async_recv(as::as_tuple(as::use_awaitable));
+                    BOOST_TEST(!ec_recv);
+                    auto const* p = pv->get_if<am::v5::publish_packet>();
+                    BOOST_REQUIRE(p);
+                    co_return std::string{p->topic()};
+                };
+
+            auto index_opt = pool.route("rpool/topic0");
+            BOOST_REQUIRE(index_opt);
+            {
+                auto [ec_pub, pubres] = co_await pool.async_publish(
+                    {am::buffer{"rpool/topic0"}, am::buffer{"payload"}, am::qos::at_least_once, {}},
+                    as::as_tuple(as::use_awaitable)
+                );
+                BOOST_TEST(!ec_pub);
+                BOOST_TEST((co_await recv_topic()) == "rpool/topic0");
+            }
+
+            // the topic is moved to the other member while the member is disconnected
+            co_await pool.at(*index_opt).async_stop(as::as_tuple(as::use_awaitable));
+            auto moved_opt = pool.route("rpool/topic0");
+            BOOST_REQUIRE(moved_opt);
+            BOOST_TEST(*moved_opt != *index_opt);
+            {
+                auto [ec_pub, pubres] = co_await pool.async_publish(
+                    {am::buffer{"rpool/topic0"}, am::buffer{"payload"}, am::qos::at_least_once, {}},
+                    as::as_tuple(as::use_awaitable)
+                );
+                BOOST_TEST(!ec_pub);
+                BOOST_TEST((co_await recv_topic()) == "rpool/topic0");
+            }
+
+            co_await pool.at(*moved_opt).async_stop(as::as_tuple(as::use_awaitable));
+            BOOST_TEST(!pool.route("rpool/topic0"));
+            co_await sub.async_disconnect(as::as_tuple(as::use_awaitable));
+            co_return;
+        },
+        as::detached
+    );
+    ioc.run();
+}
+
+BOOST_AUTO_TEST_CASE(v5_reconnecting_client) {
+    broker_runner br;
+    as::io_context ioc;
+    auto exe = ioc.get_executor();
+    using rc_type = am::reconnecting_client<am::protocol_version::v5, am::protocol::mqtt>;
+    rc_type rc{rc_type::config{}, exe};
+    rc.set_subscriptions({{"rc/topic", am::qos::at_least_once}});
+    std::vector<bool> connections;
+    rc.set_connection_handler(
+        [&](bool connected) {
+            connections.push_back(connected);
+        }
+    );
+    std::vector<std::string> received;
+    rc.set_recv_handler(
+        [&](am::error_code const& ec, std::optional<am::packet_variant> pv_opt) {
+            BOOST_TEST(!ec);
+            BOOST_REQUIRE(pv_opt);
+            auto const* p = pv_opt->get_if<am::v5::publish_packet>();
+            BOOST_REQUIRE(p);
+            received.push_back(p->payload());
+            if (received.size() == 2) {
+                rc.async_stop([]{});
+            }
+            return true;
+        }
+    );
+    rc.start(
+        "127.0.0.1",
+        "1883",
+        am::v5::connect_packet{
+            true,   // clean_start
+            0,      // keep_alive
+            "cid1",
+            std::nullopt, // will
+            "u1",
+            "passforu1"
+        }
+    );
+    // queued until connected, and sent after the subscription
+    std::vector<am::error_code> pub_ecs;
+    for (auto payload : {"payload1", "payload2"}) {
+        rc.async_publish(
+            {am::buffer{"rc/topic"}, am::buffer{payload}, am::qos::at_least_once, {}},
+            [&](am::error_code const& ec, rc_type::pubres_type const&) {
+                pub_ecs.push_back(ec);
+            }
+        );
+    }
+    ioc.run();
+    BOOST_TEST(received == (std::vector<std::string>{"payload1", "payload2"}));
+    BOOST_TEST(connections == (std::vector<bool>{true, false}));
+    BOOST_TEST(pub_ecs.size() == 2u);
+}
+
+#if !defined(_WIN32)
+
+// The broker is stopped while a QoS1 PUBLISH is in flight, and then restarted.
+// The restarted broker doesn't have the session, so the client subscribes again,
+// and publishes the stored PUBLISH again.
+BOOST_AUTO_TEST_CASE(v5_reconnecting_client_broker_restart) {
+    if (!launch_broker_required()) return;
+    std::optional<broker_runner> br;
+    br.emplace();
+    as::io_context ioc;
+    auto exe = ioc.get_executor();
+    using rc_type = am::reconnecting_client<am::protocol_version::v5, am::protocol::mqtt>;
+    rc_type::config cfg;
+    cfg.initial_backoff = std::chrono::milliseconds{100};
+    cfg.max_backoff = std::chrono::milliseconds{500};
+    rc_type rc{cfg, exe};
+    rc.set_subscriptions({{"rc/topic", am::qos::at_least_once}});
+    as::steady_timer tim{exe};
+    std::vector<bool> connections;
+    rc.set_connection_handler(
+        [&](bool connected) {
+            connections.push_back(connected);
+            if (connections.size() != 1) return;
+            // The broker doesn't respond to the PUBLISH.
+            ::kill(br->brk->id(), SIGSTOP);
+            rc.async_publish(
+                {am::buffer{"rc/topic"}, am::buffer{"replayed"}, am::qos::at_least_once, {}},
+                [](am::error_code const&, rc_type::pubres_type const&) {}
+            );
+            tim.expires_after(std::chrono::milliseconds{100});
+            tim.async_wait(
+                [&](am::error_code const&) {
+                    ::kill(br->brk->id(), SIGKILL);
+                    br.reset();
+                    br.emplace();
+                }
+            );
+        }
+    );
+    std::vector<std::string> received;
+    rc.set_recv_handler(
+        [&](am::error_code const& ec, std::optional<am::packet_variant> pv_opt) {
+            BOOST_TEST(!ec);
+            BOOST_REQUIRE(pv_opt);
+            auto const* p = pv_opt->get_if<am::v5::publish_packet>();
+            BOOST_REQUIRE(p);
+            received.push_back(p->payload());
+            rc.async_stop([]{});
+            return true;
+        }
+    );
+    rc.start(
+        "127.0.0.1",
+        "1883",
+        am::v5::connect_packet{
+            true,   // clean_start
+            0,      // keep_alive
+            "cid1",
+            std::nullopt, // will
+            "u1",
+            "passforu1"
+        }
+    );
+    ioc.run();
+    // delivered by the subscription of the second connection
+    BOOST_TEST(received == (std::vector<std::string>{"replayed"}));
+    BOOST_TEST(connections == (std::vector<bool>{true, false, true, false}));
+}
+
+// The SUBACK of the first connection arrives before the PUBLISH, so the PUBLISH gets
+// the packet id that the SUBSCRIBE of the second connection would acquire first.
+BOOST_AUTO_TEST_CASE(v5_reconnecting_client_replay_after_suback) {
+    if (!launch_broker_required()) return;
+    std::optional<broker_runner> br;
+    br.emplace();
+    as::io_context ioc;
+    auto exe = ioc.get_executor();
+    using rc_type = am::reconnecting_client<am::protocol_version::v5, am::protocol::mqtt>;
+    rc_type::config cfg;
+    cfg.initial_backoff = std::chrono::milliseconds{100};
+    cfg.max_backoff = std::chrono::milliseconds{500};
+    rc_type rc{cfg, exe};
+    rc.set_subscriptions({{"rc/topic", am::qos::at_least_once}});
+    as::steady_timer tim{exe};
+    std::vector<bool> connections;
+    rc.set_connection_handler(
+        [&](bool connected) {
+            connections.push_back(connected);
+            if (connections.size() != 1) return;
+            auto& cl = rc.get_client();
+            auto pid = cl.acquire_unique_packet_id();
+            BOOST_REQUIRE(pid);
+            // This SUBACK follows the SUBACK of the subscriptions, so both packet ids are free
+            // when the handler is called.
+            std::vector<am::topic_subopts> sub_entry{{"rc/other", am::qos::at_most_once}};
+            cl.async_subscribe(
+                am::v5::subscribe_packet{*pid, am::force_move(sub_entry)},
+                [&](am::error_code const& ec, auto const& suback_opt) {
+                    BOOST_TEST(!ec);
+                    BOOST_TEST(suback_opt.has_value());
+                    // The broker doesn't respond to the PUBLISH. It gets packet id 1.
+                    ::kill(br->brk->id(), SIGSTOP);
+                    rc.async_publish(
+                        {am::buffer{"rc/topic"}, am::buffer{"replayed"}, am::qos::at_least_once, {}},
+                        [](am::error_code const&, rc_type::pubres_type const&) {}
+                    );
+                    tim.expires_after(std::chrono::milliseconds{100});
+                    tim.async_wait(
+                        [&](am::error_code const&) {
+                            ::kill(br->brk->id(), SIGKILL);
+                            br.reset();
+                            br.emplace();
+                        }
+                    );
+                }
+            );
+        }
+    );
+    std::vector<std::string> received;
+    rc.set_recv_handler(
+        [&](am::error_code const& ec, std::optional<am::packet_variant> pv_opt) {
+            BOOST_TEST(!ec);
+            BOOST_REQUIRE(pv_opt);
+            auto const* p = pv_opt->get_if<am::v5::publish_packet>();
+            BOOST_REQUIRE(p);
+            received.push_back(p->payload());
+            rc.async_stop([]{});
+            return true;
+        }
+    );
+    rc.start(
+        "127.0.0.1",
+        "1883",
+        am::v5::connect_packet{
+            true,   // clean_start
+            0,      // keep_alive
+            "cid1",
+            std::nullopt, // will
+            "u1",
+            "passforu1"
+        }
+    );
+    ioc.run();
+    BOOST_TEST(received == (std::vector<std::string>{"replayed"}));
+    BOOST_TEST(connections == (std::vector<bool>{true, false, true, false}));
+}
+
+#endif // !defined(_WIN32)
+
 BOOST_AUTO_TEST_SUITE_END()
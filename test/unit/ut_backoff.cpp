@@ -0,0 +1,64 @@
+// Copyright Takatoshi Kondo 2024
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "../common/test_main.hpp"
+#include "../common/global_fixture.hpp"
+
+#include <set>
+#include <async_mqtt/util/backoff.hpp>
+
+BOOST_AUTO_TEST_SUITE(ut_backoff)
+
+namespace am = async_mqtt;
+using namespace std::chrono_literals;
+
+BOOST_AUTO_TEST_CASE(ceiling) {
+    am::exponential_backoff b{100ms, 1000ms, 1};
+    BOOST_TEST(b.ceiling() == 100ms);
+    BOOST_TEST(b.next() <= 100ms);
+    BOOST_TEST(b.ceiling() == 200ms);
+    BOOST_TEST(b.next() <= 200ms);
+    BOOST_TEST(b.ceiling() == 400ms);
+    BOOST_TEST(b.next() <= 400ms);
+    BOOST_TEST(b.ceiling() == 800ms);
+    BOOST_TEST(b.next() <= 800ms);
+    BOOST_TEST(b.ceiling() == 1000ms);
+    BOOST_TEST(b.next() <= 1000ms);
+    BOOST_TEST(b.ceiling() == 1000ms);
+    b.reset();
+    BOOST_TEST(b.ceiling() == 100ms);
+}
+
+BOOST_AUTO_TEST_CASE(jitter) {
+    am::exponential_backoff b{1000ms, 1000ms, 1};
+    std::set<std::chrono::milliseconds::rep> delays;
+    for (int i = 0; i != 100; ++i) {
+        auto d = b.next();
+        BOOST_TEST(d >= 0ms);
+        BOOST_TEST(d <= 1000ms);
+        delays.insert(d.count());
+    }
+    // spread, not lockstep
+    BOOST_TEST(delays.size() > 50u);
+}
+
+BOOST_AUTO_TEST_CASE(same_seed) {
+    am::exponential_backoff b1{10ms, 10000ms, 42};
+    am::exponential_backoff b2{10ms, 10000ms, 42};
+    for (int i = 0; i != 20; ++i) {
+        BOOST_TEST(b1.next() == b2.next());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(invalid_range) {
+    // max is less than initial, and initial is zero
+    am::exponential_backoff b{0ms, 0ms, 1};
+    BOOST_TEST(b.ceiling() == 1ms);
+    BOOST_TEST(b.next() <= 1ms);
+    BOOST_TEST(b.ceiling() == 1ms);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,194 @@
+// Copyright Takatoshi Kondo 2024
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "../common/test_main.hpp"
+#include "../common/global_fixture.hpp"
+
+#include <boost/asio/io_context.hpp>
+
+#include <broker/external_auth.hpp>
+
+BOOST_AUTO_TEST_SUITE(ut_broker_external_auth)
+
+namespace am = async_mqtt;
+namespace as = boost::asio;
+using namespace std::literals::chrono_literals;
+
+static am::security make_security() {
+    am::security sec;
+    std::stringstream input(R"*(
+        {
+            "authentication": [
+                {
+                    "name": "u1",
+                    "method": "plain_password",
+                    "password": "p1"
+                }
+            ],
+            "authorization": [
+                {
+                    "topic": "t1",
+                    "allow": { "pub":["u1"] }
+                }
+            ]
+        }
+        )*"
+    );
+    sec.load_json(input);
+    return sec;
+}
+
+BOOST_AUTO_TEST_CASE(coalesce_and_cache) {
+    as::io_context ioc;
+    auto backend = std::make_shared<am::security_auth_backend>(ioc.get_executor(), make_security());
+    auto cached = std::make_shared<am::cached_auth_backend>(backend, 1h, 1h);
+
+    std::vector<std::optional<std::string>> results;
+    for (int i = 0; i != 3; ++i) {
+        cached->async_authenticate(
+            "u1", "p1",
+            [&](std::optional<std::string> username) {
+                results.push_back(am::force_move(username));
+            }
+        );
+    }
+    BOOST_TEST(results.empty());
+    ioc.run();
+    BOOST_TEST(results.size() == 3);
+    for (auto const& r : results) {
+        BOOST_TEST(r.value() == "u1");
+    }
+    BOOST_TEST(backend->lookups() == 1);
+
+    // cache hit completes immediately
+    results.clear();
+    cached->async_authenticate(
+        "u1", "p1",
+        [&](std::optional<std::string> username) {
+            results.push_back(am::force_move(username));
+        }
+    );
+    BOOST_TEST(results.size() == 1);
+    BOOST_TEST(backend->lookups() == 1);
+
+    auto st = cached->get_stats();
+    BOOST_TEST(st.backend_lookups == 1);
+    BOOST_TEST(st.coalesced == 2);
+    BOOST_TEST(st.hits == 1);
+}
+
+BOOST_AUTO_TEST_CASE(negative_cache) {
+    as::io_context ioc;
+    auto backend = std::make_shared<am::security_auth_backend>(ioc.get_executor(), make_security());
+    auto cached = std::make_shared<am::cached_auth_backend>(backend, 1h, 1h);
+
+    std::optional<std::optional<std::string>> result;
+    auto h =
+        [&](std::optional<std::string> username) {
+            result.emplace(am::force_move(username));
+        };
+
+    cached->async_authenticate("u1", "wrong", h);
+    ioc.run();
+    BOOST_TEST(result.has_value());
+    BOOST_TEST(!result->has_value());
+
+    // the failure is cached, and the correct password is a different key
+    result.reset();
+    cached->async_authenticate("u1", "wrong", h);
+    BOOST_TEST(result.has_value());
+    BOOST_TEST(backend->lookups() == 1);
+
+    result.reset();
+    cached->async_authenticate("u1", "p1", h);
+    ioc.restart();
+    ioc.run();
+    BOOST_TEST(result->value() == "u1");
+    BOOST_TEST(backend->lookups() == 2);
+
+    // after clear, the backend is asked again
+    cached->clear();
+    result.reset();
+    cached->async_authenticate("u1", "wrong", h);
+    BOOST_TEST(!result.has_value());
+    ioc.restart();
+    ioc.run();
+    BOOST_TEST(backend->lookups() == 3);
+}
+
+BOOST_AUTO_TEST_CASE(no_negative_cache) {
+    as::io_context ioc;
+    auto backend = std::make_shared<am::security_auth_backend>(ioc.get_executor(), make_security());
+    auto cached = std::make_shared<am::cached_auth_backend>(backend, 1h, 0s);
+
+    bool called = false;
+    cached->async_authenticate("u1", "wrong", [&](std::optional<std::string>) { called = true; });
+    ioc.run();
+    BOOST_TEST(called);
+
+    called = false;
+    cached->async_authenticate("u1", "wrong", [&](std::optional<std::string>) { called = true; });
+    BOOST_TEST(!called);
+    ioc.restart();
+    ioc.run();
+    BOOST_TEST(called);
+    BOOST_TEST(backend->lookups() == 2);
+}
+
+BOOST_AUTO_TEST_CASE(authorize_publish) {
+    as::io_context ioc;
+    auto backend = std::make_shared<am::security_auth_backend>(ioc.get_executor(), make_security());
+    auto cached = std::make_shared<am::cached_auth_backend>(backend, 1h, 1h);
+
+    std::vector<bool> results;
+    auto h = [&](bool allowed) { results.push_back(allowed); };
+    cached->async_authorize_publish("u1", "t1", h);
+    cached->async_authorize_publish("u1", "t2", h);
+    cached->async_authorize_publish("u1", "t1", h);
+    ioc.run();
+    BOOST_TEST(results.size() == 3);
+    BOOST_TEST(std::count(results.begin(), results.end(), true) == 2);
+    BOOST_TEST(backend->lookups() == 2);
+
+    cached->async_authorize_publish("u1", "t2", h);
+    BOOST_TEST(results.size() == 4);
+    BOOST_TEST(!results.back());
+    BOOST_TEST(backend->lookups() == 2);
+}
+
+BOOST_AUTO_TEST_CASE(evict_earliest_expiry) {
+    as::io_context ioc;
+    auto backend = std::make_shared<am::security_auth_backend>(ioc.get_executor(), make_security());
+    // positive decisions expire earlier than negative ones
+    auto cached = std::make_shared<am::cached_auth_backend>(backend, 1min, 1h, 2);
+
+    std::vector<bool> results;
+    auto h = [&](bool allowed) { results.push_back(allowed); };
+    cached->async_authorize_publish("u1", "t2", h);
+    ioc.run();
+    cached->async_authorize_publish("u1", "t1", h);
+    ioc.restart();
+    ioc.run();
+    // the cache is full. t1 is newer than t2 but expires first, so it is evicted.
+    cached->async_authorize_publish("u1", "t3", h);
+    ioc.restart();
+    ioc.run();
+    BOOST_TEST(backend->lookups() == 3);
+
+    cached->async_authorize_publish("u1", "t2", h);
+    BOOST_TEST(results.size() == 4);
+    BOOST_TEST(backend->lookups() == 3);
+
+    cached->async_authorize_publish("u1", "t1", h);
+    BOOST_TEST(results.size() == 4);
+    ioc.restart();
+    ioc.run();
+    BOOST_TEST(results.size() == 5);
+    BOOST_TEST(results.back());
+    BOOST_TEST(backend->lookups() == 4);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,109 @@
+// Copyright Takatoshi Kondo 2024
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "../common/test_main.hpp"
+#include "../common/global_fixture.hpp"
+
+#include <memory>
+#include <vector>
+
+#include <broker/inflight_message.hpp>
+
+BOOST_AUTO_TEST_SUITE(ut_broker_inflight_message)
+
+namespace am = async_mqtt;
+
+namespace {
+
+// records the sent packets
+struct fake_epsp {
+    void register_packet_id(am::packet_id_type pid) {
+        registered->push_back(pid);
+    }
+
+    template <typename CompletionToken>
+    void async_send(am::store_packet_variant const& p, CompletionToken&&) {
+        sent->push_back(p);
+    }
+
+    void const* get_address() const {
+        return this;
+    }
+
+    std::shared_ptr<std::vector<am::packet_id_type>> registered =
+        std::make_shared<std::vector<am::packet_id_type>>();
+    std::shared_ptr<std::vector<am::store_packet_variant>> sent =
+        std::make_shared<std::vector<am::store_packet_variant>>();
+};
+
+am::store_packet_variant make_publish(am::packet_id_type pid, std::optional<std::uint32_t> expiry) {
+    am::properties props;
+    if (expiry) props.push_back(am::property::message_expiry_interval{*expiry});
+    return am::v5::publish_packet{
+        pid,
+        "topic1",
+        "payload1",
+        am::qos::at_least_once,
+        am::force_move(props)
+    };
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(resend_remaining_expiry) {
+    auto now = std::chrono::steady_clock::now();
+    am::inflight_messages ifms;
+    ifms.insert(make_publish(1, std::nullopt), std::nullopt);
+    ifms.insert(make_publish(2, 100), now + std::chrono::seconds(100));
+
+    fake_epsp ep;
+    ifms.send_all_messages(ep);
+    BOOST_TEST((*ep.registered == std::vector<am::packet_id_type>{1, 2}));
+    BOOST_TEST(ep.sent->size() == 2u);
+    BOOST_TEST((*ep.sent)[0].get_message_expiry_interval() == 0u);
+    // the elapsed time is subtracted
+    auto remaining = (*ep.sent)[1].get_message_expiry_interval();
+    BOOST_TEST(remaining <= 100u);
+    BOOST_TEST(remaining >= 98u);
+    // the stored packet is not changed
+    BOOST_TEST(ifms.size() == 2u);
+}
+
+BOOST_AUTO_TEST_CASE(sweep) {
+    auto now = std::chrono::steady_clock::now();
+    am::inflight_messages ifms;
+    ifms.insert(make_publish(1, 10), now + std::chrono::seconds(10));
+    ifms.insert(make_publish(2, std::nullopt), std::nullopt);
+    ifms.insert(make_publish(3, 20), now + std::chrono::seconds(20));
+
+    BOOST_TEST(ifms.sweep(now) == 0u);
+    BOOST_TEST(ifms.sweep(now + std::chrono::seconds(10)) == 1u);
+    BOOST_TEST(ifms.size() == 2u);
+    // the earliest deadline is updated by the sweep
+    BOOST_TEST(ifms.sweep(now + std::chrono::seconds(19)) == 0u);
+    BOOST_TEST(ifms.sweep(now + std::chrono::seconds(20)) == 1u);
+    BOOST_TEST(ifms.size() == 1u);
+    BOOST_TEST(ifms.sweep(now + std::chrono::hours(1)) == 0u);
+}
+
+BOOST_AUTO_TEST_CASE(erase) {
+    auto now = std::chrono::steady_clock::now();
+    am::inflight_messages ifms;
+    ifms.insert(make_publish(1, 0), now);
+    ifms.insert(make_publish(2, std::nullopt), std::nullopt);
+    ifms.insert(make_publish(3, std::nullopt), std::nullopt);
+
+    // the expired message is swept on erase
+    BOOST_TEST(ifms.erase(3) == 1u);
+    BOOST_TEST(ifms.size() == 1u);
+    BOOST_TEST(ifms.erase(3) == 0u);
+
+    fake_epsp ep;
+    ifms.send_all_messages(ep);
+    BOOST_TEST((*ep.registered == std::vector<am::packet_id_type>{2}));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,134 @@
+// Copyright Takatoshi Kondo 2024
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "../common/test_main.hpp"
+#include "../common/global_fixture.hpp"
+
+#include <string>
+
+#include <broker/interest_summary.hpp>
+
+BOOST_AUTO_TEST_SUITE(ut_broker_interest_summary)
+
+namespace am = async_mqtt;
+
+BOOST_AUTO_TEST_CASE(empty) {
+    am::interest_summary s;
+    BOOST_TEST(s.size() == 0);
+    BOOST_TEST(!s.may_match("a"));
+    BOOST_TEST(!s.may_match("a/b"));
+}
+
+BOOST_AUTO_TEST_CASE(exact) {
+    am::interest_summary s;
+    s.insert("a/b");
+    BOOST_TEST(s.size() == 1);
+    BOOST_TEST(s.may_match("a/b"));
+    BOOST_TEST(!s.may_match("a"));
+    BOOST_TEST(!s.may_match("a/b/c"));
+    BOOST_TEST(!s.may_match("ab"));
+    s.erase("a/b");
+    BOOST_TEST(s.size() == 0);
+    BOOST_TEST(!s.may_match("a/b"));
+}
+
+BOOST_AUTO_TEST_CASE(prefix) {
+    am::interest_summary s;
+    s.insert("a/#");
+    s.insert("x/+/z");
+    BOOST_TEST(s.may_match("a"));
+    BOOST_TEST(s.may_match("a/b"));
+    BOOST_TEST(s.may_match("a/b/c"));
+    BOOST_TEST(s.may_match("x/y/z"));
+    BOOST_TEST(!s.may_match("b/a"));
+    BOOST_TEST(!s.may_match("y/x"));
+
+    s.erase("a/#");
+    BOOST_TEST(!s.may_match("a/b"));
+    BOOST_TEST(s.may_match("x/y/z"));
+}
+
+BOOST_AUTO_TEST_CASE(root_wildcard) {
+    am::interest_summary s;
+    s.insert("+/b");
+    BOOST_TEST(s.may_match("a/b"));
+    BOOST_TEST(s.may_match("c"));
+    // topics that start with '$' don't match wildcards at the first level
+    BOOST_TEST(!s.may_match("$SYS/b"));
+    s.insert("$SYS/#");
+    BOOST_TEST(s.may_match("$SYS/b"));
+    s.erase("+/b");
+    BOOST_TEST(!s.may_match("a/b"));
+}
+
+BOOST_AUTO_TEST_CASE(counting) {
+    am::interest_summary s;
+    // the same topic filter from two clients
+    s.insert("a/b");
+    s.insert("a/b");
+    s.erase("a/b");
+    BOOST_TEST(s.may_match("a/b"));
+    s.erase("a/b");
+    BOOST_TEST(!s.may_match("a/b"));
+}
+
+BOOST_AUTO_TEST_CASE(many) {
+    am::interest_summary s;
+    for (int i = 0; i != 1000; ++i) {
+        s.insert("dev/" + std::to_string(i) + "/#");
+    }
+    for (int i = 0; i != 1000; ++i) {
+        BOOST_TEST(s.may_match("dev/" + std::to_string(i) + "/temp"));
+    }
+    std::size_t false_positives = 0;
+    for (int i = 1000; i != 2000; ++i) {
+        if (s.may_match("dev/" + std::to_string(i) + "/temp")) ++false_positives;
+    }
+    BOOST_TEST(false_positives < 10);
+    for (int i = 0; i != 1000; ++i) {
+        s.erase("dev/" + std::to_string(i) + "/#");
+    }
+    BOOST_TEST(s.size() == 0);
+    for (int i = 0; i != 1000; ++i) {
+        BOOST_TEST(!s.may_match("dev/" + std::to_string(i) + "/temp"));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(serialize) {
+    am::interest_summary s{1000, 4};
+    s.insert("a/b");
+    s.insert("x/#");
+    auto data = s.serialize();
+    BOOST_TEST(data.size() == 7u + 125u);
+
+    auto d = am::interest_summary::deserialize(data);
+    BOOST_TEST(d.has_value());
+    BOOST_TEST(d->may_match("a/b"));
+    BOOST_TEST(d->may_match("x/y"));
+    BOOST_TEST(!d->may_match("a/c"));
+    BOOST_TEST(!d->may_match("z"));
+    BOOST_TEST(d->serialize() == data);
+
+    s.insert("#");
+    auto d2 = am::interest_summary::deserialize(s.serialize());
+    BOOST_TEST(d2.has_value());
+    BOOST_TEST(d2->may_match("z"));
+    BOOST_TEST(!d2->may_match("$SYS/z"));
+}
+
+BOOST_AUTO_TEST_CASE(deserialize_error) {
+    BOOST_TEST(!am::interest_summary::deserialize("").has_value());
+    am::interest_summary s{64};
+    auto data = s.serialize();
+    BOOST_TEST(am::interest_summary::deserialize(data).has_value());
+    // truncated
+    BOOST_TEST(!am::interest_summary::deserialize(data.substr(0, data.size() - 1)).has_value());
+    // unknown version
+    data[0] = 2;
+    BOOST_TEST(!am::interest_summary::deserialize(data).has_value());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,331 @@
+// Copyright Takatoshi Kondo 2024
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "../common/test_main.hpp"
+#include "../common/global_fixture.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <broker/offline_message.hpp>
+
+BOOST_AUTO_TEST_SUITE(ut_broker_offline_message)
+
+namespace am = async_mqtt;
+
+namespace {
+
+// records the sent publish packets
+struct fake_epsp {
+    template <typename Func>
+    void dispatch(Func&& f) {
+        f();
+    }
+
+    std::optional<am::packet_id_type> acquire_unique_packet_id() {
+        if (*pids == 0) return std::nullopt;
+        return (*pids)--;
+    }
+
+    template <typename Packet, typename CompletionToken>
+    void async_send(Packet&& p, CompletionToken&&) {
+        sent->emplace_back(p.topic(), p.payload());
+        if constexpr (std::is_same_v<std::decay_t<Packet>, am::v5::publish_packet>) {
+            v5_sent->push_back(p);
+        }
+    }
+
+    void const* get_address() const {
+        return this;
+    }
+
+    std::shared_ptr<std::vector<std::pair<std::string, std::string>>> sent =
+        std::make_shared<std::vector<std::pair<std::string, std::string>>>();
+    std::shared_ptr<std::vector<am::v5::publish_packet>> v5_sent =
+        std::make_shared<std::vector<am::v5::publish_packet>>();
+    std::shared_ptr<std::size_t> pids = std::make_shared<std::size_t>(65535);
+};
+
+am::shared_message_ptr make_msg(std::string topic, std::string payload, am::properties props = {}) {
+    return am::shared_message::create(
+        am::force_move(topic),
+        std::vector<am::buffer>{am::buffer{am::force_move(payload)}},
+        am::force_move(props)
+    );
+}
+
+std::vector<std::string> send_all(am::offline_messages& om, fake_epsp& ep) {
+    om.send_batch(ep, am::protocol_version::v5);
+    std::vector<std::string> ret;
+    for (auto const& e : *ep.sent) ret.push_back(e.second);
+    ep.sent->clear();
+    return ret;
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(unlimited) {
+    am::offline_messages om;
+    for (int i = 0; i != 5; ++i) {
+        om.push_back(make_msg("t", std::to_string(i)), am::qos::at_least_once, std::nullopt);
+    }
+    BOOST_TEST(om.size() == 5u);
+    fake_epsp ep;
+    BOOST_TEST((send_all(om, ep) == std::vector<std::string>{"0", "1", "2", "3", "4"}));
+    BOOST_TEST(om.empty());
+}
+
+BOOST_AUTO_TEST_CASE(packet_id_exhausted) {
+    am::offline_messages om;
+    for (int i = 0; i != 3; ++i) {
+        om.push_back(make_msg("t", std::to_string(i)), am::qos::at_least_once, std::nullopt);
+    }
+    fake_epsp ep;
+    *ep.pids = 2;
+    BOOST_TEST((send_all(om, ep) == std::vector<std::string>{"0", "1"}));
+    BOOST_TEST(om.size() == 1u);
+    *ep.pids = 1;
+    BOOST_TEST((send_all(om, ep) == std::vector<std::string>{"2"}));
+}
+
+BOOST_AUTO_TEST_CASE(replay_batch) {
+    am::offline_queue_config config;
+    config.replay_batch_size = 2;
+    am::offline_messages om;
+    om.set_config(std::make_shared<am::offline_queue_config const>(config));
+    for (int i = 0; i != 5; ++i) {
+        om.push_back(make_msg("t", std::to_string(i)), am::qos::at_least_once, std::nullopt);
+    }
+    fake_epsp ep;
+    BOOST_TEST(om.send_batch(ep, am::protocol_version::v5));
+    BOOST_TEST(ep.sent->size() == 2u);
+    BOOST_TEST(om.send_batch(ep, am::protocol_version::v5));
+    BOOST_TEST(ep.sent->size() == 4u);
+    // the last batch drains the queue
+    BOOST_TEST(!om.send_batch(ep, am::protocol_version::v5));
+    BOOST_TEST(ep.sent->size() == 5u);
+    BOOST_TEST(om.empty());
+
+    // stopped by packet id exhaustion, not by the batch size
+    om.push_back(make_msg("t", "5"), am::qos::at_least_once, std::nullopt);
+    *ep.pids = 0;
+    BOOST_TEST(!om.send_batch(ep, am::protocol_version::v5));
+    BOOST_TEST(om.size() == 1u);
+}
+
+BOOST_AUTO_TEST_CASE(v5_packet) {
+    am::offline_messages om;
+    om.push_back(
+        make_msg("t", "0", am::properties{am::property::message_expiry_interval(100)}),
+        am::qos::at_least_once,
+        std::size_t(5)
+    );
+    om.push_back(make_msg("t", "1"), am::qos::at_most_once, std::nullopt);
+    fake_epsp ep;
+    *ep.pids = 0x1234;
+    om.send_batch(ep, am::protocol_version::v5);
+    BOOST_TEST(ep.v5_sent->size() == 2u);
+    auto const& p0 = ep.v5_sent->at(0);
+    BOOST_TEST(p0.packet_id() == 0x1234);
+    BOOST_TEST(p0.props().size() == 2u);
+    auto expiry = p0.props()[0].get_if<am::property::message_expiry_interval>();
+    BOOST_REQUIRE(expiry);
+    BOOST_TEST(expiry->val() <= 100u);
+    BOOST_TEST(expiry->val() >= 99u);
+    BOOST_TEST(
+        (p0.props()[1] == am::property_variant{am::property::subscription_identifier(5)})
+    );
+    auto const& p1 = ep.v5_sent->at(1);
+    BOOST_TEST(p1.packet_id() == 0u);
+    BOOST_TEST(p1.payload() == "1");
+}
+
+BOOST_AUTO_TEST_CASE(max_messages_drop_oldest) {
+    am::offline_queue_config config;
+    config.max_messages = 3;
+    am::offline_messages om;
+    om.set_config(std::make_shared<am::offline_queue_config const>(config));
+    for (int i = 0; i != 5; ++i) {
+        om.push_back(make_msg("t", std::to_string(i)), am::qos::at_most_once, std::nullopt);
+    }
+    BOOST_TEST(om.size() == 3u);
+    BOOST_TEST(om.dropped() == 2u);
+    fake_epsp ep;
+    BOOST_TEST((send_all(om, ep) == std::vector<std::string>{"2", "3", "4"}));
+}
+
+BOOST_AUTO_TEST_CASE(max_bytes_drop_newest) {
+    am::offline_queue_config config;
+    config.max_bytes = 10; // topic 1 byte + payload 4 bytes
+    config.overflow_policy = am::offline_overflow_policy::drop_newest;
+    am::offline_messages om;
+    om.set_config(std::make_shared<am::offline_queue_config const>(config));
+    om.push_back(make_msg("t", "aaaa"), am::qos::at_most_once, std::nullopt);
+    om.push_back(make_msg("t", "bbbb"), am::qos::at_most_once, std::nullopt);
+    om.push_back(make_msg("t", "cccc"), am::qos::at_most_once, std::nullopt);
+    BOOST_TEST(om.size() == 2u);
+    BOOST_TEST(om.bytes() == 10u);
+    BOOST_TEST(om.dropped() == 1u);
+    fake_epsp ep;
+    BOOST_TEST((send_all(om, ep) == std::vector<std::string>{"aaaa", "bbbb"}));
+    BOOST_TEST(om.bytes() == 0u);
+}
+
+BOOST_AUTO_TEST_CASE(expiry) {
+    am::offline_queue_config config;
+    config.compaction_interval = std::chrono::steady_clock::duration::zero();
+    am::offline_messages om;
+    om.set_config(std::make_shared<am::offline_queue_config const>(config));
+    om.push_back(
+        make_msg("t", "expired", am::properties{am::property::message_expiry_interval{0}}),
+        am::qos::at_most_once,
+        std::nullopt
+    );
+    om.push_back(
+        make_msg("t", "alive", am::properties{am::property::message_expiry_interval{3600}}),
+        am::qos::at_most_once,
+        std::nullopt
+    );
+    // the expired message is removed by the compaction on push_back
+    om.push_back(make_msg("t", "no_expiry"), am::qos::at_most_once, std::nullopt);
+    BOOST_TEST(om.size() == 2u);
+    fake_epsp ep;
+    BOOST_TEST((send_all(om, ep) == std::vector<std::string>{"alive", "no_expiry"}));
+}
+
+BOOST_AUTO_TEST_CASE(spill) {
+    auto dir = std::filesystem::temp_directory_path() / ("ut_offline_" + am::create_uuid_string());
+    {
+        am::offline_queue_config config;
+        config.spill_threshold = 2;
+        config.spill_dir = dir.string();
+        am::offline_messages om;
+        om.set_config(std::make_shared<am::offline_queue_config const>(config));
+        std::vector<std::string> expected;
+        for (int i = 0; i != 7; ++i) {
+            am::properties props;
+            if (i == 3) props.push_back(am::property::content_type{"text/plain"});
+            om.push_back(make_msg("t/" + std::to_string(i), std::to_string(i), props), am::qos::at_least_once, i + 1);
+            expected.push_back(std::to_string(i));
+        }
+        BOOST_TEST(om.size() == 7u);
+        BOOST_TEST(std::distance(std::filesystem::directory_iterator(dir), {}) == 1);
+
+        fake_epsp ep;
+        *ep.pids = 4;
+        om.send_batch(ep, am::protocol_version::v5);
+        BOOST_TEST(ep.sent->size() == 4u);
+        BOOST_TEST((*ep.sent)[3].first == "t/3");
+        BOOST_TEST(om.size() == 3u);
+
+        // new messages are appended after the spilled ones
+        om.push_back(make_msg("t/7", "7"), am::qos::at_least_once, std::nullopt);
+        expected.push_back("7");
+
+        *ep.pids = 100;
+        om.send_batch(ep, am::protocol_version::v5);
+        std::vector<std::string> sent;
+        for (auto const& e : *ep.sent) sent.push_back(e.second);
+        BOOST_TEST(sent == expected);
+        BOOST_TEST(om.empty());
+    }
+    // the segment file is removed with the queue
+    BOOST_TEST(std::filesystem::is_empty(dir));
+    std::filesystem::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_CASE(spill_failure) {
+    // spill_dir can't be created under a regular file
+    auto file = std::filesystem::temp_directory_path() / ("ut_offline_" + am::create_uuid_string());
+    std::ofstream{file};
+    auto test =
+        [&](am::offline_overflow_policy policy) {
+            am::offline_queue_config config;
+            config.spill_threshold = 2;
+            config.spill_dir = (file / "spill").string();
+            config.overflow_policy = policy;
+            am::offline_messages om;
+            om.set_config(std::make_shared<am::offline_queue_config const>(config));
+            for (int i = 0; i != 4; ++i) {
+                om.push_back(make_msg("t", std::to_string(i)), am::qos::at_least_once, std::nullopt);
+            }
+            // the memory part doesn't grow over spill_threshold
+            BOOST_TEST(om.size() == 2u);
+            BOOST_TEST(om.dropped() == 2u);
+            fake_epsp ep;
+            return send_all(om, ep);
+        };
+    BOOST_TEST(
+        (test(am::offline_overflow_policy::drop_oldest) == std::vector<std::string>{"2", "3"})
+    );
+    BOOST_TEST(
+        (test(am::offline_overflow_policy::drop_newest) == std::vector<std::string>{"0", "1"})
+    );
+    std::filesystem::remove(file);
+}
+
+BOOST_AUTO_TEST_CASE(spill_buffered) {
+    auto dir = std::filesystem::temp_directory_path() / ("ut_offline_" + am::create_uuid_string());
+    {
+        am::offline_queue_config config;
+        config.spill_threshold = 1;
+        config.spill_dir = dir.string();
+        am::offline_messages om;
+        om.set_config(std::make_shared<am::offline_queue_config const>(config));
+        for (int i = 0; i != 4; ++i) {
+            om.push_back(make_msg("t", std::to_string(i)), am::qos::at_least_once, std::nullopt);
+        }
+        // the spilled records are buffered, and written when they are read
+        auto seg = std::filesystem::directory_iterator(dir)->path();
+        BOOST_TEST(std::filesystem::file_size(seg) == 0u);
+        fake_epsp ep;
+        BOOST_TEST((send_all(om, ep) == std::vector<std::string>{"0", "1", "2", "3"}));
+        BOOST_TEST(om.empty());
+    }
+    std::filesystem::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_CASE(spill_expiry) {
+    auto dir = std::filesystem::temp_directory_path() / ("ut_offline_" + am::create_uuid_string());
+    {
+        am::offline_queue_config config;
+        config.spill_threshold = 1;
+        config.spill_dir = dir.string();
+        config.max_messages = 3;
+        config.compaction_interval = std::chrono::steady_clock::duration::zero();
+        am::offline_messages om;
+        om.set_config(std::make_shared<am::offline_queue_config const>(config));
+        om.push_back(make_msg("t", "mem"), am::qos::at_least_once, std::nullopt);
+        for (auto const& payload : {"e1", "e2"}) {
+            om.push_back(
+                make_msg("t", payload, am::properties{am::property::message_expiry_interval{0}}),
+                am::qos::at_least_once,
+                std::nullopt
+            );
+        }
+        BOOST_TEST(om.size() == 3u);
+        // the expiries are counted per second
+        std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+
+        // the expired messages on disk are excluded, so the live ones are not dropped
+        om.push_back(make_msg("t", "a"), am::qos::at_least_once, std::nullopt);
+        om.push_back(make_msg("t", "b"), am::qos::at_least_once, std::nullopt);
+        BOOST_TEST(om.size() == 3u);
+        BOOST_TEST(om.dropped() == 0u);
+        BOOST_TEST(om.bytes() == 8u);
+        fake_epsp ep;
+        BOOST_TEST((send_all(om, ep) == std::vector<std::string>{"mem", "a", "b"}));
+        BOOST_TEST(om.empty());
+        BOOST_TEST(om.bytes() == 0u);
+    }
+    std::filesystem::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,71 @@
+// Copyright Takatoshi Kondo 2024
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "../common/test_main.hpp"
+#include "../common/global_fixture.hpp"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <broker/response_topic_map.hpp>
+
+BOOST_AUTO_TEST_SUITE(ut_broker_response_topic_map)
+
+namespace am = async_mqtt;
+
+BOOST_AUTO_TEST_CASE(insert_erase) {
+    am::response_topic_map m;
+    BOOST_TEST(!m.contains("rt1"));
+    BOOST_TEST(!m.owner("rt1"));
+    m.insert("rt1", "u1");
+    m.insert("rt2", "u2");
+    BOOST_TEST(m.size() == 2);
+    BOOST_TEST(m.contains("rt1"));
+    BOOST_TEST(*m.owner("rt1") == "u1");
+    BOOST_TEST(m.is_owner("rt1", "u1"));
+    BOOST_TEST(!m.is_owner("rt1", "u2"));
+    BOOST_TEST(!m.is_owner("rt3", "u1"));
+
+    // the owner is replaced
+    m.insert("rt1", "u3");
+    BOOST_TEST(m.size() == 2);
+    BOOST_TEST(m.is_owner("rt1", "u3"));
+    BOOST_TEST(!m.is_owner("rt1", "u1"));
+
+    m.erase("rt1");
+    m.erase("rt1");
+    BOOST_TEST(m.size() == 1);
+    BOOST_TEST(!m.contains("rt1"));
+    BOOST_TEST(m.contains("rt2"));
+}
+
+BOOST_AUTO_TEST_CASE(concurrent) {
+    am::response_topic_map m;
+    // Boost.Test assertions are not thread safe
+    std::atomic<bool> owned{true};
+    std::vector<std::thread> ths;
+    for (int t = 0; t != 4; ++t) {
+        ths.emplace_back(
+            [&m, &owned, t] {
+                for (int i = 0; i != 1000; ++i) {
+                    auto topic = "rt/" + std::to_string(t) + "/" + std::to_string(i);
+                    auto user = "u" + std::to_string(t);
+                    m.insert(topic, user);
+                    if (!m.is_owner(topic, user)) owned = false;
+                    if (i % 2 == 0) m.erase(topic);
+                }
+            }
+        );
+    }
+    for (auto& th : ths) th.join();
+    BOOST_TEST(owned);
+    BOOST_TEST(m.size() == 2000);
+    BOOST_TEST(m.is_owner("rt/3/999", "u3"));
+    BOOST_TEST(!m.contains("rt/3/998"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -8,6 +8,7 @@
 #include "../common/global_fixture.hpp"
 
 #include <broker/security.hpp>
+#include <broker/login_cache.hpp>
 
 BOOST_AUTO_TEST_SUITE(ut_broker_security)
 
@@ -939,4 +940,95 @@ BOOST_AUTO_TEST_CASE(allow_pertial_deny_group) {
     BOOST_CHECK(security.auth_sub_user(security.auth_sub("topic"), "u2") == am::security::authorization::type::deny);
 }
 
+BOOST_AUTO_TEST_CASE(login_digest) {
+    am::security security;
+    std::string const value = R"*(
+        {
+            "authentication": [
+                {
+                    "name": "u1",
+                    "method": "sha256",
+                    "salt": "salt",
+                    "digest": "38EA2E5E88FCD692FE177C6CADA15E9B2DB6E70BEE0A0D6678C8D3B2A9AAE2AD"
+                }
+                ,
+                {
+                    "name": "u2",
+                    "method": "sha256",
+                    "salt": "salt",
+                    "digest": "invalid"
+                }
+            ],
+            "authorization": []
+        }
+        )*";
+    BOOST_CHECK_NO_THROW(load_config(security, value));
+
+    BOOST_CHECK(security.authentication_["u1"].digest_bin);
+    BOOST_CHECK(!security.authentication_["u2"].digest_bin);
+
+    BOOST_CHECK(security.login("u1", "mypassword"));
+    BOOST_CHECK(!security.login("u1", "mypasswore"));
+    BOOST_CHECK(!security.login("u1", ""));
+    BOOST_CHECK(!security.login("u2", "mypassword"));
+    BOOST_CHECK(security.login_cacheable("u1"));
+    BOOST_CHECK(!security.login_cacheable("unknown"));
+}
+
+BOOST_AUTO_TEST_CASE(login_cache) {
+    am::login_cache cache{2};
+    BOOST_CHECK(!cache.check("u1", "p1"));
+
+    cache.store("u1", "p1");
+    BOOST_CHECK(cache.check("u1", "p1"));
+    BOOST_CHECK(!cache.check("u1", "p2"));
+    BOOST_CHECK(!cache.check("u", "1p1"));
+
+    cache.store("u2", "p2");
+    // u1 is the most recently used, so u2 is evicted
+    BOOST_CHECK(cache.check("u1", "p1"));
+    cache.store("u3", "p3");
+    BOOST_CHECK(cache.size() == 2);
+    BOOST_CHECK(cache.check("u1", "p1"));
+    BOOST_CHECK(!cache.check("u2", "p2"));
+    BOOST_CHECK(cache.check("u3", "p3"));
+
+    cache.erase("u3");
+    BOOST_CHECK(!cache.check("u3", "p3"));
+    cache.clear();
+    BOOST_CHECK(cache.size() == 0);
+    BOOST_CHECK(!cache.check("u1", "p1"));
+}
+
+BOOST_AUTO_TEST_CASE(changed_users) {
+    am::security before;
+    am::security after;
+    std::string const value1 = R"*(
+        {
+            "authentication": [
+                { "name": "u1", "method": "plain_password", "password": "p1" },
+                { "name": "u2", "method": "plain_password", "password": "p2" },
+                { "name": "u3", "method": "plain_password", "password": "p3" }
+            ],
+            "authorization": []
+        }
+        )*";
+    std::string const value2 = R"*(
+        {
+            "authentication": [
+                { "name": "u1", "method": "plain_password", "password": "p1" },
+                { "name": "u2", "method": "plain_password", "password": "changed" },
+                { "name": "u4", "method": "plain_password", "password": "p4" }
+            ],
+            "authorization": []
+        }
+        )*";
+    BOOST_CHECK_NO_THROW(load_config(before, value1));
+    BOOST_CHECK_NO_THROW(load_config(after, value2));
+
+    auto users = am::security::changed_users(before, after);
+    BOOST_TEST(users == (std::vector<std::string>{"u2", "u3"}));
+    BOOST_TEST(am::security::changed_users(after, after).empty());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,99 @@
+// Copyright Takatoshi Kondo 2024
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "../common/test_main.hpp"
+#include "../common/global_fixture.hpp"
+
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include <broker/session_reclaimer.hpp>
+
+BOOST_AUTO_TEST_SUITE(ut_broker_session_reclaimer)
+
+namespace am = async_mqtt;
+namespace as = boost::asio;
+
+namespace {
+
+struct fake_session {
+    fake_session(std::string name, std::size_t subs, std::vector<std::string>& log)
+        :name{std::move(name)}, subs{subs}, log{log}
+    {}
+
+    ~fake_session() {
+        log.push_back(name + " destroyed");
+    }
+
+    bool reclaim(std::size_t max) {
+        auto n = std::min(max, subs);
+        subs -= n;
+        log.push_back(name + " " + std::to_string(n));
+        return subs == 0;
+    }
+
+    std::string name;
+    std::size_t subs;
+    std::vector<std::string>& log;
+};
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(batch) {
+    as::io_context ioc;
+    std::vector<std::string> log;
+    am::session_reclaimer<fake_session> r{ioc.get_executor(), 10};
+    r.add(std::make_shared<fake_session>("big", 25, log));
+    r.add(std::make_shared<fake_session>("small", 3, log));
+    // nothing is done on add
+    BOOST_TEST(log.empty());
+    BOOST_TEST(r.pending() == 2);
+
+    // one batch per handler
+    BOOST_TEST(ioc.poll_one() == 1);
+    BOOST_TEST((log == std::vector<std::string>{"big 10"}));
+
+    ioc.run();
+    BOOST_TEST(
+        (log == std::vector<std::string>{
+            "big 10",
+            "small 3",
+            "small destroyed",
+            "big 10",
+            "big 5",
+            "big destroyed"
+        })
+    );
+    BOOST_TEST(r.pending() == 0);
+    BOOST_TEST(r.reclaimed() == 2);
+
+    // restart after idle
+    log.clear();
+    r.add(std::make_shared<fake_session>("again", 1, log));
+    ioc.restart();
+    ioc.run();
+    BOOST_TEST((log == std::vector<std::string>{"again 1", "again destroyed"}));
+    BOOST_TEST(r.reclaimed() == 3);
+}
+
+BOOST_AUTO_TEST_CASE(destroy) {
+    as::io_context ioc;
+    std::vector<std::string> log;
+    {
+        am::session_reclaimer<fake_session> r{ioc.get_executor(), 10};
+        r.add(std::make_shared<fake_session>("s", 15, log));
+    }
+    // remaining sessions are reclaimed synchronously
+    BOOST_TEST((log == std::vector<std::string>{"s 10", "s 5", "s destroyed"}));
+    log.clear();
+    // posted handler does nothing
+    ioc.run();
+    BOOST_TEST(log.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
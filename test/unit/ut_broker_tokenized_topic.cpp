@@ -0,0 +1,83 @@
+// Copyright Takatoshi Kondo 2024
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "../common/test_main.hpp"
+#include "../common/global_fixture.hpp"
+
+#include <set>
+#include <vector>
+
+#include <broker/tokenized_topic.hpp>
+#include <broker/subscription_map.hpp>
+#include <broker/retained_topic_map.hpp>
+
+BOOST_AUTO_TEST_SUITE(ut_broker_tokenized_topic)
+
+namespace am = async_mqtt;
+
+BOOST_AUTO_TEST_CASE(levels) {
+    for (std::string_view topic : {"a//bc/+/#", "/", "", "a", "$SYS/x/"}) {
+        std::vector<std::string_view> expected;
+        am::topic_filter_tokenizer(
+            topic,
+            [&](std::string_view t) {
+                expected.push_back(t);
+                return true;
+            }
+        );
+        am::tokenized_topic tt{topic};
+        BOOST_TEST(tt.str() == topic);
+        BOOST_TEST(tt.size() == expected.size());
+        for (std::size_t i = 0; i != tt.size(); ++i) {
+            BOOST_TEST(tt[i].name == expected[i]);
+            BOOST_TEST(tt[i].hash == std::hash<std::string_view>{}(expected[i]));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(subscription_map) {
+    am::multiple_subscription_map<std::string, int> m;
+    m.insert_or_assign("a/b/c", "c1", 1);
+    m.insert_or_assign("a/+/c", "c2", 2);
+    m.insert_or_assign("a/#", "c3", 3);
+    m.insert_or_assign("#", "c4", 4);
+    m.insert_or_assign("b/c", "c5", 5);
+
+    for (std::string_view topic : {"a/b/c", "a/x/c", "a", "b/c", "$SYS/a/b/c", "x"}) {
+        std::set<int> by_view;
+        m.find(topic, [&](std::string const&, int v) { by_view.insert(v); });
+        std::set<int> by_tokens;
+        m.find(am::tokenized_topic{topic}, [&](std::string const&, int v) { by_tokens.insert(v); });
+        BOOST_TEST(by_view == by_tokens);
+    }
+
+    std::set<int> matched;
+    m.modify(am::tokenized_topic{"a/b/c"}, [&](std::string const&, int& v) { matched.insert(v); });
+    BOOST_TEST((matched == std::set<int>{1, 2, 3, 4}));
+}
+
+BOOST_AUTO_TEST_CASE(retained_topic_map) {
+    am::retained_topic_map<int> m;
+    BOOST_TEST(m.insert_or_assign(am::tokenized_topic{"a/b/c"}, 1) == 1);
+    BOOST_TEST(m.insert_or_assign("a/b", 2) == 1);
+    BOOST_TEST(m.insert_or_assign(am::tokenized_topic{"a/b"}, 3) == 0);
+    BOOST_TEST(m.size() == 2);
+
+    std::set<int> found;
+    m.find(am::tokenized_topic{"a/+/c"}, [&](int v) { found.insert(v); });
+    BOOST_TEST((found == std::set<int>{1}));
+    found.clear();
+    m.find("a/#", [&](int v) { found.insert(v); });
+    BOOST_TEST((found == std::set<int>{1, 3}));
+
+    BOOST_TEST(m.erase(am::tokenized_topic{"a/b/c"}) == 1);
+    BOOST_TEST(m.erase("a/b/c") == 0);
+    BOOST_TEST(m.erase(am::tokenized_topic{"a/b"}) == 1);
+    BOOST_TEST(m.size() == 0);
+    BOOST_TEST(m.internal_size() == 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
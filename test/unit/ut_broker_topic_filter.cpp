@@ -0,0 +1,162 @@
+// Copyright Takatoshi Kondo 2024
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "../common/test_main.hpp"
+#include "../common/global_fixture.hpp"
+
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <broker/topic_filter.hpp>
+
+BOOST_AUTO_TEST_SUITE(ut_broker_topic_filter)
+
+namespace am = async_mqtt;
+
+namespace {
+
+std::vector<std::string_view> split_ref(std::string_view str) {
+    std::vector<std::string_view> ret;
+    std::size_t begin = 0;
+    while (true) {
+        auto pos = str.find('/', begin);
+        if (pos == std::string_view::npos) {
+            ret.push_back(str.substr(begin));
+            return ret;
+        }
+        ret.push_back(str.substr(begin, pos - begin));
+        begin = pos + 1;
+    }
+}
+
+bool validate_topic_filter_ref(std::string_view str) {
+    if (str.empty() || str.size() > std::numeric_limits<std::uint16_t>::max()) return false;
+    auto levels = split_ref(str);
+    for (std::size_t i = 0; i != levels.size(); ++i) {
+        auto l = levels[i];
+        if (l.find('\0') != std::string_view::npos) return false;
+        if (l.find_first_of("+#") == std::string_view::npos) continue;
+        if (l == "+") continue;
+        if (l == "#" && i == levels.size() - 1) continue;
+        return false;
+    }
+    return true;
+}
+
+bool validate_topic_name_ref(std::string_view str) {
+    if (str.empty() || str.size() > std::numeric_limits<std::uint16_t>::max()) return false;
+    for (auto c : str) {
+        if (c == '\0' || c == '+' || c == '#') return false;
+    }
+    return true;
+}
+
+// Random topics with many separators and wildcards, including multi byte UTF-8
+std::string random_topic(std::mt19937& gen, std::size_t max_len) {
+    static constexpr char alphabet[] = {
+        'a', 'b', 'z', '/', '/', '+', '#', '\0', ' ', '$',
+        static_cast<char>(0xc3), static_cast<char>(0xa9), static_cast<char>(0xff)
+    };
+    std::uniform_int_distribution<std::size_t> len_dist{0, max_len};
+    std::uniform_int_distribution<std::size_t> char_dist{0, sizeof(alphabet) - 1};
+    // Mostly plain characters so that the interesting ones appear at any offset
+    std::uniform_int_distribution<int> plain_dist{0, 3};
+    std::string ret(len_dist(gen), 'x');
+    for (auto& c : ret) {
+        if (plain_dist(gen) == 0) c = alphabet[char_dist(gen)];
+    }
+    return ret;
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(find_first_of) {
+    std::mt19937 gen{12345};
+    for (std::size_t i = 0; i != 20000; ++i) {
+        auto str = random_topic(gen, 100);
+        BOOST_TEST(
+            (am::detail::topic_find_first_of<'/'>(str.data(), str.size())) ==
+            (am::detail::topic_find_first_of_scalar<'/'>(str.data(), str.size()))
+        );
+        BOOST_TEST(
+            (am::detail::topic_find_first_of<'\0', '+', '#'>(str.data(), str.size())) ==
+            (am::detail::topic_find_first_of_scalar<'\0', '+', '#'>(str.data(), str.size()))
+        );
+
+        std::vector<std::size_t> positions;
+        am::detail::topic_for_each_of<'/', '+'>(
+            str.data(),
+            str.size(),
+            [&](std::size_t pos) {
+                positions.push_back(pos);
+                return true;
+            }
+        );
+        std::vector<std::size_t> expected;
+        for (auto pos = str.find_first_of("/+"); pos != std::string::npos; pos = str.find_first_of("/+", pos + 1)) {
+            expected.push_back(pos);
+        }
+        BOOST_TEST(positions == expected);
+    }
+
+    // The match is at every offset of a long input
+    for (std::size_t pos = 0; pos != 80; ++pos) {
+        std::string str(80, 'a');
+        str[pos] = '#';
+        BOOST_TEST((am::detail::topic_find_first_of<'\0', '+', '#'>(str.data(), str.size())) == pos);
+        BOOST_TEST((am::detail::topic_find_first_of<'/'>(str.data(), str.size())) == str.size());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(tokenizer) {
+    std::mt19937 gen{23456};
+    for (std::size_t i = 0; i != 20000; ++i) {
+        auto str = random_topic(gen, 100);
+        std::vector<std::string_view> levels;
+        auto count = am::topic_filter_tokenizer(
+            str,
+            [&](std::string_view t) {
+                levels.push_back(t);
+                return true;
+            }
+        );
+        auto expected = split_ref(str);
+        BOOST_TEST(count == expected.size());
+        BOOST_TEST(levels == expected);
+    }
+
+    // stop at the second level
+    std::vector<std::string_view> levels;
+    auto count = am::topic_filter_tokenizer(
+        "a/b/c",
+        [&](std::string_view t) {
+            levels.push_back(t);
+            return levels.size() < 2;
+        }
+    );
+    BOOST_TEST(count == 2);
+    BOOST_TEST((levels == std::vector<std::string_view>{"a", "b"}));
+}
+
+BOOST_AUTO_TEST_CASE(validate) {
+    std::mt19937 gen{34567};
+    for (std::size_t i = 0; i != 20000; ++i) {
+        auto str = random_topic(gen, 100);
+        BOOST_TEST(am::validate_topic_filter(str) == validate_topic_filter_ref(str));
+        BOOST_TEST(am::validate_topic_name(str) == validate_topic_name_ref(str));
+    }
+
+    std::string long_topic(std::numeric_limits<std::uint16_t>::max(), 'a');
+    BOOST_TEST(am::validate_topic_filter(long_topic));
+    BOOST_TEST(am::validate_topic_name(long_topic));
+    long_topic.push_back('a');
+    BOOST_TEST(!am::validate_topic_filter(long_topic));
+    BOOST_TEST(!am::validate_topic_name(long_topic));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
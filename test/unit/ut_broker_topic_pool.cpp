@@ -0,0 +1,89 @@
+// Copyright Takatoshi Kondo 2024
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "../common/test_main.hpp"
+#include "../common/global_fixture.hpp"
+
+#include <thread>
+
+#include <broker/topic_pool.hpp>
+
+BOOST_AUTO_TEST_SUITE(ut_broker_topic_pool)
+
+namespace am = async_mqtt;
+
+BOOST_AUTO_TEST_CASE(intern) {
+    am::topic_pool pool;
+    auto t1 = pool.intern("a/b/c");
+    auto t2 = pool.intern(std::string("a/b/") + "c");
+    auto t3 = pool.intern("a/b");
+    BOOST_TEST(t1 == t2);
+    BOOST_TEST(t1 != t3);
+    BOOST_TEST(t1.str() == "a/b/c");
+    BOOST_TEST(t1.hash() == std::hash<std::string_view>{}("a/b/c"));
+    BOOST_TEST(pool.size() == 2);
+}
+
+BOOST_AUTO_TEST_CASE(levels) {
+    am::topic_pool pool;
+    auto t = pool.intern("a//bc/+/#");
+    BOOST_TEST(t.levels() == 5);
+    BOOST_TEST(t.level(0) == "a");
+    BOOST_TEST(t.level(1) == "");
+    BOOST_TEST(t.level(2) == "bc");
+    BOOST_TEST(t.level(3) == "+");
+    BOOST_TEST(t.level(4) == "#");
+
+    auto s = pool.intern("/");
+    BOOST_TEST(s.levels() == 2);
+    BOOST_TEST(s.level(0) == "");
+    BOOST_TEST(s.level(1) == "");
+}
+
+BOOST_AUTO_TEST_CASE(release) {
+    am::topic_pool pool;
+    {
+        auto t1 = pool.intern("a/b");
+        auto t2 = t1;
+        BOOST_TEST(pool.find("a/b") == t1);
+        t1 = am::interned_topic{};
+        BOOST_TEST(pool.size() == 1);
+    }
+    BOOST_TEST(pool.size() == 0);
+    BOOST_TEST(!pool.find("a/b"));
+}
+
+BOOST_AUTO_TEST_CASE(outlive_pool) {
+    am::interned_topic t;
+    {
+        am::topic_pool pool;
+        t = pool.intern("a/b");
+    }
+    BOOST_TEST(t.str() == "a/b");
+}
+
+BOOST_AUTO_TEST_CASE(concurrent) {
+    am::topic_pool pool;
+    std::vector<std::thread> ths;
+    std::vector<std::vector<am::interned_topic>> results(4);
+    for (std::size_t i = 0; i != results.size(); ++i) {
+        ths.emplace_back(
+            [&, i] {
+                for (int n = 0; n != 1000; ++n) {
+                    auto t = pool.intern("topic/" + std::to_string(n % 100));
+                    if (n < 100) results[i].push_back(t);
+                }
+            }
+        );
+    }
+    for (auto& th : ths) th.join();
+    for (std::size_t i = 1; i != results.size(); ++i) {
+        BOOST_TEST(results[i] == results[0]);
+    }
+    BOOST_TEST(pool.size() == 100);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -79,6 +79,36 @@ BOOST_AUTO_TEST_CASE( string ) {
     }
 }
 
+BOOST_AUTO_TEST_CASE( allocated_life ) {
+    am::buffer moved;
+    {
+        auto [life, ptr] = am::buffer::life_type::allocate(5);
+        std::copy_n("01234", 5, ptr);
+        am::buffer buf{ptr, 5, am::force_move(life)};
+        BOOST_TEST(!life);
+        BOOST_TEST(buf == "01234");
+        BOOST_TEST(buf.has_life());
+        auto ss1 = buf.substr(2, 3);
+        BOOST_TEST(ss1 == "234");
+        BOOST_TEST(ss1.has_life());
+        moved = am::force_move(ss1);
+    }
+    BOOST_TEST(moved == "234");
+}
+
+BOOST_AUTO_TEST_CASE( shared_ptr_life ) {
+    auto sp = std::make_shared<std::string>("01234");
+    {
+        am::buffer buf{std::string_view{*sp}, sp};
+        BOOST_TEST(buf.has_life());
+        auto ss1 = buf.substr(1);
+        BOOST_TEST(ss1 == "1234");
+        // copies of the buffer share one holder of sp
+        BOOST_TEST(sp.use_count() == 2);
+    }
+    BOOST_TEST(sp.use_count() == 1);
+}
+
 BOOST_AUTO_TEST_CASE( buffers ) {
     std::vector<am::buffer> bufs;
     BOOST_TEST(am::to_string(bufs).empty());
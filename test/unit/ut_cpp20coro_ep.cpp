@@ -428,6 +428,102 @@ BOOST_AUTO_TEST_CASE(bulk_write) {
     ioc.run();
 }
 
+BOOST_AUTO_TEST_CASE(bulk_write_coalesce) {
+    auto version = am::protocol_version::v3_1_1;
+    as::io_context ioc;
+    as::co_spawn(
+        ioc.get_executor(),
+        [&]() -> as::awaitable<void> {
+            auto exe = co_await as::this_coro::executor;
+            auto ep = am::endpoint<async_mqtt::role::client, am::cpp20coro_stub_socket>{
+                version,
+                // for stub_socket args
+                version,
+                am::force_move(exe)
+            };
+            {
+                auto [ec] = co_await ep.async_underlying_handshake(as::as_tuple(as::deferred));
+                BOOST_TEST(!ec);
+            }
+            ep.set_bulk_write(true);
+            ep.set_write_coalesce_threshold(32);
+            // prepare connect
+            {
+                auto connect = am::v3_1_1::connect_packet{
+                    true,   // clean_session
+                    0x1234, // keep_alive
+                    "cid1"
+                };
+                auto [ec] = co_await ep.async_send(connect, as::as_tuple(as::deferred));
+                BOOST_TEST(!ec);
+                co_await ep.next_layer().wait_response(as::as_tuple(as::deferred));
+
+                auto connack = am::v3_1_1::connack_packet{
+                    false,   // session_present
+                    am::connect_return_code::accepted
+                };
+                co_await ep.next_layer().emulate_recv(connack, as::as_tuple(as::deferred));
+                co_await ep.async_recv(as::as_tuple(as::deferred));
+            }
+            // test scenario
+            {
+                // small, small, large (zero-copy), small
+                auto small = am::v3_1_1::publish_packet{
+                    "topic1",
+                    "payload1",
+                    am::qos::at_most_once
+                };
+                auto large = am::v3_1_1::publish_packet{
+                    "topic1",
+                    std::string(100, 'x'),
+                    am::qos::at_most_once
+                };
+                auto [ec1, ec2t, ec3t, ec4t] =
+                    co_await (
+                        ep.async_send(am::v3_1_1::pingreq_packet{}, as::as_tuple(as::use_awaitable)) &&
+                        ep.async_send(small, as::as_tuple(as::use_awaitable)) &&
+                        ep.async_send(large, as::as_tuple(as::use_awaitable)) &&
+                        ep.async_send(small, as::as_tuple(as::use_awaitable))
+                    );
+                auto [ec2] = ec2t;
+                auto [ec3] = ec3t;
+                auto [ec4] = ec4t;
+                BOOST_TEST(!ec1);
+                BOOST_TEST(!ec2);
+                BOOST_TEST(!ec3);
+                BOOST_TEST(!ec4);
+                {
+                    auto [ec, pv] = co_await ep.next_layer().wait_response(as::as_tuple(as::deferred));
+                    BOOST_TEST(!ec);
+                    BOOST_TEST(*pv == am::v3_1_1::pingreq_packet{});
+                }
+                {
+                    auto [ec, pv] = co_await ep.next_layer().wait_response(as::as_tuple(as::deferred));
+                    BOOST_TEST(!ec);
+                    BOOST_TEST(*pv == small);
+                }
+                {
+                    auto [ec, pv] = co_await ep.next_layer().wait_response(as::as_tuple(as::deferred));
+                    BOOST_TEST(!ec);
+                    BOOST_TEST(*pv == large);
+                }
+                {
+                    auto [ec, pv] = co_await ep.next_layer().wait_response(as::as_tuple(as::deferred));
+                    BOOST_TEST(!ec);
+                    BOOST_TEST(*pv == small);
+                }
+
+                co_await ep.async_close(as::deferred);
+                co_await ep.next_layer().wait_response(as::as_tuple(as::deferred));
+            }
+
+            co_return;
+        },
+        as::detached
+    );
+    ioc.run();
+}
+
 // async_recv remaining length error
 
 BOOST_AUTO_TEST_CASE(remaining_length_error) {
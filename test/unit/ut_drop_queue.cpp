@@ -0,0 +1,80 @@
+// Copyright Takatoshi Kondo 2024
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "../common/test_main.hpp"
+#include "../common/global_fixture.hpp"
+
+#include <memory>
+#include <vector>
+#include <async_mqtt/util/drop_queue.hpp>
+
+BOOST_AUTO_TEST_SUITE(ut_drop_queue)
+
+namespace am = async_mqtt;
+
+namespace {
+
+template <typename T>
+std::vector<T> take_all(am::drop_queue<T>& q) {
+    auto d = q.take();
+    return std::vector<T>(d.begin(), d.end());
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(drop_oldest) {
+    am::drop_queue<int> q{3, am::drop_policy::drop_oldest};
+    BOOST_TEST(!q.push(1));
+    BOOST_TEST(!q.push(2));
+    BOOST_TEST(!q.push(3));
+    BOOST_TEST(q.size() == 3u);
+    auto d1 = q.push(4);
+    BOOST_TEST(d1.has_value());
+    BOOST_TEST(*d1 == 1);
+    auto d2 = q.push(5);
+    BOOST_TEST(d2.has_value());
+    BOOST_TEST(*d2 == 2);
+    BOOST_TEST(q.size() == 3u);
+    BOOST_TEST((take_all(q) == std::vector<int>{3, 4, 5}));
+    BOOST_TEST(q.empty());
+}
+
+BOOST_AUTO_TEST_CASE(drop_newest) {
+    am::drop_queue<int> q{2, am::drop_policy::drop_newest};
+    BOOST_TEST(!q.push(1));
+    BOOST_TEST(!q.push(2));
+    auto d = q.push(3);
+    BOOST_TEST(d.has_value());
+    BOOST_TEST(*d == 3);
+    BOOST_TEST((take_all(q) == std::vector<int>{1, 2}));
+
+    // room is made by take()
+    BOOST_TEST(!q.push(4));
+    BOOST_TEST((take_all(q) == std::vector<int>{4}));
+}
+
+BOOST_AUTO_TEST_CASE(zero) {
+    for (auto policy : {am::drop_policy::drop_oldest, am::drop_policy::drop_newest}) {
+        am::drop_queue<int> q{0, policy};
+        auto d = q.push(1);
+        BOOST_TEST(d.has_value());
+        BOOST_TEST(*d == 1);
+        BOOST_TEST(q.empty());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(move_only) {
+    am::drop_queue<std::unique_ptr<int>> q{1, am::drop_policy::drop_oldest};
+    BOOST_TEST(!q.push(std::make_unique<int>(1)));
+    auto d = q.push(std::make_unique<int>(2));
+    BOOST_TEST(d.has_value());
+    BOOST_TEST(**d == 1);
+    auto rest = q.take();
+    BOOST_TEST(rest.size() == 1u);
+    BOOST_TEST(*rest.front() == 2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,174 @@
+// Copyright Takatoshi Kondo 2024
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "../common/test_main.hpp"
+#include "../common/global_fixture.hpp"
+
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include <async_mqtt/asio_bind/endpoint.hpp>
+#include <async_mqtt/protocol/packet/packet_iterator.hpp>
+
+#include "stub_socket.hpp"
+
+BOOST_AUTO_TEST_SUITE(ut_ep_recv_batch)
+
+namespace am = async_mqtt;
+namespace as = boost::asio;
+
+namespace {
+
+am::v5::publish_packet make_publish(std::string payload) {
+    return am::v5::publish_packet{
+        "topic1",
+        am::force_move(payload),
+        am::qos::at_most_once,
+        am::properties{}
+    };
+}
+
+std::string bytes(am::v5::publish_packet const& p) {
+    return am::to_string(p.const_buffer_sequence());
+}
+
+} // anonymous namespace
+
+// One read contains whole packets followed by a part of the next packet.
+// The batch completes with the whole packets, and the rest of the partial packet
+// is read by the next batch.
+BOOST_AUTO_TEST_CASE(partial_packet) {
+    auto version = am::protocol_version::v5;
+    as::io_context ioc;
+    auto guard = as::make_work_guard(ioc.get_executor());
+    std::thread th {
+        [&] {
+            ioc.run();
+        }
+    };
+
+    auto ep = am::endpoint<async_mqtt::role::client, async_mqtt::stub_socket>{
+        version,
+        // for stub_socket args
+        version,
+        ioc.get_executor()
+    };
+
+    auto connect = am::v5::connect_packet{
+        true,   // clean_start
+        0x1234, // keep_alive
+        "cid1",
+        std::nullopt, // will
+        "user1",
+        "pass1",
+        am::properties{}
+    };
+
+    auto connack = am::v5::connack_packet{
+        false,   // session_present
+        am::connect_reason_code::success,
+        am::properties{}
+    };
+
+    auto pub1 = make_publish("payload1");
+    auto pub2 = make_publish("payload2");
+    auto pub3 = make_publish("payload3");
+    auto pub4 = make_publish("payload4");
+    auto pub5 = make_publish("payload5");
+    auto pub6 = make_publish("payload6");
+    auto pub7 = make_publish("payload7");
+    auto pub8 = make_publish("payload8");
+
+    auto b3 = bytes(pub3);
+    auto b5 = bytes(pub5);
+    // whole, whole, the first byte of the next
+    auto read1 = bytes(pub1) + bytes(pub2) + b3.substr(0, 1);
+    // rest, whole, the fixed header of the next
+    auto read2 = b3.substr(1) + bytes(pub4) + b5.substr(0, 2);
+    // rest
+    auto read3 = b5.substr(2);
+    // more whole packets than max_count
+    auto read4 = bytes(pub6) + bytes(pub7) + bytes(pub8);
+    ep.next_layer().set_recv_packets(
+        {
+            // receive packets
+            {connack},
+            {std::string_view{read1}},
+            {std::string_view{read2}},
+            {std::string_view{read3}},
+            {std::string_view{read4}},
+        }
+    );
+
+    // underlying handshake
+    {
+        auto [ec] = ep.async_underlying_handshake(as::as_tuple(as::use_future)).get();
+        BOOST_TEST(!ec);
+    }
+
+    // send connect
+    ep.next_layer().set_write_packet_checker(
+        [&](am::packet_variant wp) {
+            BOOST_TEST(connect == wp);
+        }
+    );
+    {
+        auto [ec] = ep.async_send(connect, as::as_tuple(as::use_future)).get();
+        BOOST_TEST(!ec);
+    }
+
+    // recv connack
+    {
+        auto [ec, pv] = ep.async_recv(as::as_tuple(as::use_future)).get();
+        BOOST_TEST(!ec);
+        BOOST_TEST(connack == *pv);
+    }
+
+    std::vector<am::packet_variant> packets;
+    {
+        auto [ec] = ep.async_recv_batch(packets, 0, as::as_tuple(as::use_future)).get();
+        BOOST_TEST(!ec);
+        BOOST_TEST(packets.size() == 2);
+        BOOST_TEST(pub1 == packets.at(0));
+        BOOST_TEST(pub2 == packets.at(1));
+    }
+    {
+        auto [ec] = ep.async_recv_batch(packets, 0, as::as_tuple(as::use_future)).get();
+        BOOST_TEST(!ec);
+        BOOST_TEST(packets.size() == 2);
+        BOOST_TEST(pub3 == packets.at(0));
+        BOOST_TEST(pub4 == packets.at(1));
+    }
+    {
+        auto [ec] = ep.async_recv_batch(packets, 0, as::as_tuple(as::use_future)).get();
+        BOOST_TEST(!ec);
+        BOOST_TEST(packets.size() == 1);
+        BOOST_TEST(pub5 == packets.at(0));
+    }
+    {
+        auto [ec] = ep.async_recv_batch(packets, 2, as::as_tuple(as::use_future)).get();
+        BOOST_TEST(!ec);
+        BOOST_TEST(packets.size() == 2);
+        BOOST_TEST(pub6 == packets.at(0));
+        BOOST_TEST(pub7 == packets.at(1));
+    }
+    {
+        auto [ec] = ep.async_recv_batch(packets, 2, as::as_tuple(as::use_future)).get();
+        BOOST_TEST(!ec);
+        BOOST_TEST(packets.size() == 1);
+        BOOST_TEST(pub8 == packets.at(0));
+    }
+
+    ep.async_close(as::as_tuple(as::use_future)).get();
+    guard.reset();
+    th.join();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
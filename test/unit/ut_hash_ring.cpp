@@ -0,0 +1,112 @@
+// Copyright Takatoshi Kondo 2024
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "../common/test_main.hpp"
+#include "../common/global_fixture.hpp"
+
+#include <map>
+#include <string>
+#include <async_mqtt/util/hash_ring.hpp>
+
+BOOST_AUTO_TEST_SUITE(ut_hash_ring)
+
+namespace am = async_mqtt;
+
+namespace {
+
+std::map<std::string, std::size_t> assign(am::hash_ring const& r, std::size_t keys) {
+    std::map<std::string, std::size_t> ret;
+    for (std::size_t i = 0; i != keys; ++i) {
+        auto key = "topic/" + std::to_string(i);
+        auto node = r.find(key);
+        BOOST_REQUIRE(node);
+        ret.emplace(key, *node);
+    }
+    return ret;
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(empty) {
+    am::hash_ring r;
+    BOOST_TEST(r.empty());
+    BOOST_TEST(r.size() == 0);
+    BOOST_TEST(!r.find("topic"));
+}
+
+BOOST_AUTO_TEST_CASE(insert_erase) {
+    am::hash_ring r{8};
+    BOOST_TEST(r.insert(0));
+    BOOST_TEST(!r.insert(0));
+    BOOST_TEST(r.insert(1));
+    BOOST_TEST(r.size() == 2);
+    BOOST_TEST(r.contains(1));
+    BOOST_TEST(r.erase(1));
+    BOOST_TEST(!r.erase(1));
+    BOOST_TEST(!r.contains(1));
+    BOOST_TEST(r.size() == 1);
+    BOOST_TEST(*r.find("topic") == 0u);
+}
+
+BOOST_AUTO_TEST_CASE(stable) {
+    am::hash_ring r1;
+    am::hash_ring r2;
+    for (std::size_t i = 0; i != 4; ++i) r1.insert(i);
+    for (std::size_t i = 4; i != 0; --i) r2.insert(i - 1);
+    BOOST_TEST(assign(r1, 1000) == assign(r2, 1000));
+    BOOST_TEST(am::hash_ring::hash("topic") == am::hash_ring::hash("topic"));
+    BOOST_TEST(am::hash_ring::hash("topic1") != am::hash_ring::hash("topic2"));
+}
+
+BOOST_AUTO_TEST_CASE(distribution) {
+    am::hash_ring r;
+    for (std::size_t i = 0; i != 4; ++i) r.insert(i);
+    std::map<std::size_t, std::size_t> counts;
+    for (auto const& [key, node] : assign(r, 4000)) ++counts[node];
+    BOOST_TEST(counts.size() == 4u);
+    for (auto const& [node, count] : counts) {
+        // 1000 on average
+        BOOST_TEST(count > 500u);
+        BOOST_TEST(count < 1500u);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(minimal_move) {
+    am::hash_ring r;
+    for (std::size_t i = 0; i != 4; ++i) r.insert(i);
+    auto before = assign(r, 1000);
+    r.erase(2);
+    auto after = assign(r, 1000);
+    for (auto const& [key, node] : before) {
+        if (node != 2) {
+            BOOST_TEST(after.at(key) == node);
+        }
+        else {
+            BOOST_TEST(after.at(key) != 2u);
+        }
+    }
+    r.insert(2);
+    BOOST_TEST(assign(r, 1000) == before);
+}
+
+BOOST_AUTO_TEST_CASE(skip) {
+    am::hash_ring r;
+    for (std::size_t i = 0; i != 4; ++i) r.insert(i);
+    auto before = assign(r, 1000);
+    for (auto const& [key, node] : before) {
+        auto skipped = r.find(key, [](std::size_t n) { return n != 1; });
+        BOOST_REQUIRE(skipped);
+        if (node != 1) {
+            BOOST_TEST(*skipped == node);
+        }
+        else {
+            BOOST_TEST(*skipped != 1u);
+        }
+    }
+    BOOST_TEST(!r.find("topic", [](std::size_t) { return false; }));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
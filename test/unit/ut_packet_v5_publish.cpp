@@ -18,6 +18,8 @@ struct v5_publish_invalid;
 struct v5_publish_pid4;
 struct v5_publish_topic_alias;
 struct v5_publish_error;
+struct v5_publish_many_properties;
+struct v5_publish_update_message_expiry_interval;
 BOOST_AUTO_TEST_SUITE_END()
 
 #include <async_mqtt/protocol/packet/v5_publish.hpp>
@@ -667,4 +669,110 @@ BOOST_AUTO_TEST_CASE(v5_publish_error) {
     }
 }
 
+BOOST_AUTO_TEST_CASE(v5_publish_many_properties) {
+    // the const buffer sequence exceeds the inline capacity
+    am::properties props;
+    for (int i = 0; i != 10; ++i) {
+        props.push_back(am::property::user_property("key" + std::to_string(i), "val"));
+    }
+    auto p = am::v5::publish_packet{
+        0x1234, // packet_id
+        "topic1",
+        "payload1",
+        am::qos::at_least_once,
+        props
+    };
+    auto cbs = p.const_buffer_sequence();
+    BOOST_TEST(cbs.size() == p.num_of_const_buffer_sequence());
+    BOOST_TEST(cbs.size() > am::const_buffer_vector_inline_capacity);
+
+    auto [b, e] = am::make_packet_range(cbs);
+    am::buffer buf{std::string{b, e}};
+    BOOST_TEST(buf.size() == p.size());
+    am::error_code ec;
+    auto p2 = am::v5::publish_packet{buf, ec};
+    BOOST_TEST(!ec);
+    BOOST_TEST(p2 == p);
+}
+
+BOOST_AUTO_TEST_CASE(v5_publish_update_message_expiry_interval) {
+    auto p = am::v5::publish_packet{
+        0x1234, // packet_id
+        "topic1",
+        "payload1",
+        am::qos::at_least_once,
+        am::properties{
+            am::property::topic_alias(1),
+            am::property::message_expiry_interval(100)
+        }
+    };
+    BOOST_TEST(p.message_expiry_interval_index_ == 1u);
+    auto size = p.size();
+    p.update_message_expiry_interval(50);
+    BOOST_TEST(p.size() == size);
+    {
+        auto cbs = p.const_buffer_sequence();
+        char expected[] {
+            0x32,                               // fixed_header
+            0x1b,                               // remaining_length
+            0x00, 0x06,                         // topic_name_length
+            0x74, 0x6f, 0x70, 0x69, 0x63, 0x31, // topic_name
+            0x12, 0x34,                         // packet_id
+            0x08,                               // property_length
+            0x23,                               // topic_alias
+            0x00, 0x01,                         // 1
+            0x02,                               // message_expiry_interval
+            0x00, 0x00, 0x00, 0x32,             // 50
+            0x70, 0x61, 0x79, 0x6c, 0x6f, 0x61, 0x64, 0x31 // payload
+        };
+        auto [b, e] = am::make_packet_range(cbs);
+        BOOST_TEST(std::equal(b, e, std::begin(expected)));
+    }
+
+    // the hint is stale after the topic alias is removed
+    p.remove_topic_alias();
+    p.update_message_expiry_interval(10);
+    BOOST_TEST(p.message_expiry_interval_index_ == 0u);
+    BOOST_TEST(p.props().size() == 1u);
+    BOOST_TEST(
+        (p.props()[0] == am::property_variant{am::property::message_expiry_interval(10)})
+    );
+}
+
+BOOST_AUTO_TEST_CASE(v5_publish_set_packet_id) {
+    auto p = am::v5::publish_packet{
+        0x1234, // packet_id
+        "topic1",
+        "payload1",
+        am::qos::at_least_once
+    };
+    auto size = p.size();
+    p.set_packet_id(0x5678);
+    BOOST_TEST(p.packet_id() == 0x5678);
+    BOOST_TEST(p.size() == size);
+    {
+        auto cbs = p.const_buffer_sequence();
+        char expected[] {
+            0x32,                               // fixed_header
+            0x13,                               // remaining_length
+            0x00, 0x06,                         // topic_name_length
+            0x74, 0x6f, 0x70, 0x69, 0x63, 0x31, // topic_name
+            0x56, 0x78,                         // packet_id
+            0x00,                               // property_length
+            0x70, 0x61, 0x79, 0x6c, 0x6f, 0x61, 0x64, 0x31 // payload
+        };
+        auto [b, e] = am::make_packet_range(cbs);
+        BOOST_TEST(std::equal(b, e, std::begin(expected)));
+    }
+
+    BOOST_CHECK_THROW(p.set_packet_id(0), am::system_error);
+
+    auto p0 = am::v5::publish_packet{
+        "topic1",
+        "payload1",
+        am::qos::at_most_once
+    };
+    BOOST_CHECK_THROW(p0.set_packet_id(1), am::system_error);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
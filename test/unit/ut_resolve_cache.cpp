@@ -0,0 +1,178 @@
+// Copyright Takatoshi Kondo 2024
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "../common/test_main.hpp"
+#include "../common/global_fixture.hpp"
+
+#include <async_mqtt/asio_bind/resolve_cache.hpp>
+
+BOOST_AUTO_TEST_SUITE(ut_resolve_cache)
+
+namespace am = async_mqtt;
+namespace as = boost::asio;
+using namespace std::literals::chrono_literals;
+
+namespace {
+
+am::resolve_cache::endpoints_type make_eps(unsigned short port) {
+    return {
+        as::ip::tcp::endpoint{as::ip::make_address("::1"), port},
+        as::ip::tcp::endpoint{as::ip::make_address("127.0.0.1"), port}
+    };
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(store_lookup) {
+    am::resolve_cache c{10s};
+    auto now = am::resolve_cache::clock_type::now();
+    BOOST_TEST(!c.lookup("localhost", "1883", now));
+    c.store("localhost", "1883", make_eps(1883), now);
+    BOOST_TEST(c.size() == 1);
+    auto eps = c.lookup("localhost", "1883", now);
+    BOOST_REQUIRE(eps);
+    BOOST_TEST((*eps == make_eps(1883)));
+    BOOST_TEST(!c.lookup("localhost", "8883", now));
+    BOOST_TEST(!c.lookup("example.com", "1883", now));
+}
+
+BOOST_AUTO_TEST_CASE(expire) {
+    am::resolve_cache c{10s};
+    auto now = am::resolve_cache::clock_type::now();
+    c.store("localhost", "1883", make_eps(1883), now);
+    BOOST_TEST(c.lookup("localhost", "1883", now + 9s).has_value());
+    BOOST_TEST(!c.lookup("localhost", "1883", now + 10s));
+    // expired entry is erased by lookup
+    BOOST_TEST(c.size() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(ttl_zero) {
+    am::resolve_cache c{0s};
+    auto now = am::resolve_cache::clock_type::now();
+    c.store("localhost", "1883", make_eps(1883), now);
+    BOOST_TEST(c.size() == 0);
+    BOOST_TEST(!c.lookup("localhost", "1883", now));
+
+    c.set_ttl(10s);
+    c.store("localhost", "1883", make_eps(1883), now);
+    BOOST_TEST(c.lookup("localhost", "1883", now).has_value());
+}
+
+BOOST_AUTO_TEST_CASE(empty_endpoints) {
+    am::resolve_cache c{10s};
+    c.store("localhost", "1883", {});
+    BOOST_TEST(c.size() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(erase_clear) {
+    am::resolve_cache c{10s};
+    auto now = am::resolve_cache::clock_type::now();
+    c.store("localhost", "1883", make_eps(1883), now);
+    c.store("localhost", "8883", make_eps(8883), now);
+    c.erase("localhost", "1883");
+    BOOST_TEST(!c.lookup("localhost", "1883", now));
+    BOOST_TEST(c.lookup("localhost", "8883", now).has_value());
+    c.clear();
+    BOOST_TEST(c.size() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(max_entries) {
+    am::resolve_cache c{10s, 2};
+    auto now = am::resolve_cache::clock_type::now();
+    c.store("a", "1883", make_eps(1883), now);
+    c.store("b", "1883", make_eps(1883), now + 5s);
+    // a is expired, so only a is evicted
+    c.store("c", "1883", make_eps(1883), now + 10s);
+    BOOST_TEST(c.size() == 2);
+    BOOST_TEST(c.lookup("b", "1883", now + 10s).has_value());
+    BOOST_TEST(c.lookup("c", "1883", now + 10s).has_value());
+
+    // no expired entry, one entry is evicted
+    c.store("d", "1883", make_eps(1883), now + 11s);
+    BOOST_TEST(c.size() == 2);
+    BOOST_TEST(c.lookup("d", "1883", now + 11s).has_value());
+
+    // overwriting doesn't exceed the limit
+    c.store("d", "1883", make_eps(8883), now + 11s);
+    BOOST_TEST(c.size() == 2);
+    BOOST_TEST((*c.lookup("d", "1883", now + 11s) == make_eps(8883)));
+}
+
+BOOST_AUTO_TEST_CASE(join_complete) {
+    am::resolve_cache c{10s};
+    auto now = am::resolve_cache::clock_type::now();
+    std::vector<std::size_t> sizes;
+    auto waiter =
+        [&](am::error_code const& ec, am::resolve_cache::endpoints_type const& eps) {
+            BOOST_TEST(!ec);
+            sizes.push_back(eps.size());
+        };
+    // the first caller resolves, and the others wait for it
+    BOOST_TEST(!c.join("localhost", "1883", waiter));
+    BOOST_TEST(c.join("localhost", "1883", waiter));
+    BOOST_TEST(c.join("localhost", "1883", waiter));
+    // the other host:port is resolved separately
+    BOOST_TEST(!c.join("localhost", "8883", waiter));
+
+    c.complete("localhost", "1883", am::error_code{}, make_eps(1883), now);
+    BOOST_TEST((sizes == std::vector<std::size_t>{2, 2}));
+    BOOST_TEST(c.lookup("localhost", "1883", now).has_value());
+
+    // no resolution is in progress
+    BOOST_TEST(!c.join("localhost", "1883", waiter));
+}
+
+BOOST_AUTO_TEST_CASE(join_error) {
+    am::resolve_cache c{10s};
+    auto now = am::resolve_cache::clock_type::now();
+    std::vector<am::error_code> ecs;
+    auto waiter =
+        [&](am::error_code const& ec, am::resolve_cache::endpoints_type const& eps) {
+            BOOST_TEST(eps.empty());
+            ecs.push_back(ec);
+        };
+    BOOST_TEST(!c.join("localhost", "1883", waiter));
+    BOOST_TEST(c.join("localhost", "1883", waiter));
+    c.complete("localhost", "1883", make_error_code(as::error::host_not_found), {}, now);
+    BOOST_REQUIRE(ecs.size() == 1);
+    BOOST_TEST(ecs.front() == as::error::host_not_found);
+    // failure is not cached
+    BOOST_TEST(!c.lookup("localhost", "1883", now));
+}
+
+BOOST_AUTO_TEST_CASE(pending_guard) {
+    am::resolve_cache c{10s};
+    auto now = am::resolve_cache::clock_type::now();
+    std::vector<am::error_code> ecs;
+    auto waiter =
+        [&](am::error_code const& ec, am::resolve_cache::endpoints_type const&) {
+            ecs.push_back(ec);
+        };
+    {
+        BOOST_TEST(!c.join("localhost", "1883", waiter));
+        am::resolve_cache::pending_guard g{c, "localhost", "1883"};
+        BOOST_TEST(c.join("localhost", "1883", waiter));
+        // the resolver is destroyed without complete()
+    }
+    BOOST_REQUIRE(ecs.size() == 1);
+    BOOST_TEST(ecs.front() == as::error::operation_aborted);
+    BOOST_TEST(!c.lookup("localhost", "1883", now));
+
+    // the next caller resolves
+    ecs.clear();
+    BOOST_TEST(!c.join("localhost", "1883", waiter));
+    {
+        am::resolve_cache::pending_guard g{c, "localhost", "1883"};
+        BOOST_TEST(c.join("localhost", "1883", waiter));
+        g.complete(am::error_code{}, make_eps(1883));
+    }
+    // completed only once
+    BOOST_REQUIRE(ecs.size() == 1);
+    BOOST_TEST(!ecs.front());
+    BOOST_TEST(c.lookup("localhost", "1883").has_value());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -6,6 +6,8 @@
 #include "../common/test_main.hpp"
 #include "../common/global_fixture.hpp"
 
+#include <set>
+
 #include <broker/subscription_map.hpp>
 
 BOOST_AUTO_TEST_SUITE(ut_subscription_map)
@@ -287,6 +289,30 @@ BOOST_AUTO_TEST_CASE( test_multiple_subscription_modify ) {
     });
 }
 
+BOOST_AUTO_TEST_CASE( test_multiple_subscription_erase_if ) {
+    am::multiple_subscription_map<std::string, int> map;
+    auto h1 = map.insert_or_assign("a/b/c", "123", 1).first;
+    map.insert_or_assign("a/b/c", "456", 2);
+    auto h2 = map.insert_or_assign("a/b", "123", 3).first;
+    BOOST_TEST(map.size() == 3);
+
+    // condition doesn't match
+    BOOST_TEST(map.erase_if(h1, "123", [](int v) { return v == 2; }) == 0);
+    BOOST_TEST(map.size() == 3);
+    // key doesn't exist
+    BOOST_TEST(map.erase_if(h1, "789", [](int) { return true; }) == 0);
+
+    BOOST_TEST(map.erase_if(h1, "123", [](int v) { return v == 1; }) == 1);
+    BOOST_TEST(map.size() == 2);
+    BOOST_TEST(map.erase(h1, "456") == 1);
+
+    // the handle has been removed
+    BOOST_TEST(map.erase_if(h1, "456", [](int) { return true; }) == 0);
+    BOOST_TEST(map.erase_if(h2, "123", [](int) { return true; }) == 1);
+    BOOST_TEST(map.size() == 0);
+    BOOST_TEST(map.internal_size() == 1);
+}
+
 BOOST_AUTO_TEST_CASE( test_move_only ) {
 
     struct my {
@@ -305,4 +331,38 @@ BOOST_AUTO_TEST_CASE( test_move_only ) {
     map.insert_or_assign("a/b/c", "456", my(2));
 }
 
+BOOST_AUTO_TEST_CASE( test_for_each_topic_filter ) {
+    using mi_t = am::multiple_subscription_map<std::string, int>;
+    mi_t map;
+    auto g0 = map.generation();
+    map.insert_or_assign("a/b/c", "123", 1);
+    map.insert_or_assign("a/b/c", "456", 2);
+    map.insert_or_assign("a/#", "123", 3);
+    map.insert_or_assign("+/b", "123", 4);
+    auto g1 = map.generation();
+    BOOST_TEST(g1 != g0);
+
+    std::set<std::string> filters;
+    map.for_each_topic_filter(
+        [&](std::string topic_filter) {
+            filters.insert(std::move(topic_filter));
+        }
+    );
+    BOOST_TEST((filters == std::set<std::string>{"a/b/c", "a/#", "+/b"}));
+
+    // update doesn't change the generation
+    map.insert_or_assign("a/b/c", "123", 5);
+    BOOST_TEST(map.generation() == g1);
+
+    map.erase("+/b", "123");
+    BOOST_TEST(map.generation() != g1);
+    filters.clear();
+    map.for_each_topic_filter(
+        [&](std::string topic_filter) {
+            filters.insert(std::move(topic_filter));
+        }
+    );
+    BOOST_TEST((filters == std::set<std::string>{"a/b/c", "a/#"}));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,236 @@
+// Copyright Takatoshi Kondo 2024
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "../common/test_main.hpp"
+#include "../common/global_fixture.hpp"
+
+#include <boost/asio.hpp>
+
+#include <async_mqtt/asio_bind/predefined_layer/customized_basic_stream.hpp>
+
+BOOST_AUTO_TEST_SUITE(ut_tcp_handshake)
+
+namespace am = async_mqtt;
+namespace as = boost::asio;
+
+using layer = am::layer_customize<as::ip::tcp::socket>;
+
+namespace {
+
+// The host is resolved by the cache, so the connection attempt is started by the first
+// handler of io_context.
+std::string cache_listener(as::ip::tcp::acceptor const& ac, std::string const& host) {
+    auto port = std::to_string(ac.local_endpoint().port());
+    am::resolve_cache::global().store(host, port, {ac.local_endpoint()});
+    return port;
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(connect) {
+    as::io_context ioc;
+    as::ip::tcp::acceptor ac{ioc, as::ip::tcp::endpoint{as::ip::make_address("127.0.0.1"), 0}};
+    auto port = cache_listener(ac, "connect.test");
+    as::ip::tcp::socket s{ioc};
+    std::optional<am::error_code> result;
+    layer::async_handshake(
+        s,
+        "connect.test",
+        port,
+        [&](am::error_code const& ec) {
+            result.emplace(ec);
+        }
+    );
+    ioc.run();
+    BOOST_REQUIRE(result);
+    BOOST_TEST(!*result);
+    BOOST_TEST(s.is_open());
+}
+
+BOOST_AUTO_TEST_CASE(close_cancels_connect) {
+    as::io_context ioc;
+    as::ip::tcp::acceptor ac{ioc, as::ip::tcp::endpoint{as::ip::make_address("127.0.0.1"), 0}};
+    auto port = cache_listener(ac, "close.test");
+    as::ip::tcp::socket s{ioc};
+    std::optional<am::error_code> result;
+    layer::async_handshake(
+        s,
+        "close.test",
+        port,
+        [&](am::error_code const& ec) {
+            result.emplace(ec);
+        }
+    );
+    // the connection attempt is started
+    ioc.run_one();
+    BOOST_TEST(!result);
+    layer::async_close(s, [](am::error_code const&) {});
+    ioc.run();
+    BOOST_REQUIRE(result);
+    BOOST_TEST(*result == as::error::operation_aborted);
+    // the connected socket is not moved to the closed stream
+    BOOST_TEST(!s.is_open());
+}
+
+BOOST_AUTO_TEST_CASE(close_cancels_resolve) {
+    as::io_context ioc;
+    as::ip::tcp::acceptor ac{ioc, as::ip::tcp::endpoint{as::ip::make_address("127.0.0.1"), 0}};
+    auto port = std::to_string(ac.local_endpoint().port());
+    as::ip::tcp::socket s{ioc};
+    std::optional<am::error_code> result;
+    layer::async_handshake(
+        s,
+        "localhost",
+        port,
+        [&](am::error_code const& ec) {
+            result.emplace(ec);
+        }
+    );
+    // the resolution is started
+    ioc.run_one();
+    BOOST_TEST(!result);
+    layer::async_close(s, [](am::error_code const&) {});
+    ioc.run();
+    BOOST_REQUIRE(result);
+    BOOST_TEST(*result == as::error::operation_aborted);
+    BOOST_TEST(!s.is_open());
+}
+
+BOOST_AUTO_TEST_CASE(close_cancels_join) {
+    as::io_context ioc;
+    auto& cache = am::resolve_cache::global();
+    // the other resolution of the host is in progress
+    BOOST_TEST(!cache.join("join.test", "1883", [](am::error_code const&, auto const&) {}));
+    am::resolve_cache::pending_guard g{cache, "join.test", "1883"};
+    as::ip::tcp::socket s{ioc};
+    std::optional<am::error_code> result;
+    layer::async_handshake(
+        s,
+        "join.test",
+        "1883",
+        [&](am::error_code const& ec) {
+            result.emplace(ec);
+        }
+    );
+    // joined the resolution in progress
+    ioc.run_one();
+    BOOST_TEST(!result);
+    layer::async_close(s, [](am::error_code const&) {});
+    ioc.run();
+    BOOST_REQUIRE(result);
+    BOOST_TEST(*result == as::error::operation_aborted);
+    BOOST_TEST(!s.is_open());
+}
+
+BOOST_AUTO_TEST_CASE(join_timeout) {
+    as::io_context ioc;
+    as::ip::tcp::acceptor ac{ioc, as::ip::tcp::endpoint{as::ip::make_address("127.0.0.1"), 0}};
+    auto port = std::to_string(ac.local_endpoint().port());
+    auto& cache = am::resolve_cache::global();
+    // the other resolution never finishes
+    BOOST_TEST(!cache.join("localhost", port, [](am::error_code const&, auto const&) {}));
+    am::resolve_cache::pending_guard g{cache, "localhost", port};
+    auto timeout = cache.join_timeout();
+    cache.set_join_timeout(std::chrono::milliseconds{10});
+    as::ip::tcp::socket s{ioc};
+    std::optional<am::error_code> result;
+    layer::async_handshake(
+        s,
+        "localhost",
+        port,
+        [&](am::error_code const& ec) {
+            result.emplace(ec);
+        }
+    );
+    ioc.run();
+    cache.set_join_timeout(timeout);
+    BOOST_REQUIRE(result);
+    BOOST_TEST(!*result);
+    BOOST_TEST(s.is_open());
+}
+
+BOOST_AUTO_TEST_CASE(resolver_destroyed) {
+    as::io_context ioc;
+    as::ip::tcp::acceptor ac{ioc, as::ip::tcp::endpoint{as::ip::make_address("127.0.0.1"), 0}};
+    auto port = std::to_string(ac.local_endpoint().port());
+    {
+        as::io_context ioc_stopped;
+        as::ip::tcp::socket s{ioc_stopped};
+        layer::async_handshake(s, "localhost", port, [](am::error_code const&) {});
+        // the resolution is started, and the io_context is destroyed before it finishes
+        ioc_stopped.run_one();
+    }
+    // the handshake doesn't wait for the destroyed resolution
+    as::ip::tcp::socket s{ioc};
+    std::optional<am::error_code> result;
+    layer::async_handshake(
+        s,
+        "localhost",
+        port,
+        [&](am::error_code const& ec) {
+            result.emplace(ec);
+        }
+    );
+    ioc.run();
+    BOOST_REQUIRE(result);
+    BOOST_TEST(!*result);
+    BOOST_TEST(s.is_open());
+}
+
+BOOST_AUTO_TEST_CASE(connect_failure_keeps_cache) {
+    as::io_context ioc;
+    std::string port;
+    {
+        // nobody listens on the port
+        as::ip::tcp::acceptor ac{ioc, as::ip::tcp::endpoint{as::ip::make_address("127.0.0.1"), 0}};
+        port = cache_listener(ac, "refused.test");
+    }
+    as::ip::tcp::socket s{ioc};
+    std::optional<am::error_code> result;
+    layer::async_handshake(
+        s,
+        "refused.test",
+        port,
+        [&](am::error_code const& ec) {
+            result.emplace(ec);
+        }
+    );
+    ioc.run();
+    BOOST_REQUIRE(result);
+    BOOST_TEST(*result);
+    // the retry doesn't resolve the host again
+    BOOST_TEST(am::resolve_cache::global().lookup("refused.test", port).has_value());
+}
+
+BOOST_AUTO_TEST_CASE(cancellation_slot) {
+    as::io_context ioc;
+    as::ip::tcp::acceptor ac{ioc, as::ip::tcp::endpoint{as::ip::make_address("127.0.0.1"), 0}};
+    auto port = cache_listener(ac, "cancel.test");
+    as::ip::tcp::socket s{ioc};
+    as::cancellation_signal sig;
+    std::optional<am::error_code> result;
+    layer::async_handshake(
+        s,
+        "cancel.test",
+        port,
+        as::bind_cancellation_slot(
+            sig.slot(),
+            [&](am::error_code const& ec) {
+                result.emplace(ec);
+            }
+        )
+    );
+    // the connection attempt is started
+    ioc.run_one();
+    BOOST_TEST(!result);
+    sig.emit(as::cancellation_type::terminal);
+    ioc.run();
+    BOOST_REQUIRE(result);
+    BOOST_TEST(*result == as::error::operation_aborted);
+    BOOST_TEST(!s.is_open());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
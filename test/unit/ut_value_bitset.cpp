@@ -0,0 +1,92 @@
+// Copyright Takatoshi Kondo 2024
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "../common/test_main.hpp"
+#include "../common/global_fixture.hpp"
+
+#include <cstdint>
+#include <set>
+#include <type_traits>
+#include <vector>
+
+#include <async_mqtt/protocol/rv_connection.hpp>
+#include <async_mqtt/util/value_bitset.hpp>
+
+BOOST_AUTO_TEST_SUITE(ut_value_bitset)
+
+namespace am = async_mqtt;
+
+BOOST_AUTO_TEST_CASE(insert_erase) {
+    am::value_bitset<std::uint16_t> s;
+    BOOST_TEST(s.empty());
+    BOOST_TEST(s.insert(1));
+    BOOST_TEST(!s.insert(1));
+    BOOST_TEST(s.insert(65535));
+    BOOST_TEST(s.size() == 2);
+    BOOST_TEST(s.contains(1));
+    BOOST_TEST(s.contains(65535));
+    BOOST_TEST(!s.contains(2));
+
+    BOOST_TEST(!s.erase(2));
+    BOOST_TEST(s.erase(1));
+    BOOST_TEST(!s.erase(1));
+    BOOST_TEST(!s.contains(1));
+    BOOST_TEST(s.size() == 1);
+
+    s.clear();
+    BOOST_TEST(s.empty());
+    BOOST_TEST(!s.contains(65535));
+}
+
+BOOST_AUTO_TEST_CASE(iterate) {
+    std::set<std::uint32_t> expected {0, 1, 63, 64, 1023, 1024, 5000, 70000, 0xffffffff};
+    am::value_bitset<std::uint32_t> s{expected.begin(), expected.end()};
+    BOOST_TEST(s.size() == expected.size());
+    std::vector<std::uint32_t> values(s.begin(), s.end());
+    BOOST_TEST(values == std::vector<std::uint32_t>(expected.begin(), expected.end()));
+
+    am::value_bitset<std::uint32_t> e;
+    BOOST_TEST((e.begin() == e.end()));
+}
+
+BOOST_AUTO_TEST_CASE(compare) {
+    am::value_bitset<std::uint16_t> s1;
+    am::value_bitset<std::uint16_t> s2;
+    s1.insert(10);
+    s1.insert(2000);
+    s2.insert(2000);
+    BOOST_TEST((s1 != s2));
+    s2.insert(10);
+    BOOST_TEST((s1 == s2));
+
+    // a page is removed when it becomes empty
+    s1.insert(3000);
+    s1.erase(3000);
+    BOOST_TEST((s1 == s2));
+
+    auto s3 = s1;
+    BOOST_TEST((s3 == s1));
+    s3.erase(10);
+    BOOST_TEST(s1.contains(10));
+}
+
+BOOST_AUTO_TEST_CASE(restore_handled_pids) {
+    // the range constructor accepts only iterators, so braced lists of packet ids
+    // select the std::set overload
+    static_assert(!std::is_constructible_v<am::value_bitset<std::uint16_t>, int, int>);
+    am::rv_connection<am::role::server> c{am::protocol_version::v5};
+    c.restore_qos2_publish_handled_pids({1, 2});
+    BOOST_TEST((c.get_qos2_publish_handled_pids() == std::set<std::uint16_t>{1, 2}));
+    c.restore_qos2_publish_handled_pids({});
+    BOOST_TEST(c.get_qos2_publish_handled_pids().empty());
+
+    auto pids = am::basic_packet_id_bitset<2>{};
+    pids.insert(3);
+    c.restore_qos2_publish_handled_pid_bitset(pids);
+    BOOST_TEST((c.get_qos2_publish_handled_pid_bitset() == pids));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
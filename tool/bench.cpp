@@ -5,6 +5,7 @@
 // http://www.boost.org/LICENSE_1_0.txt)
 
 #include <thread>
+#include <ctime>
 #include <fstream>
 #include <iostream>
 
@@ -52,6 +53,7 @@ enum class mode {
 
 enum class ev_type {
     recv_packet,
+    recv_batch,
     sent_result,
     acquire_result,
     other
@@ -111,7 +113,8 @@ struct bench_context {
         bool close_after_report,
         std::optional<bool> tcp_no_delay_opt,
         std::optional<std::size_t> send_buf_size_opt,
-        std::optional<std::size_t> recv_buf_size_opt
+        std::optional<std::size_t> recv_buf_size_opt,
+        std::size_t recv_batch
     )
     :ws_path{ws_path},
      version{version},
@@ -160,7 +163,8 @@ struct bench_context {
      close_after_report{close_after_report},
      tcp_no_delay_opt{tcp_no_delay_opt},
      send_buf_size_opt{send_buf_size_opt},
-     recv_buf_size_opt{recv_buf_size_opt}
+     recv_buf_size_opt{recv_buf_size_opt},
+     recv_batch{recv_batch}
     {
     }
 
@@ -216,6 +220,10 @@ struct bench_context {
     std::optional<bool> tcp_no_delay_opt;
     std::optional<std::size_t> send_buf_size_opt;
     std::optional<std::size_t> recv_buf_size_opt;
+    // max number of publish packets received at once. 0 means one by one.
+    std::size_t recv_batch;
+    // process CPU time at the start of the measured publish
+    std::clock_t cpu_publish = 0;
 };
 
 template <typename ClientInfo>
@@ -247,6 +255,28 @@ struct bench {
     }
 
 private:
+    void start_recv(ClientInfo* pci) {
+        if (bc_.recv_batch == 0) {
+            pci->c.async_recv(
+                as::append(
+                    *this,
+                    pci
+                )
+            );
+        }
+        else {
+            pci->c.async_recv_batch(
+                pci->recv_packets,
+                bc_.recv_batch,
+                as::append(
+                    *this,
+                    pci,
+                    ev_type::recv_batch
+                )
+            );
+        }
+    }
+
     void proc(
         boost::system::error_code ec,
         std::optional<am::packet_variant> pv_opt,
@@ -661,6 +691,7 @@ private:
                     else {
                         bc_.ph.store(phase::publish);
                         bc_.tp_publish = std::chrono::steady_clock::now();
+                        bc_.cpu_publish = std::clock();
                     }
                 }
             }
@@ -681,12 +712,7 @@ private:
                     }
                     if (bc_.md == mode::single || bc_.md == mode::recv) {
                         // pub recv
-                        ci.c.async_recv(
-                            as::append(
-                                *this,
-                                &ci
-                            )
-                        );
+                        start_recv(&ci);
                     }
                 }
             }
@@ -744,150 +770,169 @@ private:
                     locked_cout() << "publish send error:" << ec.message() << std::endl;
                     exit(-1);
                 }
-                else if (evt == ev_type::recv_packet) {
+                else if (evt == ev_type::recv_packet || evt == ev_type::recv_batch) {
                     // pub received
-                    BOOST_ASSERT(pv_opt);
-                    pub_recv ret = pub_recv::cont;
-                    pv_opt->visit(
-                        am::overload {
-                            [&](am::v5::publish_packet const& p) {
-                                ret = recv_publish(
-                                    *pci,
-                                    p.packet_id(),
-                                    p.opts(),
-                                    p.topic(),
-                                    p.payload(),
-                                    p.props()
-                                );
-                            },
-                            [&](am::v3_1_1::publish_packet const& p) {
-                                ret = recv_publish(
-                                    *pci,
-                                    p.packet_id(),
-                                    p.opts(),
-                                    p.topic(),
-                                    p.payload(),
-                                    am::properties{}
+                    // returns false if the bench is finished
+                    auto recv_one =
+                        [&](am::packet_variant const& pv) -> bool {
+                        pub_recv ret = pub_recv::cont;
+                        pv.visit(
+                            am::overload {
+                                [&](am::v5::publish_packet const& p) {
+                                    ret = recv_publish(
+                                        *pci,
+                                        p.packet_id(),
+                                        p.opts(),
+                                        p.topic(),
+                                        p.payload(),
+                                        p.props()
+                                    );
+                                },
+                                [&](am::v3_1_1::publish_packet const& p) {
+                                    ret = recv_publish(
+                                        *pci,
+                                        p.packet_id(),
+                                        p.opts(),
+                                        p.topic(),
+                                        p.payload(),
+                                        am::properties{}
+                                    );
+                                },
+                                [&](auto const&) {
+                                    // puback, pubrec, pubcomp
+                                }
+                            }
+                        );
+                        switch (ret) {
+                        case pub_recv::cont:
+                            // pub recv
+                            break;
+                        case pub_recv::idle_finish:
+                            if (bc_.md == mode::single) {
+                                bc_.ph.store(phase::pub_after_idle_delay);
+                                bc_.tp_pub_after_idle_delay = std::chrono::steady_clock::now();
+                                locked_cout() << "Publish (measure) delay" << std::endl;
+                                bc_.tim_delay.expires_after(std::chrono::milliseconds(bc_.pub_after_idle_delay_ms));
+                                bc_.tim_delay.async_wait(
+                                    as::append(
+                                        *this,
+                                        pci
+                                    )
                                 );
-                            },
-                            [&](auto const&) {
-                                // puback, pubrec, pubcomp
                             }
-                        }
-                    );
-                    switch (ret) {
-                    case pub_recv::cont:
-                        // pub recv
-                        break;
-                    case pub_recv::idle_finish:
-                        if (bc_.md == mode::single) {
-                            bc_.ph.store(phase::pub_after_idle_delay);
-                            bc_.tp_pub_after_idle_delay = std::chrono::steady_clock::now();
-                            locked_cout() << "Publish (measure) delay" << std::endl;
-                            bc_.tim_delay.expires_after(std::chrono::milliseconds(bc_.pub_after_idle_delay_ms));
-                            bc_.tim_delay.async_wait(
-                                as::append(
-                                    *this,
-                                    pci
-                                )
-                            );
-                        }
-                        break;
-                    case pub_recv::pub_finish: {
-                        locked_cout() << "Report" << std::endl;
-                        std::size_t maxmax = 0;
-                        std::string maxmax_cid;
-                        std::size_t maxmid = 0;
-                        std::string maxmid_cid;
-                        std::size_t maxavg = 0;
-                        std::string maxavg_cid;
-                        std::size_t maxmin = 0;
-                        std::string maxmin_cid;
-
-                        if (!bc_.all_rtt_store_file.empty()) {
-                            locked_cout() << "storing all RTT to " << bc_.all_rtt_store_file << std::endl;
-                            std::ofstream ofs{bc_.all_rtt_store_file};
-                            for (auto& ci : cis_) {
-                                for (auto rtt : ci.rtt_us) {
-                                    ofs << rtt << "\n";
+                            break;
+                        case pub_recv::pub_finish: {
+                            locked_cout() << "Report" << std::endl;
+                            std::size_t maxmax = 0;
+                            std::string maxmax_cid;
+                            std::size_t maxmid = 0;
+                            std::string maxmid_cid;
+                            std::size_t maxavg = 0;
+                            std::string maxavg_cid;
+                            std::size_t maxmin = 0;
+                            std::string maxmin_cid;
+
+                            if (!bc_.all_rtt_store_file.empty()) {
+                                locked_cout() << "storing all RTT to " << bc_.all_rtt_store_file << std::endl;
+                                std::ofstream ofs{bc_.all_rtt_store_file};
+                                for (auto& ci : cis_) {
+                                    for (auto rtt : ci.rtt_us) {
+                                        ofs << rtt << "\n";
+                                    }
+                                    ofs << "\n";
                                 }
-                                ofs << "\n";
+                                locked_cout() << "store finished" << std::endl;
                             }
-                            locked_cout() << "store finished" << std::endl;
-                        }
 
-                        for (auto& ci : cis_) {
-                            std::sort(ci.rtt_us.begin(), ci.rtt_us.end());
-                            std::string cid = ci.get_client_id();
-                            std::size_t max = ci.rtt_us.back();
-                            std::size_t mid = ci.rtt_us.at(ci.rtt_us.size() / 2);
-                            std::size_t avg = std::accumulate(
-                                ci.rtt_us.begin(),
-                                ci.rtt_us.end(),
-                                std::size_t(0)
-                            ) / ci.rtt_us.size();
-                            std::size_t min = ci.rtt_us.front();
-                            if (maxmax < max) {
-                                maxmax = max;
-                                maxmax_cid = cid;
-                            }
-                            if (maxmid < mid) {
-                                maxmid = mid;
-                                maxmid_cid = cid;
-                            }
-                            if (maxavg < avg) {
-                                maxavg = avg;
-                                maxavg_cid = cid;
-                            }
-                            if (maxmin < min) {
-                                maxmin = min;
-                                maxmin_cid = cid;
+                            for (auto& ci : cis_) {
+                                std::sort(ci.rtt_us.begin(), ci.rtt_us.end());
+                                std::string cid = ci.get_client_id();
+                                std::size_t max = ci.rtt_us.back();
+                                std::size_t mid = ci.rtt_us.at(ci.rtt_us.size() / 2);
+                                std::size_t avg = std::accumulate(
+                                    ci.rtt_us.begin(),
+                                    ci.rtt_us.end(),
+                                    std::size_t(0)
+                                ) / ci.rtt_us.size();
+                                std::size_t min = ci.rtt_us.front();
+                                if (maxmax < max) {
+                                    maxmax = max;
+                                    maxmax_cid = cid;
+                                }
+                                if (maxmid < mid) {
+                                    maxmid = mid;
+                                    maxmid_cid = cid;
+                                }
+                                if (maxavg < avg) {
+                                    maxavg = avg;
+                                    maxavg_cid = cid;
+                                }
+                                if (maxmin < min) {
+                                    maxmin = min;
+                                    maxmin_cid = cid;
+                                }
+                                if (bc_.detail_report) {
+                                    locked_cout()
+                                        << cid << " :"
+                                        << " max:" << boost::format("%+12d") % max << " us | "
+                                        << " mid:" << boost::format("%+12d") % mid << " us | "
+                                        << " avg:" << boost::format("%+12d") % avg << " us | "
+                                        << " min:" << boost::format("%+12d") % min << " us | "
+                                        << std::endl;
+                                }
                             }
-                            if (bc_.detail_report) {
+                            locked_cout()
+                                << "maxmax:" << boost::format("%+12d") % maxmax << " us "
+                                << "(" << boost::format("%+8d") % (maxmax / 1000) << " ms ) "
+                                << "client_id:" << maxmax_cid << std::endl;
+                            locked_cout()
+                                << "maxmid:" << boost::format("%+12d") % maxmid << " us "
+                                << "(" << boost::format("%+8d") % (maxmid / 1000) << " ms ) "
+                                << "client_id:" << maxmid_cid << std::endl;
+                            locked_cout()
+                                << "maxavg:" << boost::format("%+12d") % maxavg << " us "
+                                << "(" << boost::format("%+8d") % (maxavg / 1000) << " ms ) "
+                                << "client_id:" << maxavg_cid << std::endl;
+                            locked_cout()
+                                << "maxmin:" << boost::format("%+12d") % maxmin << " us "
+                                << "(" << boost::format("%+8d") % (maxmin / 1000) << " ms ) "
+                                << "client_id:" << maxmin_cid << std::endl;
+                            {
+                                // CPU time of this process per received message.
+                                // Use it with e.g. `strace -c -f` to compare the write syscalls.
+                                std::size_t msgs = 0;
+                                for (auto const& ci : cis_) msgs += ci.rtt_us.size();
+                                auto cpu_us =
+                                    double(std::clock() - bc_.cpu_publish) * 1000000 / CLOCKS_PER_SEC;
                                 locked_cout()
-                                    << cid << " :"
-                                    << " max:" << boost::format("%+12d") % max << " us | "
-                                    << " mid:" << boost::format("%+12d") % mid << " us | "
-                                    << " avg:" << boost::format("%+12d") % avg << " us | "
-                                    << " min:" << boost::format("%+12d") % min << " us | "
-                                    << std::endl;
+                                    << "cpu   :" << boost::format("%12.3f") % (cpu_us / double(msgs)) << " us/msg "
+                                    << "messages:" << msgs << std::endl;
                             }
-                        }
-                        locked_cout()
-                            << "maxmax:" << boost::format("%+12d") % maxmax << " us "
-                            << "(" << boost::format("%+8d") % (maxmax / 1000) << " ms ) "
-                            << "client_id:" << maxmax_cid << std::endl;
-                        locked_cout()
-                            << "maxmid:" << boost::format("%+12d") % maxmid << " us "
-                            << "(" << boost::format("%+8d") % (maxmid / 1000) << " ms ) "
-                            << "client_id:" << maxmid_cid << std::endl;
-                        locked_cout()
-                            << "maxavg:" << boost::format("%+12d") % maxavg << " us "
-                            << "(" << boost::format("%+8d") % (maxavg / 1000) << " ms ) "
-                            << "client_id:" << maxavg_cid << std::endl;
-                        locked_cout()
-                            << "maxmin:" << boost::format("%+12d") % maxmin << " us "
-                            << "(" << boost::format("%+8d") % (maxmin / 1000) << " ms ) "
-                            << "client_id:" << maxmin_cid << std::endl;
-                        locked_cout() << "Finish" << std::endl;
-                        bc_.tim_progress->cancel();
-                        if (bc_.close_after_report) {
-                            for (auto& ci : cis_) {
-                                ci.c.async_close([]{});
+                            locked_cout() << "Finish" << std::endl;
+                            bc_.tim_progress->cancel();
+                            if (bc_.close_after_report) {
+                                for (auto& ci : cis_) {
+                                    ci.c.async_close([]{});
+                                }
+                                for (auto& guard_ioc : bc_.guard_iocs) guard_ioc.reset();
+                                bc_.guard_ioc_timer.reset();
                             }
-                            for (auto& guard_ioc : bc_.guard_iocs) guard_ioc.reset();
-                            bc_.guard_ioc_timer.reset();
+                            return false;
+                        } break;
+                        }
+                        return true;
+                        };
+                    if (evt == ev_type::recv_batch) {
+                        for (auto const& pv : pci->recv_packets) {
+                            if (!recv_one(pv)) return;
                         }
-                        return;
-                    } break;
+                    }
+                    else {
+                        BOOST_ASSERT(pv_opt);
+                        if (!recv_one(*pv_opt)) return;
                     }
                     if (pci->recv_times != 0) {
-                        pci->c.async_recv(
-                            as::append(
-                                *this,
-                                pci
-                            )
-                        );
+                        start_recv(pci);
                     }
                 }
                 else if (evt == ev_type::acquire_result) {
@@ -1012,6 +1057,7 @@ private:
                         case phase::pub_after_idle_delay: {
                             bc_.ph.store(phase::publish);
                             bc_.tp_publish = std::chrono::steady_clock::now();
+                            bc_.cpu_publish = std::clock();
                             locked_cout() << "Publish (measure)" << std::endl;
                             std::size_t index = 0;
                             for (auto& ci : cis_) {
@@ -1282,6 +1328,16 @@ int main(int argc, char *argv[]) {
                 boost::program_options::value<bool>()->default_value(false),
                 "Set bulk write mode for all connections"
             )
+            (
+                "write_coalesce_threshold",
+                boost::program_options::value<std::size_t>()->default_value(0),
+                "Copy packets whose size is less than or equal to this value into a contiguous write buffer. 0 means disabled"
+            )
+            (
+                "recv_batch",
+                boost::program_options::value<std::size_t>()->default_value(0),
+                "Receive up to this number of already arrived publish packets at once. 0 means one by one"
+            )
             (
                 "clients",
                 boost::program_options::value<std::size_t>()->default_value(1),
@@ -1858,6 +1914,7 @@ int main(int argc, char *argv[]) {
             std::size_t recv_idle_count;
             std::vector<std::chrono::steady_clock::time_point> sent;
             std::vector<std::size_t> rtt_us;
+            std::vector<am::packet_variant> recv_packets;
             std::shared_ptr<as::steady_timer> tim;
             std::string host;
             std::string port;
@@ -2065,7 +2122,8 @@ int main(int argc, char *argv[]) {
             vm["close_after_report"].as<bool>(),
             tcp_no_delay_opt,
             send_buf_size_opt,
-            recv_buf_size_opt
+            recv_buf_size_opt,
+            vm["recv_batch"].as<std::size_t>()
         );
 
         if (protocol == "mqtt") {
@@ -2114,6 +2172,7 @@ int main(int argc, char *argv[]) {
                     std::to_string(hps[hps_index].port)
                 );
                 cis.back().c.set_bulk_write(vm["bulk_write"].as<bool>());
+                cis.back().c.set_write_coalesce_threshold(vm["write_coalesce_threshold"].as<std::size_t>());
                 ++hps_index;
                 if (hps_index == hps.size()) hps_index = 0;
             }
@@ -2180,6 +2239,7 @@ int main(int argc, char *argv[]) {
                     std::to_string(hps[hps_index].port)
                 );
                 cis.back().c.set_bulk_write(vm["bulk_write"].as<bool>());
+                cis.back().c.set_write_coalesce_threshold(vm["write_coalesce_threshold"].as<std::size_t>());
                 ++hps_index;
                 if (hps_index == hps.size()) hps_index = 0;
             }
@@ -2242,6 +2302,7 @@ int main(int argc, char *argv[]) {
                     std::to_string(hps[hps_index].port)
                 );
                 cis.back().c.set_bulk_write(vm["bulk_write"].as<bool>());
+                cis.back().c.set_write_coalesce_threshold(vm["write_coalesce_threshold"].as<std::size_t>());
                 ++hps_index;
                 if (hps_index == hps.size()) hps_index = 0;
             }
@@ -2313,6 +2374,7 @@ int main(int argc, char *argv[]) {
                     std::to_string(hps[hps_index].port)
                 );
                 cis.back().c.set_bulk_write(vm["bulk_write"].as<bool>());
+                cis.back().c.set_write_coalesce_threshold(vm["write_coalesce_threshold"].as<std::size_t>());
                 ++hps_index;
                 if (hps_index == hps.size()) hps_index = 0;
             }
@@ -9,6 +9,7 @@
 #include <iomanip>
 #include <algorithm>
 #include <thread>
+#include <chrono>
 #include <stdexcept>
 
 #include <boost/program_options.hpp>
@@ -266,6 +267,24 @@ void run_broker(boost::program_options::variables_map const& vm) {
             epv_type
         > brk{timer_ioc.get_executor(), vm["recycling_allocator"].as<bool>()};
 
+        {
+            am::offline_queue_config config;
+            config.max_messages = vm["offline_max_messages"].as<std::size_t>();
+            config.max_bytes = vm["offline_max_bytes"].as<std::size_t>();
+            auto policy = vm["offline_overflow_policy"].as<std::string>();
+            if (policy == "drop_newest") {
+                config.overflow_policy = am::offline_overflow_policy::drop_newest;
+            }
+            else if (policy != "drop_oldest") {
+                ASYNC_MQTT_LOG("mqtt_broker", warning)
+                    << "invalid offline_overflow_policy:" << policy << " drop_oldest is used";
+            }
+            config.spill_threshold = vm["offline_spill_threshold"].as<std::size_t>();
+            config.spill_dir = vm["offline_spill_dir"].as<std::string>();
+            config.replay_batch_size = vm["offline_replay_batch_size"].as<std::size_t>();
+            brk.set_offline_queue_config(am::force_move(config));
+        }
+
         auto set_auth =
             [&] {
                 if (vm.count("auth_file")) {
@@ -277,9 +296,23 @@ void run_broker(boost::program_options::variables_map const& vm) {
                         std::ifstream input(auth_file);
 
                         if (input) {
+                            auto start = std::chrono::steady_clock::now();
                             am::security security;
                             security.load_json(input);
+                            auto loaded = std::chrono::steady_clock::now();
                             brk.set_security(am::force_move(security));
+                            auto m = brk.get_security_reload_metrics();
+                            auto to_us =
+                                [](auto d) {
+                                    return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+                                };
+                            ASYNC_MQTT_LOG("mqtt_broker", info)
+                                << "auth_file loaded."
+                                << " load:" << to_us(loaded - start) << "us"
+                                << " reload:" << to_us(m.last_reload_duration) << "us"
+                                << " blocking:" << to_us(m.last_blocking_duration) << "us"
+                                << " max_blocking:" << to_us(m.max_blocking_duration) << "us"
+                                << " changed_users:" << m.last_changed_users;
                         }
                         else {
                             ASYNC_MQTT_LOG("mqtt_broker", warning)
@@ -292,6 +325,39 @@ void run_broker(boost::program_options::variables_map const& vm) {
             };
         set_auth();
 
+        if (vm.count("cluster.node_id")) {
+            auto node_id = vm["cluster.node_id"].as<std::string>();
+            ASYNC_MQTT_LOG("mqtt_broker", info)
+                << "cluster node_id:" << node_id;
+            auto secret =
+                [&] () -> std::string {
+                    if (vm.count("cluster.secret")) return vm["cluster.secret"].as<std::string>();
+                    return {};
+                } ();
+            if (secret.empty()) {
+                throw std::runtime_error("cluster.secret is required in cluster mode");
+            }
+            auto cl = brk.enable_cluster(
+                am::force_move(node_id),
+                am::force_move(secret),
+                vm["cluster.max_pending"].as<std::size_t>()
+            );
+            if (vm.count("cluster.port")) {
+                cl->listen(as::ip::tcp::endpoint{as::ip::tcp::v4(), vm["cluster.port"].as<std::uint16_t>()});
+            }
+            if (vm.count("cluster.peer")) {
+                for (auto const& peer : vm["cluster.peer"].as<std::vector<std::string>>()) {
+                    auto hp = am::host_port_from_string(peer);
+                    if (!hp) {
+                        ASYNC_MQTT_LOG("mqtt_broker", error)
+                            << "invalid cluster peer:" << peer;
+                        continue;
+                    }
+                    cl->connect(am::force_move(*hp));
+                }
+            }
+        }
+
         if (vm.count("tcp.port")) {
             mqtt_endpoint.emplace(as::ip::tcp::v4(), vm["tcp.port"].as<std::uint16_t>());
             mqtt_ac.emplace(accept_ioc, *mqtt_endpoint);
@@ -309,6 +375,7 @@ void run_broker(boost::program_options::variables_map const& vm) {
                             as::make_strand(con_ioc_getter().get_executor())
                         );
                     epsp->set_bulk_write(vm["bulk_write"].as<bool>());
+                    epsp->set_write_coalesce_threshold(vm["write_coalesce_threshold"].as<std::size_t>());
                     epsp->set_read_buffer_size(vm["read_buf_size"].as<std::size_t>());
                     auto& lowest_layer = epsp->lowest_layer();
                     mqtt_ac->async_accept(
@@ -354,6 +421,7 @@ void run_broker(boost::program_options::variables_map const& vm) {
                             as::make_strand(con_ioc_getter().get_executor())
                         );
                     epsp->set_bulk_write(vm["bulk_write"].as<bool>());
+                    epsp->set_write_coalesce_threshold(vm["write_coalesce_threshold"].as<std::size_t>());
                     epsp->set_read_buffer_size(vm["read_buf_size"].as<std::size_t>());
                     auto& lowest_layer = epsp->lowest_layer();
                     ws_ac->async_accept(
@@ -498,6 +566,7 @@ void run_broker(boost::program_options::variables_map const& vm) {
                             *mqtts_ctx
                         );
                     epsp->set_bulk_write(vm["bulk_write"].as<bool>());
+                    epsp->set_write_coalesce_threshold(vm["write_coalesce_threshold"].as<std::size_t>());
                     epsp->set_read_buffer_size(vm["read_buf_size"].as<std::size_t>());
                     auto& lowest_layer = epsp->lowest_layer();
                     mqtts_ac->async_accept(
@@ -600,6 +669,7 @@ void run_broker(boost::program_options::variables_map const& vm) {
                             *wss_ctx
                         );
                     epsp->set_bulk_write(vm["bulk_write"].as<bool>());
+                    epsp->set_write_coalesce_threshold(vm["write_coalesce_threshold"].as<std::size_t>());
                     epsp->set_read_buffer_size(vm["read_buf_size"].as<std::size_t>());
                     auto& lowest_layer = epsp->lowest_layer();
                     wss_ac->async_accept(
@@ -739,6 +809,7 @@ void run_broker(boost::program_options::variables_map const& vm) {
                             *wss_vn_ctx
                         );
                     epsp->set_bulk_write(vm["bulk_write"].as<bool>());
+                    epsp->set_write_coalesce_threshold(vm["write_coalesce_threshold"].as<std::size_t>());
                     epsp->set_read_buffer_size(vm["read_buf_size"].as<std::size_t>());
                     auto& lowest_layer = epsp->lowest_layer();
                     wss_vn_ac->async_accept(
@@ -1010,6 +1081,41 @@ int main(int argc, char *argv[]) {
                 boost::program_options::value<bool>()->default_value(false),
                 "Set bulk write mode for all connections"
             )
+            (
+                "write_coalesce_threshold",
+                boost::program_options::value<std::size_t>()->default_value(0),
+                "Copy packets whose size is less than or equal to this value into a contiguous write buffer. 0 means disabled"
+            )
+            (
+                "offline_max_messages",
+                boost::program_options::value<std::size_t>()->default_value(0),
+                "Maximum number of offline messages of each session. 0 means unlimited"
+            )
+            (
+                "offline_max_bytes",
+                boost::program_options::value<std::size_t>()->default_value(0),
+                "Maximum bytes of offline messages of each session. 0 means unlimited"
+            )
+            (
+                "offline_overflow_policy",
+                boost::program_options::value<std::string>()->default_value("drop_oldest"),
+                "Policy when the offline messages exceed the limit. drop_oldest or drop_newest"
+            )
+            (
+                "offline_spill_threshold",
+                boost::program_options::value<std::size_t>()->default_value(0),
+                "Offline messages over this number in memory are written to a file. 0 means disabled"
+            )
+            (
+                "offline_spill_dir",
+                boost::program_options::value<std::string>()->default_value("offline_spill"),
+                "Directory of the offline message files"
+            )
+            (
+                "offline_replay_batch_size",
+                boost::program_options::value<std::size_t>()->default_value(256),
+                "Maximum number of offline messages sent at once on reconnect. Other connections are served between batches. 0 means unlimited"
+            )
             (
                 "read_buf_size",
                 boost::program_options::value<std::size_t>()->default_value(65536),
@@ -1094,6 +1200,16 @@ int main(int argc, char *argv[]) {
         ;
         desc.add(tlsws_vn_desc);
 
+        boost::program_options::options_description cluster_desc("Cluster options");
+        cluster_desc.add_options()
+            ("cluster.node_id", boost::program_options::value<std::string>(), "unique name of this broker in the cluster. If set, cluster mode is enabled")
+            ("cluster.port", boost::program_options::value<std::uint16_t>(), "port for the links from the peer brokers (TCP)")
+            ("cluster.peer", boost::program_options::value<std::vector<std::string>>()->multitoken(), "host:port of the peer broker to connect. It can be specified multiple times")
+            ("cluster.secret", boost::program_options::value<std::string>(), "shared secret of the cluster. Required in cluster mode. A link whose CONNECT password doesn't match it is rejected")
+            ("cluster.max_pending", boost::program_options::value<std::size_t>()->default_value(am::cluster::default_max_pending), "maximum number of forwarded publishes that are not completed on each link. Publishes over the limit are dropped")
+        ;
+        desc.add(cluster_desc);
+
         boost::program_options::variables_map vm;
         boost::program_options::store(boost::program_options::parse_command_line(argc, argv, desc), vm);
 
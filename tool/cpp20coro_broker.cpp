@@ -147,6 +147,24 @@ coro_broker(
             epv_type
         > brk{vm["recycling_allocator"].as<bool>()};
 
+        {
+            am::offline_queue_config config;
+            config.max_messages = vm["offline_max_messages"].as<std::size_t>();
+            config.max_bytes = vm["offline_max_bytes"].as<std::size_t>();
+            auto policy = vm["offline_overflow_policy"].as<std::string>();
+            if (policy == "drop_newest") {
+                config.overflow_policy = am::offline_overflow_policy::drop_newest;
+            }
+            else if (policy != "drop_oldest") {
+                ASYNC_MQTT_LOG("mqtt_broker", warning)
+                    << "invalid offline_overflow_policy:" << policy << " drop_oldest is used";
+            }
+            config.spill_threshold = vm["offline_spill_threshold"].as<std::size_t>();
+            config.spill_dir = vm["offline_spill_dir"].as<std::string>();
+            config.replay_batch_size = vm["offline_replay_batch_size"].as<std::size_t>();
+            brk.set_offline_queue_config(am::force_move(config));
+        }
+
         auto num_of_iocs =
             [&] () -> std::size_t {
                 if (vm.count("iocs")) {
@@ -284,6 +302,7 @@ coro_broker(
                             as::make_strand(con_ioc_getter().get_executor())
                         );
                         epsp->set_bulk_write(vm["bulk_write"].as<bool>());
+                        epsp->set_write_coalesce_threshold(vm["write_coalesce_threshold"].as<std::size_t>());
                         epsp->set_read_buffer_size(vm["read_buf_size"].as<std::size_t>());
                         auto& lowest_layer = epsp->lowest_layer();
                         auto [ec] = co_await mqtt_ac->async_accept(
@@ -333,6 +352,7 @@ coro_broker(
                             as::make_strand(con_ioc_getter().get_executor())
                         );
                         epsp->set_bulk_write(vm["bulk_write"].as<bool>());
+                        epsp->set_write_coalesce_threshold(vm["write_coalesce_threshold"].as<std::size_t>());
                         epsp->set_read_buffer_size(vm["read_buf_size"].as<std::size_t>());
                         auto& lowest_layer = epsp->lowest_layer();
                         auto [ec] = co_await ws_ac->async_accept(
@@ -471,6 +491,7 @@ coro_broker(
                             *mqtts_ctx
                         );
                         epsp->set_bulk_write(vm["bulk_write"].as<bool>());
+                        epsp->set_write_coalesce_threshold(vm["write_coalesce_threshold"].as<std::size_t>());
                         epsp->set_read_buffer_size(vm["read_buf_size"].as<std::size_t>());
                         auto& lowest_layer = epsp->lowest_layer();
                         auto [ec] = co_await mqtts_ac->async_accept(
@@ -569,6 +590,7 @@ coro_broker(
                             *wss_ctx
                         );
                         epsp->set_bulk_write(vm["bulk_write"].as<bool>());
+                        epsp->set_write_coalesce_threshold(vm["write_coalesce_threshold"].as<std::size_t>());
                         epsp->set_read_buffer_size(vm["read_buf_size"].as<std::size_t>());
                         auto& lowest_layer = epsp->lowest_layer();
                         auto [ec] = co_await wss_ac->async_accept(
@@ -832,6 +854,41 @@ int main(int argc, char *argv[]) {
                 boost::program_options::value<bool>()->default_value(false),
                 "Set bulk write mode for all connections"
             )
+            (
+                "write_coalesce_threshold",
+                boost::program_options::value<std::size_t>()->default_value(0),
+                "Copy packets whose size is less than or equal to this value into a contiguous write buffer. 0 means disabled"
+            )
+            (
+                "offline_max_messages",
+                boost::program_options::value<std::size_t>()->default_value(0),
+                "Maximum number of offline messages of each session. 0 means unlimited"
+            )
+            (
+                "offline_max_bytes",
+                boost::program_options::value<std::size_t>()->default_value(0),
+                "Maximum bytes of offline messages of each session. 0 means unlimited"
+            )
+            (
+                "offline_overflow_policy",
+                boost::program_options::value<std::string>()->default_value("drop_oldest"),
+                "Policy when the offline messages exceed the limit. drop_oldest or drop_newest"
+            )
+            (
+                "offline_spill_threshold",
+                boost::program_options::value<std::size_t>()->default_value(0),
+                "Offline messages over this number in memory are written to a file. 0 means disabled"
+            )
+            (
+                "offline_spill_dir",
+                boost::program_options::value<std::string>()->default_value("offline_spill"),
+                "Directory of the offline message files"
+            )
+            (
+                "offline_replay_batch_size",
+                boost::program_options::value<std::size_t>()->default_value(256),
+                "Maximum number of offline messages sent at once on reconnect. Other connections are served between batches. 0 means unlimited"
+            )
             (
                 "read_buf_size",
                 boost::program_options::value<std::size_t>()->default_value(65536),
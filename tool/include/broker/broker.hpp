@@ -9,6 +9,7 @@
 
 #include <async_mqtt/all.hpp>
 #include <broker/endpoint_variant.hpp>
+#include <broker/response_topic_map.hpp>
 #include <broker/security.hpp>
 #include <broker/mutex.hpp>
 #include <broker/session_state.hpp>
@@ -16,6 +17,12 @@
 #include <broker/retained_messages.hpp>
 #include <broker/retained_topic_map.hpp>
 #include <broker/shared_target_impl.hpp>
+#include <broker/shared_message.hpp>
+#include <broker/tokenized_topic.hpp>
+#include <broker/login_cache.hpp>
+#include <broker/session_reclaimer.hpp>
+#include <broker/cluster.hpp>
+#include <broker/external_auth.hpp>
 #include <broker/mutex.hpp>
 #include <broker/uuid.hpp>
 
@@ -34,9 +41,15 @@ public:
     broker(as::any_io_executor timer_exe, bool recycling_allocator = false)
         :timer_exe_{force_move(timer_exe)},
          tim_disconnect_{timer_exe_},
+         reclaimer_{timer_exe_},
          recycling_allocator_{recycling_allocator} {
-        std::unique_lock<mutex> g_sec{mtx_security_};
-        security_.default_config();
+        auto sec = std::make_shared<security>();
+        sec->default_config();
+        store_security(force_move(sec));
+    }
+
+    ~broker() {
+        if (cluster_) cluster_->stop();
     }
 
     void handle_accept(epsp_type epsp, std::optional<std::string> preauthed_user_name = {}) {
@@ -44,15 +57,141 @@ public:
         async_read_packet(force_move(epsp));
     }
 
+    struct security_reload_metrics {
+        std::size_t reloads = 0;
+        std::chrono::steady_clock::duration last_reload_duration{};
+        std::chrono::steady_clock::duration last_blocking_duration{};
+        std::chrono::steady_clock::duration max_blocking_duration{};
+        std::size_t last_changed_users = 0;
+    };
+
     /**
      * @brief configure the security settings
+     *        The new settings are prepared without blocking anybody, and then published
+     *        with an atomic pointer swap. Readers take a snapshot of the pointer and never
+     *        block. The response topics that were created by the broker are kept apart from
+     *        the security settings, so they are not affected. Only login cache entries of
+     *        changed users are dropped.
+     *        The old settings are destroyed when the last snapshot is released.
      */
     void set_security(security&& sec) {
-        std::unique_lock<mutex> g_sec{mtx_security_};
-        security_ = force_move(sec);
+        std::lock_guard<std::mutex> g_reload{mtx_reload_};
+        auto start = std::chrono::steady_clock::now();
+        auto new_sec = std::make_shared<security const>(force_move(sec));
+        auto changed_users = security::changed_users(*load_security(), *new_sec);
+
+        auto blocking_start = std::chrono::steady_clock::now();
+        store_security(force_move(new_sec));
+        auto blocking = std::chrono::steady_clock::now() - blocking_start;
+        // A login that is checked against the old settings after this point
+        // drops its own cache entry. See connect_handler().
+        for (auto const& username : changed_users) {
+            login_cache_.erase(username);
+        }
+
+        reload_metrics_.reloads++;
+        reload_metrics_.last_reload_duration = std::chrono::steady_clock::now() - start;
+        reload_metrics_.last_blocking_duration = blocking;
+        reload_metrics_.max_blocking_duration = std::max(reload_metrics_.max_blocking_duration, blocking);
+        reload_metrics_.last_changed_users = changed_users.size();
+    }
+
+    /**
+     * @brief get the metrics of set_security()
+     */
+    security_reload_metrics get_security_reload_metrics() const {
+        std::lock_guard<std::mutex> g_reload{mtx_reload_};
+        return reload_metrics_;
+    }
+
+    /**
+     * @brief set the external authentication and authorization backend
+     *        If it is set, CONNECT with username and password and PUBLISH are checked by
+     *        the backend asynchronously instead of the security settings.
+     *        Receiving from the endpoint is suspended until the decision is made.
+     *        Subscription and delivery authorization still use the security settings.
+     *        Set nullptr to use the security settings again.
+     */
+    void set_auth_backend(std::shared_ptr<auth_backend> backend) {
+        std::atomic_store(&auth_backend_, force_move(backend));
+    }
+
+    /**
+     * @brief set the limits of the offline queue of each session
+     *        It is applied to the sessions that are created after the call.
+     */
+    void set_offline_queue_config(offline_queue_config config) {
+        offline_queue_config_ = std::make_shared<offline_queue_config const>(force_move(config));
+    }
+
+    /**
+     * @brief enable the cluster mode
+     *        PUBLISH from the local clients is forwarded to the peer brokers that have
+     *        matching subscriptions, and PUBLISH from the peers is delivered to the local
+     *        subscribers. Call it before accepting clients, and then call listen() and/or
+     *        connect() of the returned cluster to make the links.
+     * @param node_id     unique name of this broker in the cluster
+     * @param secret      shared secret of the cluster. It must not be empty.
+     * @param max_pending maximum number of publishes that are not completed on each link
+     * @return cluster
+     */
+    std::shared_ptr<cluster> enable_cluster(
+        std::string node_id,
+        std::string secret,
+        std::size_t max_pending = cluster::default_max_pending
+    ) {
+        BOOST_ASSERT(!cluster_);
+        cluster_ = cluster::create(
+            timer_exe_,
+            force_move(node_id),
+            force_move(secret),
+            cluster::handlers {
+                [this](std::string topic, std::vector<buffer> payload, pub::opts opts, properties props) {
+                    publish_from_cluster(force_move(topic), force_move(payload), opts, force_move(props));
+                },
+                [this] {
+                    std::shared_lock<mutex> g{mtx_subs_map_};
+                    return subs_map_.generation();
+                },
+                [this] {
+                    std::shared_lock<mutex> g{mtx_subs_map_};
+                    return subs_map_.summary().serialize();
+                }
+            },
+            max_pending
+        );
+        return cluster_;
     }
 
 private:
+    bool is_subscribe_authorized(std::string const& username, std::string_view topic_filter) const {
+        return
+            response_topics_.is_owner(topic_filter, username) ||
+            load_security()->is_subscribe_authorized(username, topic_filter);
+    }
+
+    std::shared_ptr<auth_backend> get_auth_backend() const {
+        return std::atomic_load(&auth_backend_);
+    }
+
+    // Take the snapshot of the current security settings. It never blocks.
+    std::shared_ptr<security const> load_security() const {
+#if defined(__cpp_lib_atomic_shared_ptr)
+        return security_.load();
+#else  // defined(__cpp_lib_atomic_shared_ptr)
+        return std::atomic_load(&security_);
+#endif // defined(__cpp_lib_atomic_shared_ptr)
+    }
+
+    // Publish the new security settings.
+    void store_security(std::shared_ptr<security const> sec) {
+#if defined(__cpp_lib_atomic_shared_ptr)
+        security_.store(force_move(sec));
+#else  // defined(__cpp_lib_atomic_shared_ptr)
+        std::atomic_store(&security_, force_move(sec));
+#endif // defined(__cpp_lib_atomic_shared_ptr)
+    }
+
     void async_read_packet(epsp_type epsp) {
         auto recv_proc =
             [this, epsp]
@@ -282,26 +421,103 @@ private:
         std::uint16_t /*keep_alive*/,
         properties props
     ) {
+        if (!epsp.get_preauthed_user_name() && noauth_username && password) {
+            if (auto backend = get_auth_backend()) {
+                // copy before the username is moved into the handler
+                std::string username_for_auth{*noauth_username};
+                backend->async_authenticate(
+                    force_move(username_for_auth),
+                    force_move(*password),
+                    [
+                        this,
+                        epsp,
+                        client_id = force_move(client_id),
+                        noauth_username = force_move(noauth_username),
+                        will = force_move(will),
+                        clean_start,
+                        props = force_move(props)
+                    ]
+                    (std::optional<std::string> username) mutable {
+                        auto exe = epsp.get_executor();
+                        as::dispatch(
+                            exe,
+                            [
+                                this,
+                                epsp = force_move(epsp),
+                                username = force_move(username),
+                                client_id = force_move(client_id),
+                                noauth_username = force_move(noauth_username),
+                                will = force_move(will),
+                                clean_start,
+                                props = force_move(props)
+                            ] () mutable {
+                                connect_proc(
+                                    force_move(epsp),
+                                    force_move(username),
+                                    force_move(client_id),
+                                    force_move(noauth_username),
+                                    force_move(will),
+                                    clean_start,
+                                    force_move(props)
+                                );
+                            }
+                        );
+                    }
+                );
+                return;
+            }
+        }
+
         std::optional<std::string> username;
+        auto sec = load_security();
         if (auto paun_opt = epsp.get_preauthed_user_name()) {
-            std::shared_lock<mutex> g_sec{mtx_security_};
-            if (security_.login_cert(*paun_opt)) {
+            if (sec->login_cert(*paun_opt)) {
                 username = force_move(*paun_opt);
             }
         }
         else if (!noauth_username && !password) {
-            std::shared_lock<mutex> g_sec{mtx_security_};
-            username = security_.login_anonymous();
+            username = sec->login_anonymous();
         }
         else if (noauth_username && password) {
-            std::shared_lock<mutex> g_sec{mtx_security_};
-            username = security_.login(*noauth_username, *password);
+            if (login_cache_.check(*noauth_username, *password)) {
+                username = *noauth_username;
+            }
+            else {
+                username = sec->login(*noauth_username, *password);
+                if (username && sec->login_cacheable(*noauth_username)) {
+                    login_cache_.store(*noauth_username, *password);
+                    // The settings have been replaced while checking.
+                    // The entry might come from the old settings, so drop it.
+                    if (load_security() != sec) {
+                        login_cache_.erase(*noauth_username);
+                    }
+                }
+            }
         }
 
+        connect_proc(
+            force_move(epsp),
+            force_move(username),
+            force_move(client_id),
+            force_move(noauth_username),
+            force_move(will),
+            clean_start,
+            force_move(props)
+        );
+    }
+
+    void connect_proc(
+        epsp_type epsp,
+        std::optional<std::string> username,
+        std::string client_id,
+        std::optional<std::string> noauth_username,
+        std::optional<will> will,
+        bool clean_start,
+        properties props
+    ) {
         // If login fails, try the unauthenticated user
         if (!username) {
-            std::shared_lock<mutex> g_sec{mtx_security_};
-            username = security_.login_unauthenticated();
+            username = load_security()->login_unauthenticated();
         }
 
         std::optional<std::chrono::steady_clock::duration> session_expiry_interval;
@@ -407,18 +623,20 @@ private:
                     mtx_subs_map_,
                     subs_map_,
                     shared_targets_,
+                    topics_,
                     epsp,
                     client_id,
                     *username,
                     force_move(will),
                     // will_sender
                     [this](auto&&... params) {
-                        this->do_publish(std::forward<decltype(params)>(params)...);
+                        this->enqueue_will(std::forward<decltype(params)>(params)...);
                     },
                     clean_start,
                     force_move(will_expiry_interval),
                     force_move(session_expiry_interval)
                 );
+            ss->set_offline_queue_config(offline_queue_config_);
             epsp.set_session_state(*ss);
             it = idx.emplace_hint(
                 it,
@@ -491,18 +709,20 @@ private:
                                 mtx_subs_map_,
                                 subs_map_,
                                 shared_targets_,
+                                topics_,
                                 epsp,
                                 client_id,
                                 *username,
                                 force_move(will),
                                 // will_sender
                                 [this](auto&&... params) {
-                                    this->do_publish(std::forward<decltype(params)>(params)...);
+                                    this->enqueue_will(std::forward<decltype(params)>(params)...);
                                 },
                                 clean_start,
                                 force_move(will_expiry_interval),
                                 force_move(session_expiry_interval)
                             );
+                        ss->set_offline_queue_config(offline_queue_config_);
                         epsp.set_session_state(*ss);
                         std::tie(it, inserted) = idx.emplace(
                             ss
@@ -561,20 +781,34 @@ private:
                 << ASYNC_MQTT_ADD_VALUE(address, this)
                 << "un:" << username
                 << "offline connection exists, discard old one due to new one's clean_start and renew";
-            idx.modify(
-                it,
-                [&](auto& e) {
-                    e->renew(
-                        epsp,
-                        will,
-                        clean_start,
-                        will_expiry_interval,
-                        session_expiry_interval
-                    );
-                    epsp.set_session_state(*e);
-                },
-                [](auto&) { BOOST_ASSERT(false); }
-            );
+            // The old session is replaced with a new one, and its subscriptions are
+            // removed by reclaimer_ in the background. CONNACK doesn't wait for it.
+            auto old_ss = *it;
+            old_ss->clear_will();
+            old_ss->tombstone();
+            auto ss =
+                session_state<epsp_type>::create(
+                    mtx_subs_map_,
+                    subs_map_,
+                    shared_targets_,
+                    topics_,
+                    epsp,
+                    old_ss->client_id(),
+                    username,
+                    force_move(will),
+                    // will_sender
+                    [this](auto&&... params) {
+                        this->enqueue_will(std::forward<decltype(params)>(params)...);
+                    },
+                    clean_start,
+                    force_move(will_expiry_interval),
+                    force_move(session_expiry_interval)
+                );
+            ss->set_offline_queue_config(offline_queue_config_);
+            epsp.set_session_state(*ss);
+            [[maybe_unused]] bool replaced = idx.replace(it, force_move(ss));
+            BOOST_ASSERT(replaced);
+            reclaimer_.add(force_move(old_ss));
             if (response_topic_requested) {
                 // set_response_topic never modify key part
                 set_response_topic(const_cast<session_state<epsp_type>&>(**it), connack_props, username);
@@ -678,26 +912,16 @@ private:
                 return rt;
             } ();
 
-        auto rule_nr =
-            [&] {
-                std::unique_lock<mutex> g_sec{mtx_security_};
-                return security_.add_auth(
-                    response_topic,
-                    { "@any" }, security::authorization::type::allow,
-                    { username }, security::authorization::type::allow
-                );
-            } ();
+        // Anyone can publish to the response topic, and only the user can subscribe to it.
+        response_topics_.insert(response_topic, username);
 
         s.set_clean_handler(
-            [this, response_topic, rule_nr]() {
+            [this, response_topic]() {
                 {
                     std::lock_guard<mutex> g(mtx_retains_);
                     retains_.erase(response_topic);
                 }
-                {
-                    std::unique_lock<mutex> g{mtx_security_};
-                    security_.remove_auth(rule_nr);
-                }
+                response_topics_.erase(response_topic);
             }
         );
 
@@ -886,6 +1110,76 @@ private:
         std::string topic,
         std::vector<buffer> payload,
         properties props
+    ) {
+        if (auto backend = get_auth_backend()) {
+            // copy before the topic is moved into the handler
+            std::string topic_for_auth{topic};
+            backend->async_authorize_publish(
+                epsp.get_session_state()->get_username(),
+                force_move(topic_for_auth),
+                [
+                    this,
+                    epsp,
+                    packet_id,
+                    opts,
+                    topic = force_move(topic),
+                    payload = force_move(payload),
+                    props = force_move(props)
+                ]
+                (bool authorized) mutable {
+                    auto exe = epsp.get_executor();
+                    as::dispatch(
+                        exe,
+                        [
+                            this,
+                            epsp = force_move(epsp),
+                            packet_id,
+                            opts,
+                            topic = force_move(topic),
+                            payload = force_move(payload),
+                            props = force_move(props),
+                            authorized
+                        ] () mutable {
+                            publish_proc(
+                                force_move(epsp),
+                                packet_id,
+                                opts,
+                                force_move(topic),
+                                force_move(payload),
+                                force_move(props),
+                                authorized
+                            );
+                        }
+                    );
+                }
+            );
+            return;
+        }
+
+        // See if this session is authorized to publish this topic
+        bool authorized =
+            response_topics_.contains(topic) ||
+            load_security()->auth_pub(topic, epsp.get_session_state()->get_username()) ==
+            security::authorization::type::allow;
+        publish_proc(
+            force_move(epsp),
+            packet_id,
+            opts,
+            force_move(topic),
+            force_move(payload),
+            force_move(props),
+            authorized
+        );
+    }
+
+    void publish_proc(
+        epsp_type epsp,
+        packet_id_type packet_id,
+        pub::opts opts,
+        std::string topic,
+        std::vector<buffer> payload,
+        properties props,
+        bool authorized
     ) {
         auto usg = unique_scope_guard(
             [&] {
@@ -895,8 +1189,10 @@ private:
 
         auto& ss = *epsp.get_session_state();
 
+        // dropped means that the message was not forwarded to an interested cluster peer.
+        // MQTT v3.1.1 has no reason code to tell it.
         auto send_pubres =
-            [&] (bool authorized, bool matched) {
+            [&] (bool authorized, bool matched, bool dropped) {
                 switch (opts.get_qos()) {
                 case qos::at_least_once:
                     switch (epsp.get_protocol_version()) {
@@ -916,52 +1212,22 @@ private:
                         );
                         break;
                     case protocol_version::v5: {
+                        auto rc =
+                            [&] {
+                                if (!authorized) return puback_reason_code::not_authorized;
+                                if (dropped) return puback_reason_code::quota_exceeded;
+                                if (!matched) return puback_reason_code::no_matching_subscribers;
+                                return puback_reason_code::success;
+                            } ();
                         auto packet =
                             [&] {
-                                if (authorized) {
-                                    if (puback_props_.empty()) {
-                                        if (matched) {
-                                            return v5::puback_packet{packet_id};
-                                        }
-                                        else {
-                                            return v5::puback_packet{
-                                                packet_id,
-                                                puback_reason_code::no_matching_subscribers
-                                            };
-                                        }
-                                    }
-                                    else {
-                                        if (matched) {
-                                            return v5::puback_packet{
-                                                packet_id,
-                                                puback_reason_code::success,
-                                                puback_props_
-                                            };
-                                        }
-                                        else {
-                                            return v5::puback_packet{
-                                                packet_id,
-                                                puback_reason_code::no_matching_subscribers,
-                                                puback_props_
-                                            };
-                                        }
-                                    };
-                                }
-                                else {
-                                    if (puback_props_.empty()) {
-                                        return v5::puback_packet{
-                                            packet_id,
-                                            puback_reason_code::not_authorized
-                                        };
-                                    }
-                                    else {
-                                        return v5::puback_packet{
-                                            packet_id,
-                                            puback_reason_code::not_authorized,
-                                            puback_props_
-                                        };
+                                if (puback_props_.empty()) {
+                                    if (rc == puback_reason_code::success) {
+                                        return v5::puback_packet{packet_id};
                                     }
+                                    return v5::puback_packet{packet_id, rc};
                                 }
+                                return v5::puback_packet{packet_id, rc, puback_props_};
                             } ();
                         epsp.async_send(
                             force_move(packet),
@@ -998,52 +1264,22 @@ private:
                         );
                         break;
                     case protocol_version::v5: {
+                        auto rc =
+                            [&] {
+                                if (!authorized) return pubrec_reason_code::not_authorized;
+                                if (dropped) return pubrec_reason_code::quota_exceeded;
+                                if (!matched) return pubrec_reason_code::no_matching_subscribers;
+                                return pubrec_reason_code::success;
+                            } ();
                         auto packet =
                             [&] {
-                                if (authorized) {
-                                    if (pubrec_props_.empty()) {
-                                        if (matched) {
-                                            return v5::pubrec_packet{packet_id};
-                                        }
-                                        else {
-                                            return v5::pubrec_packet{
-                                                packet_id,
-                                                pubrec_reason_code::no_matching_subscribers
-                                            };
-                                        }
-                                    }
-                                    else {
-                                        if (matched) {
-                                            return v5::pubrec_packet{
-                                                packet_id,
-                                                pubrec_reason_code::success,
-                                                pubrec_props_
-                                            };
-                                        }
-                                        else {
-                                            return v5::pubrec_packet{
-                                                packet_id,
-                                                pubrec_reason_code::no_matching_subscribers,
-                                                pubrec_props_
-                                            };
-                                        }
-                                    };
-                                }
-                                else {
-                                    if (pubrec_props_.empty()) {
-                                        return v5::pubrec_packet{
-                                            packet_id,
-                                            pubrec_reason_code::not_authorized
-                                        };
-                                    }
-                                    else {
-                                        return v5::pubrec_packet{
-                                            packet_id,
-                                            pubrec_reason_code::not_authorized,
-                                            pubrec_props_
-                                        };
+                                if (pubrec_props_.empty()) {
+                                    if (rc == pubrec_reason_code::success) {
+                                        return v5::pubrec_packet{packet_id};
                                     }
+                                    return v5::pubrec_packet{packet_id, rc};
                                 }
+                                return v5::pubrec_packet{packet_id, rc, pubrec_props_};
                             } ();
                         epsp.async_send(
                             force_move(packet),
@@ -1067,14 +1303,9 @@ private:
                 }
             };
 
-        // See if this session is authorized to publish this topic
-        if ([&] {
-                std::shared_lock<mutex> g_sec{mtx_security_};
-                return security_.auth_pub(topic, ss.get_username()) != security::authorization::type::allow;
-            } ()
-        ) {
+        if (!authorized) {
             // Publish not authorized
-            send_pubres(false, false);
+            send_pubres(false, false, false);
             return;
         }
 
@@ -1101,7 +1332,7 @@ private:
             );
         }
 
-        bool matched = do_publish(
+        auto [matched, dropped] = do_publish(
             ss,
             force_move(topic),
             force_move(payload),
@@ -1109,7 +1340,7 @@ private:
             force_move(forward_props)
         );
 
-        send_pubres(true, matched);
+        send_pubres(true, matched, dropped);
     }
 
     /**
@@ -1120,87 +1351,141 @@ private:
      * @param payload - The payload of the message.
      * @param pubopts - publish options
      * @param props - properties
+     * @return matched, and dropped by the cluster forwarding
      */
-    bool do_publish(
+    std::pair<bool, bool> do_publish(
         session_state<epsp_type> const& source_ss,
         std::string topic,
         std::vector<buffer> payload,
         pub::opts opts,
         properties props
     ) {
+        // The message body is created once and shared by all subscribers.
+        // Only the per-subscriber delta (opts and sid) is passed to each session.
+        publish_source src {
+            shared_message::create(
+                force_move(topic),
+                force_move(payload),
+                force_move(props)
+            ),
+            opts,
+            source_ss.client_id(),
+            source_ss.get_protocol_version()
+        };
+        do_publish_group(&src, &src + 1);
+        return {src.matched, src.dropped};
+    }
+
+    /**
+     * @brief publish_from_cluster Publish a message received from a peer broker.
+     *        It is delivered to the local subscribers only, and not forwarded again.
+     */
+    void publish_from_cluster(
+        std::string topic,
+        std::vector<buffer> payload,
+        pub::opts opts,
+        properties props
+    ) {
+        publish_source src {
+            shared_message::create(
+                force_move(topic),
+                force_move(payload),
+                force_move(props)
+            ),
+            opts,
+            std::string_view{},
+            protocol_version::v5,
+            false // forward
+        };
+        do_publish_group(&src, &src + 1);
+    }
+
+    /**
+     * @brief A message to publish and the attributes of its source session.
+     *        It doesn't refer to the source session, so the session can be gone.
+     */
+    struct publish_source {
+        shared_message_ptr msg;
+        pub::opts opts;
+        std::string_view client_id;
+        protocol_version version;
+        bool forward = true; ///< forward to the cluster peers
         bool matched = false;
+        bool dropped = false; ///< a cluster peer was interested but the link was full
+        //                  share_name        topic_filter
+        std::set<std::tuple<std::string_view, interned_topic>> sent = {};
+    };
+
+    /**
+     * @brief do_publish_group Publish messages that have the same topic.
+     *        The authorization and the subscription match are done once for all of them.
+     *        The messages are delivered in the order of the range.
+     *
+     * @param first - The first message
+     * @param last - The end of the messages
+     */
+    void do_publish_group(publish_source* first, publish_source* last) {
+        BOOST_ASSERT(first != last);
+
+        // The topic is split into levels once here, and then used by the authorization,
+        // the subscription match, and the retained message store.
+        // tt refers to the topic in the first message.
+        tokenized_topic tt{first->msg->topic()};
 
         // Get auth rights for this topic
         // auth_users prepared once here, and then referred multiple times in subs_map_.modify() for efficiency
-        auto auth_users =
-            [&] {
-                std::shared_lock<mutex> g_sec{mtx_security_};
-                return security_.auth_sub(topic);
-            } ();
+        // The snapshot sec is used for all subscribers of this publish.
+        auto sec = load_security();
+        auto auth_users = sec->auth_sub(tt);
+        // Only the owner of the response topic is allowed in addition to the security settings.
+        auto response_topic_owner = response_topics_.owner(first->msg->topic());
 
         // publish the message to subscribers.
         // retain is delivered as the original only if rap_value is rap::retain.
         // On MQTT v3.1.1, rap_value is always rap::dont.
         auto deliver =
-            [&] (session_state<epsp_type>& ss, subscription<epsp_type>& sub, auto const& auth_users) {
+            [&] (publish_source const& src, session_state<epsp_type>& ss, subscription<epsp_type>& sub) {
+
+                // The session has been discarded, and its subscriptions are being reclaimed.
+                if (ss.tombstoned()) return false;
 
                 // See if this session is authorized to subscribe this topic
-                {
-                    std::shared_lock<mutex> g_sec{mtx_security_};
-                    auto access = security_.auth_sub_user(auth_users, ss.get_username());
-                    if (access != security::authorization::type::allow) return false;
-                }
-                pub::opts new_opts = std::min(opts.get_qos(), sub.opts.get_qos());
-                if (sub.opts.get_rap() == sub::rap::retain && opts.get_retain() == pub::retain::yes) {
+                if (!(response_topic_owner && *response_topic_owner == ss.get_username()) &&
+                    sec->auth_sub_user(auth_users, ss.get_username()) !=
+                    security::authorization::type::allow) return false;
+                pub::opts new_opts = std::min(src.opts.get_qos(), sub.opts.get_qos());
+                if (sub.opts.get_rap() == sub::rap::retain && src.opts.get_retain() == pub::retain::yes) {
                     new_opts |= pub::retain::yes;
                 }
 
-                if (sub.sid) {
-                    props.push_back(property::subscription_identifier(boost::numeric_cast<std::uint32_t>(*sub.sid)));
-                    ss.deliver(
-                        topic,
-                        payload,
-                        new_opts,
-                        props
-                    );
-                    props.pop_back();
-                }
-                else {
-                    ss.deliver(
-                        topic,
-                        payload,
-                        new_opts,
-                        props
-                    );
-                }
+                ss.deliver(src.msg, new_opts, sub.sid);
                 return true;
             };
 
-        //                  share_name   topic_filter
-        std::set<std::tuple<std::string_view, std::string_view>> sent;
-
         {
             std::shared_lock<mutex> g{mtx_subs_map_};
             subs_map_.modify(
-                topic,
+                tt,
                 [&](std::string const& /*key*/, subscription<epsp_type>& sub) {
-                    if (sub.sharename.empty()) {
-                        // Non shared subscriptions
-
-                        // If NL (no local) subscription option is set and
-                        // publisher is the same as subscriber, then skip it.
-                        if (sub.opts.get_nl() == sub::nl::yes &&
-                            sub.ss.get().client_id() ==  source_ss.client_id()) return;
-                        if (deliver(sub.ss.get(), sub, auth_users)) matched = true;
-                    }
-                    else {
-                        // Shared subscriptions
-                        bool inserted;
-                        std::tie(std::ignore, inserted) = sent.emplace(sub.sharename, sub.topic);
-                        if (inserted) {
-                            if (auto ssr_sub_opt = shared_targets_.get_target(sub.sharename, sub.topic)) {
-                                auto [ssr, sub] = *ssr_sub_opt;
-                                if (deliver(ssr.get(), sub, auth_users)) matched = true;
+                    for (auto src = first; src != last; ++src) {
+                        if (sub.sharename.empty()) {
+                            // Non shared subscriptions
+
+                            // If NL (no local) subscription option is set and
+                            // publisher is the same as subscriber, then skip it.
+                            if (sub.opts.get_nl() == sub::nl::yes &&
+                                sub.ss.get().client_id() == src->client_id) continue;
+                            if (deliver(*src, sub.ss.get(), sub)) src->matched = true;
+                        }
+                        else {
+                            // Shared subscriptions
+                            bool inserted;
+                            std::tie(std::ignore, inserted) = src->sent.emplace(sub.sharename, sub.topic);
+                            if (inserted) {
+                                if (auto ssr_sub_opt = shared_targets_.get_target(sub.sharename, sub.topic)) {
+                                    auto [ssr, sub] = *ssr_sub_opt;
+                                    if (deliver(*src, ssr.get(), sub)) src->matched = true;
+                                }
                             }
                         }
                     }
@@ -1208,77 +1493,185 @@ private:
             );
         }
 
-        std::optional<std::chrono::steady_clock::duration> message_expiry_interval;
-        if (source_ss.get_protocol_version() == protocol_version::v5) {
-            for (auto const& prop : props) {
-                prop.visit(
-                    overload {
-                        [&](property::message_expiry_interval const& v) {
-                            message_expiry_interval.emplace(std::chrono::seconds(v.val()));
-                        },
-                        [&](auto const&){}
-                    }
-                );
+        for (auto src = first; src != last; ++src) {
+            if (src->opts.get_retain() == pub::retain::yes) {
+                update_retain(tt, *src);
             }
         }
 
-        /*
-         * If the message is marked as being retained, then we
-         * keep it in case a new subscription is added that matches
-         * this topic.
-         *
-         * @note: The MQTT standard 3.3.1.3 RETAIN makes it clear that
-         *        retained messages are global based on the topic, and
-         *        are not scoped by the client id. So any client may
-         *        publish a retained message on any topic, and the most
-         *        recently published retained message on a particular
-         *        topic is the message that is stored on the server.
-         *
-         * @note: The standard doesn't make it clear that publishing
-         *        a message with zero length, but the retain flag not
-         *        set, does not result in any existing retained message
-         *        being removed. However, internet searching indicates
-         *        that most brokers have opted to keep retained messages
-         *        when receiving payload of zero bytes, unless the so
-         *        received message has the retain flag set, in which case
-         *        the retained message is removed.
-         */
-        if (opts.get_retain() == pub::retain::yes) {
-            if (payload.empty()) {
-                std::lock_guard<mutex> g(mtx_retains_);
-                retains_.erase(topic);
+        if (cluster_) {
+            for (auto src = first; src != last; ++src) {
+                if (!src->forward) continue;
+                auto [forwarded, dropped] = cluster_->forward(tt, src->msg, src->opts);
+                if (forwarded) src->matched = true;
+                // QoS0 can be lost anyway
+                if (dropped && src->opts.get_qos() != qos::at_most_once) src->dropped = true;
             }
-            else {
-                std::shared_ptr<as::steady_timer> tim_message_expiry;
-                if (message_expiry_interval) {
-                    tim_message_expiry = std::make_shared<as::steady_timer>(timer_exe_, *message_expiry_interval);
-                    tim_message_expiry->async_wait(
-                        [this, topic = topic, wp = std::weak_ptr<as::steady_timer>(tim_message_expiry)]
-                        (boost::system::error_code const& ec) {
-                            if (auto sp = wp.lock()) {
-                                if (!ec) {
-                                    std::lock_guard<mutex> g(mtx_retains_);
-                                    retains_.erase(topic);
-                                }
-                            }
-                        }
-                    );
+        }
+    }
+
+    /*
+     * If the message is marked as being retained, then we
+     * keep it in case a new subscription is added that matches
+     * this topic.
+     *
+     * @note: The MQTT standard 3.3.1.3 RETAIN makes it clear that
+     *        retained messages are global based on the topic, and
+     *        are not scoped by the client id. So any client may
+     *        publish a retained message on any topic, and the most
+     *        recently published retained message on a particular
+     *        topic is the message that is stored on the server.
+     *
+     * @note: The standard doesn't make it clear that publishing
+     *        a message with zero length, but the retain flag not
+     *        set, does not result in any existing retained message
+     *        being removed. However, internet searching indicates
+     *        that most brokers have opted to keep retained messages
+     *        when receiving payload of zero bytes, unless the so
+     *        received message has the retain flag set, in which case
+     *        the retained message is removed.
+     */
+    void update_retain(tokenized_topic const& tt, publish_source const& src) {
+        auto const& msg = src.msg;
+        if (msg->payload().empty()) {
+            std::lock_guard<mutex> g(mtx_retains_);
+            retains_.erase(tt);
+            return;
+        }
+
+        auto message_expiry_interval =
+            [&] () -> std::optional<std::chrono::steady_clock::duration> {
+                if (src.version == protocol_version::v5) {
+                    return msg->message_expiry_interval();
                 }
+                return std::nullopt;
+            } ();
 
-                std::lock_guard<mutex> g(mtx_retains_);
-                retains_.insert_or_assign(
-                    topic,
-                    retain_type {
-                        topic,
-                        force_move(payload),
-                        force_move(props),
-                        opts.get_qos(),
-                        tim_message_expiry
+        std::shared_ptr<as::steady_timer> tim_message_expiry;
+        if (message_expiry_interval) {
+            tim_message_expiry = std::make_shared<as::steady_timer>(timer_exe_, *message_expiry_interval);
+            tim_message_expiry->async_wait(
+                [this, topic = std::string{msg->topic()}, wp = std::weak_ptr<as::steady_timer>(tim_message_expiry)]
+                (boost::system::error_code const& ec) {
+                    if (auto sp = wp.lock()) {
+                        if (!ec) {
+                            std::lock_guard<mutex> g(mtx_retains_);
+                            retains_.erase(topic);
+                        }
                     }
-                );
+                }
+            );
+        }
+
+        std::lock_guard<mutex> g(mtx_retains_);
+        retains_.insert_or_assign(
+            tt,
+            retain_type {
+                msg,
+                src.opts.get_qos(),
+                tim_message_expiry
+            }
+        );
+    }
+
+    /**
+     * @brief A will message waiting for will_flush().
+     */
+    struct pending_will {
+        std::string client_id;
+        protocol_version version;
+        shared_message_ptr msg;
+        pub::opts opts;
+    };
+
+    struct will_queue {
+        std::mutex mtx;
+        std::deque<pending_will> wills;
+        bool scheduled = false;
+    };
+
+    /**
+     * @brief will_sender of sessions.
+     *        Will messages are queued and published by will_flush() in batches,
+     *        so a mass disconnect doesn't publish each will separately.
+     */
+    void enqueue_will(
+        session_state<epsp_type> const& source_ss,
+        std::string topic,
+        std::vector<buffer> payload,
+        pub::opts opts,
+        properties props
+    ) {
+        pending_will w {
+            source_ss.client_id(),
+            source_ss.get_protocol_version(),
+            shared_message::create(
+                force_move(topic),
+                force_move(payload),
+                force_move(props)
+            ),
+            opts
+        };
+        bool schedule = false;
+        {
+            std::lock_guard<std::mutex> g{will_queue_->mtx};
+            will_queue_->wills.push_back(force_move(w));
+            if (!will_queue_->scheduled) {
+                will_queue_->scheduled = true;
+                schedule = true;
             }
         }
-        return matched;
+        if (schedule) post_will_flush();
+    }
+
+    void post_will_flush() {
+        as::post(
+            timer_exe_,
+            [this, wp = std::weak_ptr<will_queue>(will_queue_)] {
+                if (wp.lock()) will_flush();
+            }
+        );
+    }
+
+    /**
+     * @brief Publish at most will_batch_size queued will messages.
+     *        The wills that have the same topic are published by one do_publish_group() call.
+     *        If wills remain, the next batch is posted so other handlers can run in between.
+     */
+    void will_flush() {
+        std::vector<pending_will> wills;
+        bool next = false;
+        {
+            std::lock_guard<std::mutex> g{will_queue_->mtx};
+            auto& q = will_queue_->wills;
+            auto n = std::min(q.size(), will_batch_size);
+            wills.reserve(n);
+            std::move(q.begin(), q.begin() + static_cast<std::ptrdiff_t>(n), std::back_inserter(wills));
+            q.erase(q.begin(), q.begin() + static_cast<std::ptrdiff_t>(n));
+            next = !q.empty();
+            will_queue_->scheduled = next;
+        }
+        if (next) post_will_flush();
+
+        // group by topic, keeping the order of the wills in each group
+        std::unordered_map<std::string_view, std::vector<publish_source>> groups;
+        for (auto& w : wills) {
+            groups[w.msg->topic()].push_back(
+                publish_source {
+                    w.msg,
+                    w.opts,
+                    w.client_id,
+                    w.version
+                }
+            );
+        }
+        ASYNC_MQTT_LOG("mqtt_broker", trace)
+            << ASYNC_MQTT_ADD_VALUE(address, this)
+            << "publish wills:" << wills.size() << " topics:" << groups.size();
+        for (auto& group : groups) {
+            auto& srcs = group.second;
+            do_publish_group(srcs.data(), srcs.data() + srcs.size());
+        }
     }
 
     void puback_handler(
@@ -1511,15 +1904,13 @@ private:
 
         auto publish_proc =
             [&ssr, &epsp](retain_type const& r, qos qos_value, std::optional<std::size_t> sid) {
-                auto props = r.props;
-                if (sid) {
-                    props.push_back(property::subscription_identifier(std::uint32_t(*sid)));
-                }
+                auto msg = r.msg;
                 if (r.tim_message_expiry) {
                     auto d =
                         std::chrono::duration_cast<std::chrono::seconds>(
                             r.tim_message_expiry->expiry() - std::chrono::steady_clock::now()
                         ).count();
+                    auto props = msg->props();
                     for (auto& prop : props) {
                         prop.visit(
                             overload {
@@ -1530,13 +1921,17 @@ private:
                             }
                         );
                     }
+                    msg = shared_message::create(
+                        msg->topic_as_buffer(),
+                        msg->payload(),
+                        force_move(props)
+                    );
                 }
                 ssr.get().publish(
                     epsp,
-                    r.topic,
-                    r.payload,
+                    force_move(msg),
                     std::min(r.qos_value, qos_value) | pub::retain::yes,
-                    props
+                    sid
                 );
             };
 
@@ -1557,10 +1952,7 @@ private:
             res.reserve(entries.size());
             for (auto& e : entries) {
                 if (!e ||
-                    [&] {
-                        std::shared_lock<mutex> g_sec{mtx_security_};
-                        return security_.is_subscribe_authorized(ss.get_username(), e.topic());
-                    } ()
+                    is_subscribe_authorized(ss.get_username(), e.topic())
                 ) {
                     res.emplace_back(qos_to_suback_return_code(e.opts().get_qos())); // converts to granted_qos_x
                     ssr.get().subscribe(
@@ -1624,11 +2016,7 @@ private:
             res.reserve(entries.size());
             for (auto& e : entries) {
                 if (e) {
-                    if ([&] {
-                            std::shared_lock<mutex> g_sec{mtx_security_};
-                            return security_.is_subscribe_authorized(ss.get_username(), e.topic());
-                        } ()
-                    ) {
+                    if (is_subscribe_authorized(ss.get_username(), e.topic())) {
                         res.emplace_back(qos_to_suback_reason_code(e.opts().get_qos())); // converts to granted_qos_x
                         ssr.get().subscribe(
                             e.sharename(),
@@ -1908,6 +2296,10 @@ private:
             else {
                 auto sssp{force_move(idx.extract(it).value())};
                 do_send_will(*sssp);
+                // The subscriptions are removed in the background.
+                // The session is destroyed when both the reclaimer and the close operation release it.
+                sssp->tombstone();
+                brk.reclaimer_.add(sssp);
                 if (rc_opt) {
                     ASYNC_MQTT_LOG("mqtt_broker", trace)
                         << ASYNC_MQTT_ADD_VALUE(address, epsp.get_address())
@@ -1959,9 +2351,17 @@ private:
                     epsp,
                     [&brk = this->brk]
                     (std::shared_ptr<as::steady_timer> const& sp_tim) {
-                        // lock for expire (async)
-                        std::lock_guard<mutex> g(brk.mtx_sessions_);
-                        brk.sessions_.template get<tag_tim>().erase(sp_tim);
+                        std::shared_ptr<session_state<epsp_type>> expired;
+                        {
+                            // lock for expire (async)
+                            std::lock_guard<mutex> g(brk.mtx_sessions_);
+                            auto& idx = brk.sessions_.template get<tag_tim>();
+                            auto it = idx.find(sp_tim);
+                            if (it == idx.end()) return;
+                            expired = force_move(idx.extract(it).value());
+                        }
+                        expired->tombstone();
+                        brk.reclaimer_.add(force_move(expired));
                     }
                 );
                 self.complete(true);
@@ -2127,13 +2527,28 @@ private:
     std::optional<std::chrono::steady_clock::duration> delay_disconnect_; ///< Used to delay disconnect handling for testing
 
     // Authorization and authentication settings
-    mutable mutex mtx_security_;
-    security security_;
-
+    // Readers take a snapshot by load_security() without locking.
+#if defined(__cpp_lib_atomic_shared_ptr)
+    std::atomic<std::shared_ptr<security const>> security_;
+#else  // defined(__cpp_lib_atomic_shared_ptr)
+    std::shared_ptr<security const> security_;
+#endif // defined(__cpp_lib_atomic_shared_ptr)
+    response_topic_map response_topics_; ///< response topics created by the broker
+    mutable std::mutex mtx_reload_;
+    security_reload_metrics reload_metrics_;
+    login_cache login_cache_;
+    std::shared_ptr<auth_backend> auth_backend_;
+
+    topic_pool topics_; ///< interned topic filters shared by subscriptions
     mutable mutex mtx_subs_map_;
     sub_con_map<epsp_type> subs_map_;   ///< subscription information
     shared_target<epsp_type> shared_targets_; ///< shared subscription targets
 
+    /// will messages waiting for will_flush()
+    /// The sessions enqueue their wills when they are destroyed, so it outlives sessions_.
+    static constexpr std::size_t will_batch_size = 4096;
+    std::shared_ptr<will_queue> will_queue_ = std::make_shared<will_queue>();
+
     ///< Map of active client id and connections
     /// session_state has references of subs_map_ and shared_targets_.
     /// because session_state (member of sessions_) has references of subs_map_ and shared_targets_.
@@ -2143,6 +2558,12 @@ private:
     mutable mutex mtx_retains_;
     retained_messages retains_; ///< A list of messages retained so they can be sent to newly subscribed clients.
 
+    /// Discarded sessions whose subscriptions are removed in the background.
+    /// It is destroyed first because the sessions refer to the members above.
+    session_reclaimer<session_state<epsp_type>> reclaimer_;
+
+    std::shared_ptr<cluster> cluster_; ///< set by enable_cluster()
+
     // MQTTv5 members
     properties connack_props_;
     properties suback_props_;
@@ -2164,6 +2585,7 @@ private:
     bool pingresp_ = true;
     bool connack_ = true;
     bool recycling_allocator_;
+    std::shared_ptr<offline_queue_config const> offline_queue_config_; ///< nullptr means unlimited
 };
 
 } // namespace async_mqtt
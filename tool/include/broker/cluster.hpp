@@ -0,0 +1,836 @@
+// Copyright Takatoshi Kondo 2024
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#if !defined(ASYNC_MQTT_BROKER_CLUSTER_HPP)
+#define ASYNC_MQTT_BROKER_CLUSTER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <boost/asio/detached.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/strand.hpp>
+
+#include <async_mqtt/asio_bind/endpoint.hpp>
+#include <async_mqtt/asio_bind/predefined_layer/mqtt.hpp>
+#include <async_mqtt/util/host_port.hpp>
+#include <async_mqtt/util/log.hpp>
+#include <async_mqtt/util/move.hpp>
+#include <async_mqtt/util/overload.hpp>
+
+#include <broker/shared_message.hpp>
+#include <broker/interest_summary.hpp>
+#include <broker/security.hpp>
+#include <broker/tokenized_topic.hpp>
+
+namespace async_mqtt {
+
+namespace as = boost::asio;
+
+// Cluster mode of the broker.
+// The nodes of a cluster are connected with each other by links (full mesh).
+// A link is an MQTT v5 connection with 4 byte packet ids, so a link can have
+// more packet ids in use than a client connection.
+// Each node sends the interest_summary of its local subscriptions (interest)
+// to the peers, and a PUBLISH from a local client is forwarded only to the
+// peers whose interest may match the topic. Retained publishes are forwarded to all
+// peers. Publishes received from a link are delivered to the local
+// subscribers only, so they are not forwarded again.
+// Publishes are forwarded with their original QoS, so QoS2 stays exactly once
+// across a link.
+// A link is accepted only if the CONNECT has the cluster client_id prefix and
+// both nodes prove that they know the shared secret of the cluster. The secret itself
+// is never sent. The proof is HMAC-SHA256 of the nonces that are exchanged by the
+// enhanced authentication (MQTT v5 AUTH):
+//   dialer   -> CONNECT  method, data: Nd
+//   acceptor -> AUTH     method, data: Na | HMAC(secret, "acceptor" | Nd | Na)
+//   dialer   -> AUTH     method, data: HMAC(secret, "dialer" | Na | Nd)
+//   acceptor -> CONNACK  success
+// The dialer doesn't use the link until it has checked the acceptor's proof.
+// The link is not encrypted, so the network between the nodes should be trusted.
+// Each link has at most max_pending publishes that are queued, being written,
+// or waiting for the response. Publishes over the limit are dropped, and forward()
+// reports it so that the broker can tell a QoS1/QoS2 publisher by the reason code.
+// forward() refers to a snapshot of the links, and locks only the links that the
+// publish is queued on.
+class cluster : public std::enable_shared_from_this<cluster> {
+public:
+    using link_endpoint = basic_endpoint<role::any, 4, protocol::mqtt>;
+
+    struct handlers {
+        // deliver a publish received from a peer to the local subscribers
+        std::function<void(std::string topic, std::vector<buffer> payload, pub::opts opts, properties props)> publish;
+        // a number that changes when the local subscriptions are changed
+        std::function<std::size_t()> interest_generation;
+        // serialized interest_summary of the local subscriptions
+        std::function<std::string()> interest;
+    };
+
+    static constexpr std::string_view client_id_prefix = "$cluster/";
+    static constexpr std::string_view interest_topic = "$cluster/interest";
+    static constexpr std::string_view auth_method = "async_mqtt-cluster-hmac-sha256";
+    static constexpr std::size_t nonce_size = 32;
+
+    static constexpr std::size_t default_max_pending = 65536;
+
+    static std::shared_ptr<cluster> create(
+        as::any_io_executor exe,
+        std::string node_id,
+        std::string secret,
+        handlers h,
+        std::size_t max_pending = default_max_pending,
+        std::chrono::milliseconds interest_interval = std::chrono::milliseconds(200)
+    ) {
+        return std::make_shared<cluster>(
+            tag_internal{},
+            force_move(exe),
+            force_move(node_id),
+            force_move(secret),
+            force_move(h),
+            max_pending,
+            interest_interval
+        );
+    }
+
+    struct tag_internal {};
+
+    cluster(
+        tag_internal,
+        as::any_io_executor exe,
+        std::string node_id,
+        std::string secret,
+        handlers h,
+        std::size_t max_pending,
+        std::chrono::milliseconds interest_interval
+    ):exe_{force_move(exe)},
+      node_id_{force_move(node_id)},
+      secret_{force_move(secret)},
+      h_{force_move(h)},
+      max_pending_{max_pending},
+      interest_interval_{interest_interval},
+      tim_interest_{exe_}
+    {
+        BOOST_ASSERT(!secret_.empty());
+        store_links(std::make_shared<link_list const>());
+    }
+
+    std::string const& node_id() const {
+        return node_id_;
+    }
+
+    // Accept links from the peers.
+    void listen(as::ip::tcp::endpoint const& endpoint) {
+        {
+            std::lock_guard<std::mutex> g{mtx_};
+            ac_.emplace(exe_, endpoint);
+        }
+        start_interest_timer();
+        async_accept();
+    }
+
+    // Connect to the peer. If the link is closed, it is reconnected.
+    void connect(host_port hp) {
+        start_interest_timer();
+        dial(force_move(hp));
+    }
+
+    struct forward_result {
+        bool forwarded = false; ///< forwarded to at least one peer
+        bool dropped = false;   ///< dropped for at least one interested peer by max_pending
+    };
+
+    // Forward a publish from a local client to the peers that are interested in the topic.
+    forward_result forward(tokenized_topic const& tt, shared_message_ptr const& msg, pub::opts opts) {
+        forward_result ret;
+        auto links = load_links();
+        for (auto const& l : *links) {
+            if (!l->ready.load(std::memory_order_acquire)) continue;
+            if (opts.get_retain() == pub::retain::no && !l->interested(tt)) continue;
+            std::lock_guard<std::mutex> g_link{l->mtx};
+            if (l->pending >= max_pending_) {
+                // The peer is slower than the local publishers. The newest publish is
+                // dropped, and the log is throttled to 1, 2, 4, 8, ... drops.
+                ++l->dropped;
+                if ((l->dropped & (l->dropped - 1)) == 0) {
+                    ASYNC_MQTT_LOG("mqtt_broker", warning)
+                        << "cluster link to " << l->peer << " pending limit reached. dropped:"
+                        << l->dropped << " topic:" << msg->topic();
+                }
+                ret.dropped = true;
+                continue;
+            }
+            ++l->pending;
+            l->queue.push_back(forward_message{msg, opts});
+            ret.forwarded = true;
+            if (!l->flushing) {
+                l->flushing = true;
+                as::post(
+                    l->ep->get_executor(),
+                    [l] {
+                        flush(l);
+                    }
+                );
+            }
+        }
+        return ret;
+    }
+
+    // number of links that have exchanged CONNECT and CONNACK
+    std::size_t ready_links() const {
+        auto links = load_links();
+        return static_cast<std::size_t>(
+            std::count_if(
+                links->begin(),
+                links->end(),
+                [](auto const& l) {
+                    return l->ready.load(std::memory_order_acquire);
+                }
+            )
+        );
+    }
+
+    void stop() {
+        std::shared_ptr<link_list const> links;
+        {
+            std::lock_guard<std::mutex> g{mtx_};
+            stopped_ = true;
+            if (ac_) {
+                error_code ec;
+                ac_->close(ec);
+            }
+            links = load_links();
+            store_links(std::make_shared<link_list const>());
+        }
+        as::post(
+            exe_,
+            [self = shared_from_this()] {
+                self->tim_interest_.cancel();
+            }
+        );
+        for (auto const& l : *links) {
+            l->ep->async_close(as::detached);
+        }
+    }
+
+private:
+    // A shared_ptr that is loaded and stored atomically.
+    template <typename T>
+    class atomic_shared_ptr {
+    public:
+        std::shared_ptr<T> load() const {
+#if defined(__cpp_lib_atomic_shared_ptr)
+            return sp_.load();
+#else  // defined(__cpp_lib_atomic_shared_ptr)
+            return std::atomic_load(&sp_);
+#endif // defined(__cpp_lib_atomic_shared_ptr)
+        }
+
+        void store(std::shared_ptr<T> sp) {
+#if defined(__cpp_lib_atomic_shared_ptr)
+            sp_.store(force_move(sp));
+#else  // defined(__cpp_lib_atomic_shared_ptr)
+            std::atomic_store(&sp_, force_move(sp));
+#endif // defined(__cpp_lib_atomic_shared_ptr)
+        }
+
+    private:
+#if defined(__cpp_lib_atomic_shared_ptr)
+        std::atomic<std::shared_ptr<T>> sp_;
+#else  // defined(__cpp_lib_atomic_shared_ptr)
+        std::shared_ptr<T> sp_;
+#endif // defined(__cpp_lib_atomic_shared_ptr)
+    };
+
+    struct forward_message {
+        shared_message_ptr msg;
+        pub::opts opts;
+    };
+
+    struct link {
+        explicit link(as::any_io_executor exe, std::optional<host_port> dialed)
+            :ep{std::make_shared<link_endpoint>(protocol_version::v5, as::make_strand(exe))},
+             dialed{force_move(dialed)}
+        {
+            // Forwarded publishes that are sent in a row are written together.
+            ep->set_bulk_write(true);
+            ep->set_auto_pub_response(true);
+            ep->set_auto_ping_response(true);
+        }
+
+        bool interested(tokenized_topic const& tt) const {
+            auto i = interest.load();
+            return i && i->may_match(tt);
+        }
+
+        std::shared_ptr<link_endpoint> ep;
+        std::optional<host_port> dialed; ///< set if this node connected to the peer
+        atomic_shared_ptr<interest_summary const> interest;
+        std::atomic<bool> ready{false}; ///< peer is set before ready becomes true
+        mutable std::mutex mtx;
+        std::string peer;
+        std::deque<forward_message> queue;
+        std::size_t pending = 0; ///< queued, being written, or waiting for PUBACK/PUBCOMP
+        std::size_t dropped = 0;
+        bool flushing = false;
+
+        // authentication state, used on the link strand only
+        std::string nonce;      ///< sent to the peer
+        std::string peer_nonce; ///< received from the peer
+        std::string peer_id;    ///< acceptor: node_id of the dialer until CONNACK is sent
+        bool peer_authenticated = false;
+    };
+
+    // Replaced as a whole when a link is added or removed.
+    using link_list = std::vector<std::shared_ptr<link>>;
+
+    std::shared_ptr<link_list const> load_links() const {
+        return links_.load();
+    }
+
+    // called with mtx_ locked
+    void store_links(std::shared_ptr<link_list const> links) {
+        links_.store(force_move(links));
+    }
+
+    static void release_pending(link& l) {
+        std::lock_guard<std::mutex> g{l.mtx};
+        if (l.pending != 0) --l.pending;
+    }
+
+    // Send the queued publishes on the link strand.
+    static void flush(std::shared_ptr<link> const& l) {
+        std::deque<forward_message> queue;
+        {
+            std::lock_guard<std::mutex> g{l->mtx};
+            queue = force_move(l->queue);
+            l->queue.clear();
+            l->flushing = false;
+        }
+        for (auto& fm : queue) {
+            auto fwd_qos = fm.opts.get_qos();
+            typename basic_packet_id_type<4>::type pid = 0;
+            if (fwd_qos != qos::at_most_once) {
+                if (auto pid_opt = l->ep->acquire_unique_packet_id()) {
+                    pid = *pid_opt;
+                }
+                else {
+                    ASYNC_MQTT_LOG("mqtt_broker", warning)
+                        << "cluster link packet_id fully used. forward as QoS0 topic:"
+                        << fm.msg->topic();
+                    fwd_qos = qos::at_most_once;
+                }
+            }
+            l->ep->async_send(
+                v5::basic_publish_packet<4>{
+                    pid,
+                    fm.msg->topic_as_buffer(),
+                    fm.msg->payload(),
+                    fwd_qos | fm.opts.get_retain(),
+                    fm.msg->props()
+                },
+                [l, fwd_qos](error_code const& ec) {
+                    if (ec) {
+                        ASYNC_MQTT_LOG("mqtt_broker", info)
+                            << "cluster link to " << l->peer << " forward error:" << ec.message();
+                    }
+                    // QoS1 and QoS2 are released when PUBACK or PUBCOMP is received
+                    if (ec || fwd_qos == qos::at_most_once) release_pending(*l);
+                }
+            );
+        }
+    }
+
+    void start_interest_timer() {
+        std::lock_guard<std::mutex> g{mtx_};
+        if (interest_timer_started_) return;
+        interest_timer_started_ = true;
+        as::post(
+            exe_,
+            [wp = weak_from_this()] {
+                if (auto self = wp.lock()) self->wait_interest_timer();
+            }
+        );
+    }
+
+    void wait_interest_timer() {
+        tim_interest_.expires_after(interest_interval_);
+        tim_interest_.async_wait(
+            [wp = weak_from_this()](error_code const& ec) {
+                if (ec) return;
+                if (auto self = wp.lock()) {
+                    self->update_interest();
+                    self->wait_interest_timer();
+                }
+            }
+        );
+    }
+
+    // If the local subscriptions are changed, send the new interest to all peers.
+    void update_interest() {
+        {
+            std::lock_guard<std::mutex> g{mtx_};
+            if (stopped_) return;
+        }
+        auto gen = h_.interest_generation();
+        std::vector<std::shared_ptr<link>> links;
+        {
+            std::lock_guard<std::mutex> g{mtx_};
+            if (stopped_) return;
+            if (interest_generation_ && *interest_generation_ == gen) return;
+            interest_generation_.emplace(gen);
+            interest_payload_ = make_interest_payload();
+            for (auto const& l : *load_links()) {
+                if (l->ready.load(std::memory_order_acquire)) links.push_back(l);
+            }
+        }
+        for (auto const& l : links) {
+            send_interest(l);
+        }
+    }
+
+    std::string make_interest_payload() const {
+        return h_.interest();
+    }
+
+    void send_interest(std::shared_ptr<link> const& l) {
+        std::string payload;
+        {
+            std::lock_guard<std::mutex> g{mtx_};
+            payload = interest_payload_;
+        }
+        l->ep->async_send(
+            v5::basic_publish_packet<4>{
+                std::string{interest_topic},
+                force_move(payload),
+                qos::at_most_once
+            },
+            [l](error_code const& ec) {
+                if (ec) {
+                    ASYNC_MQTT_LOG("mqtt_broker", info)
+                        << "cluster link to " << l->peer << " interest send error:" << ec.message();
+                }
+            }
+        );
+    }
+
+    void receive_interest(link& l, std::vector<buffer> const& payload) {
+        std::string str;
+        for (auto const& b : payload) str.append(b.data(), b.size());
+        auto interest = interest_summary::deserialize(str);
+        if (!interest) {
+            ASYNC_MQTT_LOG("mqtt_broker", warning)
+                << "cluster invalid interest from " << l.peer << " size:" << str.size();
+            return;
+        }
+        l.interest.store(std::make_shared<interest_summary const>(force_move(*interest)));
+        ASYNC_MQTT_LOG("mqtt_broker", trace)
+            << "cluster interest from " << l.peer << " size:" << str.size();
+    }
+
+    void async_accept() {
+        std::shared_ptr<link> l;
+        {
+            std::lock_guard<std::mutex> g{mtx_};
+            if (stopped_ || !ac_) return;
+            l = std::make_shared<link>(exe_, std::nullopt);
+            ac_->async_accept(
+                l->ep->lowest_layer(),
+                [wp = weak_from_this(), l](error_code const& ec) {
+                    auto self = wp.lock();
+                    if (!self) return;
+                    if (ec) {
+                        ASYNC_MQTT_LOG("mqtt_broker", info)
+                            << "cluster accept error:" << ec.message();
+                        if (ec == as::error::operation_aborted) return;
+                    }
+                    else {
+                        l->ep->underlying_accepted();
+                        self->add_link(l);
+                        self->async_recv(l);
+                    }
+                    self->async_accept();
+                }
+            );
+        }
+    }
+
+    void dial(host_port hp) {
+        {
+            std::lock_guard<std::mutex> g{mtx_};
+            if (stopped_) return;
+        }
+        auto l = std::make_shared<link>(exe_, hp);
+        l->ep->async_underlying_handshake(
+            hp.host,
+            std::to_string(hp.port),
+            [wp = weak_from_this(), l](error_code const& ec) {
+                auto self = wp.lock();
+                if (!self) return;
+                if (ec) {
+                    ASYNC_MQTT_LOG("mqtt_broker", info)
+                        << "cluster connect to " << *l->dialed << " error:" << ec.message();
+                    self->redial(*l->dialed);
+                    return;
+                }
+                self->add_link(l);
+                l->nonce = make_nonce();
+                l->ep->async_send(
+                    v5::connect_packet{
+                        true,   // clean_start
+                        0,      // keep_alive
+                        std::string{client_id_prefix} + self->node_id_,
+                        std::nullopt, // user_name
+                        std::nullopt, // password
+                        properties{
+                            property::authentication_method{std::string{auth_method}},
+                            property::authentication_data{l->nonce}
+                        }
+                    },
+                    [](error_code const&) {}
+                );
+                self->async_recv(l);
+            }
+        );
+    }
+
+    void redial(host_port hp) {
+        auto tim = std::make_shared<as::steady_timer>(exe_, std::chrono::seconds(1));
+        tim->async_wait(
+            [wp = weak_from_this(), tim, hp = force_move(hp)](error_code const& ec) mutable {
+                if (ec) return;
+                if (auto self = wp.lock()) self->dial(force_move(hp));
+            }
+        );
+    }
+
+    void add_link(std::shared_ptr<link> const& l) {
+        std::lock_guard<std::mutex> g{mtx_};
+        auto links = std::make_shared<link_list>(*load_links());
+        links->push_back(l);
+        store_links(force_move(links));
+    }
+
+    void remove_link(std::shared_ptr<link> const& l) {
+        bool stopped;
+        {
+            std::lock_guard<std::mutex> g{mtx_};
+            stopped = stopped_;
+            auto links = std::make_shared<link_list>(*load_links());
+            links->erase(std::remove(links->begin(), links->end(), l), links->end());
+            store_links(force_move(links));
+        }
+        ASYNC_MQTT_LOG("mqtt_broker", info)
+            << "cluster link to " << l->peer << " closed";
+        l->ep->async_close(as::detached);
+        if (!stopped && l->dialed) redial(*l->dialed);
+    }
+
+    void set_ready(std::shared_ptr<link> const& l, std::string peer) {
+        {
+            std::lock_guard<std::mutex> g{l->mtx};
+            l->peer = force_move(peer);
+        }
+        l->ready.store(true, std::memory_order_release);
+        ASYNC_MQTT_LOG("mqtt_broker", info)
+            << "cluster link to " << l->peer << " established";
+        {
+            std::lock_guard<std::mutex> g{mtx_};
+            if (stopped_) return;
+            if (!interest_generation_) {
+                interest_generation_.emplace(h_.interest_generation());
+                interest_payload_ = make_interest_payload();
+            }
+        }
+        send_interest(l);
+    }
+
+    void async_recv(std::shared_ptr<link> const& l) {
+        l->ep->async_recv(
+            [wp = weak_from_this(), l]
+            (error_code const& ec, std::optional<basic_packet_variant<4>> pv_opt) {
+                auto self = wp.lock();
+                if (!self) return;
+                if (ec) {
+                    self->remove_link(l);
+                    return;
+                }
+                bool cont = true;
+                pv_opt->visit(
+                    overload {
+                        [&](v5::connect_packet& p) {
+                            auto cid = p.client_id();
+                            auto reject =
+                                [&](connect_reason_code rc) {
+                                    ASYNC_MQTT_LOG("mqtt_broker", warning)
+                                        << "cluster link rejected. client_id:" << cid
+                                        << " reason:" << rc;
+                                    l->ep->async_send(
+                                        v5::connack_packet{false, rc},
+                                        [](error_code const&) {}
+                                    );
+                                    cont = false;
+                                };
+                            if (cid.substr(0, client_id_prefix.size()) != client_id_prefix) {
+                                reject(connect_reason_code::client_identifier_not_valid);
+                                return;
+                            }
+                            auto [method, data] = get_auth_props(p.props());
+                            if (method != auth_method) {
+                                reject(connect_reason_code::bad_authentication_method);
+                                return;
+                            }
+                            if (!data || data->size() != nonce_size || !l->nonce.empty()) {
+                                reject(connect_reason_code::not_authorized);
+                                return;
+                            }
+                            l->peer_id = std::string{cid.substr(client_id_prefix.size())};
+                            l->peer_nonce = force_move(*data);
+                            l->nonce = make_nonce();
+                            l->ep->async_send(
+                                v5::auth_packet{
+                                    auth_reason_code::continue_authentication,
+                                    properties{
+                                        property::authentication_method{std::string{auth_method}},
+                                        property::authentication_data{
+                                            l->nonce +
+                                            self->proof("acceptor", l->peer_nonce, l->nonce)
+                                        }
+                                    }
+                                },
+                                [](error_code const&) {}
+                            );
+                        },
+                        [&](v5::auth_packet& p) {
+                            auto [method, data] = get_auth_props(p.props());
+                            if (p.code() != auth_reason_code::continue_authentication ||
+                                method != auth_method ||
+                                !data ||
+                                l->nonce.empty() ||
+                                l->peer_authenticated) {
+                                cont = false;
+                                return;
+                            }
+                            if (l->dialed) {
+                                // proof of the acceptor
+                                if (data->size() <= nonce_size) {
+                                    cont = false;
+                                    return;
+                                }
+                                l->peer_nonce = data->substr(0, nonce_size);
+                                if (!equal(
+                                        std::string_view{*data}.substr(nonce_size),
+                                        self->proof("acceptor", l->nonce, l->peer_nonce))) {
+                                    ASYNC_MQTT_LOG("mqtt_broker", warning)
+                                        << "cluster link to " << *l->dialed << " rejected. invalid proof";
+                                    cont = false;
+                                    return;
+                                }
+                                l->peer_authenticated = true;
+                                l->ep->async_send(
+                                    v5::auth_packet{
+                                        auth_reason_code::continue_authentication,
+                                        properties{
+                                            property::authentication_method{std::string{auth_method}},
+                                            property::authentication_data{
+                                                self->proof("dialer", l->peer_nonce, l->nonce)
+                                            }
+                                        }
+                                    },
+                                    [](error_code const&) {}
+                                );
+                                return;
+                            }
+                            // proof of the dialer
+                            if (!equal(*data, self->proof("dialer", l->nonce, l->peer_nonce))) {
+                                ASYNC_MQTT_LOG("mqtt_broker", warning)
+                                    << "cluster link rejected. node_id:" << l->peer_id
+                                    << " reason:" << connect_reason_code::not_authorized;
+                                l->ep->async_send(
+                                    v5::connack_packet{false, connect_reason_code::not_authorized},
+                                    [](error_code const&) {}
+                                );
+                                cont = false;
+                                return;
+                            }
+                            l->peer_authenticated = true;
+                            l->ep->async_send(
+                                v5::connack_packet{
+                                    false,
+                                    connect_reason_code::success
+                                },
+                                [](error_code const&) {}
+                            );
+                            self->set_ready(l, force_move(l->peer_id));
+                        },
+                        [&](v5::connack_packet& p) {
+                            if (p.code() != connect_reason_code::success) {
+                                cont = false;
+                                return;
+                            }
+                            if (!l->peer_authenticated) {
+                                // The acceptor didn't prove that it knows the secret.
+                                ASYNC_MQTT_LOG("mqtt_broker", warning)
+                                    << "cluster link to " << *l->dialed << " rejected. no proof";
+                                cont = false;
+                                return;
+                            }
+                            self->set_ready(l, to_string(*l->dialed));
+                        },
+                        [&](v5::basic_publish_packet<4>& p) {
+                            if (!l->ready.load(std::memory_order_acquire)) {
+                                // PUBLISH before the CONNECT is accepted
+                                cont = false;
+                                return;
+                            }
+                            if (p.topic() == interest_topic) {
+                                self->receive_interest(*l, p.payload_as_buffer());
+                                return;
+                            }
+                            {
+                                // The handlers refer to the broker that is being destroyed.
+                                std::lock_guard<std::mutex> g{self->mtx_};
+                                if (self->stopped_) return;
+                            }
+                            // dup flag is removed
+                            self->h_.publish(
+                                p.topic(),
+                                p.payload_as_buffer(),
+                                p.opts().get_qos() | p.opts().get_retain(),
+                                p.props()
+                            );
+                        },
+                        [&](v5::basic_puback_packet<4>&) {
+                            release_pending(*l);
+                        },
+                        [&](v5::basic_pubrec_packet<4>& p) {
+                            // PUBCOMP doesn't follow the error PUBREC
+                            if (make_error_code(p.code())) release_pending(*l);
+                        },
+                        [&](v5::basic_pubcomp_packet<4>&) {
+                            release_pending(*l);
+                        },
+                        [&](v5::disconnect_packet&) {
+                            cont = false;
+                        },
+                        [&](auto&) {
+                        }
+                    }
+                );
+                if (cont) {
+                    self->async_recv(l);
+                }
+                else {
+                    self->remove_link(l);
+                }
+            }
+        );
+    }
+
+    static std::string make_nonce() {
+        std::random_device rd;
+        std::string nonce;
+        nonce.reserve(nonce_size);
+        while (nonce.size() != nonce_size) {
+            auto r = rd();
+            for (std::size_t i = 0; i != sizeof(r) && nonce.size() != nonce_size; ++i) {
+                nonce.push_back(static_cast<char>((r >> (i * 8)) & 0xff));
+            }
+        }
+        return nonce;
+    }
+
+    static std::pair<std::optional<std::string>, std::optional<std::string>>
+    get_auth_props(properties const& props) {
+        std::optional<std::string> method;
+        std::optional<std::string> data;
+        for (auto const& prop : props) {
+            prop.visit(
+                overload {
+                    [&](property::authentication_method const& p) {
+                        method.emplace(p.val());
+                    },
+                    [&](property::authentication_data const& p) {
+                        data.emplace(p.val());
+                    },
+                    [](auto const&) {
+                    }
+                }
+            );
+        }
+        return {force_move(method), force_move(data)};
+    }
+
+    // HMAC-SHA256(secret_, role | first | second)
+    // role separates the two proofs, so a proof can't be reflected to the other direction.
+    std::string proof(std::string_view role, std::string_view first, std::string_view second) const {
+        static constexpr std::size_t block_size = 64;
+        std::string key;
+        if (secret_.size() > block_size) {
+            auto d = security::sha256_digest(std::string_view{}, secret_);
+            key.assign(d.begin(), d.end());
+        }
+        else {
+            key = secret_;
+        }
+        key.resize(block_size, '\0');
+        std::string ipad = key;
+        std::string opad = force_move(key);
+        for (auto& c : ipad) c = static_cast<char>(c ^ 0x36);
+        for (auto& c : opad) c = static_cast<char>(c ^ 0x5c);
+
+        std::string msg;
+        msg.reserve(role.size() + first.size() + second.size());
+        msg.append(role);
+        msg.append(first);
+        msg.append(second);
+        auto inner = security::sha256_digest(ipad, msg);
+        auto outer = security::sha256_digest(
+            opad,
+            std::string_view{reinterpret_cast<char const*>(inner.data()), inner.size()}
+        );
+        return std::string{outer.begin(), outer.end()};
+    }
+
+    // compare without early exit to avoid leaking the proof by timing
+    static bool equal(std::string_view lhs, std::string_view rhs) {
+        if (lhs.size() != rhs.size()) return false;
+        unsigned char diff = 0;
+        for (std::size_t i = 0; i != lhs.size(); ++i) {
+            diff |= static_cast<unsigned char>(lhs[i] ^ rhs[i]);
+        }
+        return diff == 0;
+    }
+
+    as::any_io_executor exe_;
+    std::string node_id_;
+    std::string secret_;
+    handlers h_;
+    std::size_t max_pending_;
+    std::chrono::milliseconds interest_interval_;
+    as::steady_timer tim_interest_;
+
+    mutable std::mutex mtx_;
+    std::optional<as::ip::tcp::acceptor> ac_;
+    atomic_shared_ptr<link_list const> links_; ///< stored with mtx_ locked, loaded without it
+    std::optional<std::size_t> interest_generation_;
+    std::string interest_payload_;
+    bool interest_timer_started_ = false;
+    bool stopped_ = false;
+};
+
+} // namespace async_mqtt
+
+#endif // ASYNC_MQTT_BROKER_CLUSTER_HPP
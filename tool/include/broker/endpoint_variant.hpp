@@ -113,6 +113,20 @@ public:
         );
     }
 
+    template <typename Func>
+    void post(Func&& func) const {
+        visit(
+            [&](auto& ep){
+                as::post(
+                    as::bind_executor(
+                        ep.get_executor(),
+                        std::forward<Func>(func)
+                    )
+                );
+            }
+        );
+    }
+
     as::any_io_executor get_executor() {
         return visit(
             [&](auto& ep) -> as::any_io_executor {
@@ -309,6 +323,32 @@ public:
         );
     }
 
+    /**
+     * @brief Get processed but not released QoS2 packet ids as a bitset
+     *        This function should be called after disconnection
+     * @return bitset of packet_ids
+     */
+    basic_packet_id_bitset<packet_id_bytes> get_qos2_publish_handled_pid_bitset() const {
+        return visit(
+            [&](auto& ep) {
+                return ep.get_qos2_publish_handled_pid_bitset();
+            }
+        );
+    }
+
+    /**
+     * @brief Restore processed but not released QoS2 packet ids
+     *        This function should be called before receive the first publish
+     * @param pids packet ids got by get_qos2_publish_handled_pid_bitset()
+     */
+    void restore_qos2_publish_handled_pid_bitset(basic_packet_id_bitset<packet_id_bytes> pids) {
+        visit(
+            [&](auto& ep) {
+                return ep.restore_qos2_publish_handled_pid_bitset(force_move(pids));
+            }
+        );
+    }
+
     void restore_packets(
         std::vector<basic_store_packet_variant<packet_id_bytes>> pvs
     ) {
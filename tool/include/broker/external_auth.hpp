@@ -0,0 +1,346 @@
+// Copyright Takatoshi Kondo 2024
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#if !defined(ASYNC_MQTT_BROKER_EXTERNAL_AUTH_HPP)
+#define ASYNC_MQTT_BROKER_EXTERNAL_AUTH_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/key.hpp>
+
+#include <async_mqtt/util/move.hpp>
+
+#include <broker/keyed_hash.hpp>
+#include <broker/security.hpp>
+
+namespace async_mqtt {
+
+namespace as = boost::asio;
+namespace mi = boost::multi_index;
+
+// Interface of an external authentication and authorization backend.
+// The broker calls it instead of the local security settings when it is set
+// by broker::set_auth_backend().
+// The handlers can be called on any thread, and can be called before the
+// async_* function returns (e.g. on a cache hit).
+class auth_backend {
+public:
+    // username on success, nullopt on failure
+    using authenticate_handler = std::function<void(std::optional<std::string>)>;
+    // true if allowed
+    using authorize_handler = std::function<void(bool)>;
+
+    virtual ~auth_backend() = default;
+
+    virtual void async_authenticate(
+        std::string username,
+        std::string password,
+        authenticate_handler handler
+    ) = 0;
+
+    virtual void async_authorize_publish(
+        std::string username,
+        std::string topic,
+        authorize_handler handler
+    ) = 0;
+};
+
+// Backend that evaluates a security object loaded from the auth file.
+// The result is posted to the executor, so it behaves like a remote backend.
+// It is a stand-in for a database or directory service.
+class security_auth_backend : public auth_backend {
+public:
+    security_auth_backend(as::any_io_executor exe, security sec)
+        :exe_{force_move(exe)},
+         sec_{force_move(sec)}
+    {
+    }
+
+    void async_authenticate(
+        std::string username,
+        std::string password,
+        authenticate_handler handler
+    ) override {
+        ++lookups_;
+        as::post(
+            exe_,
+            [this, username = force_move(username), password = force_move(password), handler = force_move(handler)] {
+                handler(
+                    [&] {
+                        std::lock_guard<std::mutex> g{mtx_};
+                        return sec_.login(username, password);
+                    } ()
+                );
+            }
+        );
+    }
+
+    void async_authorize_publish(
+        std::string username,
+        std::string topic,
+        authorize_handler handler
+    ) override {
+        ++lookups_;
+        as::post(
+            exe_,
+            [this, username = force_move(username), topic = force_move(topic), handler = force_move(handler)] {
+                handler(
+                    [&] {
+                        std::lock_guard<std::mutex> g{mtx_};
+                        return sec_.auth_pub(topic, username) == security::authorization::type::allow;
+                    } ()
+                );
+            }
+        );
+    }
+
+    void set_security(security sec) {
+        std::lock_guard<std::mutex> g{mtx_};
+        sec_ = force_move(sec);
+    }
+
+    // number of requests that reached this backend
+    std::size_t lookups() const {
+        return lookups_;
+    }
+
+private:
+    as::any_io_executor exe_;
+    std::mutex mtx_;
+    security sec_;
+    std::atomic<std::size_t> lookups_{0};
+};
+
+// Decorator that adds a decision cache and request coalescing to a backend.
+// Positive and negative decisions are cached with separate TTLs.
+// Concurrent requests for the same key wait for the first one, so a reconnect
+// storm produces one backend lookup per identity.
+// Passwords are not stored. Authentication keys contain a keyed hash of the password.
+// When the cache is full, the expired entries and then the entry that expires first
+// are evicted by the expiry index, so an insertion doesn't scan the cache.
+// It must be created by std::make_shared.
+class cached_auth_backend
+    : public auth_backend,
+      public std::enable_shared_from_this<cached_auth_backend> {
+public:
+    using clock_type = std::chrono::steady_clock;
+
+    struct stats {
+        std::size_t hits = 0;
+        std::size_t coalesced = 0;
+        std::size_t backend_lookups = 0;
+    };
+
+    cached_auth_backend(
+        std::shared_ptr<auth_backend> backend,
+        clock_type::duration positive_ttl,
+        clock_type::duration negative_ttl,
+        std::size_t capacity = 65536
+    ):backend_{force_move(backend)},
+      positive_ttl_{positive_ttl},
+      negative_ttl_{negative_ttl},
+      capacity_{capacity}
+    {
+    }
+
+    void async_authenticate(
+        std::string username,
+        std::string password,
+        authenticate_handler handler
+    ) override {
+        // MQTT strings never contain U+0000, so it separates the username and the tag.
+        auto key = username;
+        key.push_back('\0');
+        auto tag = tag_(username, password);
+        for (std::size_t i = 0; i != 8; ++i) {
+            key.push_back(static_cast<char>((tag >> (i * 8)) & 0xff));
+        }
+        lookup(
+            authn_,
+            force_move(key),
+            force_move(handler),
+            [&](authenticate_handler h) {
+                backend_->async_authenticate(force_move(username), force_move(password), force_move(h));
+            }
+        );
+    }
+
+    void async_authorize_publish(
+        std::string username,
+        std::string topic,
+        authorize_handler handler
+    ) override {
+        auto key = username;
+        key.push_back('\0');
+        key.append(topic);
+        lookup(
+            authz_pub_,
+            force_move(key),
+            force_move(handler),
+            [&](authorize_handler h) {
+                backend_->async_authorize_publish(force_move(username), force_move(topic), force_move(h));
+            }
+        );
+    }
+
+    // Drop all cached decisions. Pending lookups are not affected.
+    void clear() {
+        std::lock_guard<std::mutex> g{mtx_};
+        authn_.entries.clear();
+        authz_pub_.entries.clear();
+    }
+
+    stats get_stats() const {
+        std::lock_guard<std::mutex> g{mtx_};
+        return stats_;
+    }
+
+private:
+    struct tag_key {};
+    struct tag_expiry {};
+
+    template <typename Result>
+    struct cache {
+        struct entry {
+            std::string key;
+            Result result;
+            clock_type::time_point expiry;
+        };
+        using entry_set = mi::multi_index_container<
+            entry,
+            mi::indexed_by<
+                mi::hashed_unique<
+                    mi::tag<tag_key>,
+                    mi::key<&entry::key>
+                >,
+                mi::ordered_non_unique<
+                    mi::tag<tag_expiry>,
+                    mi::key<&entry::expiry>
+                >
+            >
+        >;
+        entry_set entries;
+        std::unordered_map<std::string, std::vector<std::function<void(Result)>>> pending;
+    };
+
+    static bool is_positive(std::optional<std::string> const& result) {
+        return result.has_value();
+    }
+
+    static bool is_positive(bool result) {
+        return result;
+    }
+
+    template <typename Result, typename Start>
+    void lookup(
+        cache<Result>& c,
+        std::string key,
+        std::function<void(Result)> handler,
+        Start start
+    ) {
+        std::unique_lock<std::mutex> g{mtx_};
+        auto& idx = c.entries.template get<tag_key>();
+        auto it = idx.find(key);
+        if (it != idx.end()) {
+            if (clock_type::now() < it->expiry) {
+                ++stats_.hits;
+                auto result = it->result;
+                g.unlock();
+                handler(force_move(result));
+                return;
+            }
+            idx.erase(it);
+        }
+        auto pit = c.pending.find(key);
+        if (pit != c.pending.end()) {
+            ++stats_.coalesced;
+            pit->second.push_back(force_move(handler));
+            return;
+        }
+        c.pending[key].push_back(force_move(handler));
+        ++stats_.backend_lookups;
+        g.unlock();
+        start(
+            [self = shared_from_this(), &c, key = force_move(key)]
+            (Result result) mutable {
+                self->complete(c, force_move(key), force_move(result));
+            }
+        );
+    }
+
+    template <typename Result>
+    void complete(cache<Result>& c, std::string key, Result result) {
+        std::vector<std::function<void(Result)>> handlers;
+        {
+            std::lock_guard<std::mutex> g{mtx_};
+            auto ttl = is_positive(result) ? positive_ttl_ : negative_ttl_;
+            if (ttl > clock_type::duration::zero()) {
+                auto now = clock_type::now();
+                auto& idx = c.entries.template get<tag_key>();
+                auto it = idx.find(key);
+                if (it != idx.end()) {
+                    idx.replace(it, typename cache<Result>::entry{key, result, now + ttl});
+                }
+                else {
+                    if (c.entries.size() >= capacity_) evict(c, now);
+                    if (c.entries.size() < capacity_) {
+                        idx.insert(typename cache<Result>::entry{key, result, now + ttl});
+                    }
+                }
+            }
+            auto pit = c.pending.find(key);
+            if (pit != c.pending.end()) {
+                handlers = force_move(pit->second);
+                c.pending.erase(pit);
+            }
+        }
+        for (auto& h : handlers) {
+            h(result);
+        }
+    }
+
+    template <typename Result>
+    void evict(cache<Result>& c, clock_type::time_point now) {
+        auto& idx = c.entries.template get<tag_expiry>();
+        while (!idx.empty() && idx.begin()->expiry <= now) {
+            idx.erase(idx.begin());
+        }
+        // all entries are alive, drop the one that expires first
+        if (c.entries.size() >= capacity_ && !idx.empty()) {
+            idx.erase(idx.begin());
+        }
+    }
+
+    std::shared_ptr<auth_backend> backend_;
+    clock_type::duration positive_ttl_;
+    clock_type::duration negative_ttl_;
+    std::size_t capacity_;
+    keyed_hash tag_;
+
+    mutable std::mutex mtx_;
+    cache<std::optional<std::string>> authn_;
+    cache<bool> authz_pub_;
+    stats stats_;
+};
+
+} // namespace async_mqtt
+
+#endif // ASYNC_MQTT_BROKER_EXTERNAL_AUTH_HPP
@@ -12,7 +12,6 @@
 #include <optional>
 #include <variant>
 
-#include <boost/asio/steady_timer.hpp>
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index/sequenced_index.hpp>
@@ -34,9 +33,9 @@ class inflight_message {
 public:
     inflight_message(
         store_packet_variant packet,
-        std::shared_ptr<as::steady_timer> tim_message_expiry)
+        std::optional<std::chrono::steady_clock::time_point> expiry)
         :packet_ { force_move(packet) },
-         tim_message_expiry_ { force_move(tim_message_expiry) }
+         expiry_ { expiry }
     {}
 
     packet_id_type packet_id() const {
@@ -44,8 +43,23 @@ public:
     }
 
     template <typename Epsp>
-    void send(Epsp& epsp) const {
+    void send(Epsp& epsp, std::chrono::steady_clock::time_point now) const {
         std::optional<store_packet_variant> packet_opt;
+        if (expiry_) {
+            // MessageExpiryInterval is updated to the remaining time
+            auto d =
+                std::chrono::duration_cast<std::chrono::seconds>(*expiry_ - now).count();
+            if (d < 0) d = 0;
+            packet_opt.emplace(packet_);
+            packet_opt->visit(
+                overload {
+                    [&](v5::publish_packet& p) {
+                        p.update_message_expiry_interval(static_cast<std::uint32_t>(d));
+                    },
+                    [](auto&) {}
+                }
+            );
+        }
         epsp.register_packet_id(packet_id());
         epsp.async_send(
             packet_opt ? *packet_opt : packet_,
@@ -59,38 +73,98 @@ public:
         );
     }
 
+    bool expired(std::chrono::steady_clock::time_point now) const {
+        return expiry_ && *expiry_ <= now;
+    }
+
     store_packet_variant const& packet() const {
         return packet_;
     }
 
+    std::optional<std::chrono::steady_clock::time_point> const& expiry() const {
+        return expiry_;
+    }
+
 private:
     friend class inflight_messages;
 
     store_packet_variant packet_;
-    std::shared_ptr<as::steady_timer> tim_message_expiry_;
+    std::optional<std::chrono::steady_clock::time_point> expiry_;
 };
 
+// Inflight messages of an offline session.
+// Message expiry is kept as a deadline of each message instead of a timer.
+// Expired messages are swept lazily on insert, erase and resend. The earliest
+// deadline is kept, so a sweep before it is due costs one comparison.
 class inflight_messages {
 public:
     void insert(
         store_packet_variant packet,
-        std::shared_ptr<as::steady_timer> tim_message_expiry
+        std::optional<std::chrono::steady_clock::time_point> expiry
     ) {
+        if (expiry && (!earliest_expiry_ || *expiry < *earliest_expiry_)) {
+            earliest_expiry_ = expiry;
+        }
         messages_.emplace_back(
             force_move(packet),
-            force_move(tim_message_expiry)
+            expiry
         );
     }
 
     template <typename Epsp>
     void send_all_messages(Epsp& epsp) {
+        auto now = std::chrono::steady_clock::now();
+        sweep(now);
         for (auto const& ifm : messages_) {
-            ifm.send(epsp);
+            ifm.send(epsp, now);
+        }
+    }
+
+    std::size_t erase(packet_id_type packet_id) {
+        auto ret = messages_.get<tag_pid>().erase(packet_id);
+        if (messages_.empty()) {
+            earliest_expiry_.reset();
+            return ret;
         }
+        // the clock is read only if a message has an expiry
+        if (earliest_expiry_) sweep(std::chrono::steady_clock::now());
+        return ret;
+    }
+
+    // Remove the expired messages.
+    // Returns the number of the removed messages.
+    std::size_t sweep(std::chrono::steady_clock::time_point now) {
+        if (!earliest_expiry_ || now < *earliest_expiry_) return 0;
+        earliest_expiry_.reset();
+        std::size_t ret = 0;
+        auto& idx = messages_.get<tag_seq>();
+        for (auto it = idx.begin(); it != idx.end();) {
+            if (it->expired(now)) {
+                ASYNC_MQTT_LOG("mqtt_broker", info)
+                    << "message expired:" << it->packet();
+                it = idx.erase(it);
+                ++ret;
+                continue;
+            }
+            if (it->expiry_ && (!earliest_expiry_ || *it->expiry_ < *earliest_expiry_)) {
+                earliest_expiry_ = it->expiry_;
+            }
+            ++it;
+        }
+        return ret;
     }
 
     void clear() {
         messages_.clear();
+        earliest_expiry_.reset();
+    }
+
+    std::size_t size() const {
+        return messages_.size();
+    }
+
+    bool empty() const {
+        return messages_.empty();
     }
 
     template <typename Tag>
@@ -113,15 +187,12 @@ private:
             mi::ordered_unique<
                 mi::tag<tag_pid>,
                 BOOST_MULTI_INDEX_CONST_MEM_FUN(inflight_message, packet_id_type, packet_id)
-            >,
-            mi::ordered_non_unique<
-                mi::tag<tag_tim>,
-                BOOST_MULTI_INDEX_MEMBER(inflight_message, std::shared_ptr<as::steady_timer>, tim_message_expiry_)
             >
         >
     >;
 
     mi_inflight_message messages_;
+    std::optional<std::chrono::steady_clock::time_point> earliest_expiry_;
 };
 
 } // namespace async_mqtt
@@ -0,0 +1,246 @@
+// Copyright Takatoshi Kondo 2024
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#if !defined(ASYNC_MQTT_BROKER_INTEREST_SUMMARY_HPP)
+#define ASYNC_MQTT_BROKER_INTEREST_SUMMARY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <boost/assert.hpp>
+
+#include <broker/topic_filter.hpp>
+#include <broker/tokenized_topic.hpp>
+
+namespace async_mqtt {
+
+// Compact summary of the topic filters of a subscription map.
+// It answers whether a topic may match any of the topic filters.
+// False positives are possible, false negatives are not.
+//
+// Each topic filter is summarized by its literal levels before the first
+// wildcard. A topic filter without wildcards is stored as an exact key,
+// and the other ones are stored as a prefix key. A topic filter that
+// starts with a wildcard matches every topic that doesn't start with '$',
+// so it is counted separately instead of being stored in the filter.
+// The keys are stored in a counting Bloom filter, so topic filters can be
+// removed as well as inserted. A counter that reaches its maximum value
+// sticks there, and never causes a false negative.
+//
+// The level hash is FNV-1a, so the serialized summary can be exchanged
+// between processes.
+class interest_summary {
+public:
+    static constexpr std::uint8_t format_version = 1;
+
+    explicit interest_summary(std::size_t counters = 65536, std::uint8_t hashes = 3)
+        :counters_(counters == 0 ? 1 : counters),
+         hashes_{hashes == 0 ? std::uint8_t(1) : hashes}
+    {
+    }
+
+    void insert(std::string_view topic_filter) {
+        update(topic_filter, true);
+    }
+
+    void erase(std::string_view topic_filter) {
+        update(topic_filter, false);
+    }
+
+    // number of inserted and not erased topic filters
+    std::size_t size() const {
+        return size_;
+    }
+
+    bool may_match(std::string_view topic) const {
+        return may_match(tokenized_topic{topic});
+    }
+
+    bool may_match(tokenized_topic const& topic) const {
+        if (topic.size() == 0) return false;
+        if (root_wildcards_ != 0 && topic[0].name.substr(0, 1) != "$") return true;
+        auto h = hash_seed;
+        for (auto const& level : topic) {
+            h = hash_level(h, level.name);
+            if (contains(prefix_key(h))) return true;
+        }
+        return contains(exact_key(h));
+    }
+
+    // Serialized format (integers are big endian)
+    //   1 byte   format_version
+    //   1 byte   number of hashes
+    //   4 bytes  number of bits
+    //   1 byte   1 if any topic filter starts with a wildcard, otherwise 0
+    //   n bytes  bits, the least significant bit of the first byte is bit 0
+    // The counters are reduced to bits, so a deserialized summary is for may_match() only.
+    std::string serialize() const {
+        BOOST_ASSERT(counters_.size() <= std::numeric_limits<std::uint32_t>::max());
+        auto bits = static_cast<std::uint32_t>(counters_.size());
+        std::string ret;
+        ret.reserve(header_size + (bits + 7) / 8);
+        ret.push_back(static_cast<char>(format_version));
+        ret.push_back(static_cast<char>(hashes_));
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            ret.push_back(static_cast<char>((bits >> shift) & 0xff));
+        }
+        ret.push_back(static_cast<char>(root_wildcards_ != 0 ? 1 : 0));
+        std::uint8_t byte = 0;
+        for (std::size_t i = 0; i != counters_.size(); ++i) {
+            if (counters_[i] != 0) byte |= static_cast<std::uint8_t>(1 << (i % 8));
+            if (i % 8 == 7) {
+                ret.push_back(static_cast<char>(byte));
+                byte = 0;
+            }
+        }
+        if (counters_.size() % 8 != 0) ret.push_back(static_cast<char>(byte));
+        return ret;
+    }
+
+    static std::optional<interest_summary> deserialize(std::string_view data) {
+        if (data.size() < header_size) return std::nullopt;
+        auto u8 = [&](std::size_t i) { return static_cast<std::uint8_t>(data[i]); };
+        if (u8(0) != format_version) return std::nullopt;
+        std::uint8_t hashes = u8(1);
+        std::uint32_t bits =
+            std::uint32_t(u8(2)) << 24 |
+            std::uint32_t(u8(3)) << 16 |
+            std::uint32_t(u8(4)) << 8 |
+            std::uint32_t(u8(5));
+        if (hashes == 0 || bits == 0) return std::nullopt;
+        if (data.size() != header_size + (std::size_t(bits) + 7) / 8) return std::nullopt;
+
+        interest_summary ret{bits, hashes};
+        ret.root_wildcards_ = u8(6) != 0 ? 1 : 0;
+        for (std::size_t i = 0; i != bits; ++i) {
+            if (u8(header_size + i / 8) & (1 << (i % 8))) {
+                ret.counters_[i] = 1;
+            }
+        }
+        return ret;
+    }
+
+private:
+    static constexpr std::size_t header_size = 7;
+    static constexpr std::uint64_t hash_seed = 14695981039346656037ull;
+    static constexpr std::uint64_t hash_prime = 1099511628211ull;
+    static constexpr std::uint8_t counter_max = std::numeric_limits<std::uint8_t>::max();
+
+    static std::uint64_t hash_level(std::uint64_t h, std::string_view level) {
+        for (auto c : level) {
+            h ^= static_cast<std::uint8_t>(c);
+            h *= hash_prime;
+        }
+        // '/' never appears in a level, so "a/bc" and "ab/c" are distinguished
+        h ^= static_cast<std::uint8_t>('/');
+        h *= hash_prime;
+        return h;
+    }
+
+    // splitmix64 finalizer
+    static std::uint64_t mix(std::uint64_t h) {
+        h ^= h >> 30;
+        h *= 0xbf58476d1ce4e5b9ull;
+        h ^= h >> 27;
+        h *= 0x94d049bb133111ebull;
+        h ^= h >> 31;
+        return h;
+    }
+
+    static std::uint64_t exact_key(std::uint64_t h) {
+        return mix(h ^ 0x65);
+    }
+
+    static std::uint64_t prefix_key(std::uint64_t h) {
+        return mix(h ^ 0x70);
+    }
+
+    template <typename Func>
+    void for_each_index(std::uint64_t key, Func&& func) const {
+        // double hashing
+        auto h2 = mix(key) | 1;
+        for (std::uint8_t i = 0; i != hashes_; ++i) {
+            func(static_cast<std::size_t>((key + i * h2) % counters_.size()));
+        }
+    }
+
+    bool contains(std::uint64_t key) const {
+        bool ret = true;
+        for_each_index(
+            key,
+            [&](std::size_t idx) {
+                if (counters_[idx] == 0) ret = false;
+            }
+        );
+        return ret;
+    }
+
+    void update(std::string_view topic_filter, bool insert) {
+        auto h = hash_seed;
+        std::size_t literal_levels = 0;
+        bool wildcard = false;
+        topic_filter_tokenizer(
+            topic_filter,
+            [&](std::string_view level) {
+                if (level == "+" || level == "#") {
+                    wildcard = true;
+                    return false;
+                }
+                h = hash_level(h, level);
+                ++literal_levels;
+                return true;
+            }
+        );
+
+        if (insert) {
+            ++size_;
+        }
+        else {
+            BOOST_ASSERT(size_ > 0);
+            --size_;
+        }
+
+        if (wildcard && literal_levels == 0) {
+            if (insert) {
+                ++root_wildcards_;
+            }
+            else {
+                BOOST_ASSERT(root_wildcards_ > 0);
+                --root_wildcards_;
+            }
+            return;
+        }
+
+        for_each_index(
+            wildcard ? prefix_key(h) : exact_key(h),
+            [&](std::size_t idx) {
+                auto& c = counters_[idx];
+                if (c == counter_max) return;
+                if (insert) {
+                    ++c;
+                }
+                else {
+                    BOOST_ASSERT(c > 0);
+                    --c;
+                }
+            }
+        );
+    }
+
+    std::vector<std::uint8_t> counters_;
+    std::uint8_t hashes_;
+    std::size_t root_wildcards_ = 0;
+    std::size_t size_ = 0;
+};
+
+} // namespace async_mqtt
+
+#endif // ASYNC_MQTT_BROKER_INTEREST_SUMMARY_HPP
@@ -0,0 +1,100 @@
+// Copyright Takatoshi Kondo 2024
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#if !defined(ASYNC_MQTT_BROKER_KEYED_HASH_HPP)
+#define ASYNC_MQTT_BROKER_KEYED_HASH_HPP
+
+#include <array>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <string_view>
+
+namespace async_mqtt {
+
+// SipHash-2-4 with a random per-instance key.
+// It is used to keep a short tag of credentials instead of the credentials themselves.
+// The key is generated per instance and never leaves the process.
+class keyed_hash {
+public:
+    keyed_hash() {
+        std::random_device rd;
+        for (auto& k : key_) {
+            k = (std::uint64_t(rd()) << 32) | std::uint64_t(rd());
+        }
+    }
+
+    // Tag of the pair. The first element is prefixed by its length
+    // to avoid ambiguity between ("ab", "c") and ("a", "bc").
+    std::uint64_t operator()(std::string_view first, std::string_view second) const {
+        std::string msg;
+        msg.reserve(8 + first.size() + second.size());
+        auto len = first.size();
+        for (std::size_t i = 0; i != 8; ++i) {
+            msg.push_back(static_cast<char>((len >> (i * 8)) & 0xff));
+        }
+        msg.append(first);
+        msg.append(second);
+        return siphash24(msg);
+    }
+
+private:
+    static std::uint64_t rotl(std::uint64_t x, int b) {
+        return (x << b) | (x >> (64 - b));
+    }
+
+    std::uint64_t siphash24(std::string_view msg) const {
+        std::uint64_t v0 = 0x736f6d6570736575ULL ^ key_[0];
+        std::uint64_t v1 = 0x646f72616e646f6dULL ^ key_[1];
+        std::uint64_t v2 = 0x6c7967656e657261ULL ^ key_[0];
+        std::uint64_t v3 = 0x7465646279746573ULL ^ key_[1];
+
+        auto round =
+            [&] {
+                v0 += v1; v1 = rotl(v1, 13); v1 ^= v0; v0 = rotl(v0, 32);
+                v2 += v3; v3 = rotl(v3, 16); v3 ^= v2;
+                v0 += v3; v3 = rotl(v3, 21); v3 ^= v0;
+                v2 += v1; v1 = rotl(v1, 17); v1 ^= v2; v2 = rotl(v2, 32);
+            };
+
+        auto load =
+            [&](std::size_t pos, std::size_t n) {
+                std::uint64_t m = 0;
+                for (std::size_t i = 0; i != n; ++i) {
+                    m |= std::uint64_t(static_cast<unsigned char>(msg[pos + i])) << (i * 8);
+                }
+                return m;
+            };
+
+        std::size_t const size = msg.size();
+        std::size_t pos = 0;
+        for (; pos + 8 <= size; pos += 8) {
+            auto m = load(pos, 8);
+            v3 ^= m;
+            round();
+            round();
+            v0 ^= m;
+        }
+        auto b = (std::uint64_t(size) << 56) | load(pos, size - pos);
+        v3 ^= b;
+        round();
+        round();
+        v0 ^= b;
+
+        v2 ^= 0xff;
+        round();
+        round();
+        round();
+        round();
+        return v0 ^ v1 ^ v2 ^ v3;
+    }
+
+    std::array<std::uint64_t, 2> key_;
+};
+
+} // namespace async_mqtt
+
+#endif // ASYNC_MQTT_BROKER_KEYED_HASH_HPP
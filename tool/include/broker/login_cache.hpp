@@ -0,0 +1,97 @@
+// Copyright Takatoshi Kondo 2024
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#if !defined(ASYNC_MQTT_BROKER_LOGIN_CACHE_HPP)
+#define ASYNC_MQTT_BROKER_LOGIN_CACHE_HPP
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include <broker/keyed_hash.hpp>
+
+namespace async_mqtt {
+
+// Cache of recent successful password logins.
+// A reconnect storm makes the broker verify the same credentials many times.
+// Each entry keeps only a keyed 64bit SipHash-2-4 tag of the password,
+// so a hit costs one short hash instead of the configured digest.
+// The cache must be cleared whenever the authentication settings are replaced.
+class login_cache {
+public:
+    explicit login_cache(std::size_t capacity = 4096)
+        : capacity_{capacity}
+    {
+    }
+
+    bool check(std::string_view username, std::string_view password) {
+        if (capacity_ == 0) return false;
+        auto t = tag_(username, password);
+        std::lock_guard<std::mutex> g{mtx_};
+        auto it = entries_.find(username);
+        if (it == entries_.end()) return false;
+        if (it->second.tag != t) return false;
+        // move to the most recently used position
+        lru_.splice(lru_.begin(), lru_, it->second.lru_it);
+        return true;
+    }
+
+    void store(std::string_view username, std::string_view password) {
+        if (capacity_ == 0) return;
+        auto t = tag_(username, password);
+        std::lock_guard<std::mutex> g{mtx_};
+        auto it = entries_.find(username);
+        if (it != entries_.end()) {
+            it->second.tag = t;
+            lru_.splice(lru_.begin(), lru_, it->second.lru_it);
+            return;
+        }
+        if (entries_.size() >= capacity_) {
+            entries_.erase(lru_.back());
+            lru_.pop_back();
+        }
+        lru_.emplace_front(username);
+        entries_.emplace(lru_.front(), entry{t, lru_.begin()});
+    }
+
+    void erase(std::string_view username) {
+        std::lock_guard<std::mutex> g{mtx_};
+        auto it = entries_.find(username);
+        if (it == entries_.end()) return;
+        lru_.erase(it->second.lru_it);
+        entries_.erase(it);
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> g{mtx_};
+        entries_.clear();
+        lru_.clear();
+    }
+
+    std::size_t size() const {
+        std::lock_guard<std::mutex> g{mtx_};
+        return entries_.size();
+    }
+
+private:
+    struct entry {
+        std::uint64_t tag;
+        std::list<std::string>::iterator lru_it;
+    };
+
+    keyed_hash tag_;
+    std::size_t capacity_;
+    mutable std::mutex mtx_;
+    std::list<std::string> lru_;
+    std::unordered_map<std::string_view, entry> entries_;
+};
+
+} // namespace async_mqtt
+
+#endif // ASYNC_MQTT_BROKER_LOGIN_CACHE_HPP
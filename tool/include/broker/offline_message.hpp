@@ -7,13 +7,13 @@
 #if !defined(ASYNC_MQTT_BROKER_OFFLINE_MESSAGE_HPP)
 #define ASYNC_MQTT_BROKER_OFFLINE_MESSAGE_HPP
 
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <memory>
 #include <optional>
-
-#include <boost/asio/steady_timer.hpp>
-#include <boost/multi_index_container.hpp>
-#include <boost/multi_index/ordered_index.hpp>
-#include <boost/multi_index/sequenced_index.hpp>
-#include <boost/multi_index/key.hpp>
+#include <string>
 
 #include <async_mqtt/util/buffer.hpp>
 #include <async_mqtt/util/log.hpp>
@@ -25,14 +25,34 @@
 #include <async_mqtt/protocol/packet/v5_pubrel.hpp>
 #include <async_mqtt/protocol/packet/pubopts.hpp>
 
-#include <broker/tags.hpp>
+#include <broker/shared_message.hpp>
+#include <broker/offline_spill.hpp>
 
 namespace async_mqtt {
 
-namespace mi = boost::multi_index;
-
 class offline_messages;
 
+// What to do when a new message exceeds the limit of the offline queue.
+enum class offline_overflow_policy {
+    drop_oldest, // drop the oldest messages to make room
+    drop_newest  // drop the new message
+};
+
+// Limits of the offline queue of a session. 0 means unlimited.
+struct offline_queue_config {
+    std::size_t max_messages = 0;
+    std::size_t max_bytes = 0;
+    offline_overflow_policy overflow_policy = offline_overflow_policy::drop_oldest;
+    // If more than spill_threshold messages are in memory, the following messages
+    // are written to a segment file in spill_dir. 0 disables the spill.
+    std::size_t spill_threshold = 0;
+    std::string spill_dir;
+    // Expired messages are removed in bulk at most once per this interval.
+    std::chrono::steady_clock::duration compaction_interval = std::chrono::seconds(1);
+    // Maximum number of messages sent by one replay step. 0 means unlimited.
+    std::size_t replay_batch_size = 256;
+};
+
 // The offline_message structure holds messages that have been published on a
 // topic that a not-currently-connected client is subscribed to.
 // When a new connection is made with the client id for this saved data,
@@ -40,21 +60,23 @@ class offline_messages;
 class offline_message {
 public:
     offline_message(
-        std::string topic,
-        std::vector<buffer> payload,
+        shared_message_ptr msg,
         pub::opts pubopts,
-        properties props,
-        std::shared_ptr<as::steady_timer> tim_message_expiry)
-        : topic_{force_move(topic)},
-          payload_(force_move(payload)),
+        std::optional<std::size_t> sid,
+        std::optional<std::chrono::steady_clock::time_point> expiry)
+        : msg_{force_move(msg)},
           pubopts_{pubopts},
-          props_(force_move(props)),
-          tim_message_expiry_{force_move(tim_message_expiry)}
+          sid_{sid},
+          expiry_{expiry}
     {
     }
 
+    // now is read once by the caller for a batch of messages
+    // The packet is built only when the message is sent, so the queued messages
+    // share the body with the other subscribers, and the expired or dropped
+    // messages are never built.
     template <typename Epsp>
-    bool send(Epsp epsp, protocol_version ver) {
+    bool send(Epsp epsp, protocol_version ver, std::chrono::steady_clock::time_point now) {
         auto publish =
             [&] (packet_id_type pid) {
                 switch (ver) {
@@ -62,8 +84,8 @@ public:
                     epsp.async_send(
                         v3_1_1::publish_packet{
                             pid,
-                            topic_,
-                            payload_,
+                            msg_->topic_as_buffer(),
+                            msg_->payload(),
                             pubopts_
                         },
                         [epsp](error_code const& ec) {
@@ -79,15 +101,15 @@ public:
                     auto packet =
                         v5::publish_packet{
                             pid,
-                            topic_,
-                            payload_,
+                            msg_->topic_as_buffer(),
+                            msg_->payload(),
                             pubopts_,
-                            props_
+                            msg_->props_for(sid_)
                         };
-                    if (tim_message_expiry_) {
+                    if (expiry_) {
                         auto d =
                             std::chrono::duration_cast<std::chrono::seconds>(
-                                tim_message_expiry_->expiry() - std::chrono::steady_clock::now()
+                                *expiry_ - now
                             ).count();
                         if (d < 0) d = 0;
                         packet.update_message_expiry_interval(static_cast<uint32_t>(d));
@@ -126,106 +148,271 @@ public:
         }
     }
 
+    bool expired(std::chrono::steady_clock::time_point now) const {
+        return expiry_ && *expiry_ <= now;
+    }
+
+    // approximate memory usage of the message, used for the byte limit
+    std::size_t bytes() const {
+        std::size_t ret = msg_->topic().size();
+        for (auto const& b : msg_->payload()) ret += b.size();
+        for (auto const& p : msg_->props()) ret += p.size();
+        return ret;
+    }
+
 private:
     friend class offline_messages;
 
-    std::string topic_;
-    std::vector<buffer> payload_;
+    shared_message_ptr msg_;
     pub::opts pubopts_;
-    properties props_;
-    std::shared_ptr<as::steady_timer> tim_message_expiry_;
+    std::optional<std::size_t> sid_;
+    std::optional<std::chrono::steady_clock::time_point> expiry_;
 };
 
+// Offline queue of a session.
+// Messages are kept in memory in arrival order. Message expiry doesn't use a
+// timer per message. Expired messages are skipped on send, and removed in bulk
+// when a message is pushed after compaction_interval.
+// If the spill is enabled, the messages over spill_threshold are appended to
+// an on-disk segment, and read back in order when the memory part is sent.
+// If the spill fails, it is treated as an overflow by overflow_policy.
+// The spilled messages that have an expiry are counted per second of the expiry,
+// so the compaction excludes the expired ones from size() and bytes() without
+// reading the segment, and they don't push live messages out by the limits.
 class offline_messages {
 public:
+    void set_config(std::shared_ptr<offline_queue_config const> config) {
+        config_ = force_move(config);
+    }
+
+    // Send messages until the packet ids are exhausted or replay_batch_size
+    // messages are sent. It should be called on the strand of epsp.
+    // Returns true if the batch is full and messages remain.
     template <typename Epsp>
-    void send_until_fail(Epsp& epsp, protocol_version ver) {
-        epsp.dispatch(
-            [this, epsp, ver] {
-                auto& idx = messages_.get<tag_seq>();
-                while (!idx.empty()) {
-                    auto it = idx.begin();
-
-                    // const_cast is appropriate here
-                    // See https://github.com/boostorg/multi_index/issues/50
-                    auto& m = const_cast<offline_message&>(*it);
-                    if (m.send(epsp, ver)) {
-                        idx.pop_front();
-                    }
-                    else {
-                        break;
-                    }
-                }
+    bool send_batch(Epsp& epsp, protocol_version ver) {
+        auto limit = config_ ? config_->replay_batch_size : offline_queue_config{}.replay_batch_size;
+        auto now = std::chrono::steady_clock::now();
+        std::size_t sent = 0;
+        while (true) {
+            if (messages_.empty() && !refill()) return false;
+            if (limit != 0 && sent == limit) return true;
+            auto& m = messages_.front();
+            if (m.expired(now)) {
+                pop_front();
+                continue;
             }
-        );
+            if (!m.send(epsp, ver, now)) return false;
+            pop_front();
+            ++sent;
+        }
     }
 
     void clear() {
         messages_.clear();
+        spill_.reset();
+        spilled_expiry_.clear();
+        spilled_expired_until_.reset();
+        count_ = 0;
+        bytes_ = 0;
     }
 
     bool empty() const {
-        return messages_.empty();
+        return count_ == 0;
+    }
+
+    // number of messages in memory and on disk
+    std::size_t size() const {
+        return count_;
+    }
+
+    // approximate bytes of messages in memory and on disk
+    std::size_t bytes() const {
+        return bytes_;
+    }
+
+    // number of messages dropped by the limits
+    std::size_t dropped() const {
+        return dropped_;
     }
 
     void push_back(
-        as::any_io_executor exe,
-        std::string pub_topic,
-        std::vector<buffer> payload,
+        shared_message_ptr msg,
         pub::opts pubopts,
-        properties props) {
-        std::optional<std::chrono::steady_clock::duration> message_expiry_interval;
-
-        for (auto const& prop : props) {
-            prop.visit(
-                overload {
-                    [&](property::message_expiry_interval const& p) {
-                        message_expiry_interval.emplace(std::chrono::seconds(p.val()));
-                    },
-                    [](auto const&){}
+        std::optional<std::size_t> sid) {
+        auto now = std::chrono::steady_clock::now();
+        compact(now);
+
+        std::optional<std::chrono::steady_clock::time_point> expiry;
+        if (auto message_expiry_interval = msg->message_expiry_interval()) {
+            expiry.emplace(now + *message_expiry_interval);
+        }
+        offline_message m{force_move(msg), pubopts, sid, expiry};
+        auto m_bytes = m.bytes();
+
+        if (config_) {
+            auto over =
+                [&] {
+                    return
+                        (config_->max_messages != 0 && count_ + 1 > config_->max_messages) ||
+                        (config_->max_bytes != 0 && bytes_ + m_bytes > config_->max_bytes);
+                };
+            if (over()) {
+                if (config_->overflow_policy == offline_overflow_policy::drop_newest) {
+                    ++dropped_;
+                    return;
+                }
+                while (count_ != 0 && over()) {
+                    if (messages_.empty()) refill();
+                    if (messages_.empty()) break;
+                    pop_front();
+                    ++dropped_;
+                }
+                if (over()) {
+                    // the message itself exceeds the limit
+                    ++dropped_;
+                    return;
                 }
-            );
+            }
         }
 
-        std::shared_ptr<as::steady_timer> tim_message_expiry;
-        if (message_expiry_interval) {
-            tim_message_expiry = std::make_shared<as::steady_timer>(exe, *message_expiry_interval);
-            tim_message_expiry->async_wait(
-                [this, wp = std::weak_ptr<as::steady_timer>(tim_message_expiry)](error_code ec) mutable {
-                    if (auto sp = wp.lock()) {
-                        if (!ec) {
-                            messages_.get<tag_tim>().erase(sp);
-                        }
-                    }
+        if (spill_enabled() &&
+            ((spill_ && !spill_->empty()) || messages_.size() >= config_->spill_threshold)) {
+            if (!spill_) {
+                spill_ = offline_spill::create(config_->spill_dir);
+            }
+            if (spill_ &&
+                spill_->write(offline_spill::record{m.msg_, m.pubopts_, m.sid_, m.expiry_})) {
+                if (m.expiry_) {
+                    auto& b = spilled_expiry_[expiry_bucket(*m.expiry_)];
+                    ++b.count;
+                    b.bytes += m_bytes;
                 }
-            );
+                ++count_;
+                bytes_ += m_bytes;
+                return;
+            }
+            // The spill failure is treated as an overflow, so that the memory part
+            // doesn't grow over spill_threshold.
+            // On drop_oldest, the oldest message is dropped and the new one is kept in
+            // memory. It is possible only if nothing is spilled, otherwise the new one
+            // can't be queued after the spilled ones, and it is dropped.
+            ++dropped_;
+            if (config_->overflow_policy != offline_overflow_policy::drop_oldest ||
+                (spill_ && !spill_->empty()) ||
+                messages_.empty()) {
+                return;
+            }
+            pop_front();
         }
+        messages_.push_back(force_move(m));
+        ++count_;
+        bytes_ += m_bytes;
+    }
+
+private:
+    bool spill_enabled() const {
+        return config_ && config_->spill_threshold != 0;
+    }
+
+    void pop_front() {
+        BOOST_ASSERT(!messages_.empty());
+        bytes_ -= std::min(bytes_, messages_.front().bytes());
+        --count_;
+        messages_.pop_front();
+    }
+
+    struct spilled_bucket {
+        std::size_t count = 0;
+        std::size_t bytes = 0;
+    };
+
+    // The key of the bucket is later than all expiries in the bucket.
+    static std::chrono::steady_clock::time_point expiry_bucket(std::chrono::steady_clock::time_point expiry) {
+        return
+            std::chrono::floor<std::chrono::seconds>(expiry) +
+            std::chrono::seconds(1);
+    }
+
+    // Read the messages from the spill file into memory.
+    // Returns true if any message is read.
+    bool refill() {
+        if (!spill_ || spill_->empty()) return false;
+        auto limit = config_ ? std::max<std::size_t>(config_->spill_threshold, 1) : 1;
+        if (messages_.size() >= limit) return !messages_.empty();
+        do {
+            auto before = spill_->size();
+            // The segment file is opened once for the batch.
+            auto records = spill_->read(limit - messages_.size());
+            for (auto& r : records) {
+                std::optional<std::chrono::steady_clock::time_point> key;
+                if (r.expiry) {
+                    key.emplace(expiry_bucket(*r.expiry));
+                    // already excluded by the compaction
+                    if (spilled_expired_until_ && *key <= *spilled_expired_until_) continue;
+                }
+                messages_.emplace_back(force_move(r.msg), r.pubopts, r.sid, r.expiry);
+                if (key) {
+                    auto it = spilled_expiry_.find(*key);
+                    if (it != spilled_expiry_.end()) {
+                        it->second.bytes -= std::min(it->second.bytes, messages_.back().bytes());
+                        if (--it->second.count == 0) spilled_expiry_.erase(it);
+                    }
+                }
+            }
+            if (before - records.size() != spill_->size()) {
+                // The remaining records are dropped if the file is broken.
+                spilled_expiry_.clear();
+                count_ = messages_.size();
+                bytes_ = 0;
+                for (auto const& m : messages_) bytes_ += m.bytes();
+            }
+        } while (messages_.empty() && !spill_->empty());
+        return !messages_.empty();
+    }
 
-        auto& seq_idx = messages_.get<tag_seq>();
-        seq_idx.emplace_back(
-            force_move(pub_topic),
-            force_move(payload),
-            pubopts,
-            force_move(props),
-            force_move(tim_message_expiry)
+    // Remove the expired messages in memory in bulk.
+    // Expired messages on disk are excluded from count_ and bytes_ here, and
+    // skipped when they are read.
+    void compact(std::chrono::steady_clock::time_point now) {
+        auto interval = config_ ? config_->compaction_interval : std::chrono::seconds(1);
+        if (now < next_compaction_) return;
+        next_compaction_ = now + interval;
+        auto it = std::remove_if(
+            messages_.begin(), messages_.end(),
+            [&](offline_message const& m) {
+                if (!m.expired(now)) return false;
+                bytes_ -= std::min(bytes_, m.bytes());
+                --count_;
+                return true;
+            }
         );
+        messages_.erase(it, messages_.end());
+
+        while (!spilled_expiry_.empty() && spilled_expiry_.begin()->first <= now) {
+            auto const& b = spilled_expiry_.begin()->second;
+            count_ -= std::min(count_, b.count);
+            bytes_ -= std::min(bytes_, b.bytes);
+            spilled_expired_until_ = spilled_expiry_.begin()->first;
+            spilled_expiry_.erase(spilled_expiry_.begin());
+        }
+        // Only expired messages are left on disk.
+        if (count_ == 0 && spill_) {
+            spill_.reset();
+            spilled_expiry_.clear();
+            spilled_expired_until_.reset();
+        }
     }
 
-private:
-    using mi_offline_message = mi::multi_index_container<
-        offline_message,
-        mi::indexed_by<
-            mi::sequenced<
-                mi::tag<tag_seq>
-            >,
-            mi::ordered_non_unique<
-                mi::tag<tag_tim>,
-                mi::key<&offline_message::tim_message_expiry_>
-            >
-        >
-    >;
-
-    mi_offline_message messages_;
+    std::shared_ptr<offline_queue_config const> config_;
+    std::deque<offline_message> messages_;
+    std::optional<offline_spill> spill_;
+    std::map<std::chrono::steady_clock::time_point, spilled_bucket> spilled_expiry_;
+    // The buckets up to this key have been excluded from count_ and bytes_.
+    std::optional<std::chrono::steady_clock::time_point> spilled_expired_until_;
+    std::size_t count_ = 0;
+    std::size_t bytes_ = 0;
+    std::size_t dropped_ = 0;
+    std::chrono::steady_clock::time_point next_compaction_{};
 };
 
 } // namespace async_mqtt
@@ -0,0 +1,377 @@
+// Copyright Takatoshi Kondo 2024
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#if !defined(ASYNC_MQTT_BROKER_OFFLINE_SPILL_HPP)
+#define ASYNC_MQTT_BROKER_OFFLINE_SPILL_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include <async_mqtt/util/buffer.hpp>
+#include <async_mqtt/util/log.hpp>
+#include <async_mqtt/util/move.hpp>
+#include <async_mqtt/protocol/packet/property_variant.hpp>
+#include <async_mqtt/protocol/packet/pubopts.hpp>
+
+#include <broker/shared_message.hpp>
+#include <broker/uuid.hpp>
+
+namespace async_mqtt {
+
+// On-disk segment of an offline queue.
+// Records are appended at the end and read from the beginning, so the order
+// is kept. When all records are read, the file is truncated.
+// The file is removed when the segment is destroyed.
+// Records are encoded into a write buffer, and the buffer is appended to the file
+// when it exceeds write_buffer_size or the records are read. So the file is opened
+// once per batch of records, not per record, and a broker with many spilling
+// sessions doesn't keep a file descriptor per session.
+// If the file can't be written, the records stay in the buffer and are read from
+// it. A new record is rejected when the buffer exceeds max_write_buffer_size.
+//
+// Record format (integers are big endian)
+//   4 bytes  body length
+//   1 byte   publish options
+//   1 byte   1 if subscription identifier exists, otherwise 0
+//   4 bytes  subscription identifier
+//   1 byte   1 if expiry exists, otherwise 0
+//   8 bytes  expiry (steady_clock ticks, valid only in this process)
+//   4 bytes  topic length, and topic
+//   4 bytes  properties length, and properties (MQTT v5 encoding)
+//   4 bytes  payload length, and payload
+class offline_spill {
+public:
+    struct record {
+        shared_message_ptr msg;
+        pub::opts pubopts;
+        std::optional<std::size_t> sid;
+        std::optional<std::chrono::steady_clock::time_point> expiry;
+    };
+
+    static constexpr std::size_t write_buffer_size = 64 * 1024;
+    static constexpr std::size_t max_write_buffer_size = 4 * write_buffer_size;
+
+    // Create a segment file in dir. If it fails, std::nullopt is returned.
+    static std::optional<offline_spill> create(std::filesystem::path const& dir) {
+        std::error_code ec;
+        std::filesystem::create_directories(dir, ec);
+        auto path = dir / ("offline_" + create_uuid_string() + ".seg");
+        if (!std::ofstream{path, std::ios::binary | std::ios::trunc}) {
+            ASYNC_MQTT_LOG("mqtt_broker", warning)
+                << "offline spill file open error:" << path.string();
+            return std::nullopt;
+        }
+        return offline_spill{force_move(path)};
+    }
+
+    offline_spill(offline_spill&& other) noexcept
+        :path_{force_move(other.path_)},
+         read_pos_{other.read_pos_},
+         write_pos_{other.write_pos_},
+         count_{other.count_},
+         buf_{force_move(other.buf_)},
+         buf_count_{other.buf_count_}
+    {
+        other.path_.clear();
+    }
+
+    offline_spill& operator=(offline_spill&& other) noexcept {
+        if (this != &other) {
+            remove();
+            path_ = force_move(other.path_);
+            read_pos_ = other.read_pos_;
+            write_pos_ = other.write_pos_;
+            count_ = other.count_;
+            buf_ = force_move(other.buf_);
+            buf_count_ = other.buf_count_;
+            other.path_.clear();
+        }
+        return *this;
+    }
+
+    ~offline_spill() {
+        remove();
+    }
+
+    // number of records that have not been read
+    std::size_t size() const {
+        return count_;
+    }
+
+    bool empty() const {
+        return count_ == 0;
+    }
+
+    // Returns false if the record is rejected.
+    bool write(record const& r) {
+        auto start = buf_.size();
+        put_u32(buf_, 0); // body length, set below
+        put_u8(buf_, static_cast<std::uint8_t>(r.pubopts));
+        put_u8(buf_, r.sid ? 1 : 0);
+        put_u32(buf_, r.sid ? static_cast<std::uint32_t>(*r.sid) : 0);
+        put_u8(buf_, r.expiry ? 1 : 0);
+        put_u64(buf_, r.expiry ? static_cast<std::uint64_t>(r.expiry->time_since_epoch().count()) : 0);
+        put_bytes(buf_, r.msg->topic());
+        auto props = const_buffer_sequence(r.msg->props());
+        std::size_t props_size = 0;
+        for (auto const& cb : props) props_size += cb.size();
+        put_u32(buf_, static_cast<std::uint32_t>(props_size));
+        for (auto const& cb : props) {
+            buf_.append(static_cast<char const*>(cb.data()), cb.size());
+        }
+        std::size_t payload_size = 0;
+        for (auto const& b : r.msg->payload()) payload_size += b.size();
+        put_u32(buf_, static_cast<std::uint32_t>(payload_size));
+        for (auto const& b : r.msg->payload()) buf_.append(b.data(), b.size());
+        set_u32(buf_.data() + start, static_cast<std::uint32_t>(buf_.size() - start - 4));
+
+        ++buf_count_;
+        ++count_;
+        if (buf_.size() >= write_buffer_size && !flush() && buf_.size() > max_write_buffer_size) {
+            buf_.resize(start);
+            --buf_count_;
+            --count_;
+            return false;
+        }
+        return true;
+    }
+
+    // Read at most max_count oldest records.
+    // If the file is broken, the remaining records are dropped.
+    std::vector<record> read(std::size_t max_count) {
+        std::vector<record> ret;
+        if (count_ == 0) return ret;
+        flush();
+        auto file_count = count_ - buf_count_;
+        if (file_count != 0) {
+            std::ifstream file{path_, std::ios::binary};
+            file.seekg(static_cast<std::streamoff>(read_pos_));
+            while (ret.size() < max_count && file_count != 0) {
+                auto r = read_impl(file);
+                if (!r) {
+                    drop_all();
+                    return ret;
+                }
+                ret.push_back(force_move(*r));
+                --count_;
+                --file_count;
+            }
+        }
+        // The buffer couldn't be written to the file, so the newest records are read from it.
+        if (file_count == 0 && buf_count_ != 0) {
+            std::string_view rest{buf_};
+            while (ret.size() < max_count && buf_count_ != 0) {
+                if (rest.size() < 4) {
+                    drop_all();
+                    return ret;
+                }
+                auto len = get_u32(rest.data());
+                if (rest.size() - 4 < len) {
+                    drop_all();
+                    return ret;
+                }
+                auto r = parse(rest.substr(4, len));
+                if (!r) {
+                    drop_all();
+                    return ret;
+                }
+                rest.remove_prefix(4 + len);
+                ret.push_back(force_move(*r));
+                --count_;
+                --buf_count_;
+            }
+            buf_.erase(0, buf_.size() - rest.size());
+        }
+        if (count_ == 0) truncate();
+        return ret;
+    }
+
+private:
+    explicit offline_spill(std::filesystem::path path)
+        :path_{force_move(path)}
+    {
+    }
+
+    // Append the write buffer to the file.
+    bool flush() {
+        if (buf_.empty()) return true;
+        std::ofstream file{path_, std::ios::binary | std::ios::app};
+        file.write(buf_.data(), static_cast<std::streamsize>(buf_.size()));
+        file.flush();
+        if (!file) {
+            ASYNC_MQTT_LOG("mqtt_broker", warning)
+                << "offline spill file write error:" << path_.string();
+            // remove the partially written records
+            file.close();
+            std::error_code ec;
+            std::filesystem::resize_file(path_, write_pos_, ec);
+            return false;
+        }
+        write_pos_ += buf_.size();
+        buf_.clear();
+        buf_count_ = 0;
+        return true;
+    }
+
+    void drop_all() {
+        ASYNC_MQTT_LOG("mqtt_broker", error)
+            << "offline spill file read error:" << path_.string()
+            << " dropped records:" << count_;
+        count_ = 0;
+        buf_.clear();
+        buf_count_ = 0;
+        truncate();
+    }
+
+    std::optional<record> read_impl(std::ifstream& file) {
+        char len_buf[4];
+        if (!file.read(len_buf, sizeof(len_buf))) return std::nullopt;
+        std::uint32_t len = get_u32(len_buf);
+        std::string body(len, '\0');
+        if (!file.read(body.data(), static_cast<std::streamsize>(len))) return std::nullopt;
+        read_pos_ += sizeof(len_buf) + len;
+        return parse(body);
+    }
+
+    static std::optional<record> parse(std::string_view body) {
+        std::string_view rest{body};
+        auto u8 = [&]() -> std::optional<std::uint8_t> {
+            if (rest.size() < 1) return std::nullopt;
+            auto v = static_cast<std::uint8_t>(rest[0]);
+            rest.remove_prefix(1);
+            return v;
+        };
+        auto u32 = [&]() -> std::optional<std::uint32_t> {
+            if (rest.size() < 4) return std::nullopt;
+            auto v = get_u32(rest.data());
+            rest.remove_prefix(4);
+            return v;
+        };
+        auto u64 = [&]() -> std::optional<std::uint64_t> {
+            auto hi = u32();
+            auto lo = u32();
+            if (!hi || !lo) return std::nullopt;
+            return std::uint64_t(*hi) << 32 | *lo;
+        };
+        auto bytes = [&]() -> std::optional<std::string_view> {
+            auto l = u32();
+            if (!l || rest.size() < *l) return std::nullopt;
+            auto v = rest.substr(0, *l);
+            rest.remove_prefix(*l);
+            return v;
+        };
+
+        auto opts = u8();
+        auto has_sid = u8();
+        auto sid = u32();
+        auto has_expiry = u8();
+        auto expiry = u64();
+        auto topic = bytes();
+        auto props_bytes = bytes();
+        auto payload = bytes();
+        if (!opts || !has_sid || !sid || !has_expiry || !expiry || !topic || !props_bytes || !payload) {
+            return std::nullopt;
+        }
+
+        error_code ec;
+        auto props = make_properties(
+            buffer{std::string{*props_bytes}},
+            property_location::publish,
+            ec
+        );
+        if (ec) return std::nullopt;
+
+        std::vector<buffer> payloads;
+        if (!payload->empty()) payloads.emplace_back(std::string{*payload});
+
+        record r {
+            shared_message::create(
+                std::string{*topic},
+                force_move(payloads),
+                force_move(props)
+            ),
+            pub::opts{*opts},
+            std::nullopt,
+            std::nullopt
+        };
+        if (*has_sid) r.sid.emplace(*sid);
+        if (*has_expiry) {
+            r.expiry.emplace(
+                std::chrono::steady_clock::duration{
+                    static_cast<std::chrono::steady_clock::rep>(*expiry)
+                }
+            );
+        }
+        return r;
+    }
+
+    void truncate() {
+        std::error_code ec;
+        std::filesystem::resize_file(path_, 0, ec);
+        read_pos_ = 0;
+        write_pos_ = 0;
+    }
+
+    void remove() {
+        if (path_.empty()) return;
+        std::error_code ec;
+        std::filesystem::remove(path_, ec);
+        path_.clear();
+    }
+
+    static void put_u8(std::string& s, std::uint8_t v) {
+        s.push_back(static_cast<char>(v));
+    }
+
+    static void put_u32(std::string& s, std::uint32_t v) {
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            s.push_back(static_cast<char>((v >> shift) & 0xff));
+        }
+    }
+
+    static void set_u32(char* p, std::uint32_t v) {
+        p[0] = static_cast<char>((v >> 24) & 0xff);
+        p[1] = static_cast<char>((v >> 16) & 0xff);
+        p[2] = static_cast<char>((v >> 8) & 0xff);
+        p[3] = static_cast<char>(v & 0xff);
+    }
+
+    static void put_u64(std::string& s, std::uint64_t v) {
+        put_u32(s, static_cast<std::uint32_t>(v >> 32));
+        put_u32(s, static_cast<std::uint32_t>(v & 0xffffffff));
+    }
+
+    static void put_bytes(std::string& s, std::string_view v) {
+        put_u32(s, static_cast<std::uint32_t>(v.size()));
+        s.append(v.data(), v.size());
+    }
+
+    static std::uint32_t get_u32(char const* p) {
+        return
+            std::uint32_t(static_cast<std::uint8_t>(p[0])) << 24 |
+            std::uint32_t(static_cast<std::uint8_t>(p[1])) << 16 |
+            std::uint32_t(static_cast<std::uint8_t>(p[2])) << 8 |
+            std::uint32_t(static_cast<std::uint8_t>(p[3]));
+    }
+
+    std::filesystem::path path_;
+    std::size_t read_pos_ = 0;
+    std::size_t write_pos_ = 0;
+    std::size_t count_ = 0;
+    std::string buf_;           ///< encoded records that are not written to the file yet
+    std::size_t buf_count_ = 0; ///< number of records in buf_
+};
+
+} // namespace async_mqtt
+
+#endif // ASYNC_MQTT_BROKER_OFFLINE_SPILL_HPP
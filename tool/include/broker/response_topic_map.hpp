@@ -0,0 +1,111 @@
+// Copyright Takatoshi Kondo 2024
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#if !defined(ASYNC_MQTT_BROKER_RESPONSE_TOPIC_MAP_HPP)
+#define ASYNC_MQTT_BROKER_RESPONSE_TOPIC_MAP_HPP
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include <async_mqtt/util/move.hpp>
+
+#include <broker/mutex.hpp>
+
+namespace async_mqtt {
+
+// Response topics that the broker creates for the clients that request Response Information.
+// Anyone can publish to a response topic, and only its owner can subscribe to it.
+// They are kept apart from the security settings, so adding one on CONNECT doesn't copy
+// the security settings. The map is sharded by the topic hash. A writer locks one shard
+// exclusively for one insertion or removal, and a reader locks one shard shared.
+class response_topic_map {
+public:
+    void insert(std::string topic, std::string username) {
+        auto e = std::make_unique<entry>(entry{force_move(topic), force_move(username)});
+        auto& s = shard_of(e->topic);
+        std::lock_guard<mutex> g{s.mtx};
+        auto it = s.entries.find(e->topic);
+        if (it != s.entries.end()) {
+            it->second->username = force_move(e->username);
+            return;
+        }
+        std::string_view key{e->topic};
+        s.entries.emplace(key, force_move(e));
+        ++size_;
+    }
+
+    void erase(std::string_view topic) {
+        auto& s = shard_of(topic);
+        std::lock_guard<mutex> g{s.mtx};
+        if (s.entries.erase(topic) != 0) --size_;
+    }
+
+    // Return the owner of the response topic, or std::nullopt if topic is not a response topic.
+    std::optional<std::string> owner(std::string_view topic) const {
+        if (size_ == 0) return std::nullopt;
+        auto const& s = shard_of(topic);
+        std::shared_lock<mutex> g{s.mtx};
+        auto it = s.entries.find(topic);
+        if (it == s.entries.end()) return std::nullopt;
+        return it->second->username;
+    }
+
+    bool is_owner(std::string_view topic, std::string_view username) const {
+        if (size_ == 0) return false;
+        auto const& s = shard_of(topic);
+        std::shared_lock<mutex> g{s.mtx};
+        auto it = s.entries.find(topic);
+        return it != s.entries.end() && it->second->username == username;
+    }
+
+    bool contains(std::string_view topic) const {
+        if (size_ == 0) return false;
+        auto const& s = shard_of(topic);
+        std::shared_lock<mutex> g{s.mtx};
+        return s.entries.find(topic) != s.entries.end();
+    }
+
+    std::size_t size() const {
+        return size_;
+    }
+
+private:
+    static constexpr std::size_t shard_count = 16;
+
+    struct entry {
+        std::string topic;
+        std::string username;
+    };
+
+    struct shard {
+        mutable mutex mtx;
+        // the key refers to entry::topic
+        std::unordered_map<std::string_view, std::unique_ptr<entry>> entries;
+    };
+
+    shard& shard_of(std::string_view topic) {
+        return shards_[std::hash<std::string_view>{}(topic) % shard_count];
+    }
+
+    shard const& shard_of(std::string_view topic) const {
+        return shards_[std::hash<std::string_view>{}(topic) % shard_count];
+    }
+
+    std::array<shard, shard_count> shards_;
+    std::atomic<std::size_t> size_{0};
+};
+
+} // namespace async_mqtt
+
+#endif // ASYNC_MQTT_BROKER_RESPONSE_TOPIC_MAP_HPP
@@ -13,32 +13,25 @@
 #include <async_mqtt/protocol/packet/property_variant.hpp>
 #include <async_mqtt/protocol/packet/subopts.hpp>
 
+#include <broker/shared_message.hpp>
+
 namespace async_mqtt {
 
 // A collection of messages that have been retained in
 // case clients add a new subscription to the associated topics.
+// The message body is shared with the deliveries of the original PUBLISH.
 struct retain_type {
     retain_type(
-        std::string topic,
-        std::vector<buffer> payload,
-        properties props,
+        shared_message_ptr msg,
         qos qos_value,
         std::shared_ptr<as::steady_timer> tim_message_expiry = std::shared_ptr<as::steady_timer>())
-        :topic(force_move(topic)),
-         props(force_move(props)),
+        :msg(force_move(msg)),
          qos_value(qos_value),
          tim_message_expiry(force_move(tim_message_expiry))
     {
-        auto it = std::cbegin(payload);
-        auto end = std::cend(payload);
-        for (; it != end; ++it) {
-            this->payload.emplace_back(*it);
-        }
     }
 
-    std::string topic;
-    std::vector<buffer> payload;
-    properties props;
+    shared_message_ptr msg;
     qos qos_value;
     std::shared_ptr<as::steady_timer> tim_message_expiry;
 };
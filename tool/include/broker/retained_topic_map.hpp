@@ -20,6 +20,7 @@
 #include <async_mqtt/util/buffer.hpp>
 
 #include <broker/topic_filter.hpp>
+#include <broker/tokenized_topic.hpp>
 
 namespace async_mqtt {
 
@@ -81,11 +82,20 @@ class retained_topic_map {
         path_entry,
         mi::indexed_by<
             // index required for direct child access
+            // the name hash accepts tokenized_topic::level_type, so precomputed hashes are reused
             mi::hashed_unique <
                 mi::tag<direct_index_tag>,
                 mi::key<
                     &path_entry::parent_id,
                     &path_entry::name_as_string_view
+                >,
+                mi::composite_key_hash<
+                    boost::hash<node_id_type>,
+                    topic_level_hash
+                >,
+                mi::composite_key_equal_to<
+                    std::equal_to<node_id_type>,
+                    topic_level_equal
                 >
             >,
             // index required for wildcard processing
@@ -105,59 +115,49 @@ class retained_topic_map {
 
     direct_const_iterator root;
 
-    direct_const_iterator create_topic(std::string_view topic) {
-         direct_const_iterator parent = root;
-
-        topic_filter_tokenizer(
-            topic,
-            [this, &parent](std::string_view t) {
-                if (t == "+" || t == "#") {
-                    throw_no_wildcards_allowed();
-                }
+    direct_const_iterator create_topic(tokenized_topic const& topic) {
+        direct_const_iterator parent = root;
+        auto& direct_index = map.template get<direct_index_tag>();
 
-                node_id_type parent_id = parent->id;
+        for (auto const& t : topic) {
+            if (t.name == "+" || t.name == "#") {
+                throw_no_wildcards_allowed();
+            }
 
-                auto& direct_index = map.template get<direct_index_tag>();
-                direct_const_iterator entry = direct_index.find(std::make_tuple(parent_id, t));
+            direct_const_iterator entry = direct_index.find(std::make_tuple(parent->id, t));
 
-                if (entry == direct_index.end()) {
-                    entry = map.insert(path_entry(parent->id, t, next_node_id++)).first;
-                    if (next_node_id == max_node_id) {
-                        throw_max_stored_topics();
-                    }
+            if (entry == direct_index.end()) {
+                entry = map.insert(path_entry(parent->id, t.name, next_node_id++)).first;
+                if (next_node_id == max_node_id) {
+                    throw_max_stored_topics();
                 }
-                else {
-                    direct_index.modify(entry, [](path_entry& entry){ entry.increase_count(); });
-                }
-
-                parent = entry;
-                return true;
             }
-        );
+            else {
+                direct_index.modify(entry, [](path_entry& entry){ entry.increase_count(); });
+            }
+
+            parent = entry;
+        }
 
         return parent;
     }
 
-    std::vector<direct_const_iterator> find_topic(std::string_view topic) {
+    std::vector<direct_const_iterator> find_topic(tokenized_topic const& topic) {
         std::vector<direct_const_iterator> path;
+        path.reserve(topic.size());
         direct_const_iterator parent = root;
+        auto const& direct_index = map.template get<direct_index_tag>();
 
-        topic_filter_tokenizer(
-            topic,
-            [this, &parent, &path](std::string_view t) {
-                auto const& direct_index = map.template get<direct_index_tag>();
-                auto entry = direct_index.find(std::make_tuple(parent->id, t));
-
-                if (entry == direct_index.end()) {
-                    path = std::vector<direct_const_iterator>();
-                    return false;
-                }
+        for (auto const& t : topic) {
+            auto entry = direct_index.find(std::make_tuple(parent->id, t));
 
-                path.push_back(entry);
-                parent = entry;
-                return true;
+            if (entry == direct_index.end()) {
+                return std::vector<direct_const_iterator>();
             }
-        );
+
+            path.push_back(entry);
+            parent = entry;
+        }
 
         return path;
     }
@@ -204,58 +204,59 @@ class retained_topic_map {
 
     // Find all topics that match the specified topic filter
     template<typename Output>
-    void find_match(std::string_view topic_filter, Output&& callback) const {
+    void find_match(tokenized_topic const& topic_filter, Output&& callback) const {
         std::deque<direct_const_iterator> entries;
         entries.push_back(root);
 
         std::deque<direct_const_iterator> new_entries;
-        bool const contains_wildcard = has_wildcard(topic_filter);
-
-        topic_filter_tokenizer(
-            topic_filter,
-            [this, &entries, &new_entries, &callback, contains_wildcard](std::string_view t) {
-                auto const& direct_index = map.template get<direct_index_tag>();
-                auto const& wildcard_index = map.template get<wildcard_index_tag>();
-                new_entries.resize(0);
-
-                for (auto const& entry : entries) {
-                    node_id_type parent = entry->id;
-
-                    if (t == std::string_view("+")) {
-                        for (auto i = wildcard_index.lower_bound(parent); i != wildcard_index.end() && i->parent_id == parent; ++i) {
-                            if (parent != root_node_id || i->name.empty() || i->name[0] != '$') {
-                                new_entries.push_back(map.template project<direct_index_tag, wildcard_const_iterator>(i));
-                            }
-                            else {
-                                break;
-                            }
+        bool const contains_wildcard = has_wildcard(topic_filter.str());
+        auto const& direct_index = map.template get<direct_index_tag>();
+        auto const& wildcard_index = map.template get<wildcard_index_tag>();
+
+        auto step = [&](tokenized_topic::level_type const& t) {
+            new_entries.resize(0);
+
+            for (auto const& entry : entries) {
+                node_id_type parent = entry->id;
+
+                if (t.name == std::string_view("+")) {
+                    for (auto i = wildcard_index.lower_bound(parent); i != wildcard_index.end() && i->parent_id == parent; ++i) {
+                        if (parent != root_node_id || i->name.empty() || i->name[0] != '$') {
+                            new_entries.push_back(map.template project<direct_index_tag, wildcard_const_iterator>(i));
                         }
-                    }
-                    else if (t == std::string_view("#")) {
-                        // Process all entries when # wildcard is encountered
-                        for (auto const& e : entries) {
-                            match_hash_entries(e->id, callback, e->id == root_node_id);
+                        else {
+                            break;
                         }
-                        return false;
                     }
-                    else {
-                        direct_const_iterator i = direct_index.find(std::make_tuple(parent, t));
-                        if (i != direct_index.end()) {
-                            new_entries.push_back(i);
-                        }
-                        // Optimization: for non-wildcard topic filters, at most one topic can match
-                        // If no wildcard and no match found, we can stop early
-                        if (!contains_wildcard && new_entries.empty()) {
-                            std::swap(new_entries, entries);
-                            return false;
-                        }
+                }
+                else if (t.name == std::string_view("#")) {
+                    // Process all entries when # wildcard is encountered
+                    for (auto const& e : entries) {
+                        match_hash_entries(e->id, callback, e->id == root_node_id);
+                    }
+                    return false;
+                }
+                else {
+                    direct_const_iterator i = direct_index.find(std::make_tuple(parent, t));
+                    if (i != direct_index.end()) {
+                        new_entries.push_back(i);
+                    }
+                    // Optimization: for non-wildcard topic filters, at most one topic can match
+                    // If no wildcard and no match found, we can stop early
+                    if (!contains_wildcard && new_entries.empty()) {
+                        std::swap(new_entries, entries);
+                        return false;
                     }
                 }
-
-                std::swap(new_entries, entries);
-                return !entries.empty();
             }
-        );
+
+            std::swap(new_entries, entries);
+            return !entries.empty();
+        };
+
+        for (auto const& t : topic_filter) {
+            if (!step(t)) break;
+        }
 
         for (auto& entry : entries) {
             if (entry->value) {
@@ -265,7 +266,7 @@ class retained_topic_map {
     }
 
     // Remove a value at the specified topic
-    size_t erase_topic(std::string_view topic) {
+    size_t erase_topic(tokenized_topic const& topic) {
         auto path = find_topic(topic);
 
         // Reset the value if there is actually something stored
@@ -328,6 +329,12 @@ public:
     // Insert a value at the specified topic
     template<typename V>
     std::size_t insert_or_assign(std::string_view topic, V&& value) {
+        return insert_or_assign(tokenized_topic{topic}, std::forward<V>(value));
+    }
+
+    // Insert a value at the already tokenized topic
+    template<typename V>
+    std::size_t insert_or_assign(tokenized_topic const& topic, V&& value) {
         auto& direct_index = map.template get<direct_index_tag>();
         auto path = this->find_topic(topic);
 
@@ -353,11 +360,20 @@ public:
     // Find all stored topics that math the specified topic_filter
     template<typename Output>
     void find(std::string_view topic_filter, Output&& callback) const {
+        find_match(tokenized_topic{topic_filter}, std::forward<Output>(callback));
+    }
+
+    template<typename Output>
+    void find(tokenized_topic const& topic_filter, Output&& callback) const {
         find_match(topic_filter, std::forward<Output>(callback));
     }
 
     // Remove a stored value at the specified topic
     std::size_t erase(std::string_view topic) {
+        return erase(tokenized_topic{topic});
+    }
+
+    std::size_t erase(tokenized_topic const& topic) {
         auto result = erase_topic(topic);
         decrease_map_size(result);
         return result;
@@ -7,11 +7,15 @@
 #if !defined(ASYNC_MQTT_BROKER_SECURITY_HPP)
 #define ASYNC_MQTT_BROKER_SECURITY_HPP
 
+#include <algorithm>
+#include <array>
+#include <memory>
 #include <string>
 #include <string_view>
 #include <map>
 #include <set>
 #include <optional>
+#include <tuple>
 
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/json_parser.hpp>
@@ -38,6 +42,7 @@
 #endif
 
 #include <broker/subscription_map.hpp>
+#include <broker/tokenized_topic.hpp>
 #include <async_mqtt/util/log.hpp>
 #include <async_mqtt/util/string_view_helper.hpp>
 
@@ -101,6 +106,8 @@ struct security {
 
     static constexpr char const* any_group_name = "@any";
 
+    using digest_type = std::array<unsigned char, 32>;
+
     struct authentication {
         enum class method {
             sha256,
@@ -119,11 +126,16 @@ struct security {
               digest(digest),
               salt(salt)
         {
+            if (auth_method == method::sha256 && digest) {
+                digest_bin = hex_to_digest(*digest);
+            }
         }
 
         method auth_method;
         std::optional<std::string> digest;
         std::string salt;
+        // decoded digest. nullopt if the configured digest is not a valid sha256 hex string.
+        std::optional<digest_type> digest_bin;
 
         std::vector<std::string> groups;
     };
@@ -177,11 +189,61 @@ struct security {
     }
 
     static std::string sha256hash(std::string_view message) {
-        std::vector<unsigned char> hash(picosha2::k_digest_size);
-        picosha2::hash256(message.begin(), message.end(), hash.begin(), hash.end());
+        auto hash = sha256_digest(std::string_view{}, message);
         return picosha2::bytes_to_hex_string(hash.begin(), hash.end());
     }
 
+    // Calculate sha256(salt + password) without concatenating them.
+    static digest_type sha256_digest(std::string_view salt, std::string_view password) {
+        digest_type hash{};
+#if ASYNC_MQTT_USE_TLS
+        std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)> ctx{EVP_MD_CTX_new(), &EVP_MD_CTX_free};
+        if (ctx &&
+            EVP_DigestInit_ex(ctx.get(), EVP_sha256(), nullptr) == 1 &&
+            EVP_DigestUpdate(ctx.get(), salt.data(), salt.size()) == 1 &&
+            EVP_DigestUpdate(ctx.get(), password.data(), password.size()) == 1 &&
+            EVP_DigestFinal_ex(ctx.get(), hash.data(), nullptr) == 1) {
+            return hash;
+        }
+        // fallback to picosha2
+#endif // ASYNC_MQTT_USE_TLS
+        picosha2::hash256_one_by_one hasher;
+        hasher.process(salt.begin(), salt.end());
+        hasher.process(password.begin(), password.end());
+        hasher.finish();
+        hasher.get_hash_bytes(hash.begin(), hash.end());
+        return hash;
+    }
+
+    static std::optional<digest_type> hex_to_digest(std::string_view hex) {
+        if (hex.size() != std::tuple_size<digest_type>::value * 2) return std::nullopt;
+        auto nibble =
+            [](char c) -> int {
+                if (c >= '0' && c <= '9') return c - '0';
+                if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+                if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+                return -1;
+            };
+        digest_type ret;
+        for (std::size_t i = 0; i != ret.size(); ++i) {
+            auto h = nibble(hex[i * 2]);
+            auto l = nibble(hex[i * 2 + 1]);
+            if (h < 0 || l < 0) return std::nullopt;
+            ret[i] = static_cast<unsigned char>((h << 4) | l);
+        }
+        return ret;
+    }
+
+    // Compare without early exit so that the time doesn't depend on the matched length.
+    static bool constant_time_equal(std::string_view lhs, std::string_view rhs) {
+        unsigned char diff = lhs.size() == rhs.size() ? 0 : 1;
+        auto size = std::min(lhs.size(), rhs.size());
+        for (std::size_t i = 0; i != size; ++i) {
+            diff |= static_cast<unsigned char>(lhs[i] ^ rhs[i]);
+        }
+        return diff == 0;
+    }
+
     bool login_cert(std::string_view username) const {
         auto i = authentication_.find(std::string(username));
         return
@@ -189,14 +251,28 @@ struct security {
             i->second.auth_method == security::authentication::method::client_cert;
     }
 
+    // Return true if the successful login result of the username can be cached.
+    // Only digest based authentication is worth caching.
+    bool login_cacheable(std::string_view username) const {
+        auto i = authentication_.find(std::string(username));
+        return
+            i != authentication_.end() &&
+            i->second.auth_method == security::authentication::method::sha256;
+    }
+
     std::optional<std::string> login(std::string_view username, std::string_view password) const {
         auto i = authentication_.find(std::string(username));
         if (i != authentication_.end() &&
             i->second.auth_method == security::authentication::method::sha256) {
             return [&] () -> std::optional<std::string> {
-                if (boost::iequals(
-                        i->second.digest.value(),
-                        sha256hash(i->second.salt + std::string(password))
+                if (!i->second.digest_bin) return std::nullopt;
+                auto hash = sha256_digest(i->second.salt, password);
+                if (constant_time_equal(
+                        std::string_view{reinterpret_cast<char const*>(hash.data()), hash.size()},
+                        std::string_view{
+                            reinterpret_cast<char const*>(i->second.digest_bin->data()),
+                            i->second.digest_bin->size()
+                        }
                     )
                 ) {
                     return std::string(username);
@@ -211,7 +287,7 @@ struct security {
             i != authentication_.end() &&
             i->second.auth_method == security::authentication::method::plain_password) {
             return [&] () -> std::optional<std::string> {
-                if (i->second.digest.value() == password) {
+                if (constant_time_equal(i->second.digest.value(), password)) {
                     return std::string(username);
                 }
                 else {
@@ -336,6 +412,21 @@ struct security {
         }
     }
 
+    // Return the users whose authentication in before is removed or changed in after.
+    static std::vector<std::string> changed_users(security const& before, security const& after) {
+        std::vector<std::string> ret;
+        for (auto const& b : before.authentication_) {
+            auto it = after.authentication_.find(b.first);
+            if (it == after.authentication_.end() ||
+                it->second.auth_method != b.second.auth_method ||
+                it->second.digest != b.second.digest ||
+                it->second.salt != b.second.salt) {
+                ret.push_back(b.first);
+            }
+        }
+        return ret;
+    }
+
     void load_json(std::istream& input) {
         // Create a root
         boost::property_tree::ptree root;
@@ -511,6 +602,10 @@ struct security {
     }
 
     authorization::type auth_pub(std::string_view topic, std::string_view username) const {
+        return auth_pub(tokenized_topic{topic}, username);
+    }
+
+    authorization::type auth_pub(tokenized_topic const& topic, std::string_view username) const {
         authorization::type result_type = authorization::type::deny;
 
         std::set<std::string> username_and_groups;
@@ -548,6 +643,10 @@ struct security {
     }
 
     std::map<std::string, authorization::type> auth_sub(std::string_view topic) const {
+        return auth_sub(tokenized_topic{topic});
+    }
+
+    std::map<std::string, authorization::type> auth_sub(tokenized_topic const& topic) const {
         std::map<std::string, authorization::type> result;
         std::map<std::string, std::size_t> priorities;
         auth_sub_map.find(
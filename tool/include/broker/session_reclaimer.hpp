@@ -0,0 +1,151 @@
+// Copyright Takatoshi Kondo 2024
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#if !defined(ASYNC_MQTT_BROKER_SESSION_RECLAIMER_HPP)
+#define ASYNC_MQTT_BROKER_SESSION_RECLAIMER_HPP
+
+#include <deque>
+#include <memory>
+#include <mutex>
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/post.hpp>
+
+#include <async_mqtt/util/move.hpp>
+
+namespace async_mqtt {
+
+namespace as = boost::asio;
+
+// Background reclaimer of discarded sessions.
+// Removing the subscriptions of a session with many topic filters takes
+// the subscription map lock for a long time. Instead of doing it on the
+// CONNECT path, the broker tombstones the old session and adds it here.
+// Each step removes at most batch_size subscriptions of one session, and
+// then the next step is posted, so other handlers can run in between.
+// Session is required to have bool reclaim(std::size_t max) that returns
+// true when nothing remains.
+template <typename Session>
+class session_reclaimer {
+public:
+    explicit session_reclaimer(as::any_io_executor exe, std::size_t batch_size = 1024)
+        :st_{std::make_shared<state>(force_move(exe), batch_size)}
+    {
+    }
+
+    // Reclaim the remaining sessions synchronously.
+    // It must be destroyed before the structures that the sessions refer to.
+    ~session_reclaimer() {
+        std::deque<std::shared_ptr<Session>> rest;
+        {
+            std::lock_guard<std::mutex> g{st_->mtx};
+            rest = force_move(st_->queue);
+            st_->queue.clear();
+            st_->stopped = true;
+        }
+        for (auto& ss : rest) {
+            while (!ss->reclaim(st_->batch_size));
+        }
+    }
+
+    session_reclaimer(session_reclaimer const&) = delete;
+    session_reclaimer& operator=(session_reclaimer const&) = delete;
+
+    void add(std::shared_ptr<Session> ss) {
+        bool start = false;
+        {
+            std::lock_guard<std::mutex> g{st_->mtx};
+            if (st_->stopped) return;
+            st_->queue.push_back(force_move(ss));
+            if (!st_->running) {
+                st_->running = true;
+                start = true;
+            }
+        }
+        if (start) post_step(st_);
+    }
+
+    // number of sessions waiting for reclamation
+    std::size_t pending() const {
+        std::lock_guard<std::mutex> g{st_->mtx};
+        return st_->queue.size();
+    }
+
+    // number of sessions that have been reclaimed
+    std::size_t reclaimed() const {
+        std::lock_guard<std::mutex> g{st_->mtx};
+        return st_->reclaimed;
+    }
+
+private:
+    struct state {
+        state(as::any_io_executor exe, std::size_t batch_size)
+            :exe{force_move(exe)},
+             batch_size{batch_size}
+        {
+        }
+
+        as::any_io_executor exe;
+        std::size_t batch_size;
+        mutable std::mutex mtx;
+        std::deque<std::shared_ptr<Session>> queue;
+        std::size_t reclaimed = 0;
+        bool running = false;
+        bool stopped = false;
+    };
+
+    static void post_step(std::shared_ptr<state> const& st) {
+        as::post(
+            st->exe,
+            [wp = std::weak_ptr<state>(st)] {
+                if (auto st = wp.lock()) step(st);
+            }
+        );
+    }
+
+    static void step(std::shared_ptr<state> const& st) {
+        std::shared_ptr<Session> ss;
+        {
+            std::lock_guard<std::mutex> g{st->mtx};
+            if (st->queue.empty()) {
+                st->running = false;
+                return;
+            }
+            ss = force_move(st->queue.front());
+            st->queue.pop_front();
+        }
+
+        // Sessions are processed in round robin order,
+        // so a huge session doesn't delay small ones.
+        bool done = ss->reclaim(st->batch_size);
+
+        bool next = false;
+        {
+            std::lock_guard<std::mutex> g{st->mtx};
+            if (!done && !st->stopped) {
+                st->queue.push_back(force_move(ss));
+            }
+            else {
+                ++st->reclaimed;
+            }
+            next = !st->queue.empty();
+            if (!next) st->running = false;
+        }
+        if (ss) {
+            // Finish it if the reclaimer is being destroyed.
+            // The session is destroyed outside of the lock.
+            while (!done) done = ss->reclaim(st->batch_size);
+            ss.reset();
+        }
+        if (next) post_step(st);
+    }
+
+    std::shared_ptr<state> st_;
+};
+
+} // namespace async_mqtt
+
+#endif // ASYNC_MQTT_BROKER_SESSION_RECLAIMER_HPP
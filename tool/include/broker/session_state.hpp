@@ -7,6 +7,7 @@
 #if !defined(ASYNC_MQTT_BROKER_SESSION_STATE_HPP)
 #define ASYNC_MQTT_BROKER_SESSION_STATE_HPP
 
+#include <atomic>
 #include <chrono>
 #include <set>
 
@@ -19,9 +20,11 @@
 
 #include <broker/sub_con_map.hpp>
 #include <broker/shared_target.hpp>
+#include <broker/topic_pool.hpp>
 #include <broker/tags.hpp>
 #include <broker/inflight_message.hpp>
 #include <broker/offline_message.hpp>
+#include <broker/shared_message.hpp>
 #include <broker/mutex.hpp>
 
 namespace async_mqtt {
@@ -68,6 +71,7 @@ struct session_state : std::enable_shared_from_this<session_state<Sp>> {
         mutex& mtx_subs_map,
         sub_con_map<epsp_type>& subs_map,
         shared_target<epsp_type>& shared_targets,
+        topic_pool& topics,
         epsp_type epsp,
         std::string client_id,
         std::string const& username,
@@ -82,6 +86,7 @@ struct session_state : std::enable_shared_from_this<session_state<Sp>> {
                 mutex& mtx_subs_map,
                 sub_con_map<epsp_type>& subs_map,
                 shared_target<epsp_type>& shared_targets,
+                topic_pool& topics,
                 epsp_type epsp,
                 std::string client_id,
                 std::string const& username,
@@ -93,6 +98,7 @@ struct session_state : std::enable_shared_from_this<session_state<Sp>> {
                     mtx_subs_map,
                     subs_map,
                     shared_targets,
+                    topics,
                     force_move(epsp),
                     force_move(client_id),
                     username,
@@ -106,6 +112,7 @@ struct session_state : std::enable_shared_from_this<session_state<Sp>> {
             mtx_subs_map,
             subs_map,
             shared_targets,
+            topics,
             force_move(epsp),
             force_move(client_id),
             username,
@@ -134,8 +141,9 @@ struct session_state : std::enable_shared_from_this<session_state<Sp>> {
             << ASYNC_MQTT_ADD_VALUE(address, this)
             << "store inflight message";
         auto stored = epsp.get_stored_packets();
+        auto now = std::chrono::steady_clock::now();
         for (auto& store : stored) {
-            std::shared_ptr<as::steady_timer> tim_message_expiry;
+            std::optional<std::chrono::steady_clock::time_point> expiry;
             store.visit(
                 overload {
                     [&](v5::publish_packet const& p) {
@@ -143,21 +151,7 @@ struct session_state : std::enable_shared_from_this<session_state<Sp>> {
                             prop.visit(
                                 overload {
                                     [&](property::message_expiry_interval const& v) {
-                                        tim_message_expiry =
-                                            std::make_shared<as::steady_timer>(
-                                                exe_,
-                                                std::chrono::seconds(v.val())
-                                            );
-                                        tim_message_expiry->async_wait(
-                                            [this, wp = std::weak_ptr<as::steady_timer>(tim_message_expiry)]
-                                            (error_code ec) {
-                                                if (auto sp = wp.lock()) {
-                                                    if (!ec) {
-                                                        erase_inflight_message_by_expiry(sp);
-                                                    }
-                                                }
-                                            }
-                                        );
+                                        expiry.emplace(now + std::chrono::seconds(v.val()));
                                     },
                                     [](auto const&) {}
                                 }
@@ -170,11 +164,11 @@ struct session_state : std::enable_shared_from_this<session_state<Sp>> {
 
             insert_inflight_message(
                 force_move(store),
-                force_move(tim_message_expiry)
+                expiry
             );
         }
 
-        qos2_publish_handled_ = epsp.get_qos2_publish_handled_pids();
+        qos2_publish_handled_ = epsp.get_qos2_publish_handled_pid_bitset();
 
         if (session_expiry_interval_ &&
             *session_expiry_interval_ != std::chrono::seconds(session_never_expire)) {
@@ -204,38 +198,14 @@ struct session_state : std::enable_shared_from_this<session_state<Sp>> {
         }
     }
 
-    void renew(
-        epsp_type epsp,
-        std::optional<will> will,
-        bool clean_start,
-        std::optional<std::chrono::steady_clock::duration> will_expiry_interval,
-        std::optional<std::chrono::steady_clock::duration> session_expiry_interval
-    ) {
-        clean();
-        epwp_ = epsp;
-        auto version = epsp.get_protocol_version();
-        if (version == protocol_version::v3_1_1) {
-            remain_after_close_= !clean_start;
-        }
-        else {
-            BOOST_ASSERT(version == protocol_version::v5);
-            remain_after_close_=
-                session_expiry_interval_ &&
-                *session_expiry_interval_ != std::chrono::steady_clock::duration::zero();
-        }
-        update_will(force_move(will), will_expiry_interval);
-        session_expiry_interval_ = force_move(session_expiry_interval);
-    }
-
     void publish(
         epsp_type& epsp,
-        std::string pub_topic,
-        std::vector<buffer> payload,
+        shared_message_ptr msg,
         pub::opts pubopts,
-        properties props) {
+        std::optional<std::size_t> sid = std::nullopt) {
 
         auto send_publish =
-            [this, epsp, pub_topic, payload = payload, pubopts, props, wp = this->weak_from_this()]
+            [this, epsp, msg, pubopts, sid, wp = this->weak_from_this()]
             (packet_id_type pid) mutable {
                 if (auto sp = wp.lock()) {
                     switch (version_) {
@@ -243,8 +213,8 @@ struct session_state : std::enable_shared_from_this<session_state<Sp>> {
                         epsp.async_send(
                             v3_1_1::publish_packet{
                                 pid,
-                                force_move(pub_topic),
-                                force_move(payload),
+                                msg->topic_as_buffer(),
+                                msg->payload(),
                                 pubopts
                             },
                             [this, epsp](error_code const& ec) {
@@ -261,10 +231,10 @@ struct session_state : std::enable_shared_from_this<session_state<Sp>> {
                         epsp.async_send(
                             v5::publish_packet{
                                 pid,
-                                force_move(pub_topic),
-                                force_move(payload),
+                                msg->topic_as_buffer(),
+                                msg->payload(),
                                 pubopts,
-                                force_move(props)
+                                msg->props_for(sid)
                             },
                             [this, epsp](error_code const& ec) {
                                 if (ec) {
@@ -307,42 +277,42 @@ struct session_state : std::enable_shared_from_this<session_state<Sp>> {
         // offline_messages_ is not empty or packet_id_exhausted
         std::lock_guard<mutex> g(mtx_offline_messages_);
         offline_messages_.push_back(
-            exe_,
-            force_move(pub_topic),
-            force_move(payload),
+            force_move(msg),
             pubopts,
-            force_move(props)
+            sid
         );
     }
 
     void deliver(
-        std::string pub_topic,
-        std::vector<buffer> payload,
+        shared_message_ptr msg,
         pub::opts pubopts,
-        properties props) {
+        std::optional<std::size_t> sid = std::nullopt) {
 
         if (auto epsp = lock()) {
             publish(
                 epsp,
-                force_move(pub_topic),
-                force_move(payload),
+                force_move(msg),
                 pubopts,
-                force_move(props)
+                sid
             );
         }
         else {
             std::lock_guard<mutex> g(mtx_offline_messages_);
             offline_messages_.push_back(
-                exe_,
-                force_move(pub_topic),
-                force_move(payload),
+                force_move(msg),
                 pubopts,
-                force_move(props)
+                sid
             );
-            offline_messages_empty_ = false;
+            // The message can be dropped by the limit of the offline queue.
+            offline_messages_empty_ = offline_messages_.empty();
         }
     }
 
+    void set_offline_queue_config(std::shared_ptr<offline_queue_config const> config) {
+        std::lock_guard<mutex> g(mtx_offline_messages_);
+        offline_messages_.set_config(force_move(config));
+    }
+
     void set_clean_handler(std::function<void()> handler) {
         clean_handler_ = force_move(handler);
     }
@@ -373,6 +343,63 @@ struct session_state : std::enable_shared_from_this<session_state<Sp>> {
         response_topic_ = std::nullopt;
     }
 
+    /**
+     * @brief Detach the session from the broker so that it can be reclaimed in the background.
+     * The subscriptions stay in subs_map_ until reclaim() removes them.
+     * They are tombstoned, so messages are not delivered to this session anymore.
+     * The will is kept. It is sent when the session is destroyed, the same as before.
+     */
+    void tombstone() {
+        ASYNC_MQTT_LOG("mqtt_broker", trace)
+            << ASYNC_MQTT_ADD_VALUE(address, this)
+            << "tombstone";
+        tombstoned_ = true;
+        if (clean_handler_) {
+            clean_handler_();
+            clean_handler_ = nullptr;
+        }
+        shared_targets_.erase(*this);
+        if (tim_session_expiry_) tim_session_expiry_->cancel();
+    }
+
+    bool tombstoned() const {
+        return tombstoned_;
+    }
+
+    /**
+     * @brief Remove at most max subscriptions of the tombstoned session from subs_map_.
+     * If the same client id subscribed the same topic filter again, the new subscription is kept.
+     * @return true if all subscriptions are removed and the session can be destroyed cheaply
+     */
+    bool reclaim(std::size_t max) {
+        BOOST_ASSERT(tombstoned_);
+        {
+            std::lock_guard<mutex> g{mtx_subs_map_};
+            auto it = handles_.begin();
+            for (std::size_t n = 0; it != handles_.end() && n != max; ++it, ++n) {
+                subs_map_.erase_if(
+                    *it,
+                    client_id_,
+                    [this](subscription<epsp_type> const& sub) {
+                        return &sub.ss.get() == this;
+                    }
+                );
+            }
+            handles_.erase(handles_.begin(), it);
+        }
+        if (!handles_.empty()) return false;
+        {
+            std::lock_guard<mutex> g(mtx_inflight_messages_);
+            inflight_messages_.clear();
+        }
+        {
+            std::lock_guard<mutex> g(mtx_offline_messages_);
+            offline_messages_.clear();
+            offline_messages_empty_ = true;
+        }
+        return true;
+    }
+
     template <typename PublishRetainHandler>
     void subscribe(
         std::string share_name,
@@ -381,9 +408,10 @@ struct session_state : std::enable_shared_from_this<session_state<Sp>> {
         PublishRetainHandler&& h,
         std::optional<std::size_t> sid = std::nullopt
     ) {
-        subscription<epsp_type> sub {*this, share_name, topic_filter, subopts, sid };
+        auto interned_topic_filter = topics_.intern(topic_filter);
+        subscription<epsp_type> sub {*this, share_name, interned_topic_filter, subopts, sid };
         if (!share_name.empty()) {
-            shared_targets_.insert(share_name, topic_filter, sub, *this);
+            shared_targets_.insert(share_name, force_move(interned_topic_filter), sub, *this);
         }
         ASYNC_MQTT_LOG("mqtt_broker", trace)
             << ASYNC_MQTT_ADD_VALUE(address, this)
@@ -404,7 +432,9 @@ struct session_state : std::enable_shared_from_this<session_state<Sp>> {
 
         auto rh = subopts.get_retain_handling();
 
-        if (handle_ret.second) { // insert
+        // The same client id's tombstoned session might have had the same topic filter.
+        // In this case, the entry is overwritten, but it is new for this session.
+        if (handle_ret.second || handles_.find(handle_ret.first) == handles_.end()) { // insert
             ASYNC_MQTT_LOG("mqtt_broker", trace)
                 << ASYNC_MQTT_ADD_VALUE(address, this)
                 << "subscription inserted";
@@ -428,7 +458,9 @@ struct session_state : std::enable_shared_from_this<session_state<Sp>> {
 
     void unsubscribe(std::string const& share_name, std::string const& topic_filter) {
         if (!share_name.empty()) {
-            shared_targets_.erase(share_name, topic_filter, *this);
+            if (auto interned_topic_filter = topics_.find(topic_filter)) {
+                shared_targets_.erase(share_name, force_move(interned_topic_filter), *this);
+            }
         }
         std::lock_guard<mutex> g{mtx_subs_map_};
         auto handle = subs_map_.lookup(topic_filter);
@@ -518,12 +550,13 @@ struct session_state : std::enable_shared_from_this<session_state<Sp>> {
 
     void insert_inflight_message(
         store_packet_variant msg,
-        std::shared_ptr<as::steady_timer> tim_message_expiry
+        std::optional<std::chrono::steady_clock::time_point> expiry
     ) {
         std::lock_guard<mutex> g(mtx_inflight_messages_);
+        inflight_messages_.sweep(std::chrono::steady_clock::now());
         inflight_messages_.insert(
             force_move(msg),
-            force_move(tim_message_expiry)
+            expiry
         );
     }
 
@@ -534,37 +567,17 @@ struct session_state : std::enable_shared_from_this<session_state<Sp>> {
         }
     }
 
-    void erase_inflight_message_by_expiry(std::shared_ptr<as::steady_timer> const& sp) {
-        std::lock_guard<mutex> g(mtx_inflight_messages_);
-        auto& idx = inflight_messages_.get<tag_tim>();
-        auto [b, e] = idx.equal_range(sp);
-        while (b != e) {
-        ASYNC_MQTT_LOG("mqtt_broker", info)
-            << "message expired:" << b->packet();
-            b = idx.erase(b);
-        }
-    }
-
     std::size_t erase_inflight_message_by_packet_id(packet_id_type packet_id) {
         std::lock_guard<mutex> g(mtx_inflight_messages_);
-        auto& idx = inflight_messages_.get<tag_pid>();
-        return idx.erase(packet_id);
+        return inflight_messages_.erase(packet_id);
     }
 
     void send_all_offline_messages() {
-        if (auto epsp = lock()) {
-            std::lock_guard<mutex> g(mtx_offline_messages_);
-            offline_messages_.send_until_fail(epsp, get_protocol_version());
-            offline_messages_empty_ = offline_messages_.empty();
-        }
+        start_offline_replay();
     }
 
     void send_offline_messages_by_packet_id_release() {
-        if (auto epsp = lock()) {
-            std::lock_guard<mutex> g(mtx_offline_messages_);
-            offline_messages_.send_until_fail(epsp, get_protocol_version());
-            offline_messages_empty_ = offline_messages_.empty();
-        }
+        start_offline_replay();
     }
 
     protocol_version get_protocol_version() const {
@@ -608,7 +621,7 @@ struct session_state : std::enable_shared_from_this<session_state<Sp>> {
         update_will(force_move(will), will_expiry_interval);
 
         session_expiry_interval_ = force_move(session_expiry_interval);
-        epsp.restore_qos2_publish_handled_pids(qos2_publish_handled_);
+        epsp.restore_qos2_publish_handled_pid_bitset(qos2_publish_handled_);
     }
 
     epsp_type lock() {
@@ -637,6 +650,7 @@ private:
         mutex& mtx_subs_map,
         sub_con_map<epsp_type>& subs_map,
         shared_target<epsp_type>& shared_targets,
+        topic_pool& topics,
         epsp_type epsp,
         std::string client_id,
         std::string const& username,
@@ -647,6 +661,7 @@ private:
          mtx_subs_map_(mtx_subs_map),
          subs_map_(subs_map),
          shared_targets_(shared_targets),
+         topics_(topics),
          epwp_(epsp),
          version_(epsp.get_protocol_version()),
          client_id_(force_move(client_id)),
@@ -732,6 +747,50 @@ private:
         }
     }
 
+    // Replay the offline messages incrementally.
+    // Each step sends one batch from one handler, so the endpoint's bulk write
+    // gathers the batch into one write. The next step is posted to the back of
+    // the executor's queue, so other sessions and live traffic run in between.
+    // Live messages are queued behind the replay while offline_messages_empty_ is false.
+    void start_offline_replay() {
+        auto epsp = lock();
+        if (!epsp) return;
+        {
+            std::lock_guard<mutex> g(mtx_offline_messages_);
+            // a replay to the same endpoint is in progress
+            if (offline_replay_address_ == epsp.get_address()) return;
+            offline_replay_address_ = epsp.get_address();
+        }
+        epsp.dispatch(
+            [epsp, wp = this->weak_from_this()] () mutable {
+                if (auto sp = wp.lock()) sp->offline_replay_step(epsp);
+            }
+        );
+    }
+
+    void offline_replay_step(epsp_type& epsp) {
+        std::lock_guard<mutex> g(mtx_offline_messages_);
+        // the endpoint of the session has been replaced or disconnected
+        if (offline_replay_address_ != epsp.get_address()) return;
+        auto current = lock();
+        if (!current || current.get_address() != epsp.get_address()) {
+            offline_replay_address_ = nullptr;
+            return;
+        }
+        bool remain = offline_messages_.send_batch(epsp, get_protocol_version());
+        offline_messages_empty_ = offline_messages_.empty();
+        if (!remain) {
+            // drained, or waiting for packet id release
+            offline_replay_address_ = nullptr;
+            return;
+        }
+        epsp.post(
+            [epsp, wp = this->weak_from_this()] () mutable {
+                if (auto sp = wp.lock()) sp->offline_replay_step(epsp);
+            }
+        );
+    }
+
 private:
     friend class session_states<epsp_type>;
 
@@ -742,6 +801,7 @@ private:
     mutex& mtx_subs_map_;
     sub_con_map<epsp_type>& subs_map_;
     shared_target<epsp_type>& shared_targets_;
+    topic_pool& topics_;
     epwp_type epwp_;
     protocol_version version_;
     std::string client_id_;
@@ -758,6 +818,8 @@ private:
     mutable mutex mtx_offline_messages_;
     offline_messages offline_messages_;
     std::atomic<bool> offline_messages_empty_ = true;
+    // address of the endpoint that the offline messages are being replayed to
+    void const* offline_replay_address_ = nullptr;
 
     using elem_type = typename sub_con_map<epsp_type>::handle;
     std::set<elem_type> handles_; // to efficient remove
@@ -766,10 +828,11 @@ private:
     will_sender_type will_sender_;
     bool remain_after_close_;
 
-    std::set<packet_id_type> qos2_publish_handled_;
+    packet_id_bitset qos2_publish_handled_;
 
     std::optional<std::string> response_topic_;
     std::function<void()> clean_handler_;
+    std::atomic<bool> tombstoned_ = false;
 };
 
 template <typename Sp>
@@ -0,0 +1,122 @@
+// Copyright Takatoshi Kondo 2024
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#if !defined(ASYNC_MQTT_BROKER_SHARED_MESSAGE_HPP)
+#define ASYNC_MQTT_BROKER_SHARED_MESSAGE_HPP
+
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include <async_mqtt/util/buffer.hpp>
+#include <async_mqtt/util/move.hpp>
+#include <async_mqtt/util/overload.hpp>
+#include <async_mqtt/protocol/packet/property_variant.hpp>
+
+namespace async_mqtt {
+
+class shared_message;
+
+using shared_message_ptr = std::shared_ptr<shared_message const>;
+
+// The shared_message holds the parts of a PUBLISH that are common to all
+// subscribers. It is created once per incoming PUBLISH (or will message) and
+// shared by deliver, offline, inflight and retained storage.
+// Per-subscriber differences (QoS, retain flag, subscription identifier and
+// packet id) are kept by the holder, not here.
+class shared_message {
+public:
+    static shared_message_ptr create(
+        std::string topic,
+        std::vector<buffer> payload,
+        properties props
+    ) {
+        return create(
+            buffer{force_move(topic)},
+            force_move(payload),
+            force_move(props)
+        );
+    }
+
+    static shared_message_ptr create(
+        buffer topic,
+        std::vector<buffer> payload,
+        properties props
+    ) {
+        return std::make_shared<shared_message>(
+            tag_internal{},
+            force_move(topic),
+            force_move(payload),
+            force_move(props)
+        );
+    }
+
+    struct tag_internal {};
+
+    shared_message(
+        tag_internal,
+        buffer topic,
+        std::vector<buffer> payload,
+        properties props
+    ):topic_{force_move(topic)},
+      payload_(force_move(payload)),
+      props_(force_move(props))
+    {
+        for (auto const& prop : props_) {
+            prop.visit(
+                overload {
+                    [&](property::message_expiry_interval const& v) {
+                        message_expiry_interval_.emplace(std::chrono::seconds(v.val()));
+                    },
+                    [](auto const&) {}
+                }
+            );
+        }
+    }
+
+    std::string_view topic() const {
+        return topic_;
+    }
+
+    buffer const& topic_as_buffer() const {
+        return topic_;
+    }
+
+    std::vector<buffer> const& payload() const {
+        return payload_;
+    }
+
+    properties const& props() const {
+        return props_;
+    }
+
+    // Build the properties for a specific subscriber.
+    // The subscription identifier is the only per-subscriber property.
+    properties props_for(std::optional<std::size_t> sid) const {
+        properties ret;
+        ret.reserve(props_.size() + (sid ? 1 : 0));
+        ret.insert(ret.end(), props_.begin(), props_.end());
+        if (sid) {
+            ret.push_back(property::subscription_identifier(static_cast<std::uint32_t>(*sid)));
+        }
+        return ret;
+    }
+
+    std::optional<std::chrono::steady_clock::duration> message_expiry_interval() const {
+        return message_expiry_interval_;
+    }
+
+private:
+    buffer topic_;
+    std::vector<buffer> payload_;
+    properties props_;
+    std::optional<std::chrono::steady_clock::duration> message_expiry_interval_;
+};
+
+} // namespace async_mqtt
+
+#endif // ASYNC_MQTT_BROKER_SHARED_MESSAGE_HPP
@@ -20,6 +20,7 @@
 #include <broker/tags.hpp>
 #include <broker/mutex.hpp>
 #include <broker/subscription.hpp>
+#include <broker/topic_pool.hpp>
 
 namespace async_mqtt {
 
@@ -28,11 +29,11 @@ namespace mi = boost::multi_index;
 template <typename Sp>
 class shared_target {
 public:
-    void insert(std::string share_name, std::string topic_filter, subscription<Sp> sub, session_state<Sp>& ss);
-    void erase(std::string share_name, std::string topic_filter, session_state<Sp> const& ss);
+    void insert(std::string share_name, interned_topic topic_filter, subscription<Sp> sub, session_state<Sp>& ss);
+    void erase(std::string share_name, interned_topic topic_filter, session_state<Sp> const& ss);
     void erase(session_state<Sp> const& ss);
     std::optional<std::tuple<session_state_ref<Sp>, subscription<Sp>>>
-    get_target(std::string const& share_name, std::string const& topic_filter);
+    get_target(std::string const& share_name, interned_topic const& topic_filter);
 
 private:
     struct entry {
@@ -42,7 +43,7 @@ private:
         std::string share_name;
         session_state_ref<Sp> ssr;
         std::chrono::time_point<std::chrono::steady_clock> tp;
-        std::map<std::string, subscription<Sp>> tf_subs;
+        std::map<interned_topic, subscription<Sp>> tf_subs;
     };
 
     using mi_shared_target = mi::multi_index_container<
@@ -17,7 +17,7 @@ namespace async_mqtt {
 template <typename Sp>
 inline void shared_target<Sp>::insert(
     std::string share_name,
-    std::string topic_filter,
+    interned_topic topic_filter,
     subscription<Sp> sub,
     session_state<Sp>& ss
 ) {
@@ -47,7 +47,7 @@ inline void shared_target<Sp>::insert(
 template <typename Sp>
 inline void shared_target<Sp>::erase(
     std::string share_name,
-    std::string topic_filter,
+    interned_topic topic_filter,
     session_state<Sp> const& ss
 ) {
     std::lock_guard<mutex> g{mtx_targets_};
@@ -86,7 +86,7 @@ inline void shared_target<Sp>::erase(
 template <typename Sp>
 inline std::optional<std::tuple<session_state_ref<Sp>, subscription<Sp>>> shared_target<Sp>::get_target(
     std::string const& share_name,
-    std::string const& topic_filter
+    interned_topic const& topic_filter
 ) {
     std::lock_guard<mutex> g{mtx_targets_};
     // get share_name matched range ordered by timestamp (ascending)
@@ -9,11 +9,72 @@
 
 #include <broker/subscription_map.hpp>
 #include <broker/subscription.hpp>
+#include <broker/interest_summary.hpp>
 
 namespace async_mqtt {
 
+// Subscription map that maintains the interest summary of its topic filters.
+// The summary counts each (topic filter, client id) pair, so a topic filter
+// stays in the summary while any client subscribes it.
 template <typename Sp>
-using sub_con_map = multiple_subscription_map<std::string, subscription<Sp>>;
+class sub_con_map : public multiple_subscription_map<std::string, subscription<Sp>> {
+    using base_type = multiple_subscription_map<std::string, subscription<Sp>>;
+
+public:
+    using handle = typename base_type::handle;
+
+    template <typename K, typename V>
+    std::pair<handle, bool> insert_or_assign(std::string_view topic_filter, K&& key, V&& value) {
+        auto ret = base_type::insert_or_assign(topic_filter, std::forward<K>(key), std::forward<V>(value));
+        if (ret.second) summary_.insert(topic_filter);
+        return ret;
+    }
+
+    template <typename K, typename V>
+    std::pair<handle, bool> insert_or_assign(handle const& h, K&& key, V&& value) {
+        auto ret = base_type::insert_or_assign(h, std::forward<K>(key), std::forward<V>(value));
+        if (ret.second) summary_.insert(this->handle_to_topic_filter(h));
+        return ret;
+    }
+
+    std::size_t erase(handle const& h, std::string const& key) {
+        // the base throws the invalid handle error
+        if (this->get_key(h) == this->end()) return base_type::erase(h, key);
+        auto topic_filter = this->handle_to_topic_filter(h);
+        auto ret = base_type::erase(h, key);
+        if (ret) summary_.erase(topic_filter);
+        return ret;
+    }
+
+    template <typename Condition>
+    std::size_t erase_if(handle const& h, std::string const& key, Condition cond) {
+        std::string topic_filter;
+        auto ret = base_type::erase_if(
+            h,
+            key,
+            [&](subscription<Sp> const& sub) {
+                if (!cond(sub)) return false;
+                topic_filter = this->handle_to_topic_filter(h);
+                return true;
+            }
+        );
+        if (ret) summary_.erase(topic_filter);
+        return ret;
+    }
+
+    std::size_t erase(std::string_view topic_filter, std::string const& key) {
+        auto ret = base_type::erase(topic_filter, key);
+        if (ret) summary_.erase(topic_filter);
+        return ret;
+    }
+
+    interest_summary const& summary() const {
+        return summary_;
+    }
+
+private:
+    interest_summary summary_;
+};
 
 } // namespace async_mqtt
 
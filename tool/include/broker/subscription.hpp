@@ -12,6 +12,7 @@
 
 #include <async_mqtt/protocol/packet/subopts.hpp>
 #include <broker/session_state_fwd.hpp>
+#include <broker/topic_pool.hpp>
 #include <async_mqtt/util/move.hpp>
 
 namespace async_mqtt {
@@ -21,7 +22,7 @@ struct subscription {
     subscription(
         session_state_ref<Sp> ss,
         std::string sharename,
-        std::string topic,
+        interned_topic topic,
         sub::opts opts,
         std::optional<std::size_t> sid)
         :ss{ss},
@@ -33,7 +34,7 @@ struct subscription {
 
     session_state_ref<Sp> ss;
     std::string sharename;
-    std::string topic;
+    interned_topic topic;
     sub::opts opts;
     std::optional<std::size_t> sid;
 };
@@ -7,19 +7,27 @@
 #if !defined(ASYNC_MQTT_BROKER_SUBSCRIPTION_MAP_HPP)
 #define ASYNC_MQTT_BROKER_SUBSCRIPTION_MAP_HPP
 
+#include <functional>
 #include <unordered_map>
 #include <string_view>
 #include <optional>
+#include <tuple>
 
 #include <boost/functional/hash.hpp>
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/key.hpp>
 #include <boost/range/adaptor/reversed.hpp>
 
 #include <async_mqtt/util/buffer.hpp>
 
 #include <broker/topic_filter.hpp>
+#include <broker/tokenized_topic.hpp>
 
 namespace async_mqtt {
 
+namespace mi = boost::multi_index;
+
 /**
  *
  * In MQTT we have:
@@ -212,8 +220,44 @@ private:
 
     using this_type = subscription_map_base<Value>;
 
-    // Use boost hash to hash pair in path_entry_key
-    using map_type = std::unordered_map< path_entry_key, path_entry, boost::hash< path_entry_key > >;
+    // The key is not modified after the insertion, so the entry can be modified
+    // through the const iterators of the multi_index_container.
+    struct map_value {
+        map_value(path_entry_key key, path_entry entry)
+            : first(force_move(key)), second(force_move(entry))
+        {}
+
+        node_id_type parent_id() const { return first.first; }
+        std::string_view name() const { return first.second; }
+
+        path_entry_key first;
+        mutable path_entry second;
+    };
+
+    // the name hash accepts tokenized_topic::level_type, so precomputed hashes are reused
+    using map_type = mi::multi_index_container<
+        map_value,
+        mi::indexed_by<
+            mi::hashed_unique<
+                mi::key<
+                    &map_value::parent_id,
+                    &map_value::name
+                >,
+                mi::composite_key_hash<
+                    boost::hash<node_id_type>,
+                    topic_level_hash
+                >,
+                mi::composite_key_equal_to<
+                    std::equal_to<node_id_type>,
+                    topic_level_equal
+                >
+            >
+        >
+    >;
+
+    static auto lookup_key(path_entry_key const& key) {
+        return std::make_tuple(key.first, std::string_view{key.second});
+    }
 
     map_type map;
     using map_type_iterator = typename map_type::iterator;
@@ -227,14 +271,17 @@ protected:
     node_id_type root_node_id;
 
     // Return the iterator of the root
-    map_type_iterator get_root() { return map.find(root_key); };
-    map_type_const_iterator get_root() const { return map.find(root_key); };
+    map_type_iterator get_root() { return map.find(lookup_key(root_key)); };
+    map_type_const_iterator get_root() const { return map.find(lookup_key(root_key)); };
 
 
     // Map size tracks the total number of subscriptions within the map
     size_t map_size = 0;
 
-    map_type_iterator get_key(path_entry_key key) { return map.find(key); }
+    // Incremented on each insertion and removal of a subscription
+    std::size_t generation_ = 0;
+
+    map_type_iterator get_key(path_entry_key const& key) { return map.find(lookup_key(key)); }
     map_type_iterator begin() { return map.begin(); }
     map_type_iterator end() { return map.end(); }
     map_type const& get_map() const { return map; }
@@ -250,7 +297,7 @@ protected:
         topic_filter_tokenizer(
             topic_filter,
             [this, &path, &parent_id](std::string_view t) mutable {
-                auto entry = map.find(path_entry_key(parent_id, t));
+                auto entry = map.find(std::make_tuple(parent_id, t));
 
                 if (entry == map.end()) {
                     path.clear();
@@ -274,7 +321,7 @@ protected:
         topic_filter_tokenizer(
             topic_filter,
             [this, &parent, &result](std::string_view t) mutable {
-                auto entry = map.find(path_entry_key(parent->second.id, t));
+                auto entry = map.find(std::make_tuple(parent->second.id, t));
 
                 if (entry == map.end()) {
                     entry =
@@ -324,9 +371,9 @@ protected:
                 remove_plus_child_flag = (entry->first.second == "+");
                 remove_hash_child_flag = (entry->first.second == "#");
 
-                // Erase in unordered map only invalidates erased iterator
+                // Erase in hashed index only invalidates erased iterator
                 // other iterators are unaffected
-                map.erase(entry->first);
+                map.erase(entry);
             }
         }
 
@@ -341,47 +388,50 @@ protected:
     }
 
     template <typename ThisType, typename Output>
-    static void find_match_impl(ThisType& self, std::string_view topic, Output&& callback) {
+    static void find_match_impl(ThisType& self, tokenized_topic const& topic, Output&& callback) {
         using iterator_type = decltype(self.map.end()); // const_iterator or iterator depends on self
 
         std::vector<iterator_type> entries;
         entries.push_back(self.get_root());
+        std::vector<iterator_type> new_entries;
 
-        topic_filter_tokenizer(
-            topic,
-            [&self, &entries, &callback](std::string_view t) {
-                std::vector<iterator_type> new_entries;
+        // The levels are looked up by their precomputed hashes, so the names are not rehashed.
+        auto const plus = tokenized_topic::level_type{"+", tokenized_topic::hash_level("+")};
+        auto const hash = tokenized_topic::level_type{"#", tokenized_topic::hash_level("#")};
 
-                for (auto& entry : entries) {
-                    auto parent = entry->second.id;
-                    auto i = self.map.find(path_entry_key(parent, t));
-                    if (i != self.map.end()) {
-                        new_entries.push_back(i);
-                    }
+        for (auto const& level : topic) {
+            auto t = level.name;
+            new_entries.clear();
+
+            for (auto& entry : entries) {
+                auto parent = entry->second.id;
+                auto i = self.map.find(std::make_tuple(parent, level));
+                if (i != self.map.end()) {
+                    new_entries.push_back(i);
+                }
 
-                    if (entry->second.count .has_plus_child()) {
-                        i = self.map.find(path_entry_key(parent, std::string_view("+")));
-                        if (i != self.map.end()) {
-                            if (parent != self.root_node_id || t.empty() || t[0] != '$') {
-                                new_entries.push_back(i);
-                            }
+                if (entry->second.count .has_plus_child()) {
+                    i = self.map.find(std::make_tuple(parent, plus));
+                    if (i != self.map.end()) {
+                        if (parent != self.root_node_id || t.empty() || t[0] != '$') {
+                            new_entries.push_back(i);
                         }
                     }
+                }
 
-                    if (entry->second.count.has_hash_child()) {
-                        i = self.map.find(path_entry_key(parent, std::string_view("#")));
-                        if (i != self.map.end()) {
-                            if (parent != self.root_node_id || t.empty() || t[0] != '$'){
-                                callback(i->second.value);
-                            }
+                if (entry->second.count.has_hash_child()) {
+                    i = self.map.find(std::make_tuple(parent, hash));
+                    if (i != self.map.end()) {
+                        if (parent != self.root_node_id || t.empty() || t[0] != '$'){
+                            callback(i->second.value);
                         }
                     }
                 }
-
-                std::swap(entries, new_entries);
-                return !entries.empty();
             }
-        );
+
+            std::swap(entries, new_entries);
+            if (entries.empty()) break;
+        }
 
         for (auto& entry : entries) {
             callback(entry->second.value);
@@ -390,13 +440,13 @@ protected:
 
     // Find all topic filters that match the specified topic
     template<typename Output>
-    void find_match(std::string_view topic, Output&& callback) const {
+    void find_match(tokenized_topic const& topic, Output&& callback) const {
         find_match_impl(*this, topic, std::forward<Output>(callback));
     }
 
     // Find all topic filters and allow modification
     template<typename Output>
-    void modify_match(std::string_view topic, Output&& callback) {
+    void modify_match(tokenized_topic const& topic, Output&& callback) {
         find_match_impl(*this, topic, std::forward<Output>(callback));
     }
 
@@ -404,7 +454,7 @@ protected:
     static void handle_to_iterators(ThisType& self, handle const &h, Output&& output) {
         auto i = h;
         while(i != self.root_key) {
-            auto entry_iter = self.map.find(i);
+            auto entry_iter = self.map.find(lookup_key(i));
             if (entry_iter == self.map.end()) {
                 throw_invalid_handle();
             }
@@ -441,12 +491,14 @@ protected:
         }
 
         ++map_size;
+        ++generation_;
     }
 
     // Decrease the map size (total number of subscriptions stored)
     void decrease_map_size() {
         BOOST_ASSERT(map_size > 0);
         --map_size;
+        ++generation_;
     }
 
     // Increase the number of subscriptions for this path
@@ -471,6 +523,9 @@ public:
     // Return the number of registered topic filters
     std::size_t size() const { return this->map_size; }
 
+    // Return the number that changes when a subscription is inserted or removed
+    std::size_t generation() const { return this->generation_; }
+
     // Lookup a topic filter
     std::optional<handle> lookup(std::string_view topic_filter) {
         auto path = this->find_topic_filter(topic_filter);
@@ -571,6 +626,11 @@ public:
     // Find all topic filters that match the specified topic
     template<typename Output>
     void find(std::string_view topic, Output&& callback) const {
+        find(tokenized_topic{topic}, std::forward<Output>(callback));
+    }
+
+    template<typename Output>
+    void find(tokenized_topic const& topic, Output&& callback) const {
         this->find_match(
             topic,
             [&callback](std::optional<Value> const& value) {
@@ -697,6 +757,27 @@ public:
         return result;
     }
 
+    // Remove a value at the specified handle only if cond(value) returns true
+    // Unlike erase(), the handle can be already removed. In this case, it returns 0.
+    // returns the number of removed elements
+    template <typename Condition>
+    std::size_t erase_if(handle const &h, Key const& key, Condition cond) {
+        auto h_iter = this->get_key(h);
+        if (h_iter == this->end()) {
+            return 0;
+        }
+
+        auto& values = h_iter->second.value;
+        auto it = values.find(key);
+        if (it == values.end() || !cond(it->second)) {
+            return 0;
+        }
+        values.erase(it);
+        this->remove_topic_filter(this->handle_to_iterators(h));
+        this->decrease_map_size();
+        return 1;
+    }
+
     // Remove a value at the specified topic filter
     // returns the number of removed elements
     std::size_t erase(std::string_view topic_filter, Key const& key) {
@@ -719,6 +800,11 @@ public:
     // Find all topic filters that match the specified topic
     template<typename Output>
     void find(std::string_view topic, Output&& callback) const {
+        find(tokenized_topic{topic}, std::forward<Output>(callback));
+    }
+
+    template<typename Output>
+    void find(tokenized_topic const& topic, Output&& callback) const {
         this->find_match(
             topic,
             [&callback]( Cont const &values ) {
@@ -732,6 +818,11 @@ public:
     // Find all topic filters that match and allow modification
     template<typename Output>
     void modify(std::string_view topic, Output&& callback) {
+        modify(tokenized_topic{topic}, std::forward<Output>(callback));
+    }
+
+    template<typename Output>
+    void modify(tokenized_topic const& topic, Output&& callback) {
         this->modify_match(
             topic,
             [&callback]( Cont &values ) {
@@ -742,6 +833,16 @@ public:
         );
     }
 
+    // Call the callback with each topic filter that has at least one value
+    template<typename Output>
+    void for_each_topic_filter(Output&& callback) const {
+        for (auto const& i: this->get_map()) {
+            if (!i.second.value.empty()) {
+                callback(this->handle_to_topic_filter(i.first));
+            }
+        }
+    }
+
     template<typename Output>
     void dump(Output &out) {
         out << "Root node id: " << this->root_node_id << std::endl;
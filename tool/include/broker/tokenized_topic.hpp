@@ -0,0 +1,98 @@
+// Copyright Takatoshi Kondo 2024
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#if !defined(ASYNC_MQTT_BROKER_TOKENIZED_TOPIC_HPP)
+#define ASYNC_MQTT_BROKER_TOKENIZED_TOPIC_HPP
+
+#include <cstddef>
+#include <functional>
+#include <string_view>
+
+#include <boost/assert.hpp>
+#include <boost/container/small_vector.hpp>
+
+#include <broker/topic_filter.hpp>
+
+namespace async_mqtt {
+
+// Topic name or topic filter split into levels once.
+// Each level keeps its hash, so hashed lookups by level don't rescan the string.
+// It refers to the original string, so the string must outlive it.
+class tokenized_topic {
+public:
+    struct level_type {
+        std::string_view name;
+        std::size_t hash;
+    };
+
+    static std::size_t hash_level(std::string_view name) {
+        return std::hash<std::string_view>{}(name);
+    }
+
+    explicit tokenized_topic(std::string_view topic)
+        :topic_{topic}
+    {
+        topic_filter_tokenizer(
+            topic,
+            [this](std::string_view t) {
+                levels_.push_back(level_type{t, hash_level(t)});
+                return true;
+            }
+        );
+    }
+
+    std::string_view str() const {
+        return topic_;
+    }
+
+    std::size_t size() const {
+        return levels_.size();
+    }
+
+    level_type const& operator[](std::size_t i) const {
+        BOOST_ASSERT(i < levels_.size());
+        return levels_[i];
+    }
+
+    auto begin() const {
+        return levels_.begin();
+    }
+
+    auto end() const {
+        return levels_.end();
+    }
+
+private:
+    std::string_view topic_;
+    boost::container::small_vector<level_type, 8> levels_;
+};
+
+// Hash and equality for a level name that accept both string_view and
+// tokenized_topic::level_type. The hash of a level_type is the precomputed one.
+struct topic_level_hash {
+    std::size_t operator()(std::string_view v) const {
+        return tokenized_topic::hash_level(v);
+    }
+    std::size_t operator()(tokenized_topic::level_type const& v) const {
+        return v.hash;
+    }
+};
+
+struct topic_level_equal {
+    bool operator()(std::string_view lhs, std::string_view rhs) const {
+        return lhs == rhs;
+    }
+    bool operator()(tokenized_topic::level_type const& lhs, std::string_view rhs) const {
+        return lhs.name == rhs;
+    }
+    bool operator()(std::string_view lhs, tokenized_topic::level_type const& rhs) const {
+        return lhs == rhs.name;
+    }
+};
+
+} // namespace async_mqtt
+
+#endif // ASYNC_MQTT_BROKER_TOKENIZED_TOPIC_HPP
@@ -11,15 +11,170 @@
 #include <string_view>
 #include <limits>
 #include <cstdint>
+#include <type_traits>
 
 #include <boost/assert.hpp>
 
 #include <async_mqtt/util/string_view_helper.hpp>
 
+// Topic scanning uses SSE2 or AVX2 when the target supports it.
+// Define ASYNC_MQTT_BROKER_NO_SIMD to use the scalar implementation only.
+#if !defined(ASYNC_MQTT_BROKER_NO_SIMD)
+#if defined(__AVX2__)
+#define ASYNC_MQTT_BROKER_TOPIC_AVX2
+#endif // defined(__AVX2__)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ASYNC_MQTT_BROKER_TOPIC_SSE2
+#endif // defined(__SSE2__) || ...
+#endif // !defined(ASYNC_MQTT_BROKER_NO_SIMD)
+
+#if defined(ASYNC_MQTT_BROKER_TOPIC_AVX2)
+#include <immintrin.h>
+#elif defined(ASYNC_MQTT_BROKER_TOPIC_SSE2)
+#include <emmintrin.h>
+#endif
+
+#if defined(ASYNC_MQTT_BROKER_TOPIC_SSE2) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// The validation functions are constexpr. The vectorized scan is used only
+// when they are evaluated at run time.
+#if defined(__cpp_lib_is_constant_evaluated)
+#define ASYNC_MQTT_BROKER_IS_CONSTANT_EVALUATED() std::is_constant_evaluated()
+#elif defined(__GNUC__) && (__GNUC__ >= 9)
+#define ASYNC_MQTT_BROKER_IS_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#elif defined(__clang__) && defined(__has_builtin)
+#if __has_builtin(__builtin_is_constant_evaluated)
+#define ASYNC_MQTT_BROKER_IS_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#endif
+#elif defined(_MSC_VER) && (_MSC_VER >= 1925)
+#define ASYNC_MQTT_BROKER_IS_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#endif
+
+#if !defined(ASYNC_MQTT_BROKER_IS_CONSTANT_EVALUATED)
+// Unknown compiler. Always use the scalar implementation.
+#define ASYNC_MQTT_BROKER_IS_CONSTANT_EVALUATED() true
+#endif
+
 namespace async_mqtt {
 
 static constexpr char topic_filter_separator = '/';
 
+namespace detail {
+
+// Return the index of the first character that is one of Cs, or n if not found.
+template <char... Cs>
+inline std::size_t topic_find_first_of_scalar(char const* p, std::size_t n) {
+    for (std::size_t i = 0; i != n; ++i) {
+        if (((p[i] == Cs) || ...)) return i;
+    }
+    return n;
+}
+
+#if defined(ASYNC_MQTT_BROKER_TOPIC_SSE2)
+
+inline std::size_t topic_count_trailing_zero(std::uint32_t bits) {
+    BOOST_ASSERT(bits != 0);
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long idx;
+    _BitScanForward(&idx, bits);
+    return idx;
+#else  // defined(_MSC_VER) && !defined(__clang__)
+    return static_cast<std::size_t>(__builtin_ctz(bits));
+#endif // defined(_MSC_VER) && !defined(__clang__)
+}
+
+#endif // defined(ASYNC_MQTT_BROKER_TOPIC_SSE2)
+
+#if defined(ASYNC_MQTT_BROKER_TOPIC_AVX2)
+
+// bit i is set if p[i] is one of Cs (32 bytes)
+template <char... Cs>
+inline std::uint32_t topic_match_mask32(char const* p) {
+    auto v = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(p));
+    auto m = _mm256_setzero_si256();
+    ((m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(Cs)))), ...);
+    return static_cast<std::uint32_t>(_mm256_movemask_epi8(m));
+}
+
+#endif // defined(ASYNC_MQTT_BROKER_TOPIC_AVX2)
+
+#if defined(ASYNC_MQTT_BROKER_TOPIC_SSE2)
+
+// bit i is set if p[i] is one of Cs (16 bytes)
+template <char... Cs>
+inline std::uint32_t topic_match_mask16(char const* p) {
+    auto v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p));
+    auto m = _mm_setzero_si128();
+    ((m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8(Cs)))), ...);
+    return static_cast<std::uint32_t>(_mm_movemask_epi8(m));
+}
+
+#endif // defined(ASYNC_MQTT_BROKER_TOPIC_SSE2)
+
+// Return the index of the first character that is one of Cs, or n if not found.
+// 32 bytes (AVX2) or 16 bytes (SSE2) are compared at once, and the rest is scanned one by one.
+template <char... Cs>
+inline std::size_t topic_find_first_of(char const* p, std::size_t n) {
+    std::size_t i = 0;
+#if defined(ASYNC_MQTT_BROKER_TOPIC_AVX2)
+    for (; i + 32 <= n; i += 32) {
+        auto bits = topic_match_mask32<Cs...>(p + i);
+        if (bits != 0) return i + topic_count_trailing_zero(bits);
+    }
+#endif // defined(ASYNC_MQTT_BROKER_TOPIC_AVX2)
+#if defined(ASYNC_MQTT_BROKER_TOPIC_SSE2)
+    for (; i + 16 <= n; i += 16) {
+        auto bits = topic_match_mask16<Cs...>(p + i);
+        if (bits != 0) return i + topic_count_trailing_zero(bits);
+    }
+#endif // defined(ASYNC_MQTT_BROKER_TOPIC_SSE2)
+    return i + topic_find_first_of_scalar<Cs...>(p + i, n - i);
+}
+
+// Call f(index) for each character that is one of Cs in ascending order, in one pass.
+// If f returns false, stop and return false. Otherwise return true.
+template <char... Cs, typename Func>
+inline bool topic_for_each_of(char const* p, std::size_t n, Func f) {
+    std::size_t i = 0;
+#if defined(ASYNC_MQTT_BROKER_TOPIC_AVX2)
+    for (; i + 32 <= n; i += 32) {
+        for (auto bits = topic_match_mask32<Cs...>(p + i); bits != 0; bits &= bits - 1) {
+            if (!f(i + topic_count_trailing_zero(bits))) return false;
+        }
+    }
+#endif // defined(ASYNC_MQTT_BROKER_TOPIC_AVX2)
+#if defined(ASYNC_MQTT_BROKER_TOPIC_SSE2)
+    for (; i + 16 <= n; i += 16) {
+        for (auto bits = topic_match_mask16<Cs...>(p + i); bits != 0; bits &= bits - 1) {
+            if (!f(i + topic_count_trailing_zero(bits))) return false;
+        }
+    }
+#endif // defined(ASYNC_MQTT_BROKER_TOPIC_SSE2)
+    for (; i != n; ++i) {
+        if (((p[i] == Cs) || ...)) {
+            if (!f(i)) return false;
+        }
+    }
+    return true;
+}
+
+// std::string_view::find_first_of compatible interface of the characters that need validation.
+constexpr std::string_view::size_type topic_find_null_or_wildcard(
+    std::string_view str,
+    std::string_view::size_type pos
+) {
+    if (ASYNC_MQTT_BROKER_IS_CONSTANT_EVALUATED()) {
+        return str.find_first_of(std::string_view("\0+#", 3), pos);
+    }
+    if (pos >= str.size()) return std::string_view::npos;
+    auto idx = pos + topic_find_first_of<'\0', '+', '#'>(str.data() + pos, str.size() - pos);
+    return idx == str.size() ? std::string_view::npos : idx;
+}
+
+} // namespace detail
+
 template<typename Iterator>
 inline Iterator topic_filter_tokenizer_next(Iterator first, Iterator last) {
     return std::find(first, last, topic_filter_separator);
@@ -38,20 +193,26 @@ inline std::size_t topic_filter_tokenizer(Iterator first, Iterator last, Output
 }
 
 
+// Separators are found in one pass over the string, so a topic with many
+// short levels doesn't restart the vectorized scan for each level.
 template<typename Output>
 inline std::size_t topic_filter_tokenizer(std::string_view str, Output write) {
-    return topic_filter_tokenizer(
-        std::begin(str),
-        std::end(str),
-        [&write](std::string_view::const_iterator token_begin, std::string_view::const_iterator token_end) {
-            return write(
-                make_string_view(
-                    token_begin,
-                    token_end
-                )
-            );
+    std::size_t count = 1;
+    std::size_t begin = 0;
+    auto completed = detail::topic_for_each_of<topic_filter_separator>(
+        str.data(),
+        str.size(),
+        [&](std::size_t pos) {
+            if (!write(std::string_view(str.data() + begin, pos - begin))) return false;
+            begin = pos + 1;
+            ++count;
+            return true;
         }
     );
+    if (completed) {
+        write(std::string_view(str.data() + begin, str.size() - begin));
+    }
+    return count;
 }
 
 // TODO: Technically this function is simply wrong, since it's treating the
@@ -72,9 +233,9 @@ constexpr bool validate_topic_filter(std::string_view topic_filter) {
         return false;
     }
 
-    for (std::string_view::size_type idx = topic_filter.find_first_of(std::string_view("\0+#", 3));
+    for (std::string_view::size_type idx = detail::topic_find_null_or_wildcard(topic_filter, 0);
          std::string_view::npos != idx;
-         idx = topic_filter.find_first_of(std::string_view("\0+#", 3), idx+1)) {
+         idx = detail::topic_find_null_or_wildcard(topic_filter, idx+1)) {
         BOOST_ASSERT(
             ('\0' == topic_filter[idx])
             || ('+'  == topic_filter[idx])
@@ -166,7 +327,7 @@ constexpr bool validate_topic_name(std::string_view topic_name) {
     return
         ! topic_name.empty()
         && (topic_name.size() <= std::numeric_limits<std::uint16_t>::max())
-        && (std::string_view::npos == topic_name.find_first_of(std::string_view("\0+#", 3)));
+        && (std::string_view::npos == detail::topic_find_null_or_wildcard(topic_name, 0));
 }
 
 // The following rules come from https://docs.oasis-open.org/mqtt/mqtt/v5.0/os/mqtt-v5.0-os.html#_Toc3901247
@@ -0,0 +1,203 @@
+// Copyright Takatoshi Kondo 2024
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#if !defined(ASYNC_MQTT_BROKER_TOPIC_POOL_HPP)
+#define ASYNC_MQTT_BROKER_TOPIC_POOL_HPP
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <async_mqtt/util/move.hpp>
+
+#include <broker/topic_filter.hpp>
+
+namespace async_mqtt {
+
+class topic_pool;
+
+// Handle of a topic name or topic filter interned by topic_pool.
+// The same string always gets the same entry while at least one handle is alive,
+// so comparison is a pointer comparison and copy is a reference count increment.
+// The hash and the level boundaries are calculated once when the entry is created.
+class interned_topic {
+public:
+    interned_topic() = default;
+
+    std::string_view str() const {
+        if (!p_) return std::string_view{};
+        return p_->str;
+    }
+
+    operator std::string_view() const {
+        return str();
+    }
+
+    std::size_t hash() const {
+        if (!p_) return 0;
+        return p_->hash;
+    }
+
+    std::size_t levels() const {
+        if (!p_) return 0;
+        return p_->level_ends.size();
+    }
+
+    std::string_view level(std::size_t i) const {
+        BOOST_ASSERT(p_);
+        BOOST_ASSERT(i < p_->level_ends.size());
+        std::size_t begin = i == 0 ? 0 : p_->level_ends[i - 1] + 1;
+        return std::string_view{p_->str}.substr(begin, p_->level_ends[i] - begin);
+    }
+
+    explicit operator bool() const {
+        return static_cast<bool>(p_);
+    }
+
+    friend bool operator==(interned_topic const& lhs, interned_topic const& rhs) {
+        return lhs.p_ == rhs.p_;
+    }
+
+    friend bool operator!=(interned_topic const& lhs, interned_topic const& rhs) {
+        return lhs.p_ != rhs.p_;
+    }
+
+    // Order by identity. It is stable while the handles are alive, but not lexicographical.
+    friend bool operator<(interned_topic const& lhs, interned_topic const& rhs) {
+        return std::less<void const*>{}(lhs.p_.get(), rhs.p_.get());
+    }
+
+    friend std::ostream& operator<<(std::ostream& o, interned_topic const& v) {
+        o << v.str();
+        return o;
+    }
+
+private:
+    friend class topic_pool;
+
+    struct entry {
+        std::string str;
+        std::size_t hash;
+        std::vector<std::uint32_t> level_ends;
+    };
+
+    explicit interned_topic(std::shared_ptr<entry const> p)
+        :p_{force_move(p)}
+    {}
+
+    std::shared_ptr<entry const> p_;
+};
+
+// Concurrent interning table for topic names and topic filters.
+// The table is split into shards by hash, and each shard has its own lock.
+// An entry is removed from the table when its last handle is released.
+class topic_pool {
+public:
+    topic_pool() {
+        for (auto& s : shards_) {
+            s = std::make_shared<shard>();
+        }
+    }
+
+    // Return the handle of str. If it doesn't exist, it is created.
+    interned_topic intern(std::string_view str) {
+        auto h = std::hash<std::string_view>{}(str);
+        auto const& sp = shards_[h % shards_.size()];
+        std::lock_guard<std::mutex> g{sp->mtx};
+        auto it = sp->entries.find(str);
+        if (it != sp->entries.end()) {
+            if (auto p = it->second.weak.lock()) {
+                return interned_topic{force_move(p)};
+            }
+            // The last handle has been released, but the deleter hasn't erased it yet.
+            sp->entries.erase(it);
+        }
+
+        auto* raw = new interned_topic::entry{std::string{str}, h, {}};
+        std::uint32_t pos = 0;
+        topic_filter_tokenizer(
+            raw->str,
+            [&](std::string_view token) {
+                pos += static_cast<std::uint32_t>(token.size());
+                raw->level_ends.push_back(pos);
+                ++pos;
+                return true;
+            }
+        );
+        std::weak_ptr<shard> wsp = sp;
+        std::shared_ptr<interned_topic::entry const> p{
+            raw,
+            [wsp](interned_topic::entry const* e) {
+                if (auto sp = wsp.lock()) {
+                    std::lock_guard<std::mutex> g{sp->mtx};
+                    auto it = sp->entries.find(e->str);
+                    // The same string might be interned again after this entry expired.
+                    if (it != sp->entries.end() && it->second.raw == e) {
+                        sp->entries.erase(it);
+                    }
+                }
+                delete e;
+            }
+        };
+        sp->entries.emplace(raw->str, value{p, raw});
+        return interned_topic{force_move(p)};
+    }
+
+    // Return the handle of str if it is interned. Otherwise return an empty handle.
+    interned_topic find(std::string_view str) const {
+        auto h = std::hash<std::string_view>{}(str);
+        auto const& sp = shards_[h % shards_.size()];
+        std::lock_guard<std::mutex> g{sp->mtx};
+        auto it = sp->entries.find(str);
+        if (it == sp->entries.end()) return interned_topic{};
+        return interned_topic{it->second.weak.lock()};
+    }
+
+    std::size_t size() const {
+        std::size_t ret = 0;
+        for (auto const& sp : shards_) {
+            std::lock_guard<std::mutex> g{sp->mtx};
+            ret += sp->entries.size();
+        }
+        return ret;
+    }
+
+private:
+    struct value {
+        std::weak_ptr<interned_topic::entry const> weak;
+        interned_topic::entry const* raw;
+    };
+
+    struct shard {
+        std::mutex mtx;
+        // key refers to the string in the entry
+        std::unordered_map<std::string_view, value> entries;
+    };
+
+    std::array<std::shared_ptr<shard>, 16> shards_;
+};
+
+} // namespace async_mqtt
+
+namespace std {
+
+template <>
+struct hash<async_mqtt::interned_topic> {
+    std::size_t operator()(async_mqtt::interned_topic const& v) const noexcept {
+        return v.hash();
+    }
+};
+
+} // namespace std
+
+#endif // ASYNC_MQTT_BROKER_TOPIC_POOL_HPP
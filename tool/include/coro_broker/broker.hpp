@@ -18,6 +18,7 @@
 #include <broker/retained_messages.hpp>
 #include <broker/retained_topic_map.hpp>
 #include <broker/shared_target_impl.hpp>
+#include <broker/tokenized_topic.hpp>
 #include <broker/mutex.hpp>
 #include <broker/uuid.hpp>
 
@@ -56,6 +57,14 @@ public:
         security_ = force_move(sec);
     }
 
+    /**
+     * @brief set the limits of the offline queue of each session
+     *        It is applied to the sessions that are created after the call.
+     */
+    void set_offline_queue_config(offline_queue_config config) {
+        offline_queue_config_ = std::make_shared<offline_queue_config const>(force_move(config));
+    }
+
 private:
     as::awaitable<void>
     recv_loop(epsp_type epsp) {
@@ -497,6 +506,7 @@ private:
                     mtx_subs_map_,
                     subs_map_,
                     shared_targets_,
+                    topics_,
                     epsp,
                     client_id,
                     *username,
@@ -509,6 +519,7 @@ private:
                     force_move(will_expiry_interval),
                     force_move(session_expiry_interval)
                 );
+            ss->set_offline_queue_config(offline_queue_config_);
             epsp.set_session_state(*ss);
             it = idx.emplace_hint(
                 it,
@@ -576,6 +587,7 @@ private:
                             mtx_subs_map_,
                             subs_map_,
                             shared_targets_,
+                            topics_,
                             epsp,
                             client_id,
                             *username,
@@ -588,6 +600,7 @@ private:
                             force_move(will_expiry_interval),
                             force_move(session_expiry_interval)
                         );
+                    ss->set_offline_queue_config(offline_queue_config_);
                     epsp.set_session_state(*ss);
                     std::tie(it, inserted) = idx.emplace(
                         ss
@@ -1105,14 +1118,26 @@ private:
     ) {
         bool matched = false;
 
+        // The topic is split into levels once here, and then used by the authorization,
+        // the subscription match, and the retained message store.
+        tokenized_topic tt{topic};
+
         // Get auth rights for this topic
         // auth_users prepared once here, and then referred multiple times in subs_map_.modify() for efficiency
         auto auth_users =
             [&] {
                 std::shared_lock<mutex> g_sec{mtx_security_};
-                return security_.auth_sub(topic);
+                return security_.auth_sub(tt);
             } ();
 
+        // The message body is created once and shared by all subscribers.
+        // Only the per-subscriber delta (opts and sid) is passed to each session.
+        auto msg = shared_message::create(
+            topic,
+            force_move(payload),
+            force_move(props)
+        );
+
         // publish the message to subscribers.
         // retain is delivered as the original only if rap_value is rap::retain.
         // On MQTT v3.1.1, rap_value is always rap::dont.
@@ -1131,29 +1156,16 @@ private:
                     new_opts |= pub::retain::yes;
                 }
 
-                if (sub.sid) {
-                    props.push_back(property::subscription_identifier(boost::numeric_cast<std::uint32_t>(*sub.sid)));
-                    co_await ss.deliver(
-                        topic,
-                        payload,
-                        new_opts,
-                        props
-                    );
-                    props.pop_back();
-                }
-                else {
-                    co_await ss.deliver(
-                        topic,
-                        payload,
-                        new_opts,
-                        props
-                    );
-                }
+                co_await ss.deliver(
+                    msg,
+                    new_opts,
+                    sub.sid
+                );
                 co_return true;
             };
 
-        //                  share_name   topic_filter
-        std::set<std::tuple<std::string_view, std::string_view>> sent;
+        //                  share_name        topic_filter
+        std::set<std::tuple<std::string_view, interned_topic>> sent;
         std::vector<
             std::tuple<
                 as::any_io_executor,
@@ -1164,7 +1176,7 @@ private:
         {
             std::shared_lock<mutex> g{mtx_subs_map_};
             subs_map_.modify(
-                topic,
+                tt,
                 [&](std::string const& /*key*/, subscription<epsp_type>& sub) {
                     if (sub.sharename.empty()) {
                         // Non shared subscriptions
@@ -1230,16 +1242,7 @@ private:
 
         std::optional<std::chrono::steady_clock::duration> message_expiry_interval;
         if (source_ss.get_protocol_version() == protocol_version::v5) {
-            for (auto const& prop : props) {
-                prop.visit(
-                    overload {
-                        [&](property::message_expiry_interval const& v) {
-                            message_expiry_interval.emplace(std::chrono::seconds(v.val()));
-                        },
-                        [&](auto const&){}
-                    }
-                );
-            }
+            message_expiry_interval = msg->message_expiry_interval();
         }
 
         /*
@@ -1264,9 +1267,9 @@ private:
          *        the retained message is removed.
          */
         if (opts.get_retain() == pub::retain::yes) {
-            if (payload.empty()) {
+            if (msg->payload().empty()) {
                 std::unique_lock<mutex> g(mtx_retains_);
-                retains_.erase(topic);
+                retains_.erase(tt);
             }
             else {
                 std::shared_ptr<as::steady_timer> tim_message_expiry;
@@ -1290,11 +1293,9 @@ private:
 
                 std::unique_lock<mutex> g(mtx_retains_);
                 retains_.insert_or_assign(
-                    topic,
+                    tt,
                     retain_type {
-                        topic,
-                        force_move(payload),
-                        force_move(props),
+                        force_move(msg),
                         opts.get_qos(),
                         tim_message_expiry
                     }
@@ -1511,15 +1512,13 @@ private:
         auto publish_proc =
             [&ssr, &epsp]
             (retain_type const& r, qos qos_value, std::optional<std::size_t> sid) -> as::awaitable<void> {
-                auto props = r.props;
-                if (sid) {
-                    props.push_back(property::subscription_identifier(std::uint32_t(*sid)));
-                }
+                auto msg = r.msg;
                 if (r.tim_message_expiry) {
                     auto d =
                         std::chrono::duration_cast<std::chrono::seconds>(
                             r.tim_message_expiry->expiry() - std::chrono::steady_clock::now()
                         ).count();
+                    auto props = msg->props();
                     for (auto& prop : props) {
                         prop.visit(
                             overload {
@@ -1530,13 +1529,17 @@ private:
                             }
                         );
                     }
+                    msg = shared_message::create(
+                        msg->topic_as_buffer(),
+                        msg->payload(),
+                        force_move(props)
+                    );
                 }
                 co_await ssr.get().publish(
                     epsp,
-                    r.topic,
-                    r.payload,
+                    force_move(msg),
                     std::min(r.qos_value, qos_value) | pub::retain::yes,
-                    props
+                    sid
                 );
             };
 
@@ -2019,6 +2022,7 @@ private:
     mutable mutex mtx_security_;
     security security_;
 
+    topic_pool topics_; ///< interned topic filters shared by subscriptions
     mutable mutex mtx_subs_map_;
     sub_con_map<epsp_type> subs_map_;   ///< subscription information
     shared_target<epsp_type> shared_targets_; ///< shared subscription targets
@@ -2053,6 +2057,7 @@ private:
     bool pingresp_ = true;
     bool connack_ = true;
     bool recycling_allocator_;
+    std::shared_ptr<offline_queue_config const> offline_queue_config_; ///< nullptr means unlimited
 };
 
 } // namespace async_mqtt
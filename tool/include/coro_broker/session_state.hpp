@@ -19,9 +19,11 @@
 
 #include <broker/sub_con_map.hpp>
 #include <broker/shared_target.hpp>
+#include <broker/topic_pool.hpp>
 #include <broker/tags.hpp>
 #include <broker/inflight_message.hpp>
 #include <broker/offline_message.hpp>
+#include <broker/shared_message.hpp>
 #include <broker/mutex.hpp>
 
 namespace async_mqtt {
@@ -68,6 +70,7 @@ struct session_state : std::enable_shared_from_this<session_state<Sp>> {
         mutex& mtx_subs_map,
         sub_con_map<epsp_type>& subs_map,
         shared_target<epsp_type>& shared_targets,
+        topic_pool& topics,
         epsp_type epsp,
         std::string client_id,
         std::string const& username,
@@ -82,6 +85,7 @@ struct session_state : std::enable_shared_from_this<session_state<Sp>> {
                 mutex& mtx_subs_map,
                 sub_con_map<epsp_type>& subs_map,
                 shared_target<epsp_type>& shared_targets,
+                topic_pool& topics,
                 epsp_type epsp,
                 std::string client_id,
                 std::string const& username,
@@ -93,6 +97,7 @@ struct session_state : std::enable_shared_from_this<session_state<Sp>> {
                     mtx_subs_map,
                     subs_map,
                     shared_targets,
+                    topics,
                     force_move(epsp),
                     force_move(client_id),
                     username,
@@ -106,6 +111,7 @@ struct session_state : std::enable_shared_from_this<session_state<Sp>> {
             mtx_subs_map,
             subs_map,
             shared_targets,
+            topics,
             force_move(epsp),
             force_move(client_id),
             username,
@@ -133,8 +139,9 @@ struct session_state : std::enable_shared_from_this<session_state<Sp>> {
             << ASYNC_MQTT_ADD_VALUE(address, this)
             << "store inflight message";
         auto stored = epsp.get_stored_packets();
+        auto now = std::chrono::steady_clock::now();
         for (auto& store : stored) {
-            std::shared_ptr<as::steady_timer> tim_message_expiry;
+            std::optional<std::chrono::steady_clock::time_point> expiry;
             store.visit(
                 overload {
                     [&](v5::publish_packet const& p) {
@@ -142,21 +149,7 @@ struct session_state : std::enable_shared_from_this<session_state<Sp>> {
                             prop.visit(
                                 overload {
                                     [&](property::message_expiry_interval const& v) {
-                                        tim_message_expiry =
-                                            std::make_shared<as::steady_timer>(
-                                                exe_,
-                                                std::chrono::seconds(v.val())
-                                            );
-                                        tim_message_expiry->async_wait(
-                                            [this, wp = std::weak_ptr<as::steady_timer>(tim_message_expiry)]
-                                            (error_code ec) {
-                                                if (auto sp = wp.lock()) {
-                                                    if (!ec) {
-                                                        erase_inflight_message_by_expiry(sp);
-                                                    }
-                                                }
-                                            }
-                                        );
+                                        expiry.emplace(now + std::chrono::seconds(v.val()));
                                     },
                                     [](auto const&) {}
                                 }
@@ -169,11 +162,11 @@ struct session_state : std::enable_shared_from_this<session_state<Sp>> {
 
             insert_inflight_message(
                 force_move(store),
-                force_move(tim_message_expiry)
+                expiry
             );
         }
 
-        qos2_publish_handled_ = epsp.get_qos2_publish_handled_pids();
+        qos2_publish_handled_ = epsp.get_qos2_publish_handled_pid_bitset();
 
         if (session_expiry_interval_ &&
             *session_expiry_interval_ != std::chrono::seconds(session_never_expire)) {
@@ -230,14 +223,13 @@ struct session_state : std::enable_shared_from_this<session_state<Sp>> {
     as::awaitable<void>
     publish(
         epsp_type& epsp,
-        std::string pub_topic,
-        std::vector<buffer> payload,
+        shared_message_ptr msg,
         pub::opts pubopts,
-        properties props
+        std::optional<std::size_t> sid = std::nullopt
     ) {
 
         auto send_publish =
-            [this, epsp, pub_topic, payload = payload, pubopts, props, wp = this->weak_from_this()]
+            [this, epsp, msg, pubopts, sid, wp = this->weak_from_this()]
             (packet_id_type pid) mutable -> as::awaitable<void> {
                 if (auto sp = wp.lock()) {
                     switch (version_) {
@@ -245,8 +237,8 @@ struct session_state : std::enable_shared_from_this<session_state<Sp>> {
                         auto packet =
                             v3_1_1::publish_packet{
                                 pid,
-                                force_move(pub_topic),
-                                force_move(payload),
+                                msg->topic_as_buffer(),
+                                msg->payload(),
                                 pubopts
                             };
                         auto [ec] = co_await epsp.async_send(
@@ -264,10 +256,10 @@ struct session_state : std::enable_shared_from_this<session_state<Sp>> {
                         auto packet =
                             v5::publish_packet{
                                 pid,
-                                force_move(pub_topic),
-                                force_move(payload),
+                                msg->topic_as_buffer(),
+                                msg->payload(),
                                 pubopts,
-                                force_move(props)
+                                msg->props_for(sid)
                             };
                         auto [ec] = co_await epsp.async_send(
                             force_move(packet),
@@ -310,11 +302,9 @@ struct session_state : std::enable_shared_from_this<session_state<Sp>> {
         // offline_messages_ is not empty or packet_id_exhausted
         std::unique_lock<mutex> g(mtx_offline_messages_);
         offline_messages_.push_back(
-            exe_,
-            force_move(pub_topic),
-            force_move(payload),
+            force_move(msg),
             pubopts,
-            force_move(props)
+            sid
         );
         offline_messages_empty_ = false;
         co_return;
@@ -322,32 +312,33 @@ struct session_state : std::enable_shared_from_this<session_state<Sp>> {
 
     as::awaitable<void>
     deliver(
-        std::string pub_topic,
-        std::vector<buffer> payload,
+        shared_message_ptr msg,
         pub::opts pubopts,
-        properties props) {
+        std::optional<std::size_t> sid = std::nullopt) {
 
         if (auto epsp = lock()) {
             co_await publish(
                 epsp,
-                force_move(pub_topic),
-                force_move(payload),
+                force_move(msg),
                 pubopts,
-                force_move(props)
+                sid
             );
         }
         else {
             std::unique_lock<mutex> g(mtx_offline_messages_);
             offline_messages_.push_back(
-                exe_,
-                force_move(pub_topic),
-                force_move(payload),
+                force_move(msg),
                 pubopts,
-                force_move(props)
+                sid
             );
         }
     }
 
+    void set_offline_queue_config(std::shared_ptr<offline_queue_config const> config) {
+        std::lock_guard<mutex> g(mtx_offline_messages_);
+        offline_messages_.set_config(force_move(config));
+    }
+
     void set_clean_handler(std::function<void()> handler) {
         clean_handler_ = force_move(handler);
     }
@@ -386,9 +377,10 @@ struct session_state : std::enable_shared_from_this<session_state<Sp>> {
         PublishRetainHandler&& h,
         std::optional<std::size_t> sid = std::nullopt
     ) {
-        subscription<epsp_type> sub {*this, share_name, topic_filter, subopts, sid };
+        auto interned_topic_filter = topics_.intern(topic_filter);
+        subscription<epsp_type> sub {*this, share_name, interned_topic_filter, subopts, sid };
         if (!share_name.empty()) {
-            shared_targets_.insert(share_name, topic_filter, sub, *this);
+            shared_targets_.insert(share_name, force_move(interned_topic_filter), sub, *this);
         }
         ASYNC_MQTT_LOG("mqtt_broker", trace)
             << ASYNC_MQTT_ADD_VALUE(address, this)
@@ -433,7 +425,9 @@ struct session_state : std::enable_shared_from_this<session_state<Sp>> {
 
     void unsubscribe(std::string const& share_name, std::string const& topic_filter) {
         if (!share_name.empty()) {
-            shared_targets_.erase(share_name, topic_filter, *this);
+            if (auto interned_topic_filter = topics_.find(topic_filter)) {
+                shared_targets_.erase(share_name, force_move(interned_topic_filter), *this);
+            }
         }
         std::unique_lock<mutex> g{mtx_subs_map_};
         auto handle = subs_map_.lookup(topic_filter);
@@ -526,12 +520,13 @@ struct session_state : std::enable_shared_from_this<session_state<Sp>> {
 
     void insert_inflight_message(
         store_packet_variant msg,
-        std::shared_ptr<as::steady_timer> tim_message_expiry
+        std::optional<std::chrono::steady_clock::time_point> expiry
     ) {
         std::unique_lock<mutex> g(mtx_inflight_messages_);
+        inflight_messages_.sweep(std::chrono::steady_clock::now());
         inflight_messages_.insert(
             force_move(msg),
-            force_move(tim_message_expiry)
+            expiry
         );
     }
 
@@ -542,37 +537,17 @@ struct session_state : std::enable_shared_from_this<session_state<Sp>> {
         }
     }
 
-    void erase_inflight_message_by_expiry(std::shared_ptr<as::steady_timer> const& sp) {
-        std::unique_lock<mutex> g(mtx_inflight_messages_);
-        auto& idx = inflight_messages_.get<tag_tim>();
-        auto [b, e] = idx.equal_range(sp);
-        while (b != e) {
-        ASYNC_MQTT_LOG("mqtt_broker", info)
-            << "message expired:" << b->packet();
-            b = idx.erase(b);
-        }
-    }
-
     std::size_t erase_inflight_message_by_packet_id(packet_id_type packet_id) {
         std::unique_lock<mutex> g(mtx_inflight_messages_);
-        auto& idx = inflight_messages_.get<tag_pid>();
-        return idx.erase(packet_id);
+        return inflight_messages_.erase(packet_id);
     }
 
     void send_all_offline_messages() {
-        if (auto epsp = lock()) {
-            std::unique_lock<mutex> g(mtx_offline_messages_);
-            offline_messages_.send_until_fail(epsp, get_protocol_version());
-            offline_messages_empty_ = offline_messages_.empty();
-        }
+        start_offline_replay();
     }
 
     void send_offline_messages_by_packet_id_release() {
-        if (auto epsp = lock()) {
-            std::unique_lock<mutex> g(mtx_offline_messages_);
-            offline_messages_.send_until_fail(epsp, get_protocol_version());
-            offline_messages_empty_ = offline_messages_.empty();
-        }
+        start_offline_replay();
     }
 
     protocol_version get_protocol_version() const {
@@ -616,7 +591,7 @@ struct session_state : std::enable_shared_from_this<session_state<Sp>> {
         update_will(force_move(will), will_expiry_interval);
 
         session_expiry_interval_ = force_move(session_expiry_interval);
-        epsp.restore_qos2_publish_handled_pids(qos2_publish_handled_);
+        epsp.restore_qos2_publish_handled_pid_bitset(qos2_publish_handled_);
     }
 
     epsp_type lock() {
@@ -650,6 +625,7 @@ private:
         mutex& mtx_subs_map,
         sub_con_map<epsp_type>& subs_map,
         shared_target<epsp_type>& shared_targets,
+        topic_pool& topics,
         epsp_type epsp,
         std::string client_id,
         std::string const& username,
@@ -660,6 +636,7 @@ private:
          mtx_subs_map_(mtx_subs_map),
          subs_map_(subs_map),
          shared_targets_(shared_targets),
+         topics_(topics),
          epwp_(epsp),
          version_(epsp.get_protocol_version()),
          client_id_(force_move(client_id)),
@@ -748,6 +725,50 @@ private:
         co_return;
     }
 
+    // Replay the offline messages incrementally.
+    // Each step sends one batch from one handler, so the endpoint's bulk write
+    // gathers the batch into one write. The next step is posted to the back of
+    // the executor's queue, so other sessions and live traffic run in between.
+    // Live messages are queued behind the replay while offline_messages_empty_ is false.
+    void start_offline_replay() {
+        auto epsp = lock();
+        if (!epsp) return;
+        {
+            std::unique_lock<mutex> g(mtx_offline_messages_);
+            // a replay to the same endpoint is in progress
+            if (offline_replay_address_ == epsp.get_address()) return;
+            offline_replay_address_ = epsp.get_address();
+        }
+        epsp.dispatch(
+            [epsp, wp = this->weak_from_this()] () mutable {
+                if (auto sp = wp.lock()) sp->offline_replay_step(epsp);
+            }
+        );
+    }
+
+    void offline_replay_step(epsp_type& epsp) {
+        std::unique_lock<mutex> g(mtx_offline_messages_);
+        // the endpoint of the session has been replaced or disconnected
+        if (offline_replay_address_ != epsp.get_address()) return;
+        auto current = lock();
+        if (!current || current.get_address() != epsp.get_address()) {
+            offline_replay_address_ = nullptr;
+            return;
+        }
+        bool remain = offline_messages_.send_batch(epsp, get_protocol_version());
+        offline_messages_empty_ = offline_messages_.empty();
+        if (!remain) {
+            // drained, or waiting for packet id release
+            offline_replay_address_ = nullptr;
+            return;
+        }
+        epsp.post(
+            [epsp, wp = this->weak_from_this()] () mutable {
+                if (auto sp = wp.lock()) sp->offline_replay_step(epsp);
+            }
+        );
+    }
+
 private:
     friend class session_states<epsp_type>;
 
@@ -758,6 +779,7 @@ private:
     mutex& mtx_subs_map_;
     sub_con_map<epsp_type>& subs_map_;
     shared_target<epsp_type>& shared_targets_;
+    topic_pool& topics_;
     epwp_type epwp_;
     protocol_version version_;
     std::string client_id_;
@@ -773,6 +795,8 @@ private:
     mutable mutex mtx_offline_messages_;
     offline_messages offline_messages_;
     std::atomic<bool> offline_messages_empty_ = true;
+    // address of the endpoint that the offline messages are being replayed to
+    void const* offline_replay_address_ = nullptr;
 
     using elem_type = typename sub_con_map<epsp_type>::handle;
     std::set<elem_type> handles_; // to efficient remove
@@ -781,7 +805,7 @@ private:
     will_sender_type will_sender_;
     bool remain_after_close_;
 
-    std::set<packet_id_type> qos2_publish_handled_;
+    packet_id_bitset qos2_publish_handled_;
 
     std::optional<std::string> response_topic_;
     std::function<void()> clean_handler_;
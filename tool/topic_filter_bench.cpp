@@ -0,0 +1,240 @@
+// Copyright Takatoshi Kondo 2024
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <iterator>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include <broker/topic_filter.hpp>
+
+namespace am = async_mqtt;
+
+namespace {
+
+// Topics look like "building/floor003/room0012/...". Each level is level_size or
+// level_size + 1 characters long, and the topic is cut at the requested length.
+std::vector<std::string> make_topics(
+    std::mt19937& gen,
+    std::size_t count,
+    std::size_t length,
+    std::size_t level_size
+) {
+    static constexpr std::string_view chars = "abcdefghijklmnopqrstuvwxyz0123456789";
+    std::uniform_int_distribution<std::size_t> char_dist{0, chars.size() - 1};
+    std::uniform_int_distribution<std::size_t> level_dist{level_size, level_size + 1};
+    std::vector<std::string> ret;
+    ret.reserve(count);
+    for (std::size_t i = 0; i != count; ++i) {
+        std::string topic;
+        while (topic.size() < length) {
+            if (!topic.empty()) topic.push_back('/');
+            auto n = level_dist(gen);
+            for (std::size_t j = 0; j != n; ++j) topic.push_back(chars[char_dist(gen)]);
+        }
+        topic.resize(length);
+        if (topic.back() == '/') topic.back() = 'x';
+        ret.push_back(std::move(topic));
+    }
+    return ret;
+}
+
+// "a/b/c/d" -> "a/+/c/#"
+std::vector<std::string> make_filters(std::vector<std::string> const& topics) {
+    std::vector<std::string> ret;
+    ret.reserve(topics.size());
+    for (auto const& topic : topics) {
+        std::vector<std::string_view> levels;
+        am::topic_filter_tokenizer(
+            topic,
+            [&](std::string_view level) {
+                levels.push_back(level);
+                return true;
+            }
+        );
+        std::string filter;
+        for (std::size_t i = 0; i != levels.size(); ++i) {
+            if (i != 0) filter.push_back('/');
+            if (i == 1) {
+                filter.push_back('+');
+            }
+            else if (i != 0 && i == levels.size() - 1) {
+                filter.push_back('#');
+            }
+            else {
+                filter.append(levels[i]);
+            }
+        }
+        ret.push_back(std::move(filter));
+    }
+    return ret;
+}
+
+// Keeps the results observable so that the measured calls are not optimized away.
+volatile std::size_t observed = 0;
+
+// Returns nanoseconds per call of f on one topic.
+template <typename Func>
+double measure(std::vector<std::string> const& topics, std::size_t iterations, Func f) {
+    std::size_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i != iterations; ++i) {
+        for (auto const& topic : topics) {
+            sink += f(std::string_view{topic});
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    observed = sink;
+    auto ns = std::chrono::duration<double, std::nano>(end - start).count();
+    return ns / static_cast<double>(iterations * topics.size());
+}
+
+} // anonymous namespace
+
+int main(int argc, char *argv[]) {
+    try {
+        boost::program_options::options_description desc("topic filter bench options");
+        desc.add_options()
+            ("help", "produce help message")
+            (
+                "length",
+                boost::program_options::value<std::vector<std::size_t>>()->multitoken()
+                    ->default_value(std::vector<std::size_t>{16, 32, 64, 128, 256}, "16 32 64 128 256"),
+                "topic lengths to measure"
+            )
+            (
+                "level_size",
+                boost::program_options::value<std::size_t>()->default_value(8),
+                "each topic level is level_size or level_size + 1 characters long"
+            )
+            (
+                "topics",
+                boost::program_options::value<std::size_t>()->default_value(1000),
+                "number of different topics for each length"
+            )
+            (
+                "iterations",
+                boost::program_options::value<std::size_t>()->default_value(1000),
+                "number of passes over the topics"
+            )
+            (
+                "seed",
+                boost::program_options::value<unsigned int>()->default_value(12345),
+                "random seed to generate topics"
+            )
+            ;
+
+        boost::program_options::variables_map vm;
+        boost::program_options::store(boost::program_options::parse_command_line(argc, argv, desc), vm);
+        boost::program_options::notify(vm);
+
+        if (vm.count("help")) {
+            std::cout << desc << std::endl;
+            return 1;
+        }
+
+        auto lengths = vm["length"].as<std::vector<std::size_t>>();
+        auto level_size = vm["level_size"].as<std::size_t>();
+        auto topics_count = vm["topics"].as<std::size_t>();
+        auto iterations = vm["iterations"].as<std::size_t>();
+        if (level_size == 0 || topics_count == 0 || iterations == 0) {
+            std::cerr << "level_size, topics, and iterations must be greater than 0" << std::endl;
+            return -1;
+        }
+        std::mt19937 gen{vm["seed"].as<unsigned int>()};
+
+        std::cout << "scan: "
+#if defined(ASYNC_MQTT_BROKER_TOPIC_AVX2)
+                  << "AVX2"
+#elif defined(ASYNC_MQTT_BROKER_TOPIC_SSE2)
+                  << "SSE2"
+#else
+                  << "scalar"
+#endif
+                  << std::endl;
+        std::cout << "ns per topic" << std::endl;
+        std::cout
+            << std::setw(8) << "length"
+            << std::setw(12) << "tokenize"
+            << std::setw(12) << "tok_iter"
+            << std::setw(12) << "valid_name"
+            << std::setw(12) << "valid_filt"
+            << std::endl;
+
+        for (auto length : lengths) {
+            if (length == 0) continue;
+            auto topics = make_topics(gen, topics_count, length, level_size);
+            auto filters = make_filters(topics);
+
+            // topic_filter_tokenizer(std::string_view, ...) uses the vectorized scan.
+            auto tokenize = measure(
+                topics,
+                iterations,
+                [](std::string_view topic) {
+                    std::size_t size = 0;
+                    am::topic_filter_tokenizer(
+                        topic,
+                        [&](std::string_view level) {
+                            size += level.size();
+                            return true;
+                        }
+                    );
+                    return size;
+                }
+            );
+            // The iterator overload is the std::find based implementation.
+            auto tok_iter = measure(
+                topics,
+                iterations,
+                [](std::string_view topic) {
+                    std::size_t size = 0;
+                    am::topic_filter_tokenizer(
+                        topic.begin(),
+                        topic.end(),
+                        [&](auto first, auto last) {
+                            size += static_cast<std::size_t>(std::distance(first, last));
+                            return true;
+                        }
+                    );
+                    return size;
+                }
+            );
+            auto valid_name = measure(
+                topics,
+                iterations,
+                [](std::string_view topic) {
+                    return std::size_t(am::validate_topic_name(topic));
+                }
+            );
+            auto valid_filt = measure(
+                filters,
+                iterations,
+                [](std::string_view filter) {
+                    return std::size_t(am::validate_topic_filter(filter));
+                }
+            );
+
+            std::cout
+                << std::fixed << std::setprecision(1)
+                << std::setw(8) << length
+                << std::setw(12) << tokenize
+                << std::setw(12) << tok_iter
+                << std::setw(12) << valid_name
+                << std::setw(12) << valid_filt
+                << std::endl;
+        }
+    }
+    catch(std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
+}